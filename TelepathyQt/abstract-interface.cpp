@@ -24,9 +24,11 @@
 
 #include "TelepathyQt/_gen/abstract-interface.moc.hpp"
 
+#include "TelepathyQt/dbus-metrics-internal.h"
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusMetrics>
 #include <TelepathyQt/DBusProxy>
 #include <TelepathyQt/PendingVariant>
 #include <TelepathyQt/PendingVariantMap>
@@ -67,6 +69,10 @@ AbstractInterface::AbstractInterface(const QString &busName,
     : QDBusAbstractInterface(busName, path, interface.latin1(), dbusConnection, parent),
       mPriv(new Private)
 {
+    if (DBusMetrics::isEnabled()) {
+        new DBusMetricsSignalWatcher(connection(), service(), this->path(), this->interface(),
+                this);
+    }
 }
 
 AbstractInterface::AbstractInterface(DBusProxy *parent, const QLatin1String &interface)
@@ -76,6 +82,10 @@ AbstractInterface::AbstractInterface(DBusProxy *parent, const QLatin1String &int
 {
     connect(parent, SIGNAL(invalidated(Tp::DBusProxy*,QString,QString)),
             this, SLOT(invalidate(Tp::DBusProxy*,QString,QString)));
+
+    if (DBusMetrics::isEnabled()) {
+        new DBusMetricsSignalWatcher(connection(), service(), path(), this->interface(), this);
+    }
 }
 
 AbstractInterface::~AbstractInterface()
@@ -114,7 +124,7 @@ PendingVariant *AbstractInterface::internalRequestProperty(const QString &name)
     QDBusMessage msg = QDBusMessage::createMethodCall(service(), path(),
             TP_QT_IFACE_PROPERTIES, QLatin1String("Get"));
     msg << interface() << name;
-    QDBusPendingCall pendingCall = connection().asyncCall(msg);
+    QDBusPendingCall pendingCall = internalAsyncCall(msg);
     DBusProxy *proxy = qobject_cast<DBusProxy*>(parent());
     return new PendingVariant(pendingCall, DBusProxyPtr(proxy));
 }
@@ -125,7 +135,7 @@ PendingOperation *AbstractInterface::internalSetProperty(const QString &name,
     QDBusMessage msg = QDBusMessage::createMethodCall(service(), path(),
             TP_QT_IFACE_PROPERTIES, QLatin1String("Set"));
     msg << interface() << name << QVariant::fromValue(QDBusVariant(newValue));
-    QDBusPendingCall pendingCall = connection().asyncCall(msg);
+    QDBusPendingCall pendingCall = internalAsyncCall(msg);
     DBusProxy *proxy = qobject_cast<DBusProxy*>(parent());
     return new PendingVoid(pendingCall, DBusProxyPtr(proxy));
 }
@@ -135,11 +145,32 @@ PendingVariantMap *AbstractInterface::internalRequestAllProperties() const
     QDBusMessage msg = QDBusMessage::createMethodCall(service(), path(),
             TP_QT_IFACE_PROPERTIES, QLatin1String("GetAll"));
     msg << interface();
-    QDBusPendingCall pendingCall = connection().asyncCall(msg);
+    QDBusPendingCall pendingCall = internalAsyncCall(msg);
     DBusProxy *proxy = qobject_cast<DBusProxy*>(parent());
     return new PendingVariantMap(pendingCall, DBusProxyPtr(proxy));
 }
 
+/**
+ * Send the method call \a message asynchronously on the bus of this interface.
+ *
+ * This is what the generated method wrappers use. It behaves like QDBusConnection::asyncCall(),
+ * except that the call is accounted for by DBusMetrics when metrics collection is enabled.
+ *
+ * \param message The method call message to send.
+ * \param timeout The timeout in milliseconds, or -1 for the default timeout.
+ * \return A QDBusPendingCall object tracking the call.
+ */
+QDBusPendingCall AbstractInterface::internalAsyncCall(const QDBusMessage &message,
+        int timeout) const
+{
+    QDBusPendingCall pendingCall = connection().asyncCall(message, timeout);
+    if (DBusMetrics::isEnabled()) {
+        new DBusMetricsCallWatcher(pendingCall, message.interface(), message.member(),
+                const_cast<AbstractInterface *>(this));
+    }
+    return pendingCall;
+}
+
 /**
  * Sets whether this abstract interface will be monitoring properties or not. If it's set to monitor,
  * the signal propertiesChanged will be emitted whenever a property on this interface will
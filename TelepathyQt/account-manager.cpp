@@ -37,6 +37,13 @@
 #include <TelepathyQt/PendingReady>
 #include <TelepathyQt/ReadinessHelper>
 
+#include <QByteArray>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QMetaObject>
 #include <QQueue>
 #include <QSet>
 #include <QTimer>
@@ -60,7 +67,13 @@ struct TP_QT_NO_EXPORT AccountManager::Private
 
     QSet<QString> getAccountPathsFromProp(const QVariant &prop);
     QSet<QString> getAccountPathsFromProps(const QVariantMap &props);
-    void addAccountForPath(const QString &accountObjectPath);
+    void addAccountForPath(const QString &accountObjectPath,
+            const QVariantMap &snapshotProperties = QVariantMap());
+    void removeAccountForPath(const QString &accountObjectPath);
+
+    bool loadSnapshot();
+    void scheduleSnapshotSave();
+    void saveSnapshot();
 
     // Public object
     AccountManager *parent;
@@ -84,11 +97,23 @@ struct TP_QT_NO_EXPORT AccountManager::Private
     QHash<QString, AccountPtr> incompleteAccounts;
     QHash<QString, AccountPtr> accounts;
     QStringList supportedAccountProperties;
+
+    // Warm start: when the accounts were restored from a snapshot, the GetAll(AccountManager)
+    // reply only reconciles them with the accounts actually there
+    QString snapshotFileName;
+    bool usingSnapshot;
+    bool snapshotSaveScheduled;
+    // The snapshot as last loaded or saved, so that it is only written again when it changes
+    QByteArray savedSnapshot;
 };
 
 static const int maxReintrospectionRetries = 5;
 static const int reintrospectionRetryInterval = 3;
 
+// "TpAM", followed by the format version, which must be bumped whenever the layout changes
+static const quint32 snapshotMagic = 0x5470414d;
+static const quint32 snapshotVersion = 1;
+
 AccountManager::Private::Private(AccountManager *parent,
         const AccountFactoryConstPtr &accFactory, const ConnectionFactoryConstPtr &connFactory,
         const ChannelFactoryConstPtr &chanFactory, const ContactFactoryConstPtr &contactFactory)
@@ -101,7 +126,9 @@ AccountManager::Private::Private(AccountManager *parent,
       chanFactory(chanFactory),
       contactFactory(contactFactory),
       reintrospectionRetries(0),
-      gotInitialAccounts(false)
+      gotInitialAccounts(false),
+      usingSnapshot(false),
+      snapshotSaveScheduled(false)
 {
     debug() << "Creating new AccountManager:" << parent->busName();
 
@@ -155,6 +182,11 @@ void AccountManager::Private::init()
 
 void AccountManager::Private::introspectMain(AccountManager::Private *self)
 {
+    if (!self->gotInitialAccounts && !self->snapshotFileName.isEmpty() && self->loadSnapshot()) {
+        // The accounts restored from the snapshot may already be enough to finish FeatureCore
+        self->checkIntrospectionCompleted();
+    }
+
     debug() << "Calling Properties::GetAll(AccountManager)";
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
             self->properties->GetAll(
@@ -170,6 +202,7 @@ void AccountManager::Private::checkIntrospectionCompleted()
     if (!parent->isReady(FeatureCore) &&
         incompleteAccounts.size() == 0) {
         readinessHelper->setIntrospectCompleted(FeatureCore, true);
+        scheduleSnapshotSave();
     }
 }
 
@@ -208,7 +241,8 @@ QSet<QString> AccountManager::Private::getAccountPathsFromProps(
             getAccountPathsFromProp(props[QLatin1String("InvalidAccounts")]));
 }
 
-void AccountManager::Private::addAccountForPath(const QString &path)
+void AccountManager::Private::addAccountForPath(const QString &path,
+        const QVariantMap &snapshotProperties)
 {
     // Also check incompleteAccounts, because otherwise we end up introspecting an account twice
     // when getting an AccountValidityChanged signal for a new account before we get the initial
@@ -223,12 +257,157 @@ void AccountManager::Private::addAccountForPath(const QString &path)
     AccountPtr account(AccountPtr::qObjectCast(readyOp->proxy()));
     Q_ASSERT(!account.isNull());
 
+    if (!snapshotProperties.isEmpty()) {
+        account->setSnapshotProperties(snapshotProperties);
+    }
+
     parent->connect(readyOp,
             SIGNAL(finished(Tp::PendingOperation*)),
             SLOT(onAccountReady(Tp::PendingOperation*)));
     incompleteAccounts.insert(path, account);
 }
 
+void AccountManager::Private::removeAccountForPath(const QString &path)
+{
+    AccountPtr account = accounts.take(path);
+    if (!account) {
+        account = incompleteAccounts.take(path);
+    }
+
+    if (account && account->isValid()) {
+        account->onRemoved();
+    }
+
+    scheduleSnapshotSave();
+}
+
+bool AccountManager::Private::loadSnapshot()
+{
+    QFile file(snapshotFileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        debug() << "No account snapshot to restore from" << snapshotFileName;
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_4_6);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != snapshotMagic ||
+            version != snapshotVersion) {
+        warning() << "Ignoring account snapshot" << snapshotFileName <<
+            "with an unknown format";
+        return false;
+    }
+
+    QString busName;
+    QStringList amInterfaces;
+    QStringList amSupportedAccountProperties;
+    QMap<QString, QVariantMap> accountsProperties;
+    stream >> busName >> amInterfaces >> amSupportedAccountProperties >> accountsProperties;
+    if (stream.status() != QDataStream::Ok) {
+        warning() << "Ignoring corrupted account snapshot" << snapshotFileName;
+        return false;
+    }
+
+    if (busName != parent->busName()) {
+        debug() << "Ignoring account snapshot" << snapshotFileName << "taken for" << busName;
+        return false;
+    }
+
+    debug() << "Restoring" << accountsProperties.size() << "accounts from snapshot" <<
+        snapshotFileName;
+
+    parent->setInterfaces(amInterfaces);
+    readinessHelper->setInterfaces(amInterfaces);
+    supportedAccountProperties = amSupportedAccountProperties;
+
+    gotInitialAccounts = true;
+    usingSnapshot = true;
+    savedSnapshot = data;
+
+    QMap<QString, QVariantMap>::const_iterator i = accountsProperties.constBegin();
+    for (; i != accountsProperties.constEnd(); ++i) {
+        addAccountForPath(i.key(), i.value());
+    }
+
+    return true;
+}
+
+void AccountManager::Private::scheduleSnapshotSave()
+{
+    if (snapshotFileName.isEmpty() || snapshotSaveScheduled) {
+        return;
+    }
+
+    // Coalesce the changes made in the same main loop iteration, such as the ones from reconciling
+    // a whole account with the account manager on the bus, into a single write
+    snapshotSaveScheduled = true;
+    QMetaObject::invokeMethod(parent, "saveSnapshot", Qt::QueuedConnection);
+}
+
+void AccountManager::Private::saveSnapshot()
+{
+    QMap<QString, QVariantMap> accountsProperties;
+    foreach (const AccountPtr &account, accounts) {
+        if (account->isValid()) {
+            accountsProperties.insert(account->objectPath(), account->snapshotProperties());
+        }
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_6);
+    stream << snapshotMagic << snapshotVersion << parent->busName() << parent->interfaces() <<
+        supportedAccountProperties << accountsProperties;
+    if (data == savedSnapshot) {
+        return;
+    }
+
+    // The snapshot holds the account properties, including the user's own identities, so only
+    // the user may read it
+    QString dirName = QFileInfo(snapshotFileName).absolutePath();
+    if (!QDir(dirName).exists()) {
+        if (!QDir().mkpath(dirName)) {
+            warning() << "Unable to create directory" << dirName;
+            return;
+        }
+        QFile::setPermissions(dirName,
+                QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    }
+
+    // Write to a temporary file first, so that a crash never leaves a truncated snapshot behind
+    QString tmpFileName = snapshotFileName + QLatin1String(".tmp");
+    QFile file(tmpFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        !file.setPermissions(QFile::ReadOwner | QFile::WriteOwner)) {
+        warning() << "Unable to write the account snapshot" << tmpFileName << ":" <<
+            file.errorString();
+        return;
+    }
+
+    file.write(data);
+    file.close();
+
+    if (file.error() != QFile::NoError) {
+        warning() << "Writing the account snapshot" << tmpFileName << "failed";
+        QFile::remove(tmpFileName);
+        return;
+    }
+
+    QFile::remove(snapshotFileName);
+    if (!QFile::rename(tmpFileName, snapshotFileName)) {
+        warning() << "Unable to move the account snapshot to" << snapshotFileName;
+        QFile::remove(tmpFileName);
+        return;
+    }
+
+    savedSnapshot = data;
+    debug() << "Saved" << accountsProperties.size() << "accounts to snapshot" << snapshotFileName;
+}
+
 /**
  * \class AccountManager
  * \ingroup clientam
@@ -1004,6 +1183,45 @@ QStringList AccountManager::supportedAccountProperties() const
     return mPriv->supportedAccountProperties;
 }
 
+/**
+ * Return the name of the file the accounts are restored from and saved to, if any.
+ *
+ * \return The snapshot file name, or an empty string if no snapshot is used.
+ * \sa setSnapshotFileName()
+ */
+QString AccountManager::snapshotFileName() const
+{
+    return mPriv->snapshotFileName;
+}
+
+/**
+ * Set the name of the file the accounts are restored from and saved to.
+ *
+ * When a snapshot file is set, the account manager saves the basic properties of its accounts
+ * (such as the display name, icon, nickname, validity, enabledness and presences) to it once
+ * FeatureCore is ready, and again whenever they change or accounts are added or removed. The
+ * account parameters, which may contain passwords, and the connection status are never saved.
+ *
+ * On the next run, if the snapshot is present and valid, the accounts are restored from it
+ * right away instead of having to wait for every account to be introspected, and FeatureCore
+ * finishes as soon as the features requested from the AccountFactory are ready for the restored
+ * accounts. The snapshot is then reconciled with the account manager on the bus in the
+ * background: accounts which are gone are removed, emitting Account::removed(), new ones are
+ * signalled by newAccount(), and the properties which changed are updated, emitting the usual
+ * change notification signals.
+ *
+ * Restoring from the snapshot only happens if this method is called before FeatureCore is
+ * introspected, that is right after creating the account manager and before returning to the
+ * main loop.
+ *
+ * \param fileName The snapshot file name, or an empty string to not use a snapshot.
+ * \sa snapshotFileName()
+ */
+void AccountManager::setSnapshotFileName(const QString &fileName)
+{
+    mPriv->snapshotFileName = fileName;
+}
+
 /**
  * Create an account with the given parameters.
  *
@@ -1071,11 +1289,26 @@ void AccountManager::gotMainProperties(QDBusPendingCallWatcher *watcher)
         }
 
         QSet<QString> paths = mPriv->getAccountPathsFromProps(props);
+
+        if (mPriv->usingSnapshot) {
+            // Drop the restored accounts which are gone since the snapshot was taken
+            QSet<QString> restoredPaths = QSet<QString>::fromList(mPriv->accounts.keys()) +
+                QSet<QString>::fromList(mPriv->incompleteAccounts.keys());
+            foreach (const QString &path, restoredPaths - paths) {
+                debug() << "Account" << path << "from the snapshot is gone";
+                mPriv->removeAccountForPath(path);
+            }
+        }
+
         foreach (const QString &path, paths) {
             mPriv->addAccountForPath(path);
         }
 
         mPriv->checkIntrospectionCompleted();
+    } else if (mPriv->usingSnapshot) {
+        // Keep going with the accounts restored from the snapshot
+        warning() << "GetAll(AccountManager) failed, unable to reconcile the account snapshot:" <<
+            reply.error().name() << ":" << reply.error().message();
     } else {
         if (mPriv->reintrospectionRetries++ < maxReintrospectionRetries) {
             int retryInterval = reintrospectionRetryInterval;
@@ -1114,6 +1347,26 @@ void AccountManager::onAccountReady(Tp::PendingOperation *op)
     Q_ASSERT(!mPriv->accounts.contains(path));
     mPriv->accounts.insert(path, account);
 
+    if (!mPriv->snapshotFileName.isEmpty()) {
+        // The properties saved to the snapshot, see Account::snapshotProperties()
+        const char *signalsToWatch[] = {
+            SIGNAL(serviceNameChanged(QString)),
+            SIGNAL(displayNameChanged(QString)),
+            SIGNAL(iconNameChanged(QString)),
+            SIGNAL(nicknameChanged(QString)),
+            SIGNAL(normalizedNameChanged(QString)),
+            SIGNAL(validityChanged(bool)),
+            SIGNAL(stateChanged(bool)),
+            SIGNAL(connectsAutomaticallyPropertyChanged(bool)),
+            SIGNAL(firstOnline()),
+            SIGNAL(automaticPresenceChanged(Tp::Presence)),
+            SIGNAL(requestedPresenceChanged(Tp::Presence)),
+        };
+        for (uint i = 0; i < sizeof(signalsToWatch) / sizeof(signalsToWatch[0]); ++i) {
+            connect(account.data(), signalsToWatch[i], SLOT(onAccountSnapshotChanged()));
+        }
+    }
+
     if (isReady(FeatureCore)) {
         emit newAccount(account);
     }
@@ -1148,6 +1401,7 @@ void AccountManager::onAccountRemoved(const QDBusObjectPath &objectPath)
     /* the account is either in mPriv->incompleteAccounts or mPriv->accounts */
     if (mPriv->accounts.contains(path)) {
         mPriv->accounts.remove(path);
+        mPriv->scheduleSnapshotSave();
 
         if (isReady(FeatureCore)) {
             debug() << "Account" << path << "removed";
@@ -1164,6 +1418,19 @@ void AccountManager::onAccountRemoved(const QDBusObjectPath &objectPath)
     }
 }
 
+void AccountManager::onAccountSnapshotChanged()
+{
+    mPriv->scheduleSnapshotSave();
+}
+
+void AccountManager::saveSnapshot()
+{
+    mPriv->snapshotSaveScheduled = false;
+    if (isReady(FeatureCore)) {
+        mPriv->saveSnapshot();
+    }
+}
+
 /**
  * \fn void AccountManager::newAccount(const Tp::AccountPtr &account)
  *
@@ -118,6 +118,10 @@ public:
     TP_QT_DEPRECATED QList<AccountPtr> accountsForPaths(const QStringList &paths) const;
 
     QStringList supportedAccountProperties() const;
+
+    QString snapshotFileName() const;
+    void setSnapshotFileName(const QString &fileName);
+
     PendingAccount *createAccount(const QString &connectionManager,
             const QString &protocol, const QString &displayName,
             const QVariantMap &parameters,
@@ -143,6 +147,8 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void onAccountValidityChanged(const QDBusObjectPath &objectPath,
             bool valid);
     TP_QT_NO_EXPORT void onAccountRemoved(const QDBusObjectPath &objectPath);
+    TP_QT_NO_EXPORT void onAccountSnapshotChanged();
+    TP_QT_NO_EXPORT void saveSnapshot();
 
 private:
     friend class PendingAccount;
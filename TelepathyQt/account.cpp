@@ -36,6 +36,7 @@
 #include <TelepathyQt/ConnectionCapabilities>
 #include <TelepathyQt/ConnectionLowlevel>
 #include <TelepathyQt/ConnectionManager>
+#include <TelepathyQt/ContactManager>
 #include <TelepathyQt/PendingChannel>
 #include <TelepathyQt/PendingChannelRequest>
 #include <TelepathyQt/PendingFailure>
@@ -45,6 +46,7 @@
 #include <TelepathyQt/PendingVoid>
 #include <TelepathyQt/Profile>
 #include <TelepathyQt/ReferencedHandles>
+#include <TelepathyQt/Utils>
 #include <TelepathyQt/Constants>
 #include <TelepathyQt/Debug>
 
@@ -530,8 +532,10 @@ struct TP_QT_NO_EXPORT Account::Private
     static void introspectCapabilities(Private *self);
 
     void updateProperties(const QVariantMap &props);
+    void finishMainIntrospection();
     void retrieveAvatar();
     bool processConnQueue();
+    QString contactAttributeCacheFileName() const;
 
     bool checkCapabilitiesChanged(bool profileChanged);
 
@@ -582,11 +586,20 @@ struct TP_QT_NO_EXPORT Account::Private
     Presence requestedPresence;
     bool usingConnectionCaps;
     ConnectionCapabilities customCaps;
+    bool contactAttributeCacheEnabled;
+
+    // Properties seeded from an AccountManager snapshot: FeatureCore is finished with these, and
+    // the GetAll reply then only reconciles them with the actual values
+    QVariantMap snapshotProperties;
+    bool reconciling;
 
     // The contexts should never be removed from the map, to guarantee O(1) CD introspections per bus
     struct DispatcherContext;
     static QHash<QString, QSharedPointer<DispatcherContext> > dispatcherContexts;
     QSharedPointer<DispatcherContext> dispatcherContext;
+
+    // Accounts for the same CM share its proxy, so that its protocols are only introspected once
+    static QHash<QString, WeakPtr<ConnectionManager> > connectionManagers;
 };
 
 struct Account::Private::DispatcherContext
@@ -631,6 +644,8 @@ Account::Private::Private(Account *parent, const ConnectionFactoryConstPtr &conn
       connectionStatus(ConnectionStatusDisconnected),
       connectionStatusReason(ConnectionStatusReasonNoneSpecified),
       usingConnectionCaps(false),
+      contactAttributeCacheEnabled(false),
+      reconciling(false),
       dispatcherContext(dispatcherContexts.value(parent->dbusConnection().name()))
 {
     // FIXME: QRegExp probably isn't the most efficient possible way to parse
@@ -759,6 +774,7 @@ QString Account::Private::connectionObjectPath() const
 }
 
 QHash<QString, QSharedPointer<Account::Private::DispatcherContext> > Account::Private::dispatcherContexts;
+QHash<QString, WeakPtr<ConnectionManager> > Account::Private::connectionManagers;
 
 /**
  * \class Account
@@ -1058,6 +1074,37 @@ ContactFactoryConstPtr Account::contactFactory() const
     return mPriv->contactFactory;
 }
 
+/**
+ * Return whether the attributes of the contact list contacts of this account are cached on disk.
+ *
+ * \return \c true if the contact attribute cache is enabled, \c false otherwise.
+ * \sa setContactAttributeCacheEnabled()
+ */
+bool Account::isContactAttributeCacheEnabled() const
+{
+    return mPriv->contactAttributeCacheEnabled;
+}
+
+/**
+ * Set whether the attributes of the contact list contacts of this account should be cached on
+ * disk.
+ *
+ * When enabled, the contact manager of each connection built by this account is given a cache
+ * file under the user cache directory, named after uniqueIdentifier(). This makes the contact
+ * list usable right after reconnecting, without waiting for the attributes of every contact to be
+ * retrieved again. See ContactManager::setAttributeCacheFileName() for details.
+ *
+ * The setting only applies to connections built after it is changed, so it should be set before
+ * the account goes online.
+ *
+ * \param enabled Whether the contact attribute cache should be enabled.
+ * \sa isContactAttributeCacheEnabled()
+ */
+void Account::setContactAttributeCacheEnabled(bool enabled)
+{
+    mPriv->contactAttributeCacheEnabled = enabled;
+}
+
 /**
  * Return whether this account is valid.
  *
@@ -4181,6 +4228,78 @@ Client::ChannelDispatcherInterface *Account::dispatcherInterface() const
     return mPriv->dispatcherContext->iface;
 }
 
+namespace
+{
+
+QVariantList presenceToSnapshot(const Presence &presence)
+{
+    return QVariantList() << static_cast<uint>(presence.type()) << presence.status() <<
+        presence.statusMessage();
+}
+
+QVariant presenceFromSnapshot(const QVariant &value)
+{
+    QVariantList list = value.toList();
+    SimplePresence presence;
+    presence.type = list.value(0).toUInt();
+    presence.status = list.value(1).toString();
+    presence.statusMessage = list.value(2).toString();
+    return QVariant::fromValue(presence);
+}
+
+}
+
+/*
+ * Return the properties of this account worth restoring when starting up again, using only
+ * types which QDataStream can serialize.
+ *
+ * The connection related properties are left out, as they are unlikely to still be accurate by
+ * then, and so are the parameters, which may contain passwords.
+ */
+QVariantMap Account::snapshotProperties() const
+{
+    QVariantMap props;
+    props.insert(QLatin1String("Interfaces"), interfaces());
+    props.insert(QLatin1String("Service"), mPriv->serviceName);
+    props.insert(QLatin1String("DisplayName"), mPriv->displayName);
+    props.insert(QLatin1String("Icon"), mPriv->iconName);
+    props.insert(QLatin1String("Nickname"), mPriv->nickname);
+    props.insert(QLatin1String("NormalizedName"), mPriv->normalizedName);
+    props.insert(QLatin1String("Valid"), mPriv->valid);
+    props.insert(QLatin1String("Enabled"), mPriv->enabled);
+    props.insert(QLatin1String("ConnectAutomatically"), mPriv->connectsAutomatically);
+    props.insert(QLatin1String("HasBeenOnline"), mPriv->hasBeenOnline);
+    props.insert(QLatin1String("AutomaticPresence"),
+            presenceToSnapshot(mPriv->automaticPresence));
+    props.insert(QLatin1String("RequestedPresence"),
+            presenceToSnapshot(mPriv->requestedPresence));
+    return props;
+}
+
+/*
+ * Seed the properties of this account with \a props, as returned by snapshotProperties() in a
+ * previous run, so that FeatureCore can be finished without waiting for the GetAll reply.
+ *
+ * This has no effect if FeatureCore has already been introspected.
+ */
+void Account::setSnapshotProperties(const QVariantMap &props)
+{
+    if (mPriv->coreFinished || mPriv->mayFinishCore) {
+        // Already introspected, for example because the factory returned a cached proxy
+        return;
+    }
+
+    mPriv->snapshotProperties = props;
+
+    QStringList presenceProps;
+    presenceProps << QLatin1String("AutomaticPresence") << QLatin1String("RequestedPresence");
+    foreach (const QString &prop, presenceProps) {
+        if (props.contains(prop)) {
+            mPriv->snapshotProperties.insert(prop, presenceFromSnapshot(props.value(prop)));
+        }
+    }
+}
+
 /**** Private ****/
 void Account::Private::init()
 {
@@ -4237,9 +4356,32 @@ void Account::Private::introspectProtocolInfo(Account::Private *self)
 {
     Q_ASSERT(!self->cm);
 
-    self->cm = ConnectionManager::create(
-            self->parent->dbusConnection(), self->cmName,
-            self->connFactory, self->chanFactory, self->contactFactory);
+    // The CM proxy also carries the factories used for the connections it creates, so only share
+    // it between accounts using the same ones
+    QString key = QString(QLatin1String("%1 %2 %3 %4 %5"))
+        .arg(self->parent->dbusConnection().name())
+        .arg(self->cmName)
+        .arg((quintptr) self->connFactory.data())
+        .arg((quintptr) self->chanFactory.data())
+        .arg((quintptr) self->contactFactory.data());
+
+    self->cm = ConnectionManagerPtr(connectionManagers.value(key));
+    if (!self->cm) {
+        QHash<QString, WeakPtr<ConnectionManager> >::iterator i = connectionManagers.begin();
+        while (i != connectionManagers.end()) {
+            if (i.value().isNull()) {
+                i = connectionManagers.erase(i);
+            } else {
+                ++i;
+            }
+        }
+
+        self->cm = ConnectionManager::create(
+                self->parent->dbusConnection(), self->cmName,
+                self->connFactory, self->chanFactory, self->contactFactory);
+        connectionManagers.insert(key, WeakPtr<ConnectionManager>(self->cm));
+    }
+
     self->parent->connect(self->cm->becomeReady(),
             SIGNAL(finished(Tp::PendingOperation*)),
             SLOT(onConnectionManagerReady(Tp::PendingOperation*)));
@@ -4526,6 +4668,20 @@ void Account::Private::updateProperties(const QVariantMap &props)
     }
 }
 
+void Account::Private::finishMainIntrospection()
+{
+    readinessHelper->setInterfaces(parent->interfaces());
+    mayFinishCore = true;
+
+    if (connObjPathQueue.isEmpty()) {
+        debug() << "Account basic functionality is ready";
+        coreFinished = true;
+        readinessHelper->setIntrospectCompleted(FeatureCore, true);
+    } else {
+        debug() << "Deferring finishing Account::FeatureCore until the connection is built";
+    }
+}
+
 void Account::Private::retrieveAvatar()
 {
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
@@ -4562,7 +4718,17 @@ bool Account::Private::processConnQueue()
             }
 
             QString busName = path.mid(1).replace(QLatin1String("/"), QLatin1String("."));
-            parent->connect(connFactory->proxy(busName, path, chanFactory, contactFactory),
+            PendingReady *readyOp = connFactory->proxy(busName, path, chanFactory, contactFactory);
+
+            // The roster is only introspected once the connection is ready, so there is still
+            // time to point its contact manager to the cache
+            ConnectionPtr conn = ConnectionPtr::qObjectCast(readyOp->proxy());
+            if (contactAttributeCacheEnabled && conn) {
+                conn->contactManager()->setAttributeCacheFileName(
+                        contactAttributeCacheFileName());
+            }
+
+            parent->connect(readyOp,
                     SIGNAL(finished(Tp::PendingOperation*)),
                     SLOT(onConnectionBuilt(Tp::PendingOperation*)));
 
@@ -4574,6 +4740,17 @@ bool Account::Private::processConnQueue()
     return true;
 }
 
+QString Account::Private::contactAttributeCacheFileName() const
+{
+    QString cacheDir = QString(QLatin1String(qgetenv("XDG_CACHE_HOME")));
+    if (cacheDir.isEmpty()) {
+        cacheDir = QString(QLatin1String("%1/.cache")).arg(QLatin1String(qgetenv("HOME")));
+    }
+
+    return QString(QLatin1String("%1/telepathy/contacts/%2")).
+        arg(cacheDir).arg(escapeAsIdentifier(parent->uniqueIdentifier()));
+}
+
 void Account::onDispatcherIntrospected(Tp::PendingOperation *op)
 {
     if (!mPriv->dispatcherContext->introspected) {
@@ -4601,6 +4778,14 @@ void Account::onDispatcherIntrospected(Tp::PendingOperation *op)
         }
     }
 
+    if (!mPriv->snapshotProperties.isEmpty()) {
+        debug() << "Using the snapshot properties of" << objectPath();
+        mPriv->updateProperties(mPriv->snapshotProperties);
+        mPriv->snapshotProperties.clear();
+        mPriv->reconciling = true;
+        mPriv->finishMainIntrospection();
+    }
+
     debug() << "Calling Properties::GetAll(Account) on " << objectPath();
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
             mPriv->properties->GetAll(
@@ -4614,20 +4799,23 @@ void Account::gotMainProperties(QDBusPendingCallWatcher *watcher)
 {
     QDBusPendingReply<QVariantMap> reply = *watcher;
 
-    if (!reply.isError()) {
-        debug() << "Got reply to Properties.GetAll(Account) for" << objectPath();
-        mPriv->updateProperties(reply.value());
-
-        mPriv->readinessHelper->setInterfaces(interfaces());
-        mPriv->mayFinishCore = true;
+    if (mPriv->reconciling) {
+        mPriv->reconciling = false;
 
-        if (mPriv->connObjPathQueue.isEmpty()) {
-            debug() << "Account basic functionality is ready";
-            mPriv->coreFinished = true;
-            mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, true);
+        if (!reply.isError()) {
+            debug() << "Reconciling the snapshot of" << objectPath() << "with the actual properties";
+            mPriv->updateProperties(reply.value());
+            mPriv->readinessHelper->setInterfaces(interfaces());
         } else {
-            debug() << "Deferring finishing Account::FeatureCore until the connection is built";
+            // FeatureCore is already finished, and the AccountManager will tell us if we're gone
+            warning().nospace() <<
+                "GetAll(Account) failed, keeping the snapshot properties: " <<
+                reply.error().name() << ": " << reply.error().message();
         }
+    } else if (!reply.isError()) {
+        debug() << "Got reply to Properties.GetAll(Account) for" << objectPath();
+        mPriv->updateProperties(reply.value());
+        mPriv->finishMainIntrospection();
     } else {
         mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false, reply.error());
 
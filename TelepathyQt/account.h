@@ -125,6 +125,9 @@ public:
     ChannelFactoryConstPtr channelFactory() const;
     ContactFactoryConstPtr contactFactory() const;
 
+    bool isContactAttributeCacheEnabled() const;
+    void setContactAttributeCacheEnabled(bool enabled);
+
     bool isValidAccount() const;
 
     bool isEnabled() const;
@@ -597,6 +600,11 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void onConnectionBuilt(Tp::PendingOperation *);
 
 private:
+    friend class AccountManager; // to seed and save the properties snapshot
+
+    TP_QT_NO_EXPORT QVariantMap snapshotProperties() const;
+    TP_QT_NO_EXPORT void setSnapshotProperties(const QVariantMap &props);
+
     struct Private;
     friend struct Private;
 
@@ -0,0 +1,376 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2026 TelepathyQt contributors
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TelepathyQt/async-result-internal.h"
+
+#include "TelepathyQt/debug-internal.h"
+
+#include <TelepathyQt/Constants>
+
+#include <QDBusError>
+#include <QSharedData>
+
+namespace Tp
+{
+
+struct TP_QT_NO_EXPORT AsyncResult::Private : public QSharedData
+{
+    Private()
+        : finished(false),
+          cancelled(false),
+          finishing(false),
+          firstContinuation(0),
+          lastContinuation(0),
+          pendingDependencies(0)
+    {
+    }
+
+    ~Private()
+    {
+        clearContinuations();
+    }
+
+    void clearContinuations();
+
+    bool finished;
+    bool cancelled;
+    // Set while the continuations are being invoked
+    bool finishing;
+    QString errorName;
+    QString errorMessage;
+    ContinuationBase *firstContinuation;
+    ContinuationBase *lastContinuation;
+
+    // Used by whenAll() results: the number of results still to finish, and the first error seen
+    uint pendingDependencies;
+    QString dependencyErrorName;
+    QString dependencyErrorMessage;
+};
+
+void AsyncResult::Private::clearContinuations()
+{
+    while (firstContinuation) {
+        ContinuationBase *continuation = firstContinuation;
+        firstContinuation = continuation->next;
+        delete continuation;
+    }
+    lastContinuation = 0;
+}
+
+struct TP_QT_NO_EXPORT AsyncResult::WhenAllDependency
+{
+    WhenAllDependency(const AsyncResult &combined)
+        : combined(combined)
+    {
+    }
+
+    void operator()(const AsyncResult &result) const
+    {
+        AsyncResult copy(combined);
+        copy.finishDependency(result);
+    }
+
+    AsyncResult combined;
+};
+
+namespace
+{
+
+struct FinishedForwarder
+{
+    FinishedForwarder(const AsyncResult &target)
+        : target(target)
+    {
+    }
+
+    void operator()(const AsyncResult &result) const
+    {
+        AsyncResult copy(target);
+        if (result.isError()) {
+            copy.setFinishedWithError(result.errorName(), result.errorMessage());
+        } else {
+            copy.setFinished();
+        }
+    }
+
+    AsyncResult target;
+};
+
+}
+
+/*
+ * AsyncResult is a lightweight, implicitly shared handle to the outcome of an internal
+ * asynchronous step.
+ *
+ * Unlike PendingOperation, it is not a QObject: finishing it doesn't emit any signal or wait for
+ * the mainloop, and it is destroyed when its last copy goes away rather than via deleteLater(). It
+ * is meant for chaining steps inside the library, for example during introspection. Anything
+ * exposed in the public API should still be a PendingOperation.
+ *
+ * Continuations registered with then() are invoked synchronously, in the order they were added,
+ * from within setFinished() or setFinishedWithError(), or right away if the result is already
+ * finished. This differs from PendingOperation::finished(), which is only emitted from the
+ * mainloop: code finishing a result from the middle of a D-Bus reply handler, while the state the
+ * continuations may look at or change is not consistent yet, has to defer finishing it itself, as
+ * ContactManager::Roster does.
+ *
+ * A cancelled result never invokes its continuations, and ignores any later attempt to finish it.
+ * Cancelling a result while its continuations are being invoked skips the remaining ones. This is
+ * useful when the object the continuations point to is going away.
+ *
+ * Adding a continuation to a pending result takes a single allocation, and none if the result is
+ * already finished. The results returned by createFinished(), and by whenAll() for an empty list,
+ * all share the same data.
+ *
+ * A default-constructed AsyncResult is null: it can't be finished and never invokes any
+ * continuation. Use create() to create a result which will be finished later.
+ */
+
+AsyncResult::AsyncResult()
+{
+}
+
+AsyncResult::AsyncResult(const AsyncResult &other)
+    : mPriv(other.mPriv)
+{
+}
+
+AsyncResult::~AsyncResult()
+{
+}
+
+AsyncResult AsyncResult::create()
+{
+    AsyncResult result;
+    result.mPriv = new Private;
+    return result;
+}
+
+AsyncResult AsyncResult::createFinished()
+{
+    // Never modified again: finishing it again is ignored, and so is cancelling it
+    static AsyncResult finished;
+    if (finished.isNull()) {
+        AsyncResult result = create();
+        result.setFinished();
+        finished = result;
+    }
+    return finished;
+}
+
+AsyncResult AsyncResult::createFinishedWithError(const QString &name, const QString &message)
+{
+    AsyncResult result = create();
+    result.setFinishedWithError(name, message);
+    return result;
+}
+
+/*
+ * Return a result which finishes once all of \a results have finished. It is finished with the
+ * error of the first of them to fail, if any. Null results are ignored. If there is no other
+ * result, the returned result is already finished.
+ */
+AsyncResult AsyncResult::whenAll(const QList<AsyncResult> &results)
+{
+    uint pendingDependencies = 0;
+    foreach (const AsyncResult &result, results) {
+        if (!result.isNull()) {
+            ++pendingDependencies;
+        }
+    }
+
+    if (pendingDependencies == 0) {
+        return createFinished();
+    }
+
+    // Count all of them first, so that already finished results don't finish the combined one early
+    AsyncResult combined = create();
+    combined.mPriv->pendingDependencies = pendingDependencies;
+    foreach (const AsyncResult &result, results) {
+        result.then(WhenAllDependency(combined));
+    }
+
+    return combined;
+}
+
+AsyncResult &AsyncResult::operator=(const AsyncResult &other)
+{
+    mPriv = other.mPriv;
+    return *this;
+}
+
+bool AsyncResult::isFinished() const
+{
+    return mPriv && mPriv->finished;
+}
+
+bool AsyncResult::isValid() const
+{
+    return isFinished() && mPriv->errorName.isEmpty();
+}
+
+bool AsyncResult::isError() const
+{
+    return isFinished() && !mPriv->errorName.isEmpty();
+}
+
+bool AsyncResult::isCancelled() const
+{
+    return mPriv && mPriv->cancelled;
+}
+
+QString AsyncResult::errorName() const
+{
+    return mPriv ? mPriv->errorName : QString();
+}
+
+QString AsyncResult::errorMessage() const
+{
+    return mPriv ? mPriv->errorMessage : QString();
+}
+
+bool AsyncResult::acceptsContinuations() const
+{
+    return mPriv && !mPriv->cancelled;
+}
+
+void AsyncResult::appendContinuation(ContinuationBase *continuation) const
+{
+    Q_ASSERT(acceptsContinuations() && !isFinished());
+
+    if (mPriv->lastContinuation) {
+        mPriv->lastContinuation->next = continuation;
+    } else {
+        mPriv->firstContinuation = continuation;
+    }
+    mPriv->lastContinuation = continuation;
+}
+
+void AsyncResult::setFinished()
+{
+    finish(QString(), QString());
+}
+
+void AsyncResult::setFinishedWithError(const QString &name, const QString &message)
+{
+    if (name.isEmpty()) {
+        warning() << "AsyncResult::setFinishedWithError called with an empty error name";
+        finish(TP_QT_ERROR_NOT_AVAILABLE, message);
+        return;
+    }
+
+    finish(name, message);
+}
+
+void AsyncResult::setFinishedWithError(const QDBusError &error)
+{
+    setFinishedWithError(error.name(), error.message());
+}
+
+/*
+ * Finish this result in the same way as \a other, once \a other has finished.
+ */
+void AsyncResult::setFinishedWhen(const AsyncResult &other)
+{
+    if (!mPriv) {
+        return;
+    }
+
+    other.then(FinishedForwarder(*this));
+}
+
+/*
+ * Drop all the continuations of this result, and ignore any later attempt to finish it.
+ *
+ * Results depending on this one, such as the ones returned by whenAll(), will never finish either.
+ * Cancelling a result which has already finished and invoked all of its continuations does
+ * nothing.
+ */
+void AsyncResult::cancel()
+{
+    if (!mPriv || (mPriv->finished && !mPriv->finishing)) {
+        return;
+    }
+
+    mPriv->cancelled = true;
+    mPriv->clearContinuations();
+}
+
+void AsyncResult::finish(const QString &name, const QString &message)
+{
+    if (!mPriv || mPriv->cancelled) {
+        return;
+    }
+
+    if (mPriv->finished) {
+        warning() << "AsyncResult finished twice, ignoring";
+        return;
+    }
+
+    mPriv->finished = true;
+    mPriv->errorName = name;
+    mPriv->errorMessage = message;
+
+    // Hold a reference of our own: the continuations may well drop the last copy which is held
+    // elsewhere, including the one we have been invoked on
+    AsyncResult self(*this);
+    Private *priv = self.mPriv.data();
+    priv->finishing = true;
+    // Take the continuations one at a time, as any of them may cancel the result, which deletes
+    // the ones which are left
+    while (priv->firstContinuation) {
+        ContinuationBase *continuation = priv->firstContinuation;
+        priv->firstContinuation = continuation->next;
+        if (!priv->firstContinuation) {
+            priv->lastContinuation = 0;
+        }
+
+        continuation->invoke(self);
+        delete continuation;
+    }
+    priv->finishing = false;
+}
+
+void AsyncResult::finishDependency(const AsyncResult &dependency)
+{
+    if (!mPriv || mPriv->finished || mPriv->cancelled) {
+        return;
+    }
+
+    Q_ASSERT(mPriv->pendingDependencies > 0);
+
+    if (dependency.isError() && mPriv->dependencyErrorName.isEmpty()) {
+        mPriv->dependencyErrorName = dependency.errorName();
+        mPriv->dependencyErrorMessage = dependency.errorMessage();
+    }
+
+    if (--mPriv->pendingDependencies > 0) {
+        return;
+    }
+
+    if (!mPriv->dependencyErrorName.isEmpty()) {
+        finish(mPriv->dependencyErrorName, mPriv->dependencyErrorMessage);
+    } else {
+        finish(QString(), QString());
+    }
+}
+
+} // Tp
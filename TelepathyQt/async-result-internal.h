@@ -0,0 +1,128 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2026 TelepathyQt contributors
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_async_result_internal_h_HEADER_GUARD_
+#define _TelepathyQt_async_result_internal_h_HEADER_GUARD_
+
+#include <TelepathyQt/Global>
+
+#include <QExplicitlySharedDataPointer>
+#include <QList>
+#include <QString>
+
+class QDBusError;
+
+namespace Tp
+{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+class Feature;
+class ReadinessHelper;
+
+class TP_QT_NO_EXPORT AsyncResult
+{
+public:
+    AsyncResult();
+    AsyncResult(const AsyncResult &other);
+    ~AsyncResult();
+
+    static AsyncResult create();
+    static AsyncResult createFinished();
+    static AsyncResult createFinishedWithError(const QString &name, const QString &message);
+    static AsyncResult whenAll(const QList<AsyncResult> &results);
+
+    AsyncResult &operator=(const AsyncResult &other);
+
+    bool isNull() const { return !mPriv; }
+
+    bool isFinished() const;
+    bool isValid() const;
+    bool isError() const;
+    bool isCancelled() const;
+    QString errorName() const;
+    QString errorMessage() const;
+
+    // Functor is called with a const AsyncResult &, see the class documentation
+    template <class Functor>
+    void then(const Functor &functor) const
+    {
+        if (!acceptsContinuations()) {
+            return;
+        }
+
+        if (isFinished()) {
+            functor(*this);
+        } else {
+            appendContinuation(new Continuation<Functor>(functor));
+        }
+    }
+
+    void setFinished();
+    void setFinishedWithError(const QString &name, const QString &message);
+    void setFinishedWithError(const QDBusError &error);
+    void setFinishedWhen(const AsyncResult &other);
+    void cancel();
+
+private:
+    struct Private;
+    struct WhenAllDependency;
+    friend struct WhenAllDependency;
+
+    // The continuations of a result are kept in a singly linked list of these, so that adding one
+    // takes a single allocation
+    struct ContinuationBase
+    {
+        ContinuationBase() : next(0) {}
+        virtual ~ContinuationBase() {}
+
+        virtual void invoke(const AsyncResult &result) = 0;
+
+        ContinuationBase *next;
+    };
+
+    template <class Functor>
+    struct Continuation : public ContinuationBase
+    {
+        Continuation(const Functor &functor) : functor(functor) {}
+
+        void invoke(const AsyncResult &result) { functor(result); }
+
+        Functor functor;
+    };
+
+    bool acceptsContinuations() const;
+    void appendContinuation(ContinuationBase *continuation) const;
+    void finish(const QString &name, const QString &message);
+    void finishDependency(const AsyncResult &dependency);
+
+    QExplicitlySharedDataPointer<Private> mPriv;
+};
+
+// Defined in readiness-helper.cpp
+TP_QT_NO_EXPORT void setIntrospectCompletedWhen(ReadinessHelper *helper,
+        const Feature &feature, const AsyncResult &result);
+
+#endif
+
+} // Tp
+
+#endif
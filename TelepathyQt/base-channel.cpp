@@ -1594,12 +1594,14 @@ struct TP_QT_NO_EXPORT BaseChannelRoomListType::Private {
             const QString &server)
         : server(server),
           listingRooms(false),
+          maximumGotRoomsSize(1000),
           adaptee(new BaseChannelRoomListType::Adaptee(parent))
     {
     }
 
     QString server;
     bool listingRooms;
+    uint maximumGotRoomsSize;
     ListRoomsCallback listRoomsCB;
     StopListingCallback stopListingCB;
     BaseChannelRoomListType::Adaptee *adaptee;
@@ -1747,9 +1749,50 @@ void BaseChannelRoomListType::stopListing(DBusError *error)
     return mPriv->stopListingCB(error);
 }
 
+/**
+ * Return the maximum number of rooms announced in a single GotRooms signal.
+ *
+ * \return The maximum number of rooms per signal, or 0 if there is no limit.
+ * \sa setMaximumGotRoomsSize(), gotRooms()
+ */
+uint BaseChannelRoomListType::maximumGotRoomsSize() const
+{
+    return mPriv->maximumGotRoomsSize;
+}
+
+/**
+ * Set the maximum number of rooms announced in a single GotRooms signal.
+ *
+ * The default value is 1000. Setting it to 0 disables splitting the rooms passed to gotRooms().
+ *
+ * \param maximumGotRoomsSize The maximum number of rooms per signal, or 0 for no limit.
+ * \sa gotRooms()
+ */
+void BaseChannelRoomListType::setMaximumGotRoomsSize(uint maximumGotRoomsSize)
+{
+    mPriv->maximumGotRoomsSize = maximumGotRoomsSize;
+}
+
+/**
+ * Announce the given \a rooms to the clients listing rooms on this channel.
+ *
+ * If there are more rooms than maximumGotRoomsSize(), they are split into several GotRooms
+ * signals, so that a large room list does not end up in a single huge D-Bus message.
+ *
+ * \param rooms The rooms to announce.
+ * \sa setMaximumGotRoomsSize()
+ */
 void BaseChannelRoomListType::gotRooms(const Tp::RoomInfoList &rooms)
 {
-    QMetaObject::invokeMethod(mPriv->adaptee, "gotRooms", Q_ARG(Tp::RoomInfoList, rooms)); //Can simply use emit in Qt5
+    uint chunkSize = mPriv->maximumGotRoomsSize;
+    if (chunkSize == 0 || (uint) rooms.size() <= chunkSize) {
+        QMetaObject::invokeMethod(mPriv->adaptee, "gotRooms", Q_ARG(Tp::RoomInfoList, rooms)); //Can simply use emit in Qt5
+        return;
+    }
+
+    for (int i = 0; i < rooms.size(); i += static_cast<int>(chunkSize)) {
+        QMetaObject::invokeMethod(mPriv->adaptee, "gotRooms", Q_ARG(Tp::RoomInfoList, rooms.mid(i, chunkSize))); //Can simply use emit in Qt5
+    }
 }
 
 //Chan.T.ServerAuthentication
@@ -3824,7 +3867,11 @@ void BaseChannelRoomConfigInterface::updateConfiguration(const QVariantMap &prop
         error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Not implemented"));
         return;
     }
-    return mPriv->updateConfigurationCB(properties, error);
+
+    // Send all the properties changed by the callback in one signal, before the method returns
+    beginPropertyChangeBatch();
+    mPriv->updateConfigurationCB(properties, error);
+    endPropertyChangeBatch();
 }
 
 // Chan.T.Call
@@ -334,6 +334,8 @@ public:
     void setStopListingCallback(const StopListingCallback &cb);
     void stopListing(DBusError *error);
 
+    uint maximumGotRoomsSize() const;
+    void setMaximumGotRoomsSize(uint maximumGotRoomsSize);
     void gotRooms(const Tp::RoomInfoList &rooms);
 
 protected:
@@ -401,4 +401,36 @@ private:
     BaseConnectionContactCapabilitiesInterface *mInterface;
 };
 
+class TP_QT_NO_EXPORT BaseConnectionDBusMetricsInterface::Adaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Qt.DBusMetrics")
+    Q_CLASSINFO("D-Bus Introspection", ""
+"  <interface name=\"org.freedesktop.Telepathy.Qt.DBusMetrics\">\n"
+"    <property access=\"read\" type=\"b\" name=\"Enabled\"/>\n"
+"    <method name=\"GetMetrics\">\n"
+"      <arg direction=\"out\" type=\"a{sv}\" name=\"Metrics\"/>\n"
+"    </method>\n"
+"    <method name=\"SetEnabled\">\n"
+"      <arg direction=\"in\" type=\"b\" name=\"Enabled\"/>\n"
+"    </method>\n"
+"    <method name=\"ResetMetrics\"/>\n"
+"  </interface>\n"
+        "")
+
+    Q_PROPERTY(bool Enabled READ Enabled)
+
+public:
+    Adaptor(QObject *parent);
+    ~Adaptor();
+
+public: // PROPERTIES
+    bool Enabled() const;
+
+public Q_SLOTS: // METHODS
+    QVariantMap GetMetrics();
+    void SetEnabled(bool enabled);
+    void ResetMetrics();
+};
+
 }
@@ -47,7 +47,8 @@ struct TP_QT_NO_EXPORT BaseConnectionManager::Private
             const QString &name)
         : parent(parent),
           name(name),
-          adaptee(new BaseConnectionManager::Adaptee(dbusConnection, parent))
+          adaptee(new BaseConnectionManager::Adaptee(dbusConnection, parent)),
+          protocolPropertiesCached(false)
     {
     }
 
@@ -57,6 +58,10 @@ struct TP_QT_NO_EXPORT BaseConnectionManager::Private
     BaseConnectionManager::Adaptee *adaptee;
     QHash<QString, BaseProtocolPtr> protocols;
     QSet<BaseConnectionPtr> connections;
+
+    // filled on the first request once registered, when it cannot change anymore
+    bool protocolPropertiesCached;
+    ProtocolPropertiesMap protocolProperties;
 };
 
 BaseConnectionManager::Adaptee::Adaptee(const QDBusConnection &dbusConnection,
@@ -80,10 +85,19 @@ QStringList BaseConnectionManager::Adaptee::interfaces() const
 
 ProtocolPropertiesMap BaseConnectionManager::Adaptee::protocols() const
 {
+    if (mCM->mPriv->protocolPropertiesCached) {
+        return mCM->mPriv->protocolProperties;
+    }
+
     ProtocolPropertiesMap ret;
     foreach (const BaseProtocolPtr &protocol, mCM->protocols()) {
         ret.insert(protocol->name(), protocol->immutableProperties());
     }
+
+    if (mCM->isRegistered()) {
+        mCM->mPriv->protocolProperties = ret;
+        mCM->mPriv->protocolPropertiesCached = true;
+    }
     return ret;
 }
 
@@ -210,7 +224,7 @@ QString BaseConnectionManager::name() const
  * Return the immutable properties of this connection manager object.
  *
  * Immutable properties cannot change after the object has been registered
- * on the bus with registerObject().
+ * on the bus with registerObject(), so they are only built once after that.
  *
  * \return The immutable properties of this connection manager object.
  */
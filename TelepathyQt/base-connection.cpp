@@ -29,6 +29,7 @@
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/DBusMetrics>
 #include <TelepathyQt/DBusObject>
 #include <TelepathyQt/Utils>
 #include <TelepathyQt/AbstractProtocolInterface>
@@ -38,6 +39,51 @@
 namespace Tp
 {
 
+namespace
+{
+
+/* Key of the BaseConnection channel index. Each channel is indexed twice: once by its target
+ * handle (with an empty targetID) and once by its target ID (with a zero targetHandle), so
+ * that requests specifying either of them can be resolved without walking all channels. */
+struct ChannelIndexKey
+{
+    ChannelIndexKey()
+        : targetHandleType(0),
+          targetHandle(0)
+    {
+    }
+
+    ChannelIndexKey(const QString &channelType, uint targetHandleType, uint targetHandle,
+            const QString &targetID = QString())
+        : channelType(channelType),
+          targetHandleType(targetHandleType),
+          targetHandle(targetHandle),
+          targetID(targetID)
+    {
+    }
+
+    bool operator==(const ChannelIndexKey &other) const
+    {
+        return targetHandle == other.targetHandle &&
+            targetHandleType == other.targetHandleType &&
+            channelType == other.channelType &&
+            targetID == other.targetID;
+    }
+
+    QString channelType;
+    uint targetHandleType;
+    uint targetHandle;
+    QString targetID;
+};
+
+inline uint qHash(const ChannelIndexKey &key)
+{
+    return qHash(key.channelType) ^ qHash(key.targetID) ^
+        (key.targetHandleType << 24) ^ key.targetHandle;
+}
+
+}
+
 struct TP_QT_NO_EXPORT BaseConnection::Private {
     Private(BaseConnection *connection, const QDBusConnection &dbusConnection,
             const QString &cmName, const QString &protocolName,
@@ -48,16 +94,32 @@ struct TP_QT_NO_EXPORT BaseConnection::Private {
           parameters(parameters),
           selfHandle(0),
           status(Tp::ConnectionStatusDisconnected),
+          channelsInfoValid(false),
+          channelsDetailsValid(false),
+          indexedLookupOnly(true),
           adaptee(new BaseConnection::Adaptee(dbusConnection, connection))
     {
     }
 
+    static QList<ChannelIndexKey> indexKeysFor(const BaseChannelPtr &channel);
+    void indexChannel(const BaseChannelPtr &channel);
+    void unindexChannel(const BaseChannelPtr &channel);
+    void invalidateChannelSnapshots();
+
     BaseConnection *connection;
     QString cmName;
     QString protocolName;
     QVariantMap parameters;
     QHash<QString, AbstractConnectionInterfacePtr> interfaces;
     QSet<BaseChannelPtr> channels;
+    QMultiHash<ChannelIndexKey, BaseChannelPtr> channelIndex;
+    QHash<BaseChannelPtr, QList<ChannelIndexKey> > channelIndexKeys;
+    QHash<BaseChannelPtr, ChannelDetails> channelDetails;
+    ChannelInfoList channelsInfoSnapshot;
+    ChannelDetailsList channelsDetailsSnapshot;
+    bool channelsInfoValid;
+    bool channelsDetailsValid;
+    bool indexedLookupOnly;
     uint selfHandle;
     QString selfID;
     uint status;
@@ -68,6 +130,45 @@ struct TP_QT_NO_EXPORT BaseConnection::Private {
     BaseConnection::Adaptee *adaptee;
 };
 
+QList<ChannelIndexKey> BaseConnection::Private::indexKeysFor(const BaseChannelPtr &channel)
+{
+    QList<ChannelIndexKey> keys;
+    keys << ChannelIndexKey(channel->channelType(), channel->targetHandleType(),
+            channel->targetHandle());
+    if (!channel->targetID().isEmpty()) {
+        keys << ChannelIndexKey(channel->channelType(), channel->targetHandleType(), 0,
+                channel->targetID());
+    }
+    return keys;
+}
+
+void BaseConnection::Private::indexChannel(const BaseChannelPtr &channel)
+{
+    // Remember the keys used, as the channel target ID may still be changed after the channel
+    // has been added
+    QList<ChannelIndexKey> keys = indexKeysFor(channel);
+    foreach (const ChannelIndexKey &key, keys) {
+        channelIndex.insert(key, channel);
+    }
+    channelIndexKeys.insert(channel, keys);
+}
+
+void BaseConnection::Private::unindexChannel(const BaseChannelPtr &channel)
+{
+    foreach (const ChannelIndexKey &key, channelIndexKeys.take(channel)) {
+        channelIndex.remove(key, channel);
+    }
+    channelDetails.remove(channel);
+}
+
+void BaseConnection::Private::invalidateChannelSnapshots()
+{
+    channelsInfoValid = false;
+    channelsDetailsValid = false;
+    channelsInfoSnapshot.clear();
+    channelsDetailsSnapshot.clear();
+}
+
 BaseConnection::Adaptee::Adaptee(const QDBusConnection &dbusConnection,
                                  BaseConnection *connection)
     : QObject(connection),
@@ -471,8 +572,21 @@ Tp::UIntList BaseConnection::requestHandles(uint handleType, const QStringList &
     return mPriv->requestHandlesCB(handleType, identifiers, error);
 }
 
+/**
+ * Return the list of channels of this connection, in the form used by the deprecated
+ * Connection.ListChannels() method.
+ *
+ * The returned list is cached and only rebuilt after a channel has been added or removed.
+ *
+ * \return The list of channels of this connection.
+ * \sa channelsDetails()
+ */
 Tp::ChannelInfoList BaseConnection::channelsInfo()
 {
+    if (mPriv->channelsInfoValid) {
+        return mPriv->channelsInfoSnapshot;
+    }
+
     debug() << "BaseConnection::channelsInfo:";
     Tp::ChannelInfoList list;
     foreach(const BaseChannelPtr & c, mPriv->channels) {
@@ -481,17 +595,40 @@ Tp::ChannelInfoList BaseConnection::channelsInfo()
         info.channelType = c->channelType();
         info.handle = c->targetHandle();
         info.handleType = c->targetHandleType();
-        debug() << "BaseConnection::channelsInfo " << info.channel.path();
         list << info;
     }
+    mPriv->channelsInfoSnapshot = list;
+    mPriv->channelsInfoValid = true;
     return list;
 }
 
+/**
+ * Return the details of the channels of this connection, as exposed by the
+ * Connection.Interface.Requests.Channels property.
+ *
+ * The details of each channel are computed once when the channel is added and the returned list
+ * is cached, so that it is only rebuilt after a channel has been added or removed.
+ *
+ * \return The details of the channels of this connection.
+ * \sa channelsInfo()
+ */
 Tp::ChannelDetailsList BaseConnection::channelsDetails()
 {
+    if (mPriv->channelsDetailsValid) {
+        return mPriv->channelsDetailsSnapshot;
+    }
+
     Tp::ChannelDetailsList list;
-    foreach(const BaseChannelPtr & c, mPriv->channels)
-    list << c->details();
+    foreach(const BaseChannelPtr & c, mPriv->channels) {
+        QHash<BaseChannelPtr, ChannelDetails>::const_iterator it = mPriv->channelDetails.constFind(c);
+        if (it != mPriv->channelDetails.constEnd()) {
+            list << it.value();
+        } else {
+            list << c->details();
+        }
+    }
+    mPriv->channelsDetailsSnapshot = list;
+    mPriv->channelsDetailsValid = true;
     return list;
 }
 
@@ -500,7 +637,17 @@ Tp::ChannelDetailsList BaseConnection::channelsDetails()
  *
  * Returns an existing channel satisfying the given \a request or a null pointer if such a channel does not exist.
  *
- * This method iterates over the existing channels and calls matchChannel() to find the one satisfying the \a request.
+ * If the \a request specifies a TargetHandleType together with a TargetHandle or a TargetID,
+ * only the channels found in an index keyed by (ChannelType, TargetHandleType,
+ * TargetHandle/TargetID), which is maintained as channels are added and removed, are candidates.
+ * Otherwise, all the existing channels of the requested type are. matchChannel() is called on
+ * each candidate to find the one satisfying the \a request.
+ *
+ * Looking up a channel by target therefore doesn't depend on the number of channels, including
+ * when no channel matches. Subclasses overriding matchChannel() to match channels the index
+ * can't find, for instance by normalizing the TargetID, have to call setIndexedLookupOnly()
+ * with \c false, in which case the other channels of the requested type are tried as well
+ * when none of the indexed ones matches.
  *
  * If \a error is passed, any error that may occur will be stored there.
  *
@@ -511,15 +658,58 @@ Tp::ChannelDetailsList BaseConnection::channelsDetails()
  */
 Tp::BaseChannelPtr BaseConnection::getExistingChannel(const QVariantMap &request, DBusError *error)
 {
-    if (!request.contains(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"))) {
+    static const QString keyChannelType = TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType");
+    static const QString keyTargetHandleType = TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType");
+    static const QString keyTargetHandle = TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle");
+    static const QString keyTargetID = TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID");
+
+    QVariantMap::const_iterator channelTypeIt = request.constFind(keyChannelType);
+    if (channelTypeIt == request.constEnd()) {
         error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("Missing parameters"));
         return Tp::BaseChannelPtr();
     }
 
-    const QString channelType = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")).toString();
+    const QString channelType = channelTypeIt.value().toString();
+
+    QList<BaseChannelPtr> candidates;
+    QVariantMap::const_iterator targetHandleTypeIt = request.constFind(keyTargetHandleType);
+    QVariantMap::const_iterator targetIt = request.constFind(keyTargetHandle);
+    bool indexed = false;
+    if (targetHandleTypeIt != request.constEnd()) {
+        uint targetHandleType = targetHandleTypeIt.value().toUInt();
+        if (targetIt != request.constEnd()) {
+            candidates = mPriv->channelIndex.values(ChannelIndexKey(channelType,
+                        targetHandleType, targetIt.value().toUInt()));
+            indexed = true;
+        } else {
+            targetIt = request.constFind(keyTargetID);
+            if (targetIt != request.constEnd()) {
+                candidates = mPriv->channelIndex.values(ChannelIndexKey(channelType,
+                            targetHandleType, 0, targetIt.value().toString()));
+                indexed = true;
+            }
+        }
+    }
+
+    foreach(const BaseChannelPtr &channel, candidates) {
+        bool match = matchChannel(channel, request, error);
+
+        if (error->isValid()) {
+            return BaseChannelPtr();
+        }
+
+        if (match) {
+            return channel;
+        }
+    }
+
+    if (indexed && mPriv->indexedLookupOnly) {
+        return Tp::BaseChannelPtr();
+    }
 
     foreach(const BaseChannelPtr &channel, mPriv->channels) {
-        if (channel->channelType() != channelType) {
+        if (channel->channelType() != channelType ||
+                (indexed && candidates.contains(channel))) {
             continue;
         }
 
@@ -579,6 +769,11 @@ void BaseConnection::addChannel(BaseChannelPtr channel, bool suppressHandler)
     }
 
     mPriv->channels.insert(channel);
+    mPriv->indexChannel(channel);
+    mPriv->invalidateChannelSnapshots();
+
+    ChannelDetails details = channel->details();
+    mPriv->channelDetails.insert(channel, details);
 
     BaseConnectionRequestsInterfacePtr reqIface =
         BaseConnectionRequestsInterfacePtr::dynamicCast(interface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS));
@@ -587,7 +782,7 @@ void BaseConnection::addChannel(BaseChannelPtr channel, bool suppressHandler)
         //emit after return
         QMetaObject::invokeMethod(reqIface.data(), "newChannels",
                                   Qt::QueuedConnection,
-                                  Q_ARG(Tp::ChannelDetailsList, ChannelDetailsList() << channel->details()));
+                                  Q_ARG(Tp::ChannelDetailsList, ChannelDetailsList() << details));
     }
 
     //emit after return
@@ -619,6 +814,8 @@ void BaseConnection::removeChannel()
     }
 
     mPriv->channels.remove(channel);
+    mPriv->unindexChannel(channel);
+    mPriv->invalidateChannelSnapshots();
 }
 
 /**
@@ -768,6 +965,11 @@ bool BaseConnection::registerObject(const QString &busName,
  * This virtual method is used to check if a \a channel satisfying the given request.
  * It is warranted, that the type of the channel meets the requested type.
  *
+ * When the request specifies a TargetHandleType together with a TargetHandle or a TargetID,
+ * this method is only called for the channels indexed under the same (ChannelType,
+ * TargetHandleType, TargetHandle/TargetID) key, unless setIndexedLookupOnly() has been called
+ * with \c false, as described in getExistingChannel().
+ *
  * The default implementation compares TargetHandleType and TargetHandle/TargetID.
  * If \a error is passed, any error that may occur will be stored there.
  *
@@ -803,6 +1005,34 @@ bool BaseConnection::matchChannel(const BaseChannelPtr &channel, const QVariantM
     return false;
 }
 
+/**
+ * Return whether getExistingChannel() only tries the channels found in its index when the
+ * request names a target.
+ *
+ * \return \c true if only the indexed channels are tried, \c false otherwise.
+ * \sa setIndexedLookupOnly()
+ */
+bool BaseConnection::isIndexedLookupOnly() const
+{
+    return mPriv->indexedLookupOnly;
+}
+
+/**
+ * Set whether getExistingChannel() only tries the channels found in its index when the
+ * request names a target.
+ *
+ * This is \c true by default. Set it to \c false if matchChannel() is overridden to match
+ * channels which are not indexed under the TargetHandle or TargetID of the request, at the cost
+ * of trying all the channels of the requested type whenever no indexed channel matches.
+ *
+ * \param indexedLookupOnly Whether only the indexed channels are tried.
+ * \sa isIndexedLookupOnly(), matchChannel()
+ */
+void BaseConnection::setIndexedLookupOnly(bool indexedLookupOnly)
+{
+    mPriv->indexedLookupOnly = indexedLookupOnly;
+}
+
 /**
  * \fn void BaseConnection::disconnected()
  *
@@ -1140,16 +1370,101 @@ BaseConnectionSimplePresenceInterface::Adaptee::~Adaptee()
 struct TP_QT_NO_EXPORT BaseConnectionSimplePresenceInterface::Private {
     Private(BaseConnectionSimplePresenceInterface *parent)
         : maximumStatusMessageLength(0),
+          maximumPresencesChangedSize(0),
           adaptee(new BaseConnectionSimplePresenceInterface::Adaptee(parent)) {
     }
+
+    /* A presence as kept in the presence store: the type and status are interned in
+     * statusTable, so that only the status message is stored per contact */
+    struct StoredPresence {
+        StoredPresence() : statusIndex(-1) { }
+        StoredPresence(int statusIndex, const QString &statusMessage)
+            : statusIndex(statusIndex), statusMessage(statusMessage) { }
+
+        bool operator==(const StoredPresence &other) const
+        {
+            return statusIndex == other.statusIndex && statusMessage == other.statusMessage;
+        }
+
+        bool operator!=(const StoredPresence &other) const
+        {
+            return !(*this == other);
+        }
+
+        int statusIndex;
+        QString statusMessage;
+    };
+
+    int internStatus(uint type, const QString &status);
+    SimplePresence toSimplePresence(const StoredPresence &stored) const;
+    void emitPresencesChanged(const SimpleContactPresences &presences,
+            Qt::ConnectionType type = Qt::AutoConnection);
+
     SetPresenceCallback setPresenceCB;
     SimpleStatusSpecMap statuses;
     uint maximumStatusMessageLength;
+    uint maximumPresencesChangedSize;
     /* The current presences */
-    SimpleContactPresences presences;
+    QHash<uint, StoredPresence> presences;
+    /* Interned (type, status) pairs used by the stored presences */
+    QList<QPair<uint, QString> > statusTable;
+    QHash<QPair<uint, QString>, int> statusIndexes;
     BaseConnectionSimplePresenceInterface::Adaptee *adaptee;
 };
 
+int BaseConnectionSimplePresenceInterface::Private::internStatus(uint type, const QString &status)
+{
+    QPair<uint, QString> key(type, status);
+    QHash<QPair<uint, QString>, int>::const_iterator it = statusIndexes.constFind(key);
+    if (it != statusIndexes.constEnd()) {
+        return it.value();
+    }
+
+    int index = statusTable.size();
+    statusTable.append(key);
+    statusIndexes.insert(key, index);
+    return index;
+}
+
+SimplePresence BaseConnectionSimplePresenceInterface::Private::toSimplePresence(
+        const StoredPresence &stored) const
+{
+    const QPair<uint, QString> &status = statusTable.at(stored.statusIndex);
+    SimplePresence presence;
+    presence.type = status.first;
+    presence.status = status.second;
+    presence.statusMessage = stored.statusMessage;
+    return presence;
+}
+
+void BaseConnectionSimplePresenceInterface::Private::emitPresencesChanged(
+        const SimpleContactPresences &presences, Qt::ConnectionType type)
+{
+    if (maximumPresencesChangedSize == 0 ||
+            (uint) presences.size() <= maximumPresencesChangedSize) {
+        QMetaObject::invokeMethod(adaptee, "presencesChanged", type,
+                Q_ARG(Tp::SimpleContactPresences, presences)); //Can simply use emit in Qt5
+        return;
+    }
+
+    SimpleContactPresences chunk;
+    SimpleContactPresences::const_iterator it = presences.constBegin();
+    SimpleContactPresences::const_iterator end = presences.constEnd();
+    for (; it != end; ++it) {
+        chunk.insert(it.key(), it.value());
+        if ((uint) chunk.size() == maximumPresencesChangedSize) {
+            QMetaObject::invokeMethod(adaptee, "presencesChanged", type,
+                    Q_ARG(Tp::SimpleContactPresences, chunk)); //Can simply use emit in Qt5
+            chunk.clear();
+        }
+    }
+
+    if (!chunk.isEmpty()) {
+        QMetaObject::invokeMethod(adaptee, "presencesChanged", type,
+                Q_ARG(Tp::SimpleContactPresences, chunk)); //Can simply use emit in Qt5
+    }
+}
+
 /**
  * \class BaseConnectionSimplePresenceInterface
  * \ingroup serviceconn
@@ -1198,20 +1513,41 @@ void BaseConnectionSimplePresenceInterface::createAdaptor()
 
 
 
+/**
+ * Update the presences of the given contacts.
+ *
+ * The given \a presences are compared against the stored ones in a single pass and
+ * the PresencesChanged signal is emitted for the contacts which presence actually changed.
+ * If a maximum size has been set with setMaximumPresencesChangedSize(), the changes are split
+ * into several PresencesChanged signals of at most this size.
+ *
+ * \param presences A map of contact handles to their new presences.
+ * \sa getPresences()
+ */
 void BaseConnectionSimplePresenceInterface::setPresences(const Tp::SimpleContactPresences &presences)
 {
     Tp::SimpleContactPresences newPresences;
 
-    foreach(uint handle, presences.keys()) {
-        if (mPriv->presences.contains(handle) && mPriv->presences.value(handle) == presences.value(handle)) {
+    SimpleContactPresences::const_iterator it = presences.constBegin();
+    SimpleContactPresences::const_iterator end = presences.constEnd();
+    for (; it != end; ++it) {
+        const SimplePresence &presence = it.value();
+        Private::StoredPresence stored(mPriv->internStatus(presence.type, presence.status),
+                presence.statusMessage);
+
+        QHash<uint, Private::StoredPresence>::iterator current = mPriv->presences.find(it.key());
+        if (current == mPriv->presences.end()) {
+            mPriv->presences.insert(it.key(), stored);
+        } else if (current.value() != stored) {
+            current.value() = stored;
+        } else {
             continue;
         }
-        mPriv->presences[handle] = presences[handle];
-        newPresences[handle] = presences[handle];
+        newPresences.insert(it.key(), presence);
     }
 
     if (!newPresences.isEmpty()) {
-        QMetaObject::invokeMethod(mPriv->adaptee, "presencesChanged", Q_ARG(Tp::SimpleContactPresences, newPresences)); //Can simply use emit in Qt5
+        mPriv->emitPresencesChanged(newPresences);
     }
 }
 
@@ -1220,12 +1556,28 @@ void BaseConnectionSimplePresenceInterface::setSetPresenceCallback(const SetPres
     mPriv->setPresenceCB = cb;
 }
 
+/**
+ * Return the presences of the given \a contacts.
+ *
+ * Contacts which presence has not been set with setPresences() are reported with
+ * the unknown presence.
+ *
+ * \param contacts The contact handles to look up.
+ * \return A map of contact handles to their presences.
+ * \sa setPresences()
+ */
 SimpleContactPresences BaseConnectionSimplePresenceInterface::getPresences(const UIntList &contacts)
 {
+    static const Tp::SimplePresence unknownPresence = { /* type */ ConnectionPresenceTypeUnknown, /* status */ QLatin1String("unknown") };
+
     Tp::SimpleContactPresences presences;
     foreach(uint handle, contacts) {
-        static const Tp::SimplePresence unknownPresence = { /* type */ ConnectionPresenceTypeUnknown, /* status */ QLatin1String("unknown") };
-        presences[handle] = mPriv->presences.value(handle, unknownPresence);
+        QHash<uint, Private::StoredPresence>::const_iterator it = mPriv->presences.constFind(handle);
+        if (it == mPriv->presences.constEnd()) {
+            presences.insert(handle, unknownPresence);
+        } else {
+            presences.insert(handle, mPriv->toSimplePresence(it.value()));
+        }
     }
 
     return presences;
@@ -1251,6 +1603,33 @@ void BaseConnectionSimplePresenceInterface::setMaximumStatusMessageLength(uint m
     mPriv->maximumStatusMessageLength = maximumStatusMessageLength;
 }
 
+/**
+ * Return the maximum number of contacts reported in a single PresencesChanged signal.
+ *
+ * \return The maximum number of contacts per signal, or 0 if there is no limit.
+ * \sa setMaximumPresencesChangedSize()
+ */
+uint BaseConnectionSimplePresenceInterface::maximumPresencesChangedSize() const
+{
+    return mPriv->maximumPresencesChangedSize;
+}
+
+/**
+ * Set the maximum number of contacts reported in a single PresencesChanged signal.
+ *
+ * Presence updates for more contacts, such as the ones done after downloading a large roster,
+ * are then split into several signals, so that clients don't have to process a single huge
+ * D-Bus message. The default value 0 means that there is no limit.
+ *
+ * \param maximumPresencesChangedSize The maximum number of contacts per signal, or 0 for no
+ * limit.
+ * \sa setPresences()
+ */
+void BaseConnectionSimplePresenceInterface::setMaximumPresencesChangedSize(uint maximumPresencesChangedSize)
+{
+    mPriv->maximumPresencesChangedSize = maximumPresencesChangedSize;
+}
+
 Tp::SimpleStatusSpecMap BaseConnectionSimplePresenceInterface::Adaptee::statuses() const
 {
     return mInterface->mPriv->statuses;
@@ -1293,15 +1672,14 @@ void BaseConnectionSimplePresenceInterface::Adaptee::setPresence(const QString &
     presence.type = i->type;
     presence.status = status;
     presence.statusMessage = statusMessage;
-    mInterface->mPriv->presences[selfHandle] = presence;
+    mInterface->mPriv->presences[selfHandle] = Private::StoredPresence(
+            mInterface->mPriv->internStatus(presence.type, presence.status), statusMessage);
 
     /* Emit PresencesChanged */
     SimpleContactPresences presences;
     presences[selfHandle] = presence;
     //emit after return
-    QMetaObject::invokeMethod(mInterface->mPriv->adaptee, "presencesChanged",
-                              Qt::QueuedConnection,
-                              Q_ARG(Tp::SimpleContactPresences, presences));
+    mInterface->mPriv->emitPresencesChanged(presences, Qt::QueuedConnection);
     context->setFinished();
 }
 
@@ -2987,4 +3365,115 @@ void BaseConnectionContactCapabilitiesInterface::contactCapabilitiesChanged(cons
     QMetaObject::invokeMethod(mPriv->adaptee, "contactCapabilitiesChanged", Q_ARG(Tp::ContactCapabilitiesMap, caps)); //Can simply use emit in Qt5
 }
 
+// DBusMetrics
+struct TP_QT_NO_EXPORT BaseConnectionDBusMetricsInterface::Private {
+    Private()
+    {
+    }
+};
+
+BaseConnectionDBusMetricsInterface::Adaptor::Adaptor(QObject *parent)
+    : QDBusAbstractAdaptor(parent)
+{
+}
+
+BaseConnectionDBusMetricsInterface::Adaptor::~Adaptor()
+{
+}
+
+bool BaseConnectionDBusMetricsInterface::Adaptor::Enabled() const
+{
+    return DBusMetrics::isEnabled();
+}
+
+QVariantMap BaseConnectionDBusMetricsInterface::Adaptor::GetMetrics()
+{
+    static const char *kindNames[] = {
+        "OutgoingCall", "IncomingCall", "OutgoingSignal", "IncomingSignal"
+    };
+
+    QVariantMap metrics;
+    foreach (const DBusMetrics::Entry &entry, DBusMetrics::entries()) {
+        QVariantMap values;
+        values.insert(QLatin1String("Count"), entry.count());
+        values.insert(QLatin1String("ErrorCount"), entry.errorCount());
+        values.insert(QLatin1String("TotalLatency"), entry.totalLatency());
+        values.insert(QLatin1String("LatencyHistogram"),
+                QVariant::fromValue(UIntList(entry.latencyHistogram())));
+
+        QString key = QString(QLatin1String("%1:%2.%3"))
+            .arg(QLatin1String(kindNames[entry.kind()]))
+            .arg(entry.interfaceName())
+            .arg(entry.memberName());
+        metrics.insert(key, values);
+    }
+    return metrics;
+}
+
+void BaseConnectionDBusMetricsInterface::Adaptor::SetEnabled(bool enabled)
+{
+    DBusMetrics::setEnabled(enabled);
+}
+
+void BaseConnectionDBusMetricsInterface::Adaptor::ResetMetrics()
+{
+    DBusMetrics::reset();
+}
+
+/**
+ * \class BaseConnectionDBusMetricsInterface
+ * \ingroup serviceconn
+ * \headerfile TelepathyQt/base-connection.h <TelepathyQt/BaseConnection>
+ *
+ * \brief Interface exposing the D-Bus metrics collected by the service on the bus.
+ *
+ * This is not a Telepathy specification interface, but a debugging aid specific to TelepathyQt.
+ * Once plugged into a BaseConnection, it exports the org.freedesktop.Telepathy.Qt.DBusMetrics
+ * interface on the connection object, which allows inspecting, enabling and resetting the
+ * metrics collected by DBusMetrics in the service process, for example with dbus-send or
+ * qdbus.
+ *
+ * Plugging this interface does not enable metrics collection by itself, use
+ * DBusMetrics::setEnabled() or the SetEnabled D-Bus method for that. Enabling it over D-Bus
+ * only accounts for the signals of the objects registered afterwards, see DBusMetrics.
+ *
+ * \sa DBusMetrics
+ */
+
+/**
+ * Class constructor.
+ */
+BaseConnectionDBusMetricsInterface::BaseConnectionDBusMetricsInterface()
+    : AbstractConnectionInterface(TP_QT_IFACE_DBUS_METRICS),
+      mPriv(new Private)
+{
+}
+
+/**
+ * Class destructor.
+ */
+BaseConnectionDBusMetricsInterface::~BaseConnectionDBusMetricsInterface()
+{
+    delete mPriv;
+}
+
+/**
+ * Return the immutable properties of this interface.
+ *
+ * Immutable properties cannot change after the interface has been registered
+ * on a service on the bus with registerInterface().
+ *
+ * \return The immutable properties of this interface.
+ */
+QVariantMap BaseConnectionDBusMetricsInterface::immutableProperties() const
+{
+    QVariantMap map;
+    return map;
+}
+
+void BaseConnectionDBusMetricsInterface::createAdaptor()
+{
+    (void) new BaseConnectionDBusMetricsInterface::Adaptor(dbusObject());
+}
+
 }
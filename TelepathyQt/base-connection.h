@@ -127,6 +127,9 @@ protected:
 
     virtual bool matchChannel(const Tp::BaseChannelPtr &channel, const QVariantMap &request, Tp::DBusError *error);
 
+    bool isIndexedLookupOnly() const;
+    void setIndexedLookupOnly(bool indexedLookupOnly);
+
 private:
     class Adaptee;
     friend class Adaptee;
@@ -268,6 +271,9 @@ public:
     uint maximumStatusMessageLength() const;
     void setMaximumStatusMessageLength(uint maximumStatusMessageLength);
 
+    uint maximumPresencesChangedSize() const;
+    void setMaximumPresencesChangedSize(uint maximumPresencesChangedSize);
+
     typedef Callback3<uint, const QString &, const QString &, DBusError*> SetPresenceCallback;
     void setSetPresenceCallback(const SetPresenceCallback &cb);
 
@@ -735,6 +741,40 @@ private:
     Private *mPriv;
 };
 
+class TP_QT_EXPORT BaseConnectionDBusMetricsInterface : public AbstractConnectionInterface
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BaseConnectionDBusMetricsInterface)
+
+public:
+    static BaseConnectionDBusMetricsInterfacePtr create()
+    {
+        return BaseConnectionDBusMetricsInterfacePtr(new BaseConnectionDBusMetricsInterface());
+    }
+    template<typename BaseConnectionDBusMetricsInterfaceSubclass>
+    static SharedPtr<BaseConnectionDBusMetricsInterfaceSubclass> create()
+    {
+        return SharedPtr<BaseConnectionDBusMetricsInterfaceSubclass>(
+                new BaseConnectionDBusMetricsInterfaceSubclass());
+    }
+
+    virtual ~BaseConnectionDBusMetricsInterface();
+
+    QVariantMap immutableProperties() const;
+
+protected:
+    BaseConnectionDBusMetricsInterface();
+
+private:
+    void createAdaptor();
+
+    class Adaptor;
+    friend class Adaptor;
+    struct Private;
+    friend struct Private;
+    Private *mPriv;
+};
+
 }
 
 #endif
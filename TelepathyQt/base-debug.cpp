@@ -27,31 +27,212 @@
 #include "TelepathyQt/_gen/base-debug.moc.hpp"
 #include "TelepathyQt/_gen/base-debug-internal.moc.hpp"
 
+#include "TelepathyQt/debug-internal.h"
+
+#include <QDateTime>
+#include <QQueue>
+#include <QSet>
+#include <QTimer>
+
+#include <algorithm>
+
 namespace Tp
 {
 
+namespace
+{
+
+// Number of messages which can be logged before the main thread drains them. Must be a power of
+// two.
+const int pendingMessagesCapacity = 4096;
+// Maximum number of NewDebugMessage signals emitted per batch, and interval between batches
+const int maximumMessagesPerBatch = 256;
+const int batchInterval = 20;
+
+}
+
 struct TP_QT_NO_EXPORT BaseDebug::Private
 {
+    /* A slot of the pending messages ring buffer. The sequence number tells whether the slot is
+     * free to be written by a producer (sequence == position) or holds a message published for
+     * the consumer (sequence == position + 1), as in Dmitry Vyukov's bounded queue. */
+    struct PendingMessage
+    {
+        QAtomicInt sequence;
+        double timestamp;
+        uint level;
+        QString domain;
+        QString message;
+    };
+
     Private(BaseDebug *parent, const QDBusConnection &dbusConnection)
         : parent(parent),
           enabled(false),
           getMessagesLimit(0),
-          lastMessageIndex(-1),
+          pendingMessages(new PendingMessage[pendingMessagesCapacity]),
+          enqueuePosition(0),
+          dequeuePosition(0),
+          drainScheduled(0),
+          droppedMessages(0),
+          historyStart(0),
+          batchTimer(new QTimer(parent)),
           adaptee(new BaseDebug::Adaptee(dbusConnection, parent))
     {
+        for (int i = 0; i < pendingMessagesCapacity; ++i) {
+            pendingMessages[i].sequence.fetchAndStoreRelaxed(i);
+        }
+
+        batchTimer->setSingleShot(true);
+        batchTimer->setInterval(batchInterval);
+        parent->connect(batchTimer, SIGNAL(timeout()), SLOT(sendMessageBatch()));
+    }
+
+    ~Private()
+    {
+        delete [] pendingMessages;
     }
 
+    bool enqueue(double time, const QString &domain, uint level, const QString &message);
+    bool dequeue(DebugMessage *message);
+
+    void drain();
+    QString internDomain(const QString &domain);
+    void appendToHistory(const DebugMessage &message);
+    void linearizeHistory();
+
     BaseDebug *parent;
     bool enabled;
     int getMessagesLimit;
-    int lastMessageIndex;
 
-    DebugMessageList messages;
+    // Messages logged from any thread, waiting to be drained by the main thread
+    PendingMessage *pendingMessages;
+    QAtomicInt enqueuePosition;
+    uint dequeuePosition;
+    QAtomicInt drainScheduled;
+    QAtomicInt droppedMessages;
+
+    // Ring of the last getMessagesLimit messages, the oldest one being at historyStart
+    DebugMessageList history;
+    int historyStart;
+    QSet<QString> domains;
+
+    // Messages waiting to be emitted over D-Bus. A batch is emitted right away if the previous
+    // one was emitted more than batchInterval ago, the timer being active otherwise
+    QQueue<DebugMessage> unsentMessages;
+    QTimer *batchTimer;
 
     GetMessagesCallback getMessageCB;
     BaseDebug::Adaptee *adaptee;
 };
 
+bool BaseDebug::Private::enqueue(double time, const QString &domain, uint level,
+        const QString &message)
+{
+    PendingMessage *slot;
+    uint position = enqueuePosition.fetchAndAddOrdered(0);
+    for (;;) {
+        slot = &pendingMessages[position & (pendingMessagesCapacity - 1)];
+        int diff = static_cast<int>(static_cast<uint>(slot->sequence.fetchAndAddOrdered(0)) - position);
+        if (diff == 0) {
+            if (enqueuePosition.testAndSetOrdered(position, position + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The main thread did not drain the buffer yet
+            return false;
+        }
+        position = enqueuePosition.fetchAndAddOrdered(0);
+    }
+
+    slot->timestamp = time;
+    slot->level = level;
+    slot->domain = domain;
+    slot->message = message;
+    slot->sequence.fetchAndStoreOrdered(position + 1);
+    return true;
+}
+
+bool BaseDebug::Private::dequeue(DebugMessage *message)
+{
+    PendingMessage *slot = &pendingMessages[dequeuePosition & (pendingMessagesCapacity - 1)];
+    int diff = static_cast<int>(static_cast<uint>(slot->sequence.fetchAndAddOrdered(0)) -
+            (dequeuePosition + 1));
+    if (diff < 0) {
+        return false;
+    }
+
+    message->timestamp = slot->timestamp;
+    message->level = slot->level;
+    message->domain = internDomain(slot->domain);
+    message->message = slot->message;
+    slot->domain.clear();
+    slot->message.clear();
+    slot->sequence.fetchAndStoreOrdered(dequeuePosition + pendingMessagesCapacity);
+    ++dequeuePosition;
+    return true;
+}
+
+void BaseDebug::Private::drain()
+{
+    drainScheduled.fetchAndStoreOrdered(0);
+
+    DebugMessage message;
+    while (dequeue(&message)) {
+        appendToHistory(message);
+        if (enabled) {
+            if (unsentMessages.size() >= pendingMessagesCapacity) {
+                unsentMessages.dequeue();
+                droppedMessages.ref();
+            }
+            unsentMessages.enqueue(message);
+        }
+    }
+
+    int dropped = droppedMessages.fetchAndStoreOrdered(0);
+    if (dropped) {
+        warning() << "BaseDebug: dropped" << dropped << "debug messages";
+    }
+}
+
+QString BaseDebug::Private::internDomain(const QString &domain)
+{
+    QSet<QString>::const_iterator it = domains.constFind(domain);
+    if (it != domains.constEnd()) {
+        return *it;
+    }
+    domains.insert(domain);
+    return domain;
+}
+
+void BaseDebug::Private::appendToHistory(const DebugMessage &message)
+{
+    if (getMessagesLimit == 0) {
+        return;
+    }
+
+    // A negative limit means that there is no limit at all
+    if (getMessagesLimit < 0 || history.count() < getMessagesLimit) {
+        history << message;
+        return;
+    }
+
+    history[historyStart] = message;
+    ++historyStart;
+    if (historyStart >= history.count()) {
+        historyStart = 0;
+    }
+}
+
+void BaseDebug::Private::linearizeHistory()
+{
+    if (historyStart == 0) {
+        return;
+    }
+
+    std::rotate(history.begin(), history.begin() + historyStart, history.end());
+    historyStart = 0;
+}
+
 BaseDebug::Adaptee::Adaptee(const QDBusConnection &dbusConnection, BaseDebug *interface)
     : QObject(interface),
       mInterface(interface)
@@ -66,7 +247,7 @@ bool BaseDebug::Adaptee::isEnabled()
 
 void BaseDebug::Adaptee::setEnabled(bool enabled)
 {
-    mInterface->mPriv->enabled = enabled;
+    mInterface->setEnabled(enabled);
 }
 
 void BaseDebug::Adaptee::getMessages(const Service::DebugAdaptor::GetMessagesContextPtr &context)
@@ -81,12 +262,34 @@ void BaseDebug::Adaptee::getMessages(const Service::DebugAdaptor::GetMessagesCon
     context->setFinished(messages);
 }
 
+/**
+ * \class BaseDebug
+ * \ingroup servicecm
+ * \headerfile TelepathyQt/base-debug.h <TelepathyQt/BaseDebug>
+ *
+ * \brief Base class for implementations of the Debug interface.
+ *
+ * Debug messages can be logged with newDebugMessage() from any thread. They are stored in a
+ * preallocated ring buffer without taking any lock, and drained by the thread of this object,
+ * which keeps the last getMessagesLimit() messages for GetMessages() and, if the interface is
+ * enabled, emits them over D-Bus in batches of at most 256 NewDebugMessage signals, with at
+ * least 20 milliseconds between two batches.
+ */
+
 BaseDebug::BaseDebug(const QDBusConnection &dbusConnection) :
     DBusService(dbusConnection),
     mPriv(new Private(this, dbusConnection))
 {
 }
 
+/**
+ * Class destructor.
+ */
+BaseDebug::~BaseDebug()
+{
+    delete mPriv;
+}
+
 bool BaseDebug::isEnabled() const
 {
     return mPriv->enabled;
@@ -106,11 +309,10 @@ DebugMessageList BaseDebug::getMessages(Tp::DBusError *error) const
 {
     if (!mPriv->getMessageCB.isValid()) {
         if (mPriv->getMessagesLimit) {
-            if (mPriv->lastMessageIndex < 0) {
-                return mPriv->messages;
-            } else {
-                return mPriv->messages.mid(mPriv->lastMessageIndex + 1) + mPriv->messages.mid(0, mPriv->lastMessageIndex + 1);
-            }
+            mPriv->drain();
+            mPriv->linearizeHistory();
+            // The history is implicitly shared with the reply until a new message is stored
+            return mPriv->history;
         }
         error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Not implemented"));
         return DebugMessageList();
@@ -121,35 +323,40 @@ DebugMessageList BaseDebug::getMessages(Tp::DBusError *error) const
 
 void BaseDebug::setEnabled(bool enabled)
 {
+    if (mPriv->enabled && !enabled) {
+        mPriv->drain();
+        mPriv->unsentMessages.clear();
+    }
     mPriv->enabled = enabled;
 }
 
 void BaseDebug::setGetMessagesLimit(int limit)
 {
+    mPriv->drain();
+    mPriv->linearizeHistory();
     mPriv->getMessagesLimit = limit;
-    DebugMessageList messages;
 
-    if (mPriv->lastMessageIndex < 0) {
-        messages = mPriv->messages;
-    } else {
-        messages = mPriv->messages.mid(mPriv->lastMessageIndex + 1) + mPriv->messages.mid(0, mPriv->lastMessageIndex + 1);
-    }
-
-    mPriv->lastMessageIndex = -1;
-
-    if (mPriv->messages.count() <= limit) {
-        mPriv->messages = messages;
-    } else {
-        mPriv->messages = messages.mid(messages.count() - limit, limit);
+    if (limit >= 0 && mPriv->history.count() > limit) {
+        mPriv->history = mPriv->history.mid(mPriv->history.count() - limit, limit);
     }
 }
 
 void BaseDebug::clear()
 {
-    mPriv->messages.clear();
-    mPriv->lastMessageIndex = -1;
+    mPriv->drain();
+    mPriv->history.clear();
+    mPriv->historyStart = 0;
 }
 
+/**
+ * Log a new debug message, timestamped with the current time.
+ *
+ * This method can be called from any thread.
+ *
+ * \param domain The domain of the message.
+ * \param level The level of the message.
+ * \param message The text of the message.
+ */
 void BaseDebug::newDebugMessage(const QString &domain, DebugLevel level, const QString &message)
 {
     qint64 msec = QDateTime::currentMSecsSinceEpoch();
@@ -158,35 +365,27 @@ void BaseDebug::newDebugMessage(const QString &domain, DebugLevel level, const Q
     newDebugMessage(time, domain, level, message);
 }
 
+/**
+ * Log a new debug message.
+ *
+ * This method can be called from any thread. If the ring buffer of pending messages is full
+ * because the thread of this object did not get a chance to drain it, the message is dropped.
+ *
+ * \param time The timestamp of the message, in seconds since the epoch.
+ * \param domain The domain of the message.
+ * \param level The level of the message.
+ * \param message The text of the message.
+ */
 void BaseDebug::newDebugMessage(double time, const QString &domain, DebugLevel level, const QString &message)
 {
-    if (mPriv->getMessagesLimit != 0) {
-        DebugMessage newMessage;
-        newMessage.timestamp = time;
-        newMessage.domain = domain;
-        newMessage.level = level;
-        newMessage.message = message;
-
-        if (mPriv->messages.count() == mPriv->getMessagesLimit) {
-            ++mPriv->lastMessageIndex;
-
-            if (mPriv->lastMessageIndex >= mPriv->messages.count()) {
-                mPriv->lastMessageIndex = 0;
-            }
-
-            mPriv->messages[mPriv->lastMessageIndex] = newMessage;
-        } else { // This works when the limit is not hitted yet, or when there is no limit at all (negative limit number)
-            mPriv->messages << newMessage;
-        }
-    }
-
-    if (!isEnabled()) {
+    if (!mPriv->enqueue(time, domain, level, message)) {
+        mPriv->droppedMessages.ref();
         return;
     }
 
-    QMetaObject::invokeMethod(mPriv->adaptee, "newDebugMessage",
-                              Q_ARG(double, time), Q_ARG(QString, domain),
-                              Q_ARG(uint, level), Q_ARG(QString, message)); //Can simply use emit in Qt5
+    if (mPriv->drainScheduled.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "drainPendingMessages", Qt::QueuedConnection);
+    }
 }
 
 QVariantMap BaseDebug::immutableProperties() const
@@ -211,4 +410,33 @@ bool BaseDebug::registerObject(const QString &busName, DBusError *error)
     return ret;
 }
 
+void BaseDebug::drainPendingMessages()
+{
+    mPriv->drain();
+
+    // Otherwise the messages are sent when the timer fires
+    if (!mPriv->batchTimer->isActive()) {
+        sendMessageBatch();
+    }
+}
+
+void BaseDebug::sendMessageBatch()
+{
+    mPriv->drain();
+
+    if (mPriv->unsentMessages.isEmpty()) {
+        return;
+    }
+
+    for (int i = 0; i < maximumMessagesPerBatch && !mPriv->unsentMessages.isEmpty(); ++i) {
+        const DebugMessage message = mPriv->unsentMessages.dequeue();
+        QMetaObject::invokeMethod(mPriv->adaptee, "newDebugMessage",
+                                  Q_ARG(double, message.timestamp), Q_ARG(QString, message.domain),
+                                  Q_ARG(uint, message.level), Q_ARG(QString, message.message)); //Can simply use emit in Qt5
+    }
+
+    // Don't send the next batch before batchInterval, even if it is already there
+    mPriv->batchTimer->start();
+}
+
 }
@@ -40,6 +40,7 @@ class TP_QT_EXPORT BaseDebug : public DBusService
     Q_OBJECT
 public:
     explicit BaseDebug(const QDBusConnection &dbusConnection = QDBusConnection::sessionBus());
+    virtual ~BaseDebug();
 
     bool isEnabled() const;
     int getMessagesLimit() const;
@@ -61,6 +62,10 @@ public Q_SLOTS:
 
     bool registerObject(const QString &busName, DBusError *error = NULL);
 
+private Q_SLOTS:
+    TP_QT_NO_EXPORT void drainPendingMessages();
+    TP_QT_NO_EXPORT void sendMessageBatch();
+
 protected:
     class Adaptee;
     friend class Adaptee;
@@ -26,9 +26,13 @@
 #include <TelepathyQt/MethodInvocationContext>
 #include <TelepathyQt/Types>
 
+#include <QDBusAbstractAdaptor>
+#include <QDBusMessage>
 #include <QObject>
+#include <QRunnable>
 #include <QString>
 #include <QStringList>
+#include <QVariantList>
 #include <QVariantMap>
 
 namespace Tp
@@ -69,6 +73,45 @@ public:
     BaseProtocol *mProtocol;
 };
 
+// Runs one of the protocol callbacks on a thread pool and replies from the thread of the
+// adaptor once done
+class TP_QT_NO_EXPORT BaseProtocolCallbackJob : public QObject, public QRunnable
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BaseProtocolCallbackJob)
+
+public:
+    enum Method {
+        IdentifyAccount,
+        NormalizeContact,
+        NormalizeVCardAddress,
+        NormalizeContactUri
+    };
+
+    BaseProtocolCallbackJob(const BaseProtocolPtr &protocol, Method method,
+            const QVariantList &arguments, const MethodInvocationContextPtr<QString> &context);
+    BaseProtocolCallbackJob(const BaseProtocolAddressingInterfacePtr &addressingInterface,
+            Method method, const QVariantList &arguments,
+            const MethodInvocationContextPtr<QString> &context);
+    ~BaseProtocolCallbackJob();
+
+    void run();
+
+private Q_SLOTS:
+    void finish();
+
+private:
+    BaseProtocolPtr mProtocol;
+    BaseProtocolAddressingInterfacePtr mAddressingInterface;
+    Method mMethod;
+    QVariantList mArguments;
+    MethodInvocationContextPtr<QString> mContext;
+
+    QString mResult;
+    QString mErrorName;
+    QString mErrorMessage;
+};
+
 class TP_QT_NO_EXPORT BaseProtocolAddressingInterface::Adaptee : public QObject
 {
     Q_OBJECT
@@ -92,6 +135,87 @@ public:
     BaseProtocolAddressingInterface *mInterface;
 };
 
+// Normalizes all the inputs of a BulkNormalization call with the synchronous callbacks, on a
+// thread pool or right away, and replies from the thread of the adaptor once done
+class TP_QT_NO_EXPORT BaseProtocolBulkNormalizationJob : public QObject, public QRunnable
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BaseProtocolBulkNormalizationJob)
+
+public:
+    enum Method {
+        NormalizeContacts,
+        NormalizeVCardAddresses,
+        NormalizeContactUris
+    };
+
+    typedef MethodInvocationContextPtr<Tp::StringStringMap, Tp::StringStringMap> ContextPtr;
+
+    BaseProtocolBulkNormalizationJob(const BaseProtocolPtr &protocol,
+            const BaseProtocolAddressingInterfacePtr &addressingInterface, Method method,
+            const QString &vcardField, const QStringList &inputs, const ContextPtr &context);
+    ~BaseProtocolBulkNormalizationJob();
+
+    void run();
+    void normalize();
+
+public Q_SLOTS:
+    void finish();
+
+private:
+    BaseProtocolPtr mProtocol;
+    BaseProtocolAddressingInterfacePtr mAddressingInterface;
+    Method mMethod;
+    QString mVCardField;
+    QStringList mInputs;
+    ContextPtr mContext;
+
+    Tp::StringStringMap mNormalized;
+    Tp::StringStringMap mErrors;
+};
+
+class TP_QT_NO_EXPORT BaseProtocolBulkNormalizationInterface::Adaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Qt.Protocol.Interface.BulkNormalization")
+    Q_CLASSINFO("D-Bus Introspection", ""
+"  <interface name=\"org.freedesktop.Telepathy.Qt.Protocol.Interface.BulkNormalization\">\n"
+"    <method name=\"NormalizeContacts\">\n"
+"      <arg direction=\"in\" type=\"as\" name=\"Contact_IDs\"/>\n"
+"      <arg direction=\"out\" type=\"a{ss}\" name=\"Normalized\"/>\n"
+"      <arg direction=\"out\" type=\"a{ss}\" name=\"Errors\"/>\n"
+"    </method>\n"
+"    <method name=\"NormalizeVCardAddresses\">\n"
+"      <arg direction=\"in\" type=\"s\" name=\"VCard_Field\"/>\n"
+"      <arg direction=\"in\" type=\"as\" name=\"VCard_Addresses\"/>\n"
+"      <arg direction=\"out\" type=\"a{ss}\" name=\"Normalized\"/>\n"
+"      <arg direction=\"out\" type=\"a{ss}\" name=\"Errors\"/>\n"
+"    </method>\n"
+"    <method name=\"NormalizeContactURIs\">\n"
+"      <arg direction=\"in\" type=\"as\" name=\"URIs\"/>\n"
+"      <arg direction=\"out\" type=\"a{ss}\" name=\"Normalized\"/>\n"
+"      <arg direction=\"out\" type=\"a{ss}\" name=\"Errors\"/>\n"
+"    </method>\n"
+"  </interface>\n"
+        "")
+
+public:
+    Adaptor(BaseProtocolBulkNormalizationInterface *interface);
+    ~Adaptor();
+
+public Q_SLOTS: // METHODS
+    void NormalizeContacts(const QStringList &contactIds, const QDBusMessage &message);
+    void NormalizeVCardAddresses(const QString &vcardField, const QStringList &vcardAddresses,
+            const QDBusMessage &message);
+    void NormalizeContactURIs(const QStringList &uris, const QDBusMessage &message);
+
+private:
+    void startJob(BaseProtocolBulkNormalizationJob::Method method, const QString &vcardField,
+            const QStringList &inputs, const QDBusMessage &message);
+
+    BaseProtocolBulkNormalizationInterface *mInterface;
+};
+
 class TP_QT_NO_EXPORT BaseProtocolAvatarsInterface::Adaptee : public QObject
 {
     Q_OBJECT
@@ -34,8 +34,10 @@
 #include <TelepathyQt/Utils>
 
 #include <QDBusObjectPath>
+#include <QPointer>
 #include <QString>
 #include <QStringList>
+#include <QThreadPool>
 
 namespace Tp
 {
@@ -46,7 +48,8 @@ struct TP_QT_NO_EXPORT BaseProtocol::Private
             const QString &name)
         : parent(parent),
           name(name),
-          adaptee(new BaseProtocol::Adaptee(dbusConnection, parent))
+          adaptee(new BaseProtocol::Adaptee(dbusConnection, parent)),
+          immutablePropertiesCached(false)
     {
     }
 
@@ -65,7 +68,14 @@ struct TP_QT_NO_EXPORT BaseProtocol::Private
     QStringList authTypes;
     CreateConnectionCallback createConnectionCb;
     IdentifyAccountCallback identifyAccountCb;
+    IdentifyAccountAsyncCallback identifyAccountAsyncCb;
     NormalizeContactCallback normalizeContactCb;
+    NormalizeContactAsyncCallback normalizeContactAsyncCb;
+    QPointer<QThreadPool> callbackThreadPool;
+
+    // filled on the first request once registered, when it cannot change anymore
+    bool immutablePropertiesCached;
+    QVariantMap immutableProperties;
 };
 
 BaseProtocol::Adaptee::Adaptee(const QDBusConnection &dbusConnection, BaseProtocol *protocol)
@@ -137,6 +147,19 @@ QStringList BaseProtocol::Adaptee::authenticationTypes() const
 void BaseProtocol::Adaptee::identifyAccount(const QVariantMap &parameters,
         const Tp::Service::ProtocolAdaptor::IdentifyAccountContextPtr &context)
 {
+    if (mProtocol->mPriv->identifyAccountAsyncCb.isValid()) {
+        mProtocol->mPriv->identifyAccountAsyncCb(parameters, context);
+        return;
+    }
+
+    QThreadPool *pool = mProtocol->callbackThreadPool();
+    if (pool) {
+        pool->start(new BaseProtocolCallbackJob(BaseProtocolPtr(mProtocol),
+                    BaseProtocolCallbackJob::IdentifyAccount,
+                    QVariantList() << parameters, context));
+        return;
+    }
+
     DBusError error;
     QString accountId;
     accountId = mProtocol->identifyAccount(parameters, &error);
@@ -150,6 +173,19 @@ void BaseProtocol::Adaptee::identifyAccount(const QVariantMap &parameters,
 void BaseProtocol::Adaptee::normalizeContact(const QString &contactId,
         const Tp::Service::ProtocolAdaptor::NormalizeContactContextPtr &context)
 {
+    if (mProtocol->mPriv->normalizeContactAsyncCb.isValid()) {
+        mProtocol->mPriv->normalizeContactAsyncCb(contactId, context);
+        return;
+    }
+
+    QThreadPool *pool = mProtocol->callbackThreadPool();
+    if (pool) {
+        pool->start(new BaseProtocolCallbackJob(BaseProtocolPtr(mProtocol),
+                    BaseProtocolCallbackJob::NormalizeContact,
+                    QVariantList() << contactId, context));
+        return;
+    }
+
     DBusError error;
     QString normalizedContactId;
     normalizedContactId = mProtocol->normalizeContact(contactId, &error);
@@ -160,6 +196,72 @@ void BaseProtocol::Adaptee::normalizeContact(const QString &contactId,
     context->setFinished(normalizedContactId);
 }
 
+BaseProtocolCallbackJob::BaseProtocolCallbackJob(const BaseProtocolPtr &protocol,
+        Method method, const QVariantList &arguments,
+        const MethodInvocationContextPtr<QString> &context)
+    : mProtocol(protocol),
+      mMethod(method),
+      mArguments(arguments),
+      mContext(context)
+{
+    // we delete ourselves in finish(), from the thread we were created in
+    setAutoDelete(false);
+}
+
+BaseProtocolCallbackJob::BaseProtocolCallbackJob(
+        const BaseProtocolAddressingInterfacePtr &addressingInterface,
+        Method method, const QVariantList &arguments,
+        const MethodInvocationContextPtr<QString> &context)
+    : mAddressingInterface(addressingInterface),
+      mMethod(method),
+      mArguments(arguments),
+      mContext(context)
+{
+    setAutoDelete(false);
+}
+
+BaseProtocolCallbackJob::~BaseProtocolCallbackJob()
+{
+}
+
+void BaseProtocolCallbackJob::run()
+{
+    DBusError error;
+    switch (mMethod) {
+        case IdentifyAccount:
+            mResult = mProtocol->identifyAccount(mArguments.at(0).toMap(), &error);
+            break;
+        case NormalizeContact:
+            mResult = mProtocol->normalizeContact(mArguments.at(0).toString(), &error);
+            break;
+        case NormalizeVCardAddress:
+            mResult = mAddressingInterface->normalizeVCardAddress(mArguments.at(0).toString(),
+                    mArguments.at(1).toString(), &error);
+            break;
+        case NormalizeContactUri:
+            mResult = mAddressingInterface->normalizeContactUri(mArguments.at(0).toString(),
+                    &error);
+            break;
+    }
+
+    if (mResult.isEmpty()) {
+        mErrorName = error.name();
+        mErrorMessage = error.message();
+    }
+
+    QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+}
+
+void BaseProtocolCallbackJob::finish()
+{
+    if (mResult.isEmpty()) {
+        mContext->setFinishedWithError(mErrorName, mErrorMessage);
+    } else {
+        mContext->setFinished(mResult);
+    }
+    deleteLater();
+}
+
 /**
  * \class BaseProtocol
  * \ingroup servicecm
@@ -212,12 +314,16 @@ QString BaseProtocol::name() const
  * Return the immutable properties of this protocol object.
  *
  * Immutable properties cannot change after the object has been registered
- * on the bus with registerObject().
+ * on the bus with registerObject(), so they are only built once after that.
  *
  * \return The immutable properties of this protocol object.
  */
 QVariantMap BaseProtocol::immutableProperties() const
 {
+    if (mPriv->immutablePropertiesCached) {
+        return mPriv->immutableProperties;
+    }
+
     QVariantMap ret;
     foreach (const AbstractProtocolInterfacePtr &iface, mPriv->interfaces) {
         ret.unite(iface->immutableProperties());
@@ -238,6 +344,11 @@ QVariantMap BaseProtocol::immutableProperties() const
             QVariant::fromValue(mPriv->adaptee->icon()));
     ret.insert(TP_QT_IFACE_PROTOCOL + QLatin1String(".AuthenticationTypes"),
             QVariant::fromValue(mPriv->adaptee->authenticationTypes()));
+
+    if (isRegistered()) {
+        mPriv->immutableProperties = ret;
+        mPriv->immutablePropertiesCached = true;
+    }
     return ret;
 }
 
@@ -591,6 +702,26 @@ QString BaseProtocol::identifyAccount(const QVariantMap &parameters, Tp::DBusErr
     return mPriv->identifyAccountCb(parameters, error);
 }
 
+/**
+ * Set a callback that will be called from a client to identify an account, and
+ * which replies later on through the given context.
+ *
+ * This callback will be called when the IdentifyAccount method on the Protocol
+ * D-Bus object has been called, instead of the one set with setIdentifyAccountCallback().
+ * It must eventually call MethodInvocationContext::setFinished() with the account
+ * identifier, or MethodInvocationContext::setFinishedWithError(), for instance once
+ * a request to the server has completed. It is called in the thread of this protocol,
+ * regardless of setCallbackThreadPool().
+ *
+ * \param cb The callback to set, or an invalid callback to call the one set with
+ * setIdentifyAccountCallback() again.
+ * \sa setIdentifyAccountCallback()
+ */
+void BaseProtocol::setIdentifyAccountAsyncCallback(const IdentifyAccountAsyncCallback &cb)
+{
+    mPriv->identifyAccountAsyncCb = cb;
+}
+
 /**
  * Set a callback that will be called from a client to normalize a contact id.
  *
@@ -622,6 +753,58 @@ QString BaseProtocol::normalizeContact(const QString &contactId, Tp::DBusError *
     return mPriv->normalizeContactCb(contactId, error);
 }
 
+/**
+ * Set a callback that will be called from a client to normalize a contact id, and
+ * which replies later on through the given context.
+ *
+ * This works the same as setIdentifyAccountAsyncCallback(), for the NormalizeContact
+ * method. The callback set with setNormalizeContactCallback() is still used by
+ * BaseProtocolBulkNormalizationInterface.
+ *
+ * \param cb The callback to set, or an invalid callback to call the one set with
+ * setNormalizeContactCallback() again.
+ * \sa setNormalizeContactCallback()
+ */
+void BaseProtocol::setNormalizeContactAsyncCallback(const NormalizeContactAsyncCallback &cb)
+{
+    mPriv->normalizeContactAsyncCb = cb;
+}
+
+/**
+ * Return the thread pool set with setCallbackThreadPool().
+ *
+ * \return A pointer to the QThreadPool, or \c 0 if none has been set.
+ * \sa setCallbackThreadPool()
+ */
+QThreadPool *BaseProtocol::callbackThreadPool() const
+{
+    return mPriv->callbackThreadPool;
+}
+
+/**
+ * Set a thread pool on which the callbacks set with setIdentifyAccountCallback() and
+ * setNormalizeContactCallback() will be called when the corresponding methods are
+ * called on the bus.
+ *
+ * By default, or if \a pool is \c 0, these callbacks are called right away, in the thread
+ * of this protocol. With a pool, many calls can be processed at the same time and each
+ * reply is sent from the thread of this protocol as soon as its callback returns, possibly
+ * out of order. The callbacks must then be thread-safe.
+ *
+ * The pool is not owned by this protocol. If it is deleted, the callbacks are called in the
+ * thread of this protocol again.
+ *
+ * The pool is not used for the methods which have an asynchronous callback, see
+ * setIdentifyAccountAsyncCallback() and setNormalizeContactAsyncCallback().
+ *
+ * \param pool The thread pool to use, or \c 0.
+ * \sa callbackThreadPool()
+ */
+void BaseProtocol::setCallbackThreadPool(QThreadPool *pool)
+{
+    mPriv->callbackThreadPool = pool;
+}
+
 /**
  * Return a list of interfaces that have been plugged into this Protocol
  * D-Bus object with plugInterface().
@@ -727,6 +910,23 @@ AbstractProtocolInterface::~AbstractProtocolInterface()
 }
 
 // Proto.I.Addressing
+struct TP_QT_NO_EXPORT BaseProtocolAddressingInterface::Private
+{
+    Private(BaseProtocolAddressingInterface *parent)
+        : adaptee(new BaseProtocolAddressingInterface::Adaptee(parent))
+    {
+    }
+
+    BaseProtocolAddressingInterface::Adaptee *adaptee;
+    QStringList addressableVCardFields;
+    QStringList addressableUriSchemes;
+    NormalizeVCardAddressCallback normalizeVCardAddressCb;
+    NormalizeVCardAddressAsyncCallback normalizeVCardAddressAsyncCb;
+    NormalizeContactUriCallback normalizeContactUriCb;
+    NormalizeContactUriAsyncCallback normalizeContactUriAsyncCb;
+    QPointer<QThreadPool> callbackThreadPool;
+};
+
 BaseProtocolAddressingInterface::Adaptee::Adaptee(BaseProtocolAddressingInterface *interface)
     : QObject(interface),
       mInterface(interface)
@@ -751,6 +951,19 @@ void BaseProtocolAddressingInterface::Adaptee::normalizeVCardAddress(const QStri
         const QString& vcardAddress,
         const Tp::Service::ProtocolInterfaceAddressingAdaptor::NormalizeVCardAddressContextPtr &context)
 {
+    if (mInterface->mPriv->normalizeVCardAddressAsyncCb.isValid()) {
+        mInterface->mPriv->normalizeVCardAddressAsyncCb(vcardField, vcardAddress, context);
+        return;
+    }
+
+    QThreadPool *pool = mInterface->callbackThreadPool();
+    if (pool) {
+        pool->start(new BaseProtocolCallbackJob(BaseProtocolAddressingInterfacePtr(mInterface),
+                    BaseProtocolCallbackJob::NormalizeVCardAddress,
+                    QVariantList() << vcardField << vcardAddress, context));
+        return;
+    }
+
     DBusError error;
     QString normalizedAddress;
     normalizedAddress = mInterface->normalizeVCardAddress(vcardField, vcardAddress, &error);
@@ -764,6 +977,19 @@ void BaseProtocolAddressingInterface::Adaptee::normalizeVCardAddress(const QStri
 void BaseProtocolAddressingInterface::Adaptee::normalizeContactURI(const QString& uri,
         const Tp::Service::ProtocolInterfaceAddressingAdaptor::NormalizeContactURIContextPtr &context)
 {
+    if (mInterface->mPriv->normalizeContactUriAsyncCb.isValid()) {
+        mInterface->mPriv->normalizeContactUriAsyncCb(uri, context);
+        return;
+    }
+
+    QThreadPool *pool = mInterface->callbackThreadPool();
+    if (pool) {
+        pool->start(new BaseProtocolCallbackJob(BaseProtocolAddressingInterfacePtr(mInterface),
+                    BaseProtocolCallbackJob::NormalizeContactUri,
+                    QVariantList() << uri, context));
+        return;
+    }
+
     DBusError error;
     QString normalizedUri;
     normalizedUri = mInterface->normalizeContactUri(uri, &error);
@@ -774,20 +1000,6 @@ void BaseProtocolAddressingInterface::Adaptee::normalizeContactURI(const QString
     context->setFinished(normalizedUri);
 }
 
-struct TP_QT_NO_EXPORT BaseProtocolAddressingInterface::Private
-{
-    Private(BaseProtocolAddressingInterface *parent)
-        : adaptee(new BaseProtocolAddressingInterface::Adaptee(parent))
-    {
-    }
-
-    BaseProtocolAddressingInterface::Adaptee *adaptee;
-    QStringList addressableVCardFields;
-    QStringList addressableUriSchemes;
-    NormalizeVCardAddressCallback normalizeVCardAddressCb;
-    NormalizeContactUriCallback normalizeContactUriCb;
-};
-
 /**
  * \class BaseProtocolAddressingInterface
  * \ingroup servicecm
@@ -849,11 +1061,19 @@ QStringList BaseProtocolAddressingInterface::addressableVCardFields() const
  *
  * All the field names should be normalized to lower case.
  *
+ * This property cannot change after this interface has been registered
+ * on an object on the bus with registerInterface().
+ *
  * \param vcardFields The list of vcard fields to set.
  * \sa addressableVCardFields()
  */
 void BaseProtocolAddressingInterface::setAddressableVCardFields(const QStringList &vcardFields)
 {
+    if (isRegistered()) {
+        warning() << "BaseProtocolAddressingInterface::setAddressableVCardFields: cannot change "
+            "property after registration, immutable property";
+        return;
+    }
     mPriv->addressableVCardFields = vcardFields;
 }
 
@@ -877,11 +1097,19 @@ QStringList BaseProtocolAddressingInterface::addressableUriSchemes() const
 /**
  * Set the list of URI schemes that are supported by this protocol.
  *
+ * This property cannot change after this interface has been registered
+ * on an object on the bus with registerInterface().
+ *
  * \param uriSchemes The list of URI schemes to set.
  * \sa addressableUriSchemes()
  */
 void BaseProtocolAddressingInterface::setAddressableUriSchemes(const QStringList &uriSchemes)
 {
+    if (isRegistered()) {
+        warning() << "BaseProtocolAddressingInterface::setAddressableUriSchemes: cannot change "
+            "property after registration, immutable property";
+        return;
+    }
     mPriv->addressableUriSchemes = uriSchemes;
 }
 
@@ -925,6 +1153,23 @@ QString BaseProtocolAddressingInterface::normalizeVCardAddress(const QString &vc
     return mPriv->normalizeVCardAddressCb(vcardField, vcardAddress, error);
 }
 
+/**
+ * Set a callback that will be called from a client to normalize a given vcard address,
+ * and which replies later on through the given context.
+ *
+ * This works the same as BaseProtocol::setIdentifyAccountAsyncCallback(), for the
+ * NormalizeVCardAddress method.
+ *
+ * \param cb The callback to set, or an invalid callback to call the one set with
+ * setNormalizeVCardAddressCallback() again.
+ * \sa setNormalizeVCardAddressCallback()
+ */
+void BaseProtocolAddressingInterface::setNormalizeVCardAddressAsyncCallback(
+        const NormalizeVCardAddressAsyncCallback &cb)
+{
+    mPriv->normalizeVCardAddressAsyncCb = cb;
+}
+
 /**
  * Set a callback that will be called from a client to normalize a given contact URI.
  *
@@ -960,6 +1205,49 @@ QString BaseProtocolAddressingInterface::normalizeContactUri(const QString &uri,
     return mPriv->normalizeContactUriCb(uri, error);
 }
 
+/**
+ * Set a callback that will be called from a client to normalize a given contact URI,
+ * and which replies later on through the given context.
+ *
+ * This works the same as BaseProtocol::setIdentifyAccountAsyncCallback(), for the
+ * NormalizeContactURI method.
+ *
+ * \param cb The callback to set, or an invalid callback to call the one set with
+ * setNormalizeContactUriCallback() again.
+ * \sa setNormalizeContactUriCallback()
+ */
+void BaseProtocolAddressingInterface::setNormalizeContactUriAsyncCallback(
+        const NormalizeContactUriAsyncCallback &cb)
+{
+    mPriv->normalizeContactUriAsyncCb = cb;
+}
+
+/**
+ * Return the thread pool set with setCallbackThreadPool().
+ *
+ * \return A pointer to the QThreadPool, or \c 0 if none has been set.
+ * \sa setCallbackThreadPool()
+ */
+QThreadPool *BaseProtocolAddressingInterface::callbackThreadPool() const
+{
+    return mPriv->callbackThreadPool;
+}
+
+/**
+ * Set a thread pool on which the callbacks set with setNormalizeVCardAddressCallback() and
+ * setNormalizeContactUriCallback() will be called when the corresponding methods are
+ * called on the bus.
+ *
+ * This works the same as BaseProtocol::setCallbackThreadPool().
+ *
+ * \param pool The thread pool to use, or \c 0.
+ * \sa callbackThreadPool()
+ */
+void BaseProtocolAddressingInterface::setCallbackThreadPool(QThreadPool *pool)
+{
+    mPriv->callbackThreadPool = pool;
+}
+
 void BaseProtocolAddressingInterface::createAdaptor()
 {
     (void) new Service::ProtocolInterfaceAddressingAdaptor(dbusObject()->dbusConnection(),
@@ -1241,4 +1529,207 @@ void BaseProtocolPresenceInterface::createAdaptor()
                 mPriv->adaptee, dbusObject());
 }
 
+// Proto.I.BulkNormalization
+struct TP_QT_NO_EXPORT BaseProtocolBulkNormalizationInterface::Private
+{
+    Private(BaseProtocol *protocol)
+        : protocol(protocol)
+    {
+    }
+
+    BaseProtocol *protocol;
+};
+
+BaseProtocolBulkNormalizationJob::BaseProtocolBulkNormalizationJob(
+        const BaseProtocolPtr &protocol,
+        const BaseProtocolAddressingInterfacePtr &addressingInterface, Method method,
+        const QString &vcardField, const QStringList &inputs, const ContextPtr &context)
+    : mProtocol(protocol),
+      mAddressingInterface(addressingInterface),
+      mMethod(method),
+      mVCardField(vcardField),
+      mInputs(inputs),
+      mContext(context)
+{
+    // we delete ourselves in finish(), from the thread we were created in
+    setAutoDelete(false);
+}
+
+BaseProtocolBulkNormalizationJob::~BaseProtocolBulkNormalizationJob()
+{
+}
+
+void BaseProtocolBulkNormalizationJob::run()
+{
+    normalize();
+    QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+}
+
+void BaseProtocolBulkNormalizationJob::normalize()
+{
+    foreach (const QString &input, mInputs) {
+        if (mNormalized.contains(input) || mErrors.contains(input)) {
+            continue;
+        }
+
+        DBusError error;
+        QString result;
+        switch (mMethod) {
+            case NormalizeContacts:
+                result = mProtocol->normalizeContact(input, &error);
+                break;
+            case NormalizeVCardAddresses:
+                result = mAddressingInterface->normalizeVCardAddress(mVCardField, input, &error);
+                break;
+            case NormalizeContactUris:
+                result = mAddressingInterface->normalizeContactUri(input, &error);
+                break;
+        }
+
+        if (!result.isEmpty()) {
+            mNormalized.insert(input, result);
+        } else if (error.isValid()) {
+            mErrors.insert(input, error.name());
+        } else {
+            mErrors.insert(input, TP_QT_ERROR_INVALID_ARGUMENT);
+        }
+    }
+}
+
+void BaseProtocolBulkNormalizationJob::finish()
+{
+    mContext->setFinished(mNormalized, mErrors);
+    deleteLater();
+}
+
+BaseProtocolBulkNormalizationInterface::Adaptor::Adaptor(
+        BaseProtocolBulkNormalizationInterface *interface)
+    : QDBusAbstractAdaptor(interface->dbusObject()),
+      mInterface(interface)
+{
+}
+
+BaseProtocolBulkNormalizationInterface::Adaptor::~Adaptor()
+{
+}
+
+void BaseProtocolBulkNormalizationInterface::Adaptor::NormalizeContacts(
+        const QStringList &contactIds, const QDBusMessage &message)
+{
+    startJob(BaseProtocolBulkNormalizationJob::NormalizeContacts, QString(), contactIds, message);
+}
+
+void BaseProtocolBulkNormalizationInterface::Adaptor::NormalizeVCardAddresses(
+        const QString &vcardField, const QStringList &vcardAddresses, const QDBusMessage &message)
+{
+    startJob(BaseProtocolBulkNormalizationJob::NormalizeVCardAddresses, vcardField,
+            vcardAddresses, message);
+}
+
+void BaseProtocolBulkNormalizationInterface::Adaptor::NormalizeContactURIs(
+        const QStringList &uris, const QDBusMessage &message)
+{
+    startJob(BaseProtocolBulkNormalizationJob::NormalizeContactUris, QString(), uris, message);
+}
+
+void BaseProtocolBulkNormalizationInterface::Adaptor::startJob(
+        BaseProtocolBulkNormalizationJob::Method method, const QString &vcardField,
+        const QStringList &inputs, const QDBusMessage &message)
+{
+    BaseProtocolBulkNormalizationJob::ContextPtr context(
+            new MethodInvocationContext<Tp::StringStringMap, Tp::StringStringMap>(
+                mInterface->dbusObject()->dbusConnection(), message));
+
+    BaseProtocol *protocol = mInterface->mPriv->protocol;
+    BaseProtocolAddressingInterfacePtr addressingInterface;
+    QThreadPool *pool;
+    if (method == BaseProtocolBulkNormalizationJob::NormalizeContacts) {
+        pool = protocol->callbackThreadPool();
+    } else {
+        addressingInterface = BaseProtocolAddressingInterfacePtr::qObjectCast(
+                protocol->interface(TP_QT_IFACE_PROTOCOL_INTERFACE_ADDRESSING));
+        if (!addressingInterface) {
+            context->setFinishedWithError(TP_QT_ERROR_NOT_IMPLEMENTED,
+                    QLatin1String("The protocol has no Addressing interface"));
+            return;
+        }
+        pool = addressingInterface->callbackThreadPool();
+    }
+
+    BaseProtocolBulkNormalizationJob *job = new BaseProtocolBulkNormalizationJob(
+            BaseProtocolPtr(protocol), addressingInterface, method, vcardField, inputs, context);
+    if (pool) {
+        pool->start(job);
+        return;
+    }
+
+    job->normalize();
+    job->finish();
+}
+
+/**
+ * \class BaseProtocolBulkNormalizationInterface
+ * \ingroup servicecm
+ * \headerfile TelepathyQt/base-protocol.h <TelepathyQt/BaseProtocolBulkNormalizationInterface>
+ *
+ * \brief Interface normalizing many contact identifiers or addresses in a single call.
+ *
+ * This is not a Telepathy specification interface, but an extension specific to TelepathyQt.
+ * Once plugged into a BaseProtocol, it exports the
+ * org.freedesktop.Telepathy.Qt.Protocol.Interface.BulkNormalization interface on the
+ * protocol object, whose NormalizeContacts, NormalizeVCardAddresses and NormalizeContactURIs
+ * methods take a list of inputs and return two maps: the normalized form of each input that
+ * could be normalized, and the D-Bus error name of each one that could not.
+ *
+ * The inputs are normalized with the synchronous callbacks, set with
+ * BaseProtocol::setNormalizeContactCallback(),
+ * BaseProtocolAddressingInterface::setNormalizeVCardAddressCallback() and
+ * BaseProtocolAddressingInterface::setNormalizeContactUriCallback(), one after the other
+ * as a single job on the callback thread pool of the protocol, or of its addressing interface,
+ * when one has been set. An input for which the callback returned an empty string without
+ * setting an error is reported with TP_QT_ERROR_INVALID_ARGUMENT.
+ *
+ * The vCard address and contact URI methods fail with TP_QT_ERROR_NOT_IMPLEMENTED if no
+ * BaseProtocolAddressingInterface has been plugged into the protocol.
+ */
+
+/**
+ * Class constructor.
+ *
+ * \param protocol The protocol this interface is to be plugged into.
+ */
+BaseProtocolBulkNormalizationInterface::BaseProtocolBulkNormalizationInterface(
+        BaseProtocol *protocol)
+    : AbstractProtocolInterface(TP_QT_IFACE_PROTOCOL_INTERFACE_BULK_NORMALIZATION),
+      mPriv(new Private(protocol))
+{
+}
+
+/**
+ * Class destructor.
+ */
+BaseProtocolBulkNormalizationInterface::~BaseProtocolBulkNormalizationInterface()
+{
+    delete mPriv;
+}
+
+/**
+ * Return the immutable properties of this interface.
+ *
+ * Immutable properties cannot change after the interface has been registered
+ * on a service on the bus with registerInterface().
+ *
+ * \return The immutable properties of this interface.
+ */
+QVariantMap BaseProtocolBulkNormalizationInterface::immutableProperties() const
+{
+    QVariantMap map;
+    return map;
+}
+
+void BaseProtocolBulkNormalizationInterface::createAdaptor()
+{
+    (void) new BaseProtocolBulkNormalizationInterface::Adaptor(this);
+}
+
 }
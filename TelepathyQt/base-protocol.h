@@ -40,6 +40,7 @@
 
 class QString;
 class QStringList;
+class QThreadPool;
 
 namespace Tp
 {
@@ -107,10 +108,21 @@ public:
     void setIdentifyAccountCallback(const IdentifyAccountCallback &cb);
     QString identifyAccount(const QVariantMap &parameters, DBusError *error);
 
+    typedef Callback2<void, const QVariantMap &,
+            const MethodInvocationContextPtr<QString> &> IdentifyAccountAsyncCallback;
+    void setIdentifyAccountAsyncCallback(const IdentifyAccountAsyncCallback &cb);
+
     typedef Callback2<QString, const QString &, DBusError*> NormalizeContactCallback;
     void setNormalizeContactCallback(const NormalizeContactCallback &cb);
     QString normalizeContact(const QString &contactId, DBusError *error);
 
+    typedef Callback2<void, const QString &,
+            const MethodInvocationContextPtr<QString> &> NormalizeContactAsyncCallback;
+    void setNormalizeContactAsyncCallback(const NormalizeContactAsyncCallback &cb);
+
+    QThreadPool *callbackThreadPool() const;
+    void setCallbackThreadPool(QThreadPool *pool);
+
     QList<AbstractProtocolInterfacePtr> interfaces() const;
     AbstractProtocolInterfacePtr interface(const QString & interfaceName) const;
     bool plugInterface(const AbstractProtocolInterfacePtr &interface);
@@ -178,10 +190,21 @@ public:
     void setNormalizeVCardAddressCallback(const NormalizeVCardAddressCallback &cb);
     QString normalizeVCardAddress(const QString &vcardField, const QString &vcardAddress, DBusError *error);
 
+    typedef Callback3<void, const QString &, const QString &,
+            const MethodInvocationContextPtr<QString> &> NormalizeVCardAddressAsyncCallback;
+    void setNormalizeVCardAddressAsyncCallback(const NormalizeVCardAddressAsyncCallback &cb);
+
     typedef Callback2<QString, const QString &, DBusError*> NormalizeContactUriCallback;
     void setNormalizeContactUriCallback(const NormalizeContactUriCallback &cb);
     QString normalizeContactUri(const QString &uri, DBusError *error);
 
+    typedef Callback2<void, const QString &,
+            const MethodInvocationContextPtr<QString> &> NormalizeContactUriAsyncCallback;
+    void setNormalizeContactUriAsyncCallback(const NormalizeContactUriAsyncCallback &cb);
+
+    QThreadPool *callbackThreadPool() const;
+    void setCallbackThreadPool(QThreadPool *pool);
+
 protected:
     BaseProtocolAddressingInterface();
 
@@ -232,6 +255,41 @@ private:
     Private *mPriv;
 };
 
+class TP_QT_EXPORT BaseProtocolBulkNormalizationInterface : public AbstractProtocolInterface
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BaseProtocolBulkNormalizationInterface)
+
+public:
+    static BaseProtocolBulkNormalizationInterfacePtr create(BaseProtocol *protocol)
+    {
+        return BaseProtocolBulkNormalizationInterfacePtr(
+                new BaseProtocolBulkNormalizationInterface(protocol));
+    }
+    template<typename BaseProtocolBulkNormalizationInterfaceSubclass>
+    static SharedPtr<BaseProtocolBulkNormalizationInterfaceSubclass> create(BaseProtocol *protocol)
+    {
+        return SharedPtr<BaseProtocolBulkNormalizationInterfaceSubclass>(
+                new BaseProtocolBulkNormalizationInterfaceSubclass(protocol));
+    }
+
+    virtual ~BaseProtocolBulkNormalizationInterface();
+
+    QVariantMap immutableProperties() const;
+
+protected:
+    BaseProtocolBulkNormalizationInterface(BaseProtocol *protocol);
+
+private:
+    void createAdaptor();
+
+    class Adaptor;
+    friend class Adaptor;
+    struct Private;
+    friend struct Private;
+    Private *mPriv;
+};
+
 class TP_QT_EXPORT BaseProtocolPresenceInterface : public AbstractProtocolInterface
 {
     Q_OBJECT
@@ -34,6 +34,8 @@
 #include <TelepathyQt/PendingVariantMap>
 #include <TelepathyQt/PendingVariant>
 
+#include <QTimer>
+
 namespace Tp
 {
 
@@ -82,6 +84,12 @@ struct TP_QT_NO_EXPORT CallChannel::Private
     CallContents contents;
     CallContents incompleteContents;
 
+    // Batched resolution of stream remote members
+    uint pendingProxyIntrospections;
+    bool requestStreamContactsScheduled;
+    QSet<uint> streamContactsHandles;
+    QList<WeakPtr<CallStream> > streamContactsQueue;
+
     uint localHoldState;
     uint localHoldStateReason;
 };
@@ -127,6 +135,8 @@ CallChannel::Private::Private(CallChannel *parent)
       initialAudio(false),
       initialVideo(false),
       mutableContents(false),
+      pendingProxyIntrospections(0),
+      requestStreamContactsScheduled(false),
       localHoldState(LocalHoldStateUnheld),
       localHoldStateReason(LocalHoldStateReasonNone)
 {
@@ -1203,6 +1213,73 @@ CallContentPtr CallChannel::lookupContent(const QDBusObjectPath &contentPath) co
     return CallContentPtr();
 }
 
+/*
+ * Contents and streams bracket their main properties request with
+ * beginProxyIntrospection() and endProxyIntrospection(). While any of these
+ * requests is in flight, contacts requested by streams are only queued, so
+ * that the remote members of every stream of the channel are resolved with a
+ * single contacts request once the whole content/stream tree is known.
+ */
+void CallChannel::beginProxyIntrospection()
+{
+    ++mPriv->pendingProxyIntrospections;
+}
+
+void CallChannel::endProxyIntrospection()
+{
+    Q_ASSERT(mPriv->pendingProxyIntrospections > 0);
+
+    if (--mPriv->pendingProxyIntrospections == 0 &&
+        !mPriv->streamContactsQueue.isEmpty() &&
+        !mPriv->requestStreamContactsScheduled) {
+        mPriv->requestStreamContactsScheduled = true;
+        QTimer::singleShot(0, this, SLOT(doRequestStreamContacts()));
+    }
+}
+
+void CallChannel::requestStreamContacts(CallStream *stream, const UIntList &handles,
+        const HandleIdentifierMap &identifiers)
+{
+    connection()->lowlevel()->injectContactIds(identifiers);
+
+    mPriv->streamContactsHandles.unite(handles.toSet());
+    mPriv->streamContactsQueue.append(WeakPtr<CallStream>(CallStreamPtr(stream)));
+
+    if (!mPriv->requestStreamContactsScheduled) {
+        mPriv->requestStreamContactsScheduled = true;
+        QTimer::singleShot(0, this, SLOT(doRequestStreamContacts()));
+    }
+}
+
+void CallChannel::doRequestStreamContacts()
+{
+    mPriv->requestStreamContactsScheduled = false;
+
+    if (mPriv->pendingProxyIntrospections > 0 || mPriv->streamContactsQueue.isEmpty()) {
+        // endProxyIntrospection() will reschedule us once the tree is known
+        return;
+    }
+
+    debug() << "Requesting" << mPriv->streamContactsHandles.size() <<
+        "stream remote members for" << mPriv->streamContactsQueue.size() << "streams";
+
+    ContactManagerPtr contactManager = connection()->contactManager();
+    PendingContacts *contacts = contactManager->contactsForHandles(
+            mPriv->streamContactsHandles.toList());
+
+    foreach (const WeakPtr<CallStream> &weakStream, mPriv->streamContactsQueue) {
+        CallStreamPtr stream(weakStream);
+        if (stream) {
+            stream->connect(contacts,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(gotRemoteMembersContacts(Tp::PendingOperation*)));
+        }
+    }
+
+    mPriv->streamContactsHandles.clear();
+    mPriv->streamContactsQueue.clear();
+}
+
 /**
  * \fn void CallChannel::callStateChanged(Tp::CallState state);
  *
@@ -128,16 +128,24 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void onContentRemoved(const QDBusObjectPath &contentPath,
             const Tp::CallStateReason &reason);
     TP_QT_NO_EXPORT void onContentReady(Tp::PendingOperation *op);
+    TP_QT_NO_EXPORT void doRequestStreamContacts();
 
     TP_QT_NO_EXPORT void gotLocalHoldState(QDBusPendingCallWatcher *);
     TP_QT_NO_EXPORT void onLocalHoldStateChanged(uint, uint);
 
 private:
+    friend class CallContent;
+    friend class CallStream;
     friend class PendingCallContent;
 
     TP_QT_NO_EXPORT CallContentPtr addContent(const QDBusObjectPath &contentPath);
     TP_QT_NO_EXPORT CallContentPtr lookupContent(const QDBusObjectPath &contentPath) const;
 
+    TP_QT_NO_EXPORT void beginProxyIntrospection();
+    TP_QT_NO_EXPORT void endProxyIntrospection();
+    TP_QT_NO_EXPORT void requestStreamContacts(CallStream *stream, const UIntList &handles,
+            const HandleIdentifierMap &identifiers);
+
     struct Private;
     friend struct Private;
     Private *mPriv;
@@ -45,6 +45,7 @@ struct TP_QT_NO_EXPORT CallContent::Private
     Private(CallContent *parent, const CallChannelPtr &channel);
 
     static void introspectMainProperties(Private *self);
+    void finishMainPropertiesIntrospection();
     void checkIntrospectionCompleted();
 
     CallStreamPtr addStream(const QDBusObjectPath &streamPath);
@@ -66,13 +67,15 @@ struct TP_QT_NO_EXPORT CallContent::Private
     uint disposition;
     CallStreams streams;
     CallStreams incompleteStreams;
+    bool introspectingMainProperties;
 };
 
 CallContent::Private::Private(CallContent *parent, const CallChannelPtr &channel)
     : parent(parent),
       channel(channel.data()),
       contentInterface(parent->interface<Client::CallContentInterface>()),
-      readinessHelper(parent->readinessHelper())
+      readinessHelper(parent->readinessHelper()),
+      introspectingMainProperties(false)
 {
     ReadinessHelper::Introspectables introspectables;
 
@@ -93,6 +96,12 @@ void CallContent::Private::introspectMainProperties(CallContent::Private *self)
     CallContent *parent = self->parent;
     CallChannelPtr channel = parent->channel();
 
+    if (channel) {
+        // let the channel hold back stream contacts until our streams are known
+        channel->beginProxyIntrospection();
+        self->introspectingMainProperties = true;
+    }
+
     parent->connect(self->contentInterface,
             SIGNAL(StreamsAdded(Tp::ObjectPathList)),
             SLOT(onStreamsAdded(Tp::ObjectPathList)));
@@ -105,6 +114,20 @@ void CallContent::Private::introspectMainProperties(CallContent::Private *self)
             SLOT(gotMainProperties(Tp::PendingOperation*)));
 }
 
+void CallContent::Private::finishMainPropertiesIntrospection()
+{
+    if (!introspectingMainProperties) {
+        return;
+    }
+
+    introspectingMainProperties = false;
+
+    CallChannelPtr channel(this->channel);
+    if (channel) {
+        channel->endProxyIntrospection();
+    }
+}
+
 void CallContent::Private::checkIntrospectionCompleted()
 {
     if (!parent->isReady(FeatureCore) && incompleteStreams.size() == 0) {
@@ -183,6 +206,7 @@ CallContent::CallContent(const CallChannelPtr &channel, const QDBusObjectPath &o
  */
 CallContent::~CallContent()
 {
+    mPriv->finishMainPropertiesIntrospection();
     delete mPriv;
 }
 
@@ -325,6 +349,7 @@ void CallContent::gotMainProperties(PendingOperation *op)
     if (op->isError()) {
         warning().nospace() << "CallContentInterface::requestAllProperties() failed with" <<
             op->errorName() << ": " << op->errorMessage();
+        mPriv->finishMainPropertiesIntrospection();
         mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false,
             op->errorName(), op->errorMessage());
         return;
@@ -353,6 +378,9 @@ void CallContent::gotMainProperties(PendingOperation *op)
     } else {
         mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, true);
     }
+
+    // streams created above are now accounted for by the channel
+    mPriv->finishMainPropertiesIntrospection();
 }
 
 void CallContent::onStreamsAdded(const ObjectPathList &streamsPaths)
@@ -47,8 +47,10 @@ struct TP_QT_NO_EXPORT CallStream::Private
     Private(CallStream *parent, const CallContentPtr &content);
 
     static void introspectMainProperties(Private *self);
+    void finishMainPropertiesIntrospection();
 
     void processRemoteMembersChanged();
+    QSet<uint> currentRemoteMembersChangedHandles() const;
 
     struct RemoteMembersChangedInfo;
 
@@ -69,6 +71,7 @@ struct TP_QT_NO_EXPORT CallStream::Private
     bool canRequestReceiving;
     QQueue< QSharedPointer<RemoteMembersChangedInfo> > remoteMembersChangedQueue;
     QSharedPointer<RemoteMembersChangedInfo> currentRemoteMembersChangedInfo;
+    bool introspectingMainProperties;
 };
 
 struct TP_QT_NO_EXPORT CallStream::Private::RemoteMembersChangedInfo
@@ -107,7 +110,8 @@ CallStream::Private::Private(CallStream *parent, const CallContentPtr &content)
       streamInterface(parent->interface<Client::CallStreamInterface>()),
       readinessHelper(parent->readinessHelper()),
       localSendingState(SendingStateNone),
-      canRequestReceiving(true)
+      canRequestReceiving(true),
+      introspectingMainProperties(false)
 {
     ReadinessHelper::Introspectables introspectables;
 
@@ -127,6 +131,14 @@ void CallStream::Private::introspectMainProperties(CallStream::Private *self)
 {
     CallStream *parent = self->parent;
 
+    CallContentPtr content(self->content);
+    CallChannelPtr channel = content ? content->channel() : CallChannelPtr();
+    if (channel) {
+        // let the channel hold back stream contacts until our members are known
+        channel->beginProxyIntrospection();
+        self->introspectingMainProperties = true;
+    }
+
     parent->connect(self->streamInterface,
             SIGNAL(LocalSendingStateChanged(uint,Tp::CallStateReason)),
             SLOT(onLocalSendingStateChanged(uint,Tp::CallStateReason)));
@@ -139,6 +151,21 @@ void CallStream::Private::introspectMainProperties(CallStream::Private *self)
             SLOT(gotMainProperties(Tp::PendingOperation*)));
 }
 
+void CallStream::Private::finishMainPropertiesIntrospection()
+{
+    if (!introspectingMainProperties) {
+        return;
+    }
+
+    introspectingMainProperties = false;
+
+    CallContentPtr content(this->content);
+    CallChannelPtr channel = content ? content->channel() : CallChannelPtr();
+    if (channel) {
+        channel->endProxyIntrospection();
+    }
+}
+
 void CallStream::Private::processRemoteMembersChanged()
 {
     if (currentRemoteMembersChangedInfo) { // currently building contacts
@@ -154,30 +181,32 @@ void CallStream::Private::processRemoteMembersChanged()
 
     currentRemoteMembersChangedInfo = remoteMembersChangedQueue.dequeue();
 
-    QSet<uint> pendingRemoteMembers;
+    QSet<uint> pendingRemoteMembers = currentRemoteMembersChangedHandles();
+    if (!pendingRemoteMembers.isEmpty()) {
+        // the channel resolves the members of all its streams in one go and
+        // calls gotRemoteMembersContacts() with the combined result
+        CallChannelPtr channel = parent->content()->channel();
+        channel->requestStreamContacts(parent, pendingRemoteMembers.toList(),
+                currentRemoteMembersChangedInfo->identifiers);
+    } else {
+        currentRemoteMembersChangedInfo.clear();
+        processRemoteMembersChanged();
+    }
+}
+
+QSet<uint> CallStream::Private::currentRemoteMembersChangedHandles() const
+{
+    QSet<uint> handles;
     for (ContactSendingStateMap::const_iterator i = currentRemoteMembersChangedInfo->updates.constBegin();
             i != currentRemoteMembersChangedInfo->updates.constEnd(); ++i) {
-        pendingRemoteMembers.insert(i.key());
+        handles.insert(i.key());
     }
 
     foreach(uint i, currentRemoteMembersChangedInfo->removed) {
-        pendingRemoteMembers.insert(i);
+        handles.insert(i);
     }
 
-    if (!pendingRemoteMembers.isEmpty()) {
-        ConnectionPtr connection = parent->content()->channel()->connection();
-        connection->lowlevel()->injectContactIds(currentRemoteMembersChangedInfo->identifiers);
-
-        ContactManagerPtr contactManager = connection->contactManager();
-        PendingContacts *contacts = contactManager->contactsForHandles(
-                pendingRemoteMembers.toList());
-        parent->connect(contacts,
-                SIGNAL(finished(Tp::PendingOperation*)),
-                SLOT(gotRemoteMembersContacts(Tp::PendingOperation*)));
-    } else {
-        currentRemoteMembersChangedInfo.clear();
-        processRemoteMembersChanged();
-    }
+    return handles;
 }
 
 /**
@@ -225,6 +254,7 @@ CallStream::CallStream(const CallContentPtr &content, const QDBusObjectPath &obj
  */
 CallStream::~CallStream()
 {
+    mPriv->finishMainPropertiesIntrospection();
     delete mPriv;
 }
 
@@ -339,6 +369,7 @@ void CallStream::gotMainProperties(PendingOperation *op)
     if (op->isError()) {
         warning().nospace() << "CallStreamInterface::requestAllProperties() failed with " <<
             op->errorName() << ": " << op->errorMessage();
+        mPriv->finishMainPropertiesIntrospection();
         mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false,
             op->errorName(), op->errorMessage());
         return;
@@ -362,12 +393,20 @@ void CallStream::gotMainProperties(PendingOperation *op)
     mPriv->remoteMembersChangedQueue.enqueue(Private::RemoteMembersChangedInfo::create(
                 remoteMembers, remoteMemberIdentifiers, UIntList(), CallStateReason()));
     mPriv->processRemoteMembersChanged();
+
+    // our members are queued on the channel by now, if there are any
+    mPriv->finishMainPropertiesIntrospection();
 }
 
 void CallStream::gotRemoteMembersContacts(PendingOperation *op)
 {
     PendingContacts *pc = qobject_cast<PendingContacts *>(op);
 
+    if (!mPriv->currentRemoteMembersChangedInfo) {
+        warning() << "Got remote members contacts without a pending change, ignoring";
+        return;
+    }
+
     if (!pc->isValid()) {
         warning().nospace() << "Getting contacts failed with " <<
             pc->errorName() << ":" << pc->errorMessage() << ", ignoring";
@@ -376,6 +415,8 @@ void CallStream::gotRemoteMembersContacts(PendingOperation *op)
         return;
     }
 
+    // the request is shared with the other streams of the channel
+    QSet<uint> requested = mPriv->currentRemoteMembersChangedHandles();
     QMap<uint, ContactPtr> removed;
 
     for (ContactSendingStateMap::const_iterator i =
@@ -385,7 +426,10 @@ void CallStream::gotRemoteMembersContacts(PendingOperation *op)
     }
 
     foreach (const ContactPtr &contact, pc->contacts()) {
-        mPriv->remoteMembersContacts.insert(contact->handle()[0], contact);
+        uint handle = contact->handle()[0];
+        if (requested.contains(handle)) {
+            mPriv->remoteMembersContacts.insert(handle, contact);
+        }
     }
 
     foreach (uint handle, mPriv->currentRemoteMembersChangedInfo->removed) {
@@ -400,14 +444,19 @@ void CallStream::gotRemoteMembersContacts(PendingOperation *op)
     }
 
     foreach (uint handle, pc->invalidHandles()) {
+        if (!requested.contains(handle)) {
+            continue;
+        }
+
         mPriv->remoteMembers.remove(handle);
         if (isReady(FeatureCore) && mPriv->remoteMembersContacts.contains(handle)) {
             removed.insert(handle, mPriv->remoteMembersContacts[handle]);
-
-            // make sure we don't have updates for invalid handles
-            mPriv->currentRemoteMembersChangedInfo->updates.remove(handle);
         }
         mPriv->remoteMembersContacts.remove(handle);
+
+        // make sure we don't have updates for invalid handles, even for members we never had a
+        // contact for
+        mPriv->currentRemoteMembersChangedInfo->updates.remove(handle);
     }
 
     if (isReady(FeatureCore)) {
@@ -31,9 +31,29 @@ namespace Tp
 
 struct TP_QT_NO_EXPORT ChannelClassSpec::Private : public QSharedData
 {
+    Private()
+        : hash(0)
+    {
+    }
+
+    void updateHash();
+
     QVariantMap props;
+
+    // Specs are compared and hashed far more often than they're modified, so keep the hash of
+    // props up to date here instead of recomputing it every time
+    uint hash;
 };
 
+void ChannelClassSpec::Private::updateHash()
+{
+    hash = 0;
+    for (QVariantMap::const_iterator i = props.constBegin(); i != props.constEnd(); ++i) {
+        // all D-Bus types should be convertible to QString
+        hash = 31 * hash + qHash(qMakePair(i.key(), i.value().toString()));
+    }
+}
+
 /**
  * \class ChannelClassSpec
  * \ingroup wrappers
@@ -124,17 +144,34 @@ ChannelClassSpec &ChannelClassSpec::operator=(const ChannelClassSpec &other)
     return *this;
 }
 
+bool ChannelClassSpec::operator==(const ChannelClassSpec &other) const
+{
+    if (mPriv.constData() == other.mPriv.constData()) {
+        return true;
+    }
+
+    // The cached hash can't be used to rule out equality: it is computed from the string form of
+    // the values, while QVariant considers values of different types equal when they convert to
+    // each other, for example true and 1
+    return this->allProperties() == other.allProperties();
+}
+
 bool ChannelClassSpec::isSubsetOf(const ChannelClassSpec &other) const
 {
-    if (!mPriv) {
+    if (!mPriv || mPriv->props.isEmpty()) {
         // Invalid instances have no properties - hence they're subset of anything
         return true;
     }
 
-    foreach (QString propName, mPriv->props.keys()) {
-        if (!other.hasProperty(propName)) {
-            return false;
-        } else if (property(propName) != other.property(propName)) {
+    if (!other.mPriv || other.mPriv->props.size() < mPriv->props.size()) {
+        return false;
+    }
+
+    const QVariantMap &otherProps = other.mPriv->props;
+    for (QVariantMap::const_iterator i = mPriv->props.constBegin();
+            i != mPriv->props.constEnd(); ++i) {
+        QVariantMap::const_iterator j = otherProps.constFind(i.key());
+        if (j == otherProps.constEnd() || j.value() != i.value()) {
             return false;
         }
     }
@@ -168,6 +205,7 @@ void ChannelClassSpec::setProperty(const QString &qualifiedName, const QVariant
     }
 
     mPriv->props.insert(qualifiedName, value);
+    mPriv->updateHash();
 }
 
 void ChannelClassSpec::unsetProperty(const QString &qualifiedName)
@@ -177,7 +215,9 @@ void ChannelClassSpec::unsetProperty(const QString &qualifiedName)
         return;
     }
 
-    mPriv->props.remove(qualifiedName);
+    if (mPriv->props.remove(qualifiedName)) {
+        mPriv->updateHash();
+    }
 }
 
 QVariantMap ChannelClassSpec::allProperties() const
@@ -714,6 +754,19 @@ ChannelClassSpec ChannelClassSpec::contactSearch(const QVariantMap &additionalPr
     }
 }
 
+/**
+ * Return a hash of \a spec, based on all of its properties.
+ *
+ * The hash is cached by the spec, so this is a constant time operation.
+ *
+ * \param spec The channel class spec to hash.
+ * \return The hash of \a spec.
+ */
+uint qHash(const ChannelClassSpec &spec)
+{
+    return spec.mPriv.constData() != 0 ? spec.mPriv->hash : 0;
+}
+
 /**
  * \class ChannelClassSpecList
  * \ingroup wrappers
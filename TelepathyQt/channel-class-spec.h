@@ -39,6 +39,10 @@
 namespace Tp
 {
 
+class ChannelClassSpec;
+
+TP_QT_EXPORT uint qHash(const ChannelClassSpec &spec);
+
 class TP_QT_EXPORT ChannelClassSpec
 {
 public:
@@ -57,10 +61,7 @@ public:
 
     ChannelClassSpec &operator=(const ChannelClassSpec &other);
 
-    bool operator==(const ChannelClassSpec &other) const
-    {
-        return this->allProperties() == other.allProperties();
-    }
+    bool operator==(const ChannelClassSpec &other) const;
 
     bool isSubsetOf(const ChannelClassSpec &other) const;
     bool matches(const QVariantMap &immutableProperties) const;
@@ -243,6 +244,7 @@ public:
 private:
     struct Private;
     friend struct Private;
+    friend uint qHash(const ChannelClassSpec &spec);
     QSharedDataPointer<Private> mPriv;
 };
 
@@ -280,22 +282,6 @@ public:
     }
 };
 
-inline uint qHash(const ChannelClassSpec &spec)
-{
-    uint ret = 0;
-    QVariantMap::const_iterator it = spec.allProperties().constBegin();
-    QVariantMap::const_iterator end = spec.allProperties().constEnd();
-    int i = spec.allProperties().size() + 1;
-    for (; it != end; ++it) {
-        // all D-Bus types should be convertible to QString
-        QPair<QString, QString> p(it.key(), it.value().toString());
-        int h = qHash(p);
-        ret ^= ((h << (2 << i)) | (h >> (2 >> i)));
-        i--;
-    }
-    return ret;
-}
-
 inline uint qHash(const QSet<ChannelClassSpec> &specSet)
 {
     int ret = 0;
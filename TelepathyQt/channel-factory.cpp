@@ -55,16 +55,99 @@ struct TP_QT_NO_EXPORT ChannelFactory::Private
 {
     Private();
 
+    // (ChannelType, TargetHandleType)
+    typedef QPair<QString, uint> IndexKey;
+    typedef QHash<IndexKey, QList<int> > Index;
+
+    static bool indexKeyFor(const ChannelClassSpec &spec, IndexKey *key);
+
+    template<typename T>
+    static void buildIndex(const QList<QPair<ChannelClassSpec, T> > &entries,
+            Index *index, QList<int> *wildcards);
+
+    static const QList<int> &candidatesFor(const ChannelClassSpec &channelClass,
+            const Index &index, const QList<int> &wildcards);
+
     QList<ChannelClassFeatures> features;
 
     typedef QPair<ChannelClassSpec, ConstructorConstPtr> CtorPair;
     QList<CtorPair> ctors;
+
+    // Positions in features and ctors of the entries which can possibly match a channel class with
+    // a given (ChannelType, TargetHandleType), in list order. Entries which don't specify both of
+    // those are wildcards: they're listed in every bucket, and on their own for channel classes
+    // which have no bucket.
+    Index featuresIndex;
+    QList<int> wildcardFeatures;
+    Index ctorsIndex;
+    QList<int> wildcardCtors;
 };
 
 ChannelFactory::Private::Private()
 {
 }
 
+bool ChannelFactory::Private::indexKeyFor(const ChannelClassSpec &spec, IndexKey *key)
+{
+    static const QString channelTypeKey = TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType");
+    static const QString targetHandleTypeKey =
+        TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType");
+
+    if (!spec.hasProperty(channelTypeKey) || !spec.hasProperty(targetHandleTypeKey)) {
+        return false;
+    }
+
+    *key = IndexKey(qdbus_cast<QString>(spec.property(channelTypeKey)),
+            qdbus_cast<uint>(spec.property(targetHandleTypeKey)));
+    return true;
+}
+
+template<typename T>
+void ChannelFactory::Private::buildIndex(const QList<QPair<ChannelClassSpec, T> > &entries,
+        Index *index, QList<int> *wildcards)
+{
+    index->clear();
+    wildcards->clear();
+
+    QList<bool> hasKey;
+    QList<IndexKey> keys;
+    for (int i = 0; i < entries.size(); ++i) {
+        IndexKey key;
+        hasKey << indexKeyFor(entries[i].first, &key);
+        keys << key;
+        if (hasKey.last() && !index->contains(key)) {
+            index->insert(key, QList<int>());
+        }
+    }
+
+    for (int i = 0; i < entries.size(); ++i) {
+        if (hasKey[i]) {
+            (*index)[keys[i]] << i;
+            continue;
+        }
+
+        wildcards->append(i);
+        for (Index::iterator bucket = index->begin(); bucket != index->end(); ++bucket) {
+            bucket.value() << i;
+        }
+    }
+}
+
+const QList<int> &ChannelFactory::Private::candidatesFor(const ChannelClassSpec &channelClass,
+        const Index &index, const QList<int> &wildcards)
+{
+    IndexKey key;
+    if (indexKeyFor(channelClass, &key)) {
+        Index::const_iterator bucket = index.constFind(key);
+        if (bucket != index.constEnd()) {
+            return bucket.value();
+        }
+    }
+
+    // No entry specifically for this kind of channel, so only the wildcards can match
+    return wildcards;
+}
+
 /**
  * \class ChannelFactory
  * \ingroup utils
@@ -548,7 +631,9 @@ Features ChannelFactory::featuresFor(const ChannelClassSpec &channelClass) const
 {
     Features features;
 
-    foreach (const ChannelClassFeatures &pair, mPriv->features) {
+    foreach (int i, Private::candidatesFor(channelClass, mPriv->featuresIndex,
+                mPriv->wildcardFeatures)) {
+        const ChannelClassFeatures &pair = mPriv->features.at(i);
         if (pair.first.isSubsetOf(channelClass)) {
             features.unite(pair.second);
         }
@@ -574,14 +659,16 @@ void ChannelFactory::addFeaturesFor(const ChannelClassSpec &channelClass, const
     // We ran out of feature specifications (for the given size/specificity of a channel class)
     // before finding a matching one, so let's create a new entry
     mPriv->features.insert(i, qMakePair(channelClass, features));
+    Private::buildIndex(mPriv->features, &mPriv->featuresIndex, &mPriv->wildcardFeatures);
 }
 
 ChannelFactory::ConstructorConstPtr ChannelFactory::constructorFor(const ChannelClassSpec &cc) const
 {
-    QList<Private::CtorPair>::iterator i;
-    for (i = mPriv->ctors.begin(); i != mPriv->ctors.end(); ++i) {
-        if (i->first.isSubsetOf(cc)) {
-            return i->second;
+    // The candidates are in the order of ctors, so the most specific match still wins
+    foreach (int i, Private::candidatesFor(cc, mPriv->ctorsIndex, mPriv->wildcardCtors)) {
+        const Private::CtorPair &pair = mPriv->ctors.at(i);
+        if (pair.first.isSubsetOf(cc)) {
+            return pair.second;
         }
     }
 
@@ -615,6 +702,7 @@ void ChannelFactory::setConstructorFor(const ChannelClassSpec &channelClass,
     // We ran out of constructors (for the given size/specificity of a channel class)
     // before finding a matching one, so let's create a new entry
     mPriv->ctors.insert(i, qMakePair(channelClass, ctor));
+    Private::buildIndex(mPriv->ctors, &mPriv->ctorsIndex, &mPriv->wildcardCtors);
 }
 
 /**
@@ -406,11 +406,12 @@ void ClientHandlerAdaptor::HandleChannels(const QDBusObjectPath &accountPath,
     SharedPtr<InvocationData> invocation(new InvocationData());
     QList<PendingOperation *> readyOps;
 
-    RequestTemporaryHandler *tempHandler = dynamic_cast<RequestTemporaryHandler *>(mClient);
+    SharedRequestTemporaryHandler *tempHandler =
+        dynamic_cast<SharedRequestTemporaryHandler *>(mClient);
     if (tempHandler) {
         debug() << "  This is a temporary handler for the Request & Handle API,"
             << "giving an early signal of the invocation";
-        tempHandler->setDBusHandlerInvoked();
+        tempHandler->setDBusHandlerInvoked(requestsSatisfied);
     }
 
     PendingReady *accReady = accFactory->proxy(TP_QT_ACCOUNT_MANAGER_BUS_NAME,
@@ -437,6 +438,7 @@ void ClientHandlerAdaptor::HandleChannels(const QDBusObjectPath &accountPath,
     }
 
     invocation->handlerInfo = AbstractClientHandler::HandlerInfo(handlerInfo);
+    invocation->requestsSatisfied = requestsSatisfied;
 
     ObjectImmutablePropertiesMap reqPropsMap = qdbus_cast<ObjectImmutablePropertiesMap>(
     handlerInfo.value(QLatin1String("request-properties")));
@@ -498,14 +500,17 @@ void ClientHandlerAdaptor::onReadyOpFinished(Tp::PendingOperation *op)
         break;
     }
 
+    SharedRequestTemporaryHandler *tempHandler =
+        dynamic_cast<SharedRequestTemporaryHandler *>(mClient);
+
     while (!mInvocations.isEmpty() && !mInvocations.first()->readyOp) {
         SharedPtr<InvocationData> invocation = mInvocations.takeFirst();
 
         if (!invocation->error.isEmpty()) {
-            RequestTemporaryHandler *tempHandler = dynamic_cast<RequestTemporaryHandler *>(mClient);
             if (tempHandler) {
                 debug() << "  This is a temporary handler for the Request & Handle API, indicating failure";
-                tempHandler->setDBusHandlerErrored(invocation->error, invocation->message);
+                tempHandler->setDBusHandlerErrored(invocation->requestsSatisfied,
+                        invocation->error, invocation->message);
             }
 
             // We guarantee that the proxies were ready - so we can't invoke the client if they
@@ -517,6 +522,15 @@ void ClientHandlerAdaptor::onReadyOpFinished(Tp::PendingOperation *op)
         debug() << "Invoking application handleChannels with" << invocation->chans.size()
             << "channels on" << mClient;
 
+        if (tempHandler) {
+            // chanReqs leaves out the requests whose properties were not given, so give the
+            // temporary handler all the request object paths to route the channels with
+            tempHandler->handleRequestedChannels(invocation->ctx, invocation->acc,
+                    invocation->chans, invocation->chanReqs, invocation->requestsSatisfied,
+                    invocation->time);
+            continue;
+        }
+
         mClient->handleChannels(invocation->ctx, invocation->acc, invocation->conn,
                 invocation->chans, invocation->chanReqs, invocation->time, invocation->handlerInfo);
     }
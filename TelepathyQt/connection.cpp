@@ -30,6 +30,7 @@
 #include "TelepathyQt/_gen/connection-internal.moc.hpp"
 #include "TelepathyQt/_gen/connection-lowlevel.moc.hpp"
 
+#include "TelepathyQt/async-result-internal.h"
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/ChannelFactory>
@@ -46,11 +47,12 @@
 #include <TelepathyQt/PendingVoid>
 #include <TelepathyQt/ReferencedHandles>
 
+#include <QAtomicInt>
+#include <QHash>
 #include <QMetaObject>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QPair>
-#include <QQueue>
 #include <QString>
 #include <QTimer>
 #include <QtGlobal>
@@ -68,11 +70,12 @@ struct TP_QT_NO_EXPORT Connection::Private
     void init();
 
     static void introspectMain(Private *self);
-    void introspectMainFallbackStatus();
-    void introspectMainFallbackInterfaces();
-    void introspectMainFallbackSelfHandle();
-    void introspectCapabilities();
-    void introspectContactAttributeInterfaces();
+    AsyncResult introspectMainFallbackStatus();
+    AsyncResult introspectMainFallbackInterfaces();
+    AsyncResult introspectMainFallbackSelfHandle();
+    AsyncResult introspectCapabilities();
+    AsyncResult introspectContactAttributeInterfaces();
+    AsyncResult introspectInterfaceProperties();
     static void introspectSelfContact(Private *self);
     static void introspectSimplePresence(Private *self);
     static void introspectRoster(Private *self);
@@ -80,7 +83,8 @@ struct TP_QT_NO_EXPORT Connection::Private
     static void introspectBalance(Private *self);
     static void introspectConnected(Private *self);
 
-    void continueMainIntrospection();
+    AsyncResult startMainIntrospectionCall(const QDBusPendingCall &call, const char *slot);
+    AsyncResult takeMainIntrospectionCall(QDBusPendingCallWatcher *watcher);
     void setCurrentStatus(uint status);
     void forceCurrentStatus(uint status);
     void setInterfaces(const QStringList &interfaces);
@@ -110,7 +114,9 @@ struct TP_QT_NO_EXPORT Connection::Private
     ReadinessHelper *readinessHelper;
 
     // Introspection
-    QQueue<void (Private::*)()> introspectMainQueue;
+    QHash<QDBusPendingCallWatcher *, AsyncResult> introspectMainCalls;
+    bool introspectingCapabilities;
+    bool introspectingContactAttributeInterfaces;
 
     // FeatureCore
     // keep pendingStatus and pendingStatusReason until we emit statusChanged
@@ -166,20 +172,44 @@ struct TP_QT_NO_EXPORT ConnectionLowlevel::Private
 };
 
 // Handle tracking
+//
+// The reference counts of each handle type are split over a fixed number of shards, each with its
+// own lock, so that ReferencedHandles copies of unrelated handles don't all serialize on a single
+// mutex. The state shared by a whole handle type is kept in atomics.
 struct TP_QT_NO_EXPORT Connection::Private::HandleContext
 {
-    struct Type
+    enum { NumShards = 16 };
+    // Upper bound on the number of handles given to a single ReleaseHandles call
+    enum { MaxHandlesPerRelease = 256 };
+
+    struct Shard
     {
+        QMutex lock;
         QHash<uint, uint> refcounts;
         QSet<uint> toRelease;
-        uint requestsInFlight;
-        bool releaseScheduled;
+    };
+
+    struct Type
+    {
+        Shard shards[NumShards];
+        QAtomicInt requestsInFlight;
+        QAtomicInt releaseScheduled;
 
         Type()
             : requestsInFlight(0),
-              releaseScheduled(false)
+              releaseScheduled(0)
+        {
+        }
+
+        Shard &shard(uint handle)
         {
+            return shards[handle % NumShards];
         }
+
+        bool isHeld(uint handle);
+        bool hasHandlesToRelease();
+        UIntList takeHandlesToRelease(int max);
+        UIntList takeAllHandles();
     };
 
     HandleContext()
@@ -187,11 +217,76 @@ struct TP_QT_NO_EXPORT Connection::Private::HandleContext
     {
     }
 
+    // Handle types come from callers and from the bus, so unknown ones are ignored rather than
+    // trusted as an index
+    Type *type(uint handleType)
+    {
+        if (handleType >= static_cast<uint>(NUM_HANDLE_TYPES)) {
+            warning() << "Ignoring handles of unknown handle type" << handleType;
+            return 0;
+        }
+        return &types[handleType];
+    }
+
+    static void releaseHandles(Client::ConnectionInterface *baseInterface, uint handleType,
+            const UIntList &handles);
+
     int refcount;
-    QMutex lock;
-    QHash<uint, Type> types;
+    Type types[NUM_HANDLE_TYPES];
 };
 
+bool Connection::Private::HandleContext::Type::isHeld(uint handle)
+{
+    Shard &s = shard(handle);
+    QMutexLocker locker(&s.lock);
+    return s.refcounts.contains(handle) || s.toRelease.contains(handle);
+}
+
+bool Connection::Private::HandleContext::Type::hasHandlesToRelease()
+{
+    for (int i = 0; i < NumShards; ++i) {
+        QMutexLocker locker(&shards[i].lock);
+        if (!shards[i].toRelease.isEmpty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+UIntList Connection::Private::HandleContext::Type::takeHandlesToRelease(int max)
+{
+    UIntList ret;
+    for (int i = 0; i < NumShards && ret.size() < max; ++i) {
+        QMutexLocker locker(&shards[i].lock);
+        QSet<uint>::iterator it = shards[i].toRelease.begin();
+        while (it != shards[i].toRelease.end() && ret.size() < max) {
+            ret << *it;
+            it = shards[i].toRelease.erase(it);
+        }
+    }
+    return ret;
+}
+
+UIntList Connection::Private::HandleContext::Type::takeAllHandles()
+{
+    UIntList ret;
+    for (int i = 0; i < NumShards; ++i) {
+        QMutexLocker locker(&shards[i].lock);
+        ret << shards[i].refcounts.keys() << shards[i].toRelease.toList();
+        shards[i].refcounts.clear();
+        shards[i].toRelease.clear();
+    }
+    return ret;
+}
+
+void Connection::Private::HandleContext::releaseHandles(Client::ConnectionInterface *baseInterface,
+        uint handleType, const UIntList &handles)
+{
+    for (int i = 0; i < handles.size(); i += MaxHandlesPerRelease) {
+        baseInterface->ReleaseHandles(handleType, handles.mid(i, MaxHandlesPerRelease));
+    }
+}
+
 Connection::Private::Private(Connection *parent,
         const ChannelFactoryConstPtr &chanFactory,
         const ContactFactoryConstPtr &contactFactory)
@@ -203,6 +298,8 @@ Connection::Private::Private(Connection *parent,
       properties(parent->interface<Client::DBus::PropertiesInterface>()),
       simplePresence(0),
       readinessHelper(parent->readinessHelper()),
+      introspectingCapabilities(false),
+      introspectingContactAttributeInterfaces(false),
       introspectingConnected(false),
       pendingStatus((uint) -1),
       pendingStatusReason(ConnectionStatusReasonNoneSpecified),
@@ -341,22 +438,15 @@ Connection::Private::~Private()
         if (!immortalHandles) {
             debug() << "Destroying HandleContext";
 
-            foreach (uint handleType, handleContext->types.keys()) {
-                HandleContext::Type type = handleContext->types[handleType];
-
-                if (!type.refcounts.empty()) {
-                    debug() << " Still had references to" <<
-                        type.refcounts.size() << "handles, releasing now";
-                    baseInterface->ReleaseHandles(handleType, type.refcounts.keys());
-                }
-
-                if (!type.toRelease.empty()) {
-                    debug() << " Was going to release" <<
-                        type.toRelease.size() << "handles, doing that now";
-                    baseInterface->ReleaseHandles(handleType, type.toRelease.toList());
+            for (uint handleType = 0; handleType < static_cast<uint>(NUM_HANDLE_TYPES);
+                    ++handleType) {
+                UIntList handles = handleContext->types[handleType].takeAllHandles();
+                if (!handles.isEmpty()) {
+                    debug() << " Still had" << handles.size() << "handles of type" <<
+                        handleType << "referenced or waiting to be released, releasing now";
+                    HandleContext::releaseHandles(baseInterface, handleType, handles);
                 }
             }
-
         }
 
         handleContexts.remove(qMakePair(baseInterface->connection().name(),
@@ -402,73 +492,95 @@ void Connection::Private::init()
 
 void Connection::Private::introspectMain(Connection::Private *self)
 {
+    Q_ASSERT(self->introspectMainCalls.isEmpty());
+
+    QList<AsyncResult> calls;
+    self->introspectingCapabilities = false;
+    self->introspectingContactAttributeInterfaces = false;
+
     debug() << "Calling Properties::GetAll(Connection)";
-    QDBusPendingCallWatcher *watcher =
-        new QDBusPendingCallWatcher(
-                self->properties->GetAll(TP_QT_IFACE_CONNECTION),
-                self->parent);
-    self->parent->connect(watcher,
-            SIGNAL(finished(QDBusPendingCallWatcher*)),
+    calls << self->startMainIntrospectionCall(
+            self->properties->GetAll(TP_QT_IFACE_CONNECTION),
             SLOT(gotMainProperties(QDBusPendingCallWatcher*)));
+
+    // The Requests and Contacts properties only depend on the interfaces being there, so they are
+    // pipelined together with the GetAll, making FeatureCore ready after a single round trip.
+    //
+    // When the interfaces are known from an earlier introspection, for example before the status
+    // changed to Connected, only the calls for the interfaces already seen are pipelined, and
+    // introspectInterfaceProperties() catches up with any interface added meanwhile. Otherwise
+    // both calls are made speculatively: nearly every CM implements both interfaces, and one which
+    // doesn't just answers one extra call with an error per missing interface, while the others
+    // save a round trip.
+    bool interfacesKnown = !self->parent->interfaces().isEmpty();
+    if (!interfacesKnown || self->parent->hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS)) {
+        calls << self->introspectCapabilities();
+    }
+    if (!interfacesKnown || self->parent->hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS)) {
+        calls << self->introspectContactAttributeInterfaces();
+    }
+
+    // The GetAll result only finishes once any fallback calls it needed have landed too
+    setIntrospectCompletedWhen(self->readinessHelper, FeatureCore, AsyncResult::whenAll(calls));
 }
 
-void Connection::Private::introspectMainFallbackStatus()
+AsyncResult Connection::Private::introspectMainFallbackStatus()
 {
     debug() << "Calling GetStatus()";
-    QDBusPendingCallWatcher *watcher =
-        new QDBusPendingCallWatcher(baseInterface->GetStatus(),
-                parent);
-    parent->connect(watcher,
-            SIGNAL(finished(QDBusPendingCallWatcher*)),
+    return startMainIntrospectionCall(baseInterface->GetStatus(),
             SLOT(gotStatus(QDBusPendingCallWatcher*)));
 }
 
-void Connection::Private::introspectMainFallbackInterfaces()
+AsyncResult Connection::Private::introspectMainFallbackInterfaces()
 {
     debug() << "Calling GetInterfaces()";
-    QDBusPendingCallWatcher *watcher =
-        new QDBusPendingCallWatcher(baseInterface->GetInterfaces(),
-                parent);
-    parent->connect(watcher,
-            SIGNAL(finished(QDBusPendingCallWatcher*)),
+    return startMainIntrospectionCall(baseInterface->GetInterfaces(),
             SLOT(gotInterfaces(QDBusPendingCallWatcher*)));
 }
 
-void Connection::Private::introspectMainFallbackSelfHandle()
+AsyncResult Connection::Private::introspectMainFallbackSelfHandle()
 {
     debug() << "Calling GetSelfHandle()";
-    QDBusPendingCallWatcher *watcher =
-        new QDBusPendingCallWatcher(baseInterface->GetSelfHandle(),
-                parent);
-    parent->connect(watcher,
-            SIGNAL(finished(QDBusPendingCallWatcher*)),
+    return startMainIntrospectionCall(baseInterface->GetSelfHandle(),
             SLOT(gotSelfHandle(QDBusPendingCallWatcher*)));
 }
 
-void Connection::Private::introspectCapabilities()
+AsyncResult Connection::Private::introspectCapabilities()
 {
     debug() << "Retrieving capabilities";
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+    introspectingCapabilities = true;
+    return startMainIntrospectionCall(
             properties->Get(
                 TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS,
-                QLatin1String("RequestableChannelClasses")), parent);
-    parent->connect(watcher,
-            SIGNAL(finished(QDBusPendingCallWatcher*)),
+                QLatin1String("RequestableChannelClasses")),
             SLOT(gotCapabilities(QDBusPendingCallWatcher*)));
 }
 
-void Connection::Private::introspectContactAttributeInterfaces()
+AsyncResult Connection::Private::introspectContactAttributeInterfaces()
 {
     debug() << "Retrieving contact attribute interfaces";
-    QDBusPendingCall call =
-        properties->Get(
+    introspectingContactAttributeInterfaces = true;
+    return startMainIntrospectionCall(
+            properties->Get(
                 TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS,
-                QLatin1String("ContactAttributeInterfaces"));
-    QDBusPendingCallWatcher *watcher =
-        new QDBusPendingCallWatcher(call, parent);
-    parent->connect(watcher,
-                    SIGNAL(finished(QDBusPendingCallWatcher*)),
-                    SLOT(gotContactAttributeInterfaces(QDBusPendingCallWatcher*)));
+                QLatin1String("ContactAttributeInterfaces")),
+            SLOT(gotContactAttributeInterfaces(QDBusPendingCallWatcher*)));
+}
+
+AsyncResult Connection::Private::introspectInterfaceProperties()
+{
+    // Called once the interfaces have been retrieved, for the interface properties which weren't
+    // pipelined by introspectMain()
+    QList<AsyncResult> calls;
+    if (!introspectingCapabilities &&
+            parent->hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS)) {
+        calls << introspectCapabilities();
+    }
+    if (!introspectingContactAttributeInterfaces &&
+            parent->hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS)) {
+        calls << introspectContactAttributeInterfaces();
+    }
+    return AsyncResult::whenAll(calls);
 }
 
 void Connection::Private::introspectSelfContact(Connection::Private *self)
@@ -507,20 +619,16 @@ void Connection::Private::introspectRoster(Connection::Private *self)
 {
     debug() << "Introspecting roster";
 
-    PendingOperation *op = self->contactManager->introspectRoster();
-    self->parent->connect(op,
-            SIGNAL(finished(Tp::PendingOperation*)),
-            SLOT(onIntrospectRosterFinished(Tp::PendingOperation*)));
+    setIntrospectCompletedWhen(self->readinessHelper, FeatureRoster,
+            self->contactManager->introspectRoster());
 }
 
 void Connection::Private::introspectRosterGroups(Connection::Private *self)
 {
     debug() << "Introspecting roster groups";
 
-    PendingOperation *op = self->contactManager->introspectRosterGroups();
-    self->parent->connect(op,
-            SIGNAL(finished(Tp::PendingOperation*)),
-            SLOT(onIntrospectRosterGroupsFinished(Tp::PendingOperation*)));
+    setIntrospectCompletedWhen(self->readinessHelper, FeatureRosterGroups,
+            self->contactManager->introspectRosterGroups());
 }
 
 void Connection::Private::introspectBalance(Connection::Private *self)
@@ -558,18 +666,23 @@ void Connection::Private::introspectConnected(Connection::Private *self)
     }
 }
 
-void Connection::Private::continueMainIntrospection()
+AsyncResult Connection::Private::startMainIntrospectionCall(const QDBusPendingCall &call,
+        const char *slot)
 {
-    if (!parent->isValid()) {
-        debug() << parent << "stopping main introspection, as it has been invalidated";
-        return;
-    }
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, parent);
+    parent->connect(watcher,
+            SIGNAL(finished(QDBusPendingCallWatcher*)),
+            slot);
 
-    if (introspectMainQueue.isEmpty()) {
-        readinessHelper->setIntrospectCompleted(FeatureCore, true);
-    } else {
-        (this->*(introspectMainQueue.dequeue()))();
-    }
+    AsyncResult result = AsyncResult::create();
+    introspectMainCalls.insert(watcher, result);
+    return result;
+}
+
+AsyncResult Connection::Private::takeMainIntrospectionCall(QDBusPendingCallWatcher *watcher)
+{
+    Q_ASSERT(introspectMainCalls.contains(watcher));
+    return introspectMainCalls.take(watcher);
 }
 
 void Connection::Private::setCurrentStatus(uint status)
@@ -578,10 +691,8 @@ void Connection::Private::setCurrentStatus(uint status)
     // before proceeding to a new one.
     //
     // Therefore we don't need any safeguarding here to prevent finishing introspection when there
-    // is a pending status change. However, we can speed up the process slightly by canceling any
-    // pending introspect ops from our local introspection queue when it's waiting for us.
-
-    introspectMainQueue.clear();
+    // is a pending status change. The main introspection has all of its calls in flight at once,
+    // so there is nothing left to cancel there either.
 
     if (introspectingConnected) {
         // On the other hand, we have to finish the Connected introspection for now, as
@@ -1527,6 +1638,8 @@ void Connection::onConnectionError(const QString &error,
 void Connection::gotMainProperties(QDBusPendingCallWatcher *watcher)
 {
     QDBusPendingReply<QVariantMap> reply = *watcher;
+    AsyncResult result = mPriv->takeMainIntrospectionCall(watcher);
+    QList<AsyncResult> fallbacks;
     QVariantMap props;
 
     if (!reply.isError()) {
@@ -1545,42 +1658,30 @@ void Connection::gotMainProperties(QDBusPendingCallWatcher *watcher)
     } else {
         // only introspect status if we did not got it from StatusChanged
         if (mPriv->pendingStatus == (uint) -1) {
-            mPriv->introspectMainQueue.enqueue(
-                    &Private::introspectMainFallbackStatus);
+            fallbacks << mPriv->introspectMainFallbackStatus();
         }
     }
 
     if (props.contains(QLatin1String("Interfaces"))) {
         mPriv->setInterfaces(qdbus_cast<QStringList>(
                     props[QLatin1String("Interfaces")]));
+        fallbacks << mPriv->introspectInterfaceProperties();
     } else {
-        mPriv->introspectMainQueue.enqueue(
-                &Private::introspectMainFallbackInterfaces);
+        fallbacks << mPriv->introspectMainFallbackInterfaces();
     }
 
     if (props.contains(QLatin1String("SelfHandle"))) {
         mPriv->selfHandle = qdbus_cast<uint>(
                 props[QLatin1String("SelfHandle")]);
     } else {
-        mPriv->introspectMainQueue.enqueue(
-                &Private::introspectMainFallbackSelfHandle);
+        fallbacks << mPriv->introspectMainFallbackSelfHandle();
     }
 
     if (props.contains(QLatin1String("HasImmortalHandles"))) {
         mPriv->immortalHandles = qdbus_cast<bool>(props[QLatin1String("HasImmortalHandles")]);
     }
 
-    if (hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS)) {
-        mPriv->introspectMainQueue.enqueue(
-                &Private::introspectCapabilities);
-    }
-
-    if (hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS)) {
-        mPriv->introspectMainQueue.enqueue(
-                &Private::introspectContactAttributeInterfaces);
-    }
-
-    mPriv->continueMainIntrospection();
+    result.setFinishedWhen(AsyncResult::whenAll(fallbacks));
 
     watcher->deleteLater();
 }
@@ -1591,14 +1692,14 @@ void Connection::gotStatus(QDBusPendingCallWatcher *watcher)
 
     if (!reply.isError()) {
         mPriv->forceCurrentStatus(reply.value());
-
-        mPriv->continueMainIntrospection();
     } else {
         warning().nospace() << "GetStatus() failed with " <<
             reply.error().name() << ": " << reply.error().message();
         mPriv->invalidateResetCaps(reply.error().name(), reply.error().message());
     }
 
+    mPriv->takeMainIntrospectionCall(watcher).setFinished();
+
     watcher->deleteLater();
 }
 
@@ -1606,18 +1707,20 @@ void Connection::gotInterfaces(QDBusPendingCallWatcher *watcher)
 {
     QDBusPendingReply<QStringList> reply = *watcher;
 
+    AsyncResult result = mPriv->takeMainIntrospectionCall(watcher);
+
     if (!reply.isError()) {
         mPriv->setInterfaces(reply.value());
+        result.setFinishedWhen(mPriv->introspectInterfaceProperties());
     }
     else {
         warning().nospace() << "GetInterfaces() failed with " <<
             reply.error().name() << ": " << reply.error().message() <<
             " - assuming no new interfaces";
         // let's not fail if GetInterfaces fail
+        result.setFinished();
     }
 
-    mPriv->continueMainIntrospection();
-
     watcher->deleteLater();
 }
 
@@ -1625,16 +1728,16 @@ void Connection::gotSelfHandle(QDBusPendingCallWatcher *watcher)
 {
     QDBusPendingReply<uint> reply = *watcher;
 
+    AsyncResult result = mPriv->takeMainIntrospectionCall(watcher);
+
     if (!reply.isError()) {
         mPriv->selfHandle = reply.value();
         debug() << "Got self handle:" << mPriv->selfHandle;
-
-        mPriv->continueMainIntrospection();
+        result.setFinished();
     } else {
         warning().nospace() << "GetSelfHandle() failed with " <<
             reply.error().name() << ": " << reply.error().message();
-        mPriv->readinessHelper->setIntrospectCompleted(FeatureCore,
-                false, reply.error());
+        result.setFinishedWithError(reply.error());
     }
 
     watcher->deleteLater();
@@ -1649,12 +1752,16 @@ void Connection::gotCapabilities(QDBusPendingCallWatcher *watcher)
         mPriv->caps.updateRequestableChannelClasses(
                 qdbus_cast<RequestableChannelClassList>(reply.value().variant()));
     } else {
-        warning().nospace() << "Getting capabilities failed with " <<
-            reply.error().name() << ": " << reply.error().message();
+        // This may be requested before we know the interfaces, so only complain if it should have
+        // worked
+        if (hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS)) {
+            warning().nospace() << "Getting capabilities failed with " <<
+                reply.error().name() << ": " << reply.error().message();
+        }
         // let's not fail if retrieving capabilities fail
     }
 
-    mPriv->continueMainIntrospection();
+    mPriv->takeMainIntrospectionCall(watcher).setFinished();
 
     watcher->deleteLater();
 }
@@ -1667,13 +1774,17 @@ void Connection::gotContactAttributeInterfaces(QDBusPendingCallWatcher *watcher)
         debug() << "Got contact attribute interfaces";
         mPriv->contactAttributeInterfaces = qdbus_cast<QStringList>(reply.value().variant());
     } else {
-        warning().nospace() << "Getting contact attribute interfaces failed with " <<
-            reply.error().name() << ": " << reply.error().message();
+        // This may be requested before we know the interfaces, so only complain if it should have
+        // worked
+        if (hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS)) {
+            warning().nospace() << "Getting contact attribute interfaces failed with " <<
+                reply.error().name() << ": " << reply.error().message();
+        }
         // let's not fail if retrieving contact attribute interfaces fail
         // TODO should we remove Contacts interface from interfaces?
     }
 
-    mPriv->continueMainIntrospection();
+    mPriv->takeMainIntrospectionCall(watcher).setFinished();
 
     watcher->deleteLater();
 }
@@ -1746,34 +1857,6 @@ void Connection::gotSelfContact(PendingOperation *op)
     }
 }
 
-void Connection::onIntrospectRosterFinished(PendingOperation *op)
-{
-    if (op->isError()) {
-        warning().nospace() << "Introspecting roster failed with " <<
-            op->errorName() << ": " << op->errorMessage();
-        mPriv->readinessHelper->setIntrospectCompleted(FeatureRoster, false,
-                op->errorName(), op->errorMessage());
-        return;
-    }
-
-    debug() << "Introspecting roster finished";
-    mPriv->readinessHelper->setIntrospectCompleted(FeatureRoster, true);
-}
-
-void Connection::onIntrospectRosterGroupsFinished(PendingOperation *op)
-{
-    if (op->isError()) {
-        warning().nospace() << "Introspecting roster groups failed with " <<
-            op->errorName() << ": " << op->errorMessage();
-        mPriv->readinessHelper->setIntrospectCompleted(FeatureRosterGroups, false,
-                op->errorName(), op->errorMessage());
-        return;
-    }
-
-    debug() << "Introspecting roster groups finished";
-    mPriv->readinessHelper->setIntrospectCompleted(FeatureRosterGroups, true);
-}
-
 void Connection::gotBalance(QDBusPendingCallWatcher *watcher)
 {
     QDBusPendingReply<QVariant> reply = *watcher;
@@ -1988,10 +2071,10 @@ PendingHandles *ConnectionLowlevel::requestHandles(HandleType handleType, const
     }
 
     ConnectionPtr conn(connection());
-    if (!hasImmortalHandles()) {
-        Connection::Private::HandleContext *handleContext = conn->mPriv->handleContext;
-        QMutexLocker locker(&handleContext->lock);
-        handleContext->types[handleType].requestsInFlight++;
+    Connection::Private::HandleContext::Type *type = hasImmortalHandles() ?
+        0 : conn->mPriv->handleContext->type(handleType);
+    if (type) {
+        type->requestsInFlight.ref();
     }
 
     PendingHandles *pending =
@@ -2042,13 +2125,12 @@ PendingHandles *ConnectionLowlevel::referenceHandles(HandleType handleType, cons
     ConnectionPtr conn(connection());
     UIntList alreadyHeld;
     UIntList notYetHeld;
-    if (!hasImmortalHandles()) {
-        Connection::Private::HandleContext *handleContext = conn->mPriv->handleContext;
-        QMutexLocker locker(&handleContext->lock);
-
+    if (hasImmortalHandles()) {
+        alreadyHeld = handles;
+    } else if (Connection::Private::HandleContext::Type *type =
+            conn->mPriv->handleContext->type(handleType)) {
         foreach (uint handle, handles) {
-            if (handleContext->types[handleType].refcounts.contains(handle) ||
-                handleContext->types[handleType].toRelease.contains(handle)) {
+            if (type->isHeld(handle)) {
                 alreadyHeld.push_back(handle);
             }
             else {
@@ -2059,7 +2141,7 @@ PendingHandles *ConnectionLowlevel::referenceHandles(HandleType handleType, cons
         debug() << " Already holding" << alreadyHeld.size() <<
             "of the handles -" << notYetHeld.size() << "to go";
     } else {
-        alreadyHeld = handles;
+        notYetHeld = handles;
     }
 
     PendingHandles *pending =
@@ -2193,9 +2275,7 @@ PendingContactAttributes *ConnectionLowlevel::contactAttributes(const UIntList &
     }
 
     if (!hasImmortalHandles()) {
-        Connection::Private::HandleContext *handleContext = conn->mPriv->handleContext;
-        QMutexLocker locker(&handleContext->lock);
-        handleContext->types[HandleTypeContact].requestsInFlight++;
+        conn->mPriv->handleContext->type(HandleTypeContact)->requestsInFlight.ref();
     }
 
     Client::ConnectionInterfaceContactsInterface *contactsInterface =
@@ -2307,14 +2387,16 @@ void Connection::refHandle(HandleType handleType, uint handle)
         return;
     }
 
-    Private::HandleContext *handleContext = mPriv->handleContext;
-    QMutexLocker locker(&handleContext->lock);
-
-    if (handleContext->types[handleType].toRelease.contains(handle)) {
-        handleContext->types[handleType].toRelease.remove(handle);
+    Private::HandleContext::Type *type = mPriv->handleContext->type(handleType);
+    if (!type) {
+        return;
     }
 
-    handleContext->types[handleType].refcounts[handle]++;
+    Private::HandleContext::Shard &shard = type->shard(handle);
+    QMutexLocker locker(&shard.lock);
+
+    shard.toRelease.remove(handle);
+    shard.refcounts[handle]++;
 }
 
 void Connection::unrefHandle(HandleType handleType, uint handle)
@@ -2323,26 +2405,36 @@ void Connection::unrefHandle(HandleType handleType, uint handle)
         return;
     }
 
-    Private::HandleContext *handleContext = mPriv->handleContext;
-    QMutexLocker locker(&handleContext->lock);
+    Private::HandleContext::Type *typePtr = mPriv->handleContext->type(handleType);
+    if (!typePtr) {
+        return;
+    }
+    Private::HandleContext::Type &type = *typePtr;
 
-    Q_ASSERT(handleContext->types.contains(handleType));
-    Q_ASSERT(handleContext->types[handleType].refcounts.contains(handle));
+    {
+        Private::HandleContext::Shard &shard = type.shard(handle);
+        QMutexLocker locker(&shard.lock);
 
-    if (!--handleContext->types[handleType].refcounts[handle]) {
-        handleContext->types[handleType].refcounts.remove(handle);
-        handleContext->types[handleType].toRelease.insert(handle);
+        QHash<uint, uint>::iterator i = shard.refcounts.find(handle);
+        Q_ASSERT(i != shard.refcounts.end());
 
-        if (!handleContext->types[handleType].releaseScheduled) {
-            if (!handleContext->types[handleType].requestsInFlight) {
-                debug() << "Lost last reference to at least one handle of type" <<
-                    handleType <<
-                    "and no requests in flight for that type - scheduling a release sweep";
-                QMetaObject::invokeMethod(this, "doReleaseSweep",
-                        Qt::QueuedConnection, Q_ARG(uint, handleType));
-                handleContext->types[handleType].releaseScheduled = true;
-            }
+        if (--i.value()) {
+            return;
         }
+
+        shard.refcounts.erase(i);
+        shard.toRelease.insert(handle);
+    }
+
+    // The handle is queued for release before we look at requestsInFlight, so either we see no
+    // requests in flight, or the last one to land will see the handle and schedule the sweep
+    if (!type.requestsInFlight.fetchAndAddOrdered(0) &&
+        type.releaseScheduled.testAndSetOrdered(0, 1)) {
+        debug() << "Lost last reference to at least one handle of type" <<
+            handleType <<
+            "and no requests in flight for that type - scheduling a release sweep";
+        QMetaObject::invokeMethod(this, "doReleaseSweep",
+                Qt::QueuedConnection, Q_ARG(uint, handleType));
     }
 }
 
@@ -2352,29 +2444,39 @@ void Connection::doReleaseSweep(uint handleType)
         return;
     }
 
-    Private::HandleContext *handleContext = mPriv->handleContext;
-    QMutexLocker locker(&handleContext->lock);
-
-    Q_ASSERT(handleContext->types.contains(handleType));
-    Q_ASSERT(handleContext->types[handleType].releaseScheduled);
+    Private::HandleContext::Type *typePtr = mPriv->handleContext->type(handleType);
+    if (!typePtr) {
+        return;
+    }
+    Private::HandleContext::Type &type = *typePtr;
 
     debug() << "Entering handle release sweep for type" << handleType;
-    handleContext->types[handleType].releaseScheduled = false;
+    type.releaseScheduled.fetchAndStoreOrdered(0);
 
-    if (handleContext->types[handleType].requestsInFlight > 0) {
+    if (type.requestsInFlight.fetchAndAddOrdered(0) > 0) {
         debug() << " There are requests in flight, deferring sweep to when they have been completed";
         return;
     }
 
-    if (handleContext->types[handleType].toRelease.isEmpty()) {
+    // Release at most MaxHandlesPerRelease handles per sweep, so that large roster and group
+    // updates don't result in a single huge ReleaseHandles call, nor block the event loop while
+    // we gather all of the handles
+    UIntList handles = type.takeHandlesToRelease(
+            Private::HandleContext::MaxHandlesPerRelease);
+    if (handles.isEmpty()) {
         debug() << " No handles to release - every one has been resurrected";
         return;
     }
 
-    debug() << " Releasing" << handleContext->types[handleType].toRelease.size() << "handles";
+    debug() << " Releasing" << handles.size() << "handles";
+    mPriv->baseInterface->ReleaseHandles(handleType, handles);
 
-    mPriv->baseInterface->ReleaseHandles(handleType, handleContext->types[handleType].toRelease.toList());
-    handleContext->types[handleType].toRelease.clear();
+    if (type.hasHandlesToRelease() && type.releaseScheduled.testAndSetOrdered(0, 1)) {
+        debug() << " More handles of type" << handleType <<
+            "to release - scheduling another sweep";
+        QMetaObject::invokeMethod(this, "doReleaseSweep",
+                Qt::QueuedConnection, Q_ARG(uint, handleType));
+    }
 }
 
 void Connection::handleRequestLanded(HandleType handleType)
@@ -2383,19 +2485,20 @@ void Connection::handleRequestLanded(HandleType handleType)
         return;
     }
 
-    Private::HandleContext *handleContext = mPriv->handleContext;
-    QMutexLocker locker(&handleContext->lock);
+    Private::HandleContext::Type *typePtr = mPriv->handleContext->type(handleType);
+    if (!typePtr) {
+        return;
+    }
+    Private::HandleContext::Type &type = *typePtr;
 
-    Q_ASSERT(handleContext->types.contains(handleType));
-    Q_ASSERT(handleContext->types[handleType].requestsInFlight > 0);
+    Q_ASSERT(type.requestsInFlight.fetchAndAddOrdered(0) > 0);
 
-    if (!--handleContext->types[handleType].requestsInFlight &&
-        !handleContext->types[handleType].toRelease.isEmpty() &&
-        !handleContext->types[handleType].releaseScheduled) {
+    if (!type.requestsInFlight.deref() &&
+        type.hasHandlesToRelease() &&
+        type.releaseScheduled.testAndSetOrdered(0, 1)) {
         debug() << "All handle requests for type" << handleType <<
             "landed and there are handles of that type to release - scheduling a release sweep";
         QMetaObject::invokeMethod(this, "doReleaseSweep", Qt::QueuedConnection, Q_ARG(uint, handleType));
-        handleContext->types[handleType].releaseScheduled = true;
     }
 }
 
@@ -212,9 +212,6 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void gotSimpleStatuses(QDBusPendingCallWatcher *watcher);
     TP_QT_NO_EXPORT void gotSelfContact(Tp::PendingOperation *op);
 
-    TP_QT_NO_EXPORT void onIntrospectRosterFinished(Tp::PendingOperation *op);
-    TP_QT_NO_EXPORT void onIntrospectRosterGroupsFinished(Tp::PendingOperation *op);
-
     TP_QT_NO_EXPORT void doReleaseSweep(uint handleType);
 
     TP_QT_NO_EXPORT void onSelfHandleChanged(uint);
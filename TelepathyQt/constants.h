@@ -112,6 +112,20 @@
 #define TP_QT_DEBUG_OBJECT_PATH \
     (QLatin1String("/org/freedesktop/Telepathy/debug"))
 
+/**
+ * The D-Bus interface on which Tp::BaseConnectionDBusMetricsInterface exposes the metrics
+ * collected by Tp::DBusMetrics.
+ */
+#define TP_QT_IFACE_DBUS_METRICS \
+    (QLatin1String("org.freedesktop.Telepathy.Qt.DBusMetrics"))
+
+/**
+ * The D-Bus interface on which Tp::BaseProtocolBulkNormalizationInterface normalizes many
+ * contact identifiers, vCard addresses or contact URIs in a single call.
+ */
+#define TP_QT_IFACE_PROTOCOL_INTERFACE_BULK_NORMALIZATION \
+    (QLatin1String("org.freedesktop.Telepathy.Qt.Protocol.Interface.BulkNormalization"))
+
 /**
  * @}
  */
@@ -53,6 +53,7 @@ public:
 
 protected:
     friend class Contact;
+    friend class ContactManager;
     friend class TestBackdoors;
 
     ContactCapabilities(bool specificToContact);
@@ -23,20 +23,80 @@
 #ifndef _TelepathyQt_contact_manager_internal_h_HEADER_GUARD_
 #define _TelepathyQt_contact_manager_internal_h_HEADER_GUARD_
 
+#include "TelepathyQt/async-result-internal.h"
+
 #include <TelepathyQt/ContactManager>
 #include <TelepathyQt/Global>
 #include <TelepathyQt/PendingOperation>
 #include <TelepathyQt/Types>
 
+#include <QHash>
 #include <QList>
 #include <QObject>
 #include <QQueue>
+#include <QSet>
 #include <QString>
 #include <QStringList>
+#include <QVariantMap>
 
 namespace Tp
 {
 
+class TP_QT_NO_EXPORT ContactAttributeKeys
+{
+public:
+    enum Key {
+        KeyContactId = 0,
+        KeySubscribe,
+        KeyPublish,
+        KeyPublishRequest,
+        KeyAlias,
+        KeyAvatarToken,
+        KeyCapabilities,
+        KeyInfo,
+        KeyLocation,
+        KeyPresence,
+        KeyGroups,
+        KeyAddresses,
+        KeyUris,
+        KeyClientTypes,
+        NumKeys
+    };
+
+    ContactAttributeKeys();
+    ContactAttributeKeys(const Features &supportedFeatures);
+
+    void lookup(const QVariantMap &attributes, const QVariant *values[NumKeys]) const;
+    Key key(const QString &attribute) const;
+
+private:
+    void addKey(const QString &interface, const char *attribute, Key key);
+
+    QHash<QString, Key> mKeys;
+};
+
+class TP_QT_NO_EXPORT ContactAttributeCache
+{
+public:
+    ContactAttributeCache(const QString &fileName, const QStringList &version);
+
+    QString fileName() const { return mFileName; }
+    bool isEmpty() const { return mEntries.isEmpty(); }
+
+    bool load();
+    bool save() const;
+
+    QVariantMap attributes(const QString &id) const;
+    void setAttributes(const QString &id, const QVariantMap &attributes);
+    void retain(const QSet<QString> &ids);
+
+private:
+    QString mFileName;
+    QStringList mVersion;
+    ContactAttributeKeys mKeys;
+    QHash<QString, QVariantMap> mEntries;
+};
+
 class TP_QT_NO_EXPORT ContactManager::Roster : public QObject
 {
     Q_OBJECT
@@ -47,8 +107,8 @@ public:
 
     ContactListState state() const;
 
-    PendingOperation *introspect();
-    PendingOperation *introspectGroups();
+    AsyncResult introspect();
+    AsyncResult introspectGroups();
     void reset();
 
     Contacts allKnownContacts() const;
@@ -98,6 +158,7 @@ private Q_SLOTS:
 
     void gotContactListProperties(Tp::PendingOperation *op);
     void gotContactListContacts(QDBusPendingCallWatcher *watcher);
+    void gotDeferredContactAttributes(Tp::PendingOperation *op);
     void setStateSuccess();
     void onContactListStateChanged(uint state);
     void onContactListContactsChangedWithId(const Tp::ContactSubscriptionMap &changes,
@@ -161,6 +222,8 @@ private Q_SLOTS:
     void onContactListGroupRemoved(Tp::DBusProxy *proxy,
         const QString &errorName, const QString &errorMessage);
 
+    void finishPendingIntrospections();
+
 private:
     struct ChannelInfo;
     struct BlockedContactsChangedInfo;
@@ -169,11 +232,19 @@ private:
     struct GroupRenamedInfo;
     class ModifyFinishOp;
     class RemoveGroupOp;
+    struct PendingIntrospection;
+    struct StateSuccessSetter;
+
+    AsyncResult createFinishedLater(const QString &errorName = QString(),
+            const QString &errorMessage = QString());
+    void finishIntrospection(AsyncResult &result,
+            const QString &errorName = QString(), const QString &errorMessage = QString());
 
     void introspectContactBlocking();
     void introspectContactBlockingBlockedContacts();
     void introspectContactList();
     void introspectContactListContacts();
+    void refreshDeferredContactAttributes();
     void processContactListChanges();
     void processContactListBlockedContactsChanged();
     void processContactListUpdates();
@@ -200,8 +271,9 @@ private:
     bool usingFallbackContactList;
     bool hasContactBlockingInterface;
 
-    PendingOperation *introspectPendingOp;
-    PendingOperation *introspectGroupsPendingOp;
+    AsyncResult introspectResult;
+    AsyncResult introspectGroupsResult;
+    QList<PendingIntrospection> pendingIntrospections;
     uint pendingContactListState;
     uint contactListState;
     bool canReportAbusive;
@@ -245,6 +317,13 @@ private:
 
     // Contact list contacts using the Conn.I.ContactList API
     Contacts contactListContacts;
+    // On-disk cache of the contact list contacts attributes, if enabled
+    ContactAttributeCache *attributeCache;
+    // Interfaces served from the cache and left out of GetContactListAttributes
+    QStringList deferredInterfaces;
+    // Contact list contacts whose deferred attributes are still to be refreshed, those which
+    // weren't in the cache first
+    QList<uint> deferredRefreshHandles;
     // Blocked contacts using the new ContactBlocking API
     Contacts blockedContacts;
 };
@@ -335,6 +414,37 @@ struct TP_QT_NO_EXPORT ContactManager::Roster::GroupRenamedInfo
     QString newName;
 };
 
+struct TP_QT_NO_EXPORT ContactManager::Roster::PendingIntrospection
+{
+    PendingIntrospection(const AsyncResult &result, const QString &errorName,
+            const QString &errorMessage)
+        : result(result),
+          errorName(errorName),
+          errorMessage(errorMessage)
+    {
+    }
+
+    AsyncResult result;
+    QString errorName;
+    QString errorMessage;
+};
+
+struct TP_QT_NO_EXPORT ContactManager::Roster::StateSuccessSetter
+{
+    StateSuccessSetter(Roster *roster)
+        : roster(roster)
+    {
+    }
+
+    void operator()(const AsyncResult &result) const
+    {
+        Q_UNUSED(result);
+        roster->setStateSuccess();
+    }
+
+    Roster *roster;
+};
+
 class TP_QT_NO_EXPORT ContactManager::Roster::ModifyFinishOp : public PendingOperation
 {
     Q_OBJECT
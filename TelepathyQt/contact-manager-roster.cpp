@@ -30,6 +30,7 @@
 #include <TelepathyQt/ConnectionLowlevel>
 #include <TelepathyQt/ContactFactory>
 #include <TelepathyQt/PendingChannel>
+#include <TelepathyQt/PendingContactAttributes>
 #include <TelepathyQt/PendingContacts>
 #include <TelepathyQt/PendingFailure>
 #include <TelepathyQt/PendingHandles>
@@ -38,16 +39,20 @@
 #include <TelepathyQt/PendingReady>
 #include <TelepathyQt/ReferencedHandles>
 
+#include <QMetaObject>
+
 namespace Tp
 {
 
+// Contacts whose cached attributes are refreshed with each GetContactAttributes call, so that
+// the refresh of a large contact list doesn't hold the other calls to the CM up
+static const int maxDeferredRefreshHandles = 256;
+
 ContactManager::Roster::Roster(ContactManager *contactManager)
     : QObject(),
       contactManager(contactManager),
       usingFallbackContactList(false),
       hasContactBlockingInterface(false),
-      introspectPendingOp(0),
-      introspectGroupsPendingOp(0),
       pendingContactListState((uint) -1),
       contactListState((uint) -1),
       canReportAbusive(false),
@@ -61,12 +66,14 @@ ContactManager::Roster::Roster(ContactManager *contactManager)
       processingContactListChanges(false),
       contactListChannelsReady(0),
       featureContactListGroupsTodo(0),
-      groupsSetSuccess(false)
+      groupsSetSuccess(false),
+      attributeCache(0)
 {
 }
 
 ContactManager::Roster::~Roster()
 {
+    delete attributeCache;
 }
 
 ContactListState ContactManager::Roster::state() const
@@ -74,7 +81,7 @@ ContactListState ContactManager::Roster::state() const
     return (Tp::ContactListState) contactListState;
 }
 
-PendingOperation *ContactManager::Roster::introspect()
+AsyncResult ContactManager::Roster::introspect()
 {
     ConnectionPtr conn(contactManager->connection());
 
@@ -125,21 +132,21 @@ PendingOperation *ContactManager::Roster::introspect()
         }
     }
 
-    Q_ASSERT(!introspectPendingOp);
-    introspectPendingOp = new PendingOperation(conn);
-    return introspectPendingOp;
+    Q_ASSERT(introspectResult.isNull());
+    introspectResult = AsyncResult::create();
+    return introspectResult;
 }
 
-PendingOperation *ContactManager::Roster::introspectGroups()
+AsyncResult ContactManager::Roster::introspectGroups()
 {
     ConnectionPtr conn(contactManager->connection());
 
-    Q_ASSERT(!introspectGroupsPendingOp);
+    Q_ASSERT(introspectGroupsResult.isNull());
 
     if (conn->hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST)) {
         if (!conn->hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_GROUPS)) {
-            return new PendingFailure(TP_QT_ERROR_NOT_IMPLEMENTED,
-                    QLatin1String("Roster groups not supported"), conn);
+            return createFinishedLater(TP_QT_ERROR_NOT_IMPLEMENTED,
+                    QLatin1String("Roster groups not supported"));
         }
 
         debug() << "Connection.ContactGroups found, using it";
@@ -147,7 +154,7 @@ PendingOperation *ContactManager::Roster::introspectGroups()
         if (!gotContactListInitialContacts) {
             debug() << "Initial ContactList contacts not retrieved. Postponing introspection";
             groupsReintrospectionRequired = true;
-            return new PendingSuccess(conn);
+            return createFinishedLater();
         }
 
         Client::ConnectionInterfaceContactGroupsInterface *iface =
@@ -198,16 +205,27 @@ PendingOperation *ContactManager::Roster::introspectGroups()
     }
 
     if (groupsReintrospectionRequired) {
-        return NULL;
+        return AsyncResult();
     }
 
-    Q_ASSERT(!introspectGroupsPendingOp);
-    introspectGroupsPendingOp = new PendingOperation(conn);
-    return introspectGroupsPendingOp;
+    Q_ASSERT(introspectGroupsResult.isNull());
+    introspectGroupsResult = AsyncResult::create();
+    return introspectGroupsResult;
 }
 
 void ContactManager::Roster::reset()
 {
+    // The continuations point to the Connection, which is going away
+    introspectResult.cancel();
+    introspectResult = AsyncResult();
+    introspectGroupsResult.cancel();
+    introspectGroupsResult = AsyncResult();
+    foreach (const PendingIntrospection &pending, pendingIntrospections) {
+        AsyncResult result(pending.result);
+        result.cancel();
+    }
+    pendingIntrospections.clear();
+
     contactListChannels.clear();
     subscribeChannel.reset();
     publishChannel.reset();
@@ -768,11 +786,7 @@ void ContactManager::Roster::gotContactListProperties(PendingOperation *op)
 {
     if (op->isError()) {
         // We may have been in state Failure and then Success, and FeatureRoster is already ready
-        if (introspectPendingOp) {
-            introspectPendingOp->setFinishedWithError(
-                    op->errorName(), op->errorMessage());
-            introspectPendingOp = 0;
-        }
+        finishIntrospection(introspectResult, op->errorName(), op->errorMessage());
         return;
     }
 
@@ -804,11 +818,7 @@ void ContactManager::Roster::gotContactListContacts(QDBusPendingCallWatcher *wat
         emit contactManager->stateChanged((Tp::ContactListState) contactListState);
 
         // We may have been in state Failure and then Success, and FeatureRoster is already ready
-        if (introspectPendingOp) {
-            introspectPendingOp->setFinishedWithError(
-                    reply.error());
-            introspectPendingOp = 0;
-        }
+        finishIntrospection(introspectResult, reply.error().name(), reply.error().message());
         return;
     }
 
@@ -820,10 +830,36 @@ void ContactManager::Roster::gotContactListContacts(QDBusPendingCallWatcher *wat
     ContactAttributesMap attrsMap = reply.value();
     ContactAttributesMap::const_iterator begin = attrsMap.constBegin();
     ContactAttributesMap::const_iterator end = attrsMap.constEnd();
+    QSet<QString> ids;
+    QList<uint> uncachedHandles;
+    QList<uint> cachedHandles;
     for (ContactAttributesMap::const_iterator i = begin; i != end; ++i) {
         uint bareHandle = i.key();
         QVariantMap attrs = i.value();
 
+        if (attributeCache) {
+            QString id = qdbus_cast<QString>(attrs.value(
+                        TP_QT_IFACE_CONNECTION + QLatin1String("/contact-id")));
+            ids.insert(id);
+
+            if (deferredInterfaces.isEmpty()) {
+                attributeCache->setAttributes(id, attrs);
+            } else {
+                // Fill in what was left out of the request from the cache, until the refresh
+                // below brings in the actual values
+                QVariantMap cachedAttrs = attributeCache->attributes(id);
+                if (cachedAttrs.isEmpty()) {
+                    uncachedHandles << bareHandle;
+                } else {
+                    cachedHandles << bareHandle;
+                }
+                for (QVariantMap::const_iterator j = cachedAttrs.constBegin();
+                        j != cachedAttrs.constEnd(); ++j) {
+                    attrs.insert(j.key(), j.value());
+                }
+            }
+        }
+
         ContactPtr contact = contactManager->ensureContact(ReferencedHandles(conn,
                     HandleTypeContact, UIntList() << bareHandle),
                 conn->contactFactory()->features(), attrs);
@@ -831,6 +867,18 @@ void ContactManager::Roster::gotContactListContacts(QDBusPendingCallWatcher *wat
         contactListContacts.insert(contact);
     }
 
+    if (attributeCache) {
+        attributeCache->retain(ids);
+
+        if (deferredInterfaces.isEmpty()) {
+            attributeCache->save();
+        } else {
+            // The contacts which only have their roster attributes so far come first
+            deferredRefreshHandles = uncachedHandles + cachedHandles;
+            refreshDeferredContactAttributes();
+        }
+    }
+
     if (contactManager->connection()->requestedFeatures().contains(
                 Connection::FeatureRosterGroups)) {
         groupsSetSuccess = true;
@@ -840,17 +888,14 @@ void ContactManager::Roster::gotContactListContacts(QDBusPendingCallWatcher *wat
     // In any case, if we're going to reintrospect Groups, we only advance to state success once
     // that is finished. We connect to the op finishing already here to catch all the failure finish
     // cases as well.
-    if (introspectPendingOp) {
+    if (!introspectResult.isNull()) {
         if (!groupsSetSuccess) {
-            // Will emit stateChanged() signal when the op is finished in idle
-            // callback. This is to ensure FeatureRoster (and Groups) is marked ready.
-            connect(introspectPendingOp,
-                    SIGNAL(finished(Tp::PendingOperation *)),
-                    SLOT(setStateSuccess()));
+            // Will emit stateChanged() signal once the result is finished. The Connection has
+            // added its continuation first, so FeatureRoster (and Groups) is marked ready by then.
+            introspectResult.then(StateSuccessSetter(this));
         }
 
-        introspectPendingOp->setFinished();
-        introspectPendingOp = 0;
+        finishIntrospection(introspectResult);
     } else if (!groupsSetSuccess) {
         setStateSuccess();
     } else {
@@ -864,6 +909,125 @@ void ContactManager::Roster::gotContactListContacts(QDBusPendingCallWatcher *wat
     }
 }
 
+void ContactManager::Roster::refreshDeferredContactAttributes()
+{
+    UIntList handles;
+    while (handles.size() < maxDeferredRefreshHandles && !deferredRefreshHandles.isEmpty()) {
+        uint handle = deferredRefreshHandles.takeFirst();
+        ContactPtr contact = contactManager->lookupContactByHandle(handle);
+        // Removed from the contact list meanwhile, and its handle may be gone with it
+        if (contact && contactListContacts.contains(contact)) {
+            handles << handle;
+        }
+    }
+
+    if (handles.isEmpty()) {
+        attributeCache->save();
+        return;
+    }
+
+    debug() << "Refreshing cached attributes of" << handles.size() << "contacts," <<
+        deferredRefreshHandles.size() << "left";
+
+    // The handles are already held by the contacts
+    ConnectionPtr conn(contactManager->connection());
+    PendingContactAttributes *pca = conn->lowlevel()->contactAttributes(handles,
+            deferredInterfaces, false);
+    connect(pca,
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(gotDeferredContactAttributes(Tp::PendingOperation*)));
+}
+
+void ContactManager::Roster::gotDeferredContactAttributes(PendingOperation *op)
+{
+    if (op->isError()) {
+        warning() << "Refreshing cached contact attributes failed with" <<
+            op->errorName() << ":" << op->errorMessage();
+        deferredRefreshHandles.clear();
+        attributeCache->save();
+        return;
+    }
+
+    ConnectionPtr conn(contactManager->connection());
+    if (!conn->isValid()) {
+        deferredRefreshHandles.clear();
+        return;
+    }
+
+    PendingContactAttributes *pca = qobject_cast<PendingContactAttributes*>(op);
+
+    // Only augment the features which were refreshed, so that the groups and presence which came
+    // with the roster are left alone. FeatureAvatarData is updated along with the avatar token.
+    Features features;
+    foreach (const Feature &feature, conn->contactFactory()->features()) {
+        if (feature != Contact::FeatureAvatarData &&
+            pca->interfacesRequested().contains(contactManager->featureToInterface(feature))) {
+            features.insert(feature);
+        }
+    }
+
+    ContactAttributesMap attrsMap = pca->attributes();
+    for (ContactAttributesMap::const_iterator i = attrsMap.constBegin();
+            i != attrsMap.constEnd(); ++i) {
+        ContactPtr contact = contactManager->lookupContactByHandle(i.key());
+        if (!contact || !contactListContacts.contains(contact)) {
+            // Removed from the contact list meanwhile
+            continue;
+        }
+
+        // Contact::augment() only signals the attributes which actually changed
+        contactManager->ensureContact(contact->handle(), features, i.value());
+        attributeCache->setAttributes(contact->id(), i.value());
+    }
+
+    // The cache is saved once the last chunk is in
+    refreshDeferredContactAttributes();
+}
+
+AsyncResult ContactManager::Roster::createFinishedLater(const QString &errorName,
+        const QString &errorMessage)
+{
+    AsyncResult result = AsyncResult::create();
+    AsyncResult finishing(result);
+    finishIntrospection(finishing, errorName, errorMessage);
+    return result;
+}
+
+void ContactManager::Roster::finishIntrospection(AsyncResult &result,
+        const QString &errorName, const QString &errorMessage)
+{
+    if (result.isNull()) {
+        // We may have been in state Failure and then Success, and the feature is already ready
+        return;
+    }
+
+    // AsyncResult invokes its continuations right away, but we are typically called from the
+    // middle of a D-Bus reply handler, with the roster state only partially updated. So, as
+    // PendingOperation did, finish the result from the mainloop instead, in the order the results
+    // were finished in.
+    if (pendingIntrospections.isEmpty()) {
+        QMetaObject::invokeMethod(this, "finishPendingIntrospections", Qt::QueuedConnection);
+    }
+    pendingIntrospections.append(PendingIntrospection(result, errorName, errorMessage));
+    result = AsyncResult();
+}
+
+void ContactManager::Roster::finishPendingIntrospections()
+{
+    // Finishing one may well queue another one, which is then finished in the next round
+    QList<PendingIntrospection> pending = pendingIntrospections;
+    pendingIntrospections.clear();
+
+    foreach (const PendingIntrospection &introspection, pending) {
+        AsyncResult result(introspection.result);
+        if (introspection.errorName.isEmpty()) {
+            result.setFinished();
+        } else {
+            result.setFinishedWithError(introspection.errorName, introspection.errorMessage);
+        }
+    }
+}
+
 void ContactManager::Roster::setStateSuccess()
 {
     if (contactManager->connection()->isValid()) {
@@ -898,9 +1062,8 @@ void ContactManager::Roster::onContactListStateChanged(uint state)
     if (state == ContactListStateFailure) {
         // Consider it done here as the state may go from Failure to Success afterwards, in which
         // case the contacts will appear.
-        Q_ASSERT(introspectPendingOp);
-        introspectPendingOp->setFinished();
-        introspectPendingOp = 0;
+        Q_ASSERT(!introspectResult.isNull());
+        finishIntrospection(introspectResult);
     }
 }
 
@@ -1267,10 +1430,9 @@ void ContactManager::Roster::onContactListChannelReady()
             debug() << "State is failure, roster not supported";
             emit contactManager->stateChanged((Tp::ContactListState) contactListState);
 
-            Q_ASSERT(introspectPendingOp);
-            introspectPendingOp->setFinishedWithError(TP_QT_ERROR_NOT_IMPLEMENTED,
+            Q_ASSERT(!introspectResult.isNull());
+            finishIntrospection(introspectResult, TP_QT_ERROR_NOT_IMPLEMENTED,
                     QLatin1String("Roster not supported"));
-            introspectPendingOp = 0;
             return;
         }
 
@@ -1291,44 +1453,36 @@ void ContactManager::Roster::onContactListChannelReady()
 
         updateContactsPresenceState();
 
-        Q_ASSERT(introspectPendingOp);
+        Q_ASSERT(!introspectResult.isNull());
 
         if (!contactManager->connection()->requestedFeatures().contains(
                     Connection::FeatureRosterGroups)) {
-            // Will emit stateChanged() signal when the op is finished in idle
-            // callback. This is to ensure FeatureRoster is marked ready.
-            connect(introspectPendingOp,
-                    SIGNAL(finished(Tp::PendingOperation *)),
-                    SLOT(setStateSuccess()));
+            // Will emit stateChanged() signal once the result is finished, after the Connection
+            // has marked FeatureRoster ready.
+            introspectResult.then(StateSuccessSetter(this));
         } else {
             Q_ASSERT(!groupsSetSuccess);
             groupsSetSuccess = true;
         }
 
-        introspectPendingOp->setFinished();
-        introspectPendingOp = 0;
+        finishIntrospection(introspectResult);
     }
 }
 
 void ContactManager::Roster::gotContactListGroupsProperties(PendingOperation *op)
 {
-    Q_ASSERT(introspectGroupsPendingOp != NULL);
+    Q_ASSERT(!introspectGroupsResult.isNull());
 
     if (groupsSetSuccess) {
-        // Connect here, so we catch the following and the other failure cases
-        connect(introspectGroupsPendingOp,
-                SIGNAL(finished(Tp::PendingOperation *)),
-                SLOT(setStateSuccess()));
+        // Add the continuation here, so we catch the following and the other failure cases
+        introspectGroupsResult.then(StateSuccessSetter(this));
     }
 
     if (op->isError()) {
         warning() << "Getting contact list groups properties failed:" << op->errorName() << '-'
             << op->errorMessage();
 
-        introspectGroupsPendingOp->setFinishedWithError(
-                op->errorName(), op->errorMessage());
-        introspectGroupsPendingOp = 0;
-
+        finishIntrospection(introspectGroupsResult, op->errorName(), op->errorMessage());
         return;
     }
 
@@ -1354,21 +1508,18 @@ void ContactManager::Roster::onContactListContactsUpgraded(PendingOperation *op)
     Q_ASSERT(processingContactListChanges);
     processingContactListChanges = false;
 
-    Q_ASSERT(introspectGroupsPendingOp != NULL);
+    Q_ASSERT(!introspectGroupsResult.isNull());
 
     if (op->isError()) {
         warning() << "Upgrading contacts with group membership failed:" << op->errorName() << '-'
             << op->errorMessage();
 
-        introspectGroupsPendingOp->setFinishedWithError(
-                op->errorName(), op->errorMessage());
-        introspectGroupsPendingOp = 0;
+        finishIntrospection(introspectGroupsResult, op->errorName(), op->errorMessage());
         processContactListChanges();
         return;
     }
 
-    introspectGroupsPendingOp->setFinished();
-    introspectGroupsPendingOp = 0;
+    finishIntrospection(introspectGroupsResult);
     processContactListChanges();
 }
 
@@ -1413,7 +1564,7 @@ void ContactManager::Roster::onContactListGroupChannelReady(PendingOperation *op
 
     ConnectionPtr conn(contactManager->connection());
 
-    if (introspectGroupsPendingOp) {
+    if (!introspectGroupsResult.isNull()) {
         checkContactListGroupsReady();
     } else {
         PendingReady *pr = qobject_cast<PendingReady*>(op);
@@ -1692,6 +1843,31 @@ void ContactManager::Roster::introspectContactListContacts()
     }
     interfaces.insert(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST);
 
+    QString cacheFileName = contactManager->attributeCacheFileName();
+    if (!attributeCache && !cacheFileName.isEmpty()) {
+        QStringList version = conn->interfaces();
+        version.sort();
+        attributeCache = new ContactAttributeCache(cacheFileName, version);
+        attributeCache->load();
+    }
+
+    deferredInterfaces.clear();
+    if (attributeCache && !attributeCache->isEmpty()) {
+        // Serve the attributes which rarely change from the cache, and only ask for the ones
+        // which can't be cached now. The rest is refreshed once the roster is up. The cached
+        // contacts can't be built before the reply, as it brings the handles they need.
+        foreach (const QString &interface, interfaces) {
+            if (interface != TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST &&
+                interface != TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_GROUPS &&
+                interface != TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE) {
+                deferredInterfaces << interface;
+            }
+        }
+        foreach (const QString &interface, deferredInterfaces) {
+            interfaces.remove(interface);
+        }
+    }
+
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
             iface->GetContactListAttributes(interfaces.toList(), true), contactManager);
     connect(watcher,
@@ -2052,12 +2228,10 @@ void ContactManager::Roster::checkContactListGroupsReady()
     if (groupsSetSuccess) {
         Q_ASSERT(contactManager->state() != ContactListStateSuccess);
 
-        if (introspectGroupsPendingOp) {
-            // Will emit stateChanged() signal when the op is finished in idle
-            // callback. This is to ensure FeatureRosterGroups is marked ready.
-            connect(introspectGroupsPendingOp,
-                    SIGNAL(finished(Tp::PendingOperation *)),
-                    SLOT(setStateSuccess()));
+        if (!introspectGroupsResult.isNull()) {
+            // Will emit stateChanged() signal once the result is finished, after the Connection
+            // has marked FeatureRosterGroups ready.
+            introspectGroupsResult.then(StateSuccessSetter(this));
         } else {
             setStateSuccess();
         }
@@ -2066,9 +2240,8 @@ void ContactManager::Roster::checkContactListGroupsReady()
     }
 
     setContactListGroupChannelsReady();
-    if (introspectGroupsPendingOp) {
-        introspectGroupsPendingOp->setFinished();
-        introspectGroupsPendingOp = 0;
+    if (!introspectGroupsResult.isNull()) {
+        finishIntrospection(introspectGroupsResult);
     }
     pendingContactListGroupChannels.clear();
 }
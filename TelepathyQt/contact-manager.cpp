@@ -30,7 +30,9 @@
 
 #include <TelepathyQt/AvatarData>
 #include <TelepathyQt/Connection>
+#include <TelepathyQt/ConnectionCapabilities>
 #include <TelepathyQt/ConnectionLowlevel>
+#include <TelepathyQt/ContactCapabilities>
 #include <TelepathyQt/ContactFactory>
 #include <TelepathyQt/PendingChannel>
 #include <TelepathyQt/PendingContactAttributes>
@@ -38,14 +40,385 @@
 #include <TelepathyQt/PendingFailure>
 #include <TelepathyQt/PendingHandles>
 #include <TelepathyQt/PendingVariantMap>
+#include <TelepathyQt/Presence>
 #include <TelepathyQt/ReferencedHandles>
 #include <TelepathyQt/Utils>
 
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QMap>
 
 namespace Tp
 {
 
+ContactAttributeKeys::ContactAttributeKeys()
+{
+}
+
+ContactAttributeKeys::ContactAttributeKeys(const Features &supportedFeatures)
+{
+    addKey(TP_QT_IFACE_CONNECTION, "/contact-id", KeyContactId);
+    addKey(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST, "/subscribe", KeySubscribe);
+    addKey(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST, "/publish", KeyPublish);
+    addKey(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST, "/publish-request", KeyPublishRequest);
+
+    if (supportedFeatures.contains(Contact::FeatureAlias)) {
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_ALIASING, "/alias", KeyAlias);
+    }
+    if (supportedFeatures.contains(Contact::FeatureAvatarToken)) {
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_AVATARS, "/token", KeyAvatarToken);
+    }
+    if (supportedFeatures.contains(Contact::FeatureCapabilities)) {
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_CAPABILITIES, "/capabilities",
+                KeyCapabilities);
+    }
+    if (supportedFeatures.contains(Contact::FeatureInfo)) {
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_INFO, "/info", KeyInfo);
+    }
+    if (supportedFeatures.contains(Contact::FeatureLocation)) {
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_LOCATION, "/location", KeyLocation);
+    }
+    if (supportedFeatures.contains(Contact::FeatureSimplePresence)) {
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE, "/presence", KeyPresence);
+    }
+    if (supportedFeatures.contains(Contact::FeatureRosterGroups)) {
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_GROUPS, "/groups", KeyGroups);
+    }
+    if (supportedFeatures.contains(Contact::FeatureAddresses)) {
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING, "/addresses", KeyAddresses);
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING, "/uris", KeyUris);
+    }
+    if (supportedFeatures.contains(Contact::FeatureClientTypes)) {
+        addKey(TP_QT_IFACE_CONNECTION_INTERFACE_CLIENT_TYPES, "/client-types", KeyClientTypes);
+    }
+}
+
+void ContactAttributeKeys::addKey(const QString &interface, const char *attribute, Key key)
+{
+    mKeys.insert(interface + QLatin1String(attribute), key);
+}
+
+/*
+ * Walk the attributes of a contact once, pointing values[key] to the value of each known
+ * attribute and to 0 for the ones not present.
+ */
+void ContactAttributeKeys::lookup(const QVariantMap &attributes,
+        const QVariant *values[NumKeys]) const
+{
+    for (int i = 0; i < NumKeys; ++i) {
+        values[i] = 0;
+    }
+
+    for (QVariantMap::const_iterator i = attributes.constBegin();
+            i != attributes.constEnd(); ++i) {
+        QHash<QString, Key>::const_iterator key = mKeys.constFind(i.key());
+        if (key != mKeys.constEnd()) {
+            values[*key] = &i.value();
+        }
+    }
+}
+
+ContactAttributeKeys::Key ContactAttributeKeys::key(const QString &attribute) const
+{
+    return mKeys.value(attribute, NumKeys);
+}
+
+namespace
+{
+
+const quint32 attributeCacheMagic = 0x54704341; // "TpCA"
+const quint32 attributeCacheFormat = 1;
+
+// Whether the value only contains types which QDataStream knows how to write, i.e. no
+// QDBusArgument left over from demarshalling
+bool isPlainValue(const QVariant &value)
+{
+    if (value.type() == QVariant::Map) {
+        foreach (const QVariant &item, value.toMap()) {
+            if (!isPlainValue(item)) {
+                return false;
+            }
+        }
+        return true;
+    } else if (value.type() == QVariant::List) {
+        foreach (const QVariant &item, value.toList()) {
+            if (!isPlainValue(item)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    return value.userType() < QMetaType::User;
+}
+
+QVariant encodeAttribute(ContactAttributeKeys::Key key, const QVariant &value)
+{
+    switch (key) {
+        case ContactAttributeKeys::KeyAlias:
+        case ContactAttributeKeys::KeyAvatarToken:
+            return QVariant(qdbus_cast<QString>(value));
+
+        case ContactAttributeKeys::KeyUris:
+        case ContactAttributeKeys::KeyClientTypes:
+            return QVariant(qdbus_cast<QStringList>(value));
+
+        case ContactAttributeKeys::KeyAddresses: {
+            VCardFieldAddressMap addresses = qdbus_cast<VCardFieldAddressMap>(value);
+            QVariantMap ret;
+            for (VCardFieldAddressMap::const_iterator i = addresses.constBegin();
+                    i != addresses.constEnd(); ++i) {
+                ret.insert(i.key(), i.value());
+            }
+            return QVariant(ret);
+        }
+
+        case ContactAttributeKeys::KeyCapabilities: {
+            QVariantList ret;
+            foreach (const RequestableChannelClass &rcc,
+                    qdbus_cast<RequestableChannelClassList>(value)) {
+                QVariant fixedProperties(rcc.fixedProperties);
+                if (!isPlainValue(fixedProperties)) {
+                    return QVariant();
+                }
+                ret << QVariant(QVariantList() << fixedProperties
+                        << QVariant(rcc.allowedProperties));
+            }
+            return QVariant(ret);
+        }
+
+        case ContactAttributeKeys::KeyInfo: {
+            QVariantList ret;
+            foreach (const ContactInfoField &field, qdbus_cast<ContactInfoFieldList>(value)) {
+                ret << QVariant(QVariantList() << QVariant(field.fieldName)
+                        << QVariant(field.parameters) << QVariant(field.fieldValue));
+            }
+            return QVariant(ret);
+        }
+
+        case ContactAttributeKeys::KeyLocation: {
+            QVariant ret(qdbus_cast<QVariantMap>(value));
+            return isPlainValue(ret) ? ret : QVariant();
+        }
+
+        default:
+            // Contact list attributes and presence are always retrieved with the roster itself
+            return QVariant();
+    }
+}
+
+QVariant decodeAttribute(ContactAttributeKeys::Key key, const QVariant &value)
+{
+    switch (key) {
+        case ContactAttributeKeys::KeyAddresses: {
+            QVariantMap addresses = value.toMap();
+            VCardFieldAddressMap ret;
+            for (QVariantMap::const_iterator i = addresses.constBegin();
+                    i != addresses.constEnd(); ++i) {
+                ret.insert(i.key(), i.value().toString());
+            }
+            return QVariant::fromValue(ret);
+        }
+
+        case ContactAttributeKeys::KeyCapabilities: {
+            RequestableChannelClassList ret;
+            foreach (const QVariant &item, value.toList()) {
+                QVariantList fields = item.toList();
+                if (fields.size() != 2) {
+                    continue;
+                }
+                RequestableChannelClass rcc;
+                rcc.fixedProperties = fields[0].toMap();
+                rcc.allowedProperties = fields[1].toStringList();
+                ret << rcc;
+            }
+            return QVariant::fromValue(ret);
+        }
+
+        case ContactAttributeKeys::KeyInfo: {
+            ContactInfoFieldList ret;
+            foreach (const QVariant &item, value.toList()) {
+                QVariantList fields = item.toList();
+                if (fields.size() != 3) {
+                    continue;
+                }
+                ContactInfoField field;
+                field.fieldName = fields[0].toString();
+                field.parameters = fields[1].toStringList();
+                field.fieldValue = fields[2].toStringList();
+                ret << field;
+            }
+            return QVariant::fromValue(ret);
+        }
+
+        default:
+            return value;
+    }
+}
+
+}
+
+/*
+ * The attributes are stored per contact identifier, as handles don't survive the connection.
+ * Only the attributes which rarely change are kept, in a form QDataStream can write, and the
+ * whole cache is discarded when the version (the connection interfaces) doesn't match.
+ */
+ContactAttributeCache::ContactAttributeCache(const QString &fileName, const QStringList &version)
+    : mFileName(fileName),
+      mVersion(version),
+      mKeys(Features() << Contact::FeatureAlias << Contact::FeatureAvatarToken
+              << Contact::FeatureCapabilities << Contact::FeatureInfo
+              << Contact::FeatureLocation << Contact::FeatureAddresses
+              << Contact::FeatureClientTypes)
+{
+}
+
+bool ContactAttributeCache::load()
+{
+    mEntries.clear();
+
+    QFile file(mFileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+
+    quint32 magic, format;
+    QStringList version;
+    stream >> magic >> format;
+    if (magic != attributeCacheMagic || format != attributeCacheFormat) {
+        warning() << "Ignoring contact attribute cache" << mFileName << "in an unknown format";
+        return false;
+    }
+
+    stream >> version;
+    if (version != mVersion) {
+        debug() << "Ignoring outdated contact attribute cache" << mFileName;
+        return false;
+    }
+
+    QHash<QString, QVariantMap> entries;
+    stream >> entries;
+    if (stream.status() != QDataStream::Ok) {
+        warning() << "Ignoring corrupted contact attribute cache" << mFileName;
+        return false;
+    }
+
+    mEntries = entries;
+    debug() << "Loaded cached attributes of" << mEntries.size() << "contacts from" << mFileName;
+    return true;
+}
+
+bool ContactAttributeCache::save() const
+{
+    // The cache reveals who the contacts of the user are, so only the user may read it
+    QString dirName = QFileInfo(mFileName).absolutePath();
+    if (!QDir(dirName).exists()) {
+        if (!QDir().mkpath(dirName)) {
+            warning() << "Unable to create directory" << dirName;
+            return false;
+        }
+        QFile::setPermissions(dirName,
+                QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    }
+
+    // Write to a temporary file first, so a crash never leaves a truncated cache behind
+    QString tmpFileName = mFileName + QLatin1String(".tmp");
+    QFile file(tmpFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        !file.setPermissions(QFile::ReadOwner | QFile::WriteOwner)) {
+        warning() << "Unable to write contact attribute cache" << tmpFileName;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+    stream << attributeCacheMagic << attributeCacheFormat << mVersion << mEntries;
+    file.close();
+
+    if (stream.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+        warning() << "Unable to write contact attribute cache" << tmpFileName;
+        QFile::remove(tmpFileName);
+        return false;
+    }
+
+    QFile::remove(mFileName);
+    if (!QFile::rename(tmpFileName, mFileName)) {
+        warning() << "Unable to rename" << tmpFileName << "to" << mFileName;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Return the cached attributes of the contact with the given identifier, in the same form as
+ * they would be returned by GetContactAttributes.
+ */
+QVariantMap ContactAttributeCache::attributes(const QString &id) const
+{
+    QVariantMap ret;
+    QHash<QString, QVariantMap>::const_iterator entry = mEntries.constFind(id);
+    if (entry == mEntries.constEnd()) {
+        return ret;
+    }
+
+    for (QVariantMap::const_iterator i = entry->constBegin(); i != entry->constEnd(); ++i) {
+        ret.insert(i.key(), decodeAttribute(mKeys.key(i.key()), i.value()));
+    }
+    return ret;
+}
+
+/*
+ * Replace the entry of the contact with the given identifier by the cacheable attributes out of
+ * a GetContactAttributes result.
+ */
+void ContactAttributeCache::setAttributes(const QString &id, const QVariantMap &attributes)
+{
+    if (id.isEmpty()) {
+        return;
+    }
+
+    QVariantMap entry;
+    for (QVariantMap::const_iterator i = attributes.constBegin();
+            i != attributes.constEnd(); ++i) {
+        ContactAttributeKeys::Key key = mKeys.key(i.key());
+        if (key == ContactAttributeKeys::NumKeys) {
+            continue;
+        }
+
+        QVariant value = encodeAttribute(key, i.value());
+        if (value.isValid()) {
+            entry.insert(i.key(), value);
+        }
+    }
+
+    if (entry.isEmpty()) {
+        mEntries.remove(id);
+    } else {
+        mEntries.insert(id, entry);
+    }
+}
+
+/*
+ * Drop the entries of the contacts which are not in the given set anymore.
+ */
+void ContactAttributeCache::retain(const QSet<QString> &ids)
+{
+    QHash<QString, QVariantMap>::iterator i = mEntries.begin();
+    while (i != mEntries.end()) {
+        if (!ids.contains(i.key())) {
+            i = mEntries.erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
 struct TP_QT_NO_EXPORT ContactManager::Private
 {
     Private(ContactManager *parent, Connection *connection);
@@ -72,6 +445,17 @@ struct TP_QT_NO_EXPORT ContactManager::Private
 
     // contact info
     PendingRefreshContactInfo *refreshInfoOp;
+
+    // values shared by the contacts of this manager
+    ContactAttributeKeys attributeKeys;
+    ContactCapabilities defaultCaps;
+    RequestableChannelClassSpecList defaultCapsSpecs;
+    bool defaultCapsValid;
+    bool defaultCapsSpecific;
+    QHash<QPair<uint, QString>, Presence> presences;
+    QSet<QString> strings;
+
+    QString attributeCacheFileName;
 };
 
 ContactManager::Private::Private(ContactManager *parent, Connection *connection)
@@ -79,7 +463,10 @@ ContactManager::Private::Private(ContactManager *parent, Connection *connection)
       connection(connection),
       roster(new ContactManager::Roster(parent)),
       requestAvatarsIdle(false),
-      refreshInfoOp(0)
+      refreshInfoOp(0),
+      attributeKeys(Features()),
+      defaultCapsValid(false),
+      defaultCapsSpecific(false)
 {
 }
 
@@ -261,6 +648,8 @@ Features ContactManager::supportedFeatures() const
             }
         }
 
+        mPriv->attributeKeys = ContactAttributeKeys(mPriv->supportedFeatures);
+
         debug() << mPriv->supportedFeatures.size() << "contact features supported using" << this;
     }
 
@@ -1244,6 +1633,39 @@ PendingOperation *ContactManager::refreshContactInfo(const QList<ContactPtr> &co
     return mPriv->refreshInfoOp;
 }
 
+/**
+ * Return the file used to cache the attributes of the contact list contacts.
+ *
+ * \return The cache file name, or an empty string if the cache is disabled.
+ * \sa setAttributeCacheFileName()
+ */
+QString ContactManager::attributeCacheFileName() const
+{
+    return mPriv->attributeCacheFileName;
+}
+
+/**
+ * Set the file used to cache the attributes of the contact list contacts across connections.
+ *
+ * When a cache written by a connection with the same interfaces is found, the contact list
+ * contacts are built right away with their cached aliases, avatar tokens, capabilities, contact
+ * info, location, addresses and client types, and only their subscription states, groups and
+ * presences are retrieved with the roster. The cached attributes are then refreshed in the
+ * background, a few hundred contacts at a time and starting with the contacts missing from the
+ * cache, and only the ones which actually changed are signalled on the contacts.
+ *
+ * The cache is only used by connections implementing the ContactList interface, and the file
+ * name must be set before Connection::FeatureRoster is requested. Account does this
+ * automatically when Account::setContactAttributeCacheEnabled() is used.
+ *
+ * \param fileName The cache file name, or an empty string to disable the cache.
+ * \sa attributeCacheFileName()
+ */
+void ContactManager::setAttributeCacheFileName(const QString &fileName)
+{
+    mPriv->attributeCacheFileName = fileName;
+}
+
 void ContactManager::onAliasesChanged(const AliasPairList &aliases)
 {
     debug() << "Got AliasesChanged for" << aliases.size() << "contacts";
@@ -1578,12 +2000,12 @@ void ContactManager::ensureTracking(const Feature &feature)
     mPriv->tracking[feature] = true;
 }
 
-PendingOperation *ContactManager::introspectRoster()
+AsyncResult ContactManager::introspectRoster()
 {
     return mPriv->roster->introspect();
 }
 
-PendingOperation *ContactManager::introspectRosterGroups()
+AsyncResult ContactManager::introspectRosterGroups()
 {
     return mPriv->roster->introspectGroups();
 }
@@ -1593,6 +2015,70 @@ void ContactManager::resetRoster()
     mPriv->roster->reset();
 }
 
+const ContactAttributeKeys &ContactManager::contactAttributeKeys()
+{
+    // The table is built along with the supported features, see supportedFeatures()
+    if (mPriv->supportedFeatures.isEmpty()) {
+        supportedFeatures();
+    }
+    return mPriv->attributeKeys;
+}
+
+ContactCapabilities ContactManager::defaultContactCapabilities()
+{
+    if (supportedFeatures().contains(Contact::FeatureCapabilities)) {
+        if (!mPriv->defaultCapsValid || !mPriv->defaultCapsSpecific) {
+            mPriv->defaultCaps = ContactCapabilities(true);
+            mPriv->defaultCapsSpecs = RequestableChannelClassSpecList();
+            mPriv->defaultCapsSpecific = true;
+            mPriv->defaultCapsValid = true;
+        }
+        return mPriv->defaultCaps;
+    }
+
+    // Comparing is cheap while the connection keeps handing out the same shared list
+    RequestableChannelClassSpecList specs = connection()->capabilities().allClassSpecs();
+    if (!mPriv->defaultCapsValid || mPriv->defaultCapsSpecific ||
+            mPriv->defaultCapsSpecs != specs) {
+        mPriv->defaultCaps = ContactCapabilities(specs, false);
+        mPriv->defaultCapsSpecs = specs;
+        mPriv->defaultCapsSpecific = false;
+        mPriv->defaultCapsValid = true;
+    }
+    return mPriv->defaultCaps;
+}
+
+Presence ContactManager::internedPresence(const SimplePresence &presence)
+{
+    // Status messages are mostly unique, only presences without one are worth sharing
+    if (!presence.statusMessage.isEmpty()) {
+        return Presence((ConnectionPresenceType) presence.type, internedString(presence.status),
+                presence.statusMessage);
+    }
+
+    QPair<uint, QString> key(presence.type, presence.status);
+    QHash<QPair<uint, QString>, Presence>::const_iterator i = mPriv->presences.constFind(key);
+    if (i != mPriv->presences.constEnd()) {
+        return *i;
+    }
+
+    Presence ret((ConnectionPresenceType) presence.type, internedString(presence.status),
+            presence.statusMessage);
+    mPriv->presences.insert(key, ret);
+    return ret;
+}
+
+QString ContactManager::internedString(const QString &str)
+{
+    QSet<QString>::const_iterator i = mPriv->strings.constFind(str);
+    if (i != mPriv->strings.constEnd()) {
+        return *i;
+    }
+
+    mPriv->strings.insert(str);
+    return str;
+}
+
 /**
  * \fn void ContactManager::presencePublicationRequested(const Tp::Contacts &contacts)
  *
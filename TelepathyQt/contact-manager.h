@@ -43,7 +43,9 @@
 namespace Tp
 {
 
+class AsyncResult;
 class Connection;
+class ContactAttributeKeys;
 class PendingContacts;
 class PendingOperation;
 
@@ -129,6 +131,9 @@ public:
 
     PendingOperation *refreshContactInfo(const QList<ContactPtr> &contact);
 
+    QString attributeCacheFileName() const;
+    void setAttributeCacheFileName(const QString &fileName);
+
 Q_SIGNALS:
     void stateChanged(Tp::ContactListState state);
 
@@ -164,6 +169,7 @@ private:
     class Roster;
     friend class Channel;
     friend class Connection;
+    friend class Contact;
     friend class PendingContacts;
     friend class PendingRefreshContactInfo;
     friend class Roster;
@@ -181,12 +187,17 @@ private:
     TP_QT_NO_EXPORT static QString featureToInterface(const Feature &feature);
     TP_QT_NO_EXPORT void ensureTracking(const Feature &feature);
 
-    TP_QT_NO_EXPORT PendingOperation *introspectRoster();
-    TP_QT_NO_EXPORT PendingOperation *introspectRosterGroups();
+    TP_QT_NO_EXPORT AsyncResult introspectRoster();
+    TP_QT_NO_EXPORT AsyncResult introspectRosterGroups();
     TP_QT_NO_EXPORT void resetRoster();
 
     TP_QT_NO_EXPORT PendingOperation *refreshContactInfo(Contact *contact);
 
+    TP_QT_NO_EXPORT const ContactAttributeKeys &contactAttributeKeys();
+    TP_QT_NO_EXPORT ContactCapabilities defaultContactCapabilities();
+    TP_QT_NO_EXPORT Presence internedPresence(const SimplePresence &presence);
+    TP_QT_NO_EXPORT QString internedString(const QString &str);
+
     struct Private;
     friend struct Private;
     Private *mPriv;
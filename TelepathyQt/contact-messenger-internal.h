@@ -0,0 +1,89 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2026 TelepathyQt contributors
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_contact_messenger_internal_h_HEADER_GUARD_
+#define _TelepathyQt_contact_messenger_internal_h_HEADER_GUARD_
+
+#include <TelepathyQt/ContactMessenger>
+#include <TelepathyQt/SharedPtr>
+#include <TelepathyQt/Types>
+
+#include <QDBusConnection>
+#include <QDBusPendingCallWatcher>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+
+namespace Tp
+{
+
+namespace Client
+{
+class ChannelDispatcherInterfaceMessages1Interface;
+}
+
+class PendingSendMessage;
+
+class TP_QT_NO_EXPORT ContactMessenger::SendQueue : public QObject, public RefCounted
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(SendQueue)
+
+public:
+    static SharedPtr<SendQueue> lookup(const AccountPtr &account);
+    static SharedPtr<SendQueue> forAccount(const AccountPtr &account);
+    ~SendQueue();
+
+    void enqueue(PendingSendMessage *op, const QString &targetID,
+            const MessagePartList &parts, uint flags);
+    QList<PendingSendMessage *> pendingOperations() const;
+
+private Q_SLOTS:
+    void onMessageSent(QDBusPendingCallWatcher *watcher);
+
+private:
+    struct Request
+    {
+        PendingSendMessage *op;
+        QString targetID;
+        MessagePartList parts;
+        uint flags;
+    };
+
+    SendQueue(const QDBusConnection &bus, const QString &accountPath);
+
+    void dispatch();
+
+    QString mAccountPath;
+    Client::ChannelDispatcherInterfaceMessages1Interface *mCDMessagesInterface;
+
+    QHash<QString, QQueue<Request> > mQueues;
+    QQueue<QString> mReadyTargets;
+    QHash<QString, int> mInFlightPerTarget;
+    QHash<QDBusPendingCallWatcher *, Request> mInFlight;
+
+    static QHash<QString, WeakPtr<SendQueue> > sendQueues;
+};
+
+} // Tp
+
+#endif
@@ -21,8 +21,10 @@
  */
 
 #include <TelepathyQt/ContactMessenger>
+#include "TelepathyQt/contact-messenger-internal.h"
 
 #include "TelepathyQt/_gen/contact-messenger.moc.hpp"
+#include "TelepathyQt/_gen/contact-messenger-internal.moc.hpp"
 
 #include "TelepathyQt/debug-internal.h"
 
@@ -33,6 +35,7 @@
 #include <TelepathyQt/ClientRegistrar>
 #include <TelepathyQt/MessageContentPartList>
 #include <TelepathyQt/PendingSendMessage>
+#include <TelepathyQt/SimplePendingOperations>
 #include <TelepathyQt/SimpleTextObserver>
 #include <TelepathyQt/TextChannel>
 
@@ -44,8 +47,7 @@ struct TP_QT_NO_EXPORT ContactMessenger::Private
     Private(ContactMessenger *parent, const AccountPtr &account, const QString &contactIdentifier)
         : parent(parent),
           account(account),
-          contactIdentifier(contactIdentifier),
-          cdMessagesInterface(0)
+          contactIdentifier(contactIdentifier)
     {
     }
 
@@ -55,16 +57,14 @@ struct TP_QT_NO_EXPORT ContactMessenger::Private
     AccountPtr account;
     QString contactIdentifier;
     SimpleTextObserverPtr observer;
-    Tp::Client::ChannelDispatcherInterfaceMessages1Interface *cdMessagesInterface;
+    SharedPtr<SendQueue> sendQueue;
 };
 
 PendingSendMessage *ContactMessenger::Private::sendMessage(const Message &message,
         MessageSendingFlags flags)
 {
-    if (!cdMessagesInterface) {
-        cdMessagesInterface = new Tp::Client::ChannelDispatcherInterfaceMessages1Interface(
-                account->dbusConnection(),
-                TP_QT_CHANNEL_DISPATCHER_BUS_NAME, TP_QT_CHANNEL_DISPATCHER_OBJECT_PATH, parent);
+    if (!sendQueue) {
+        sendQueue = SendQueue::forAccount(account);
     }
 
     PendingSendMessage *op = new PendingSendMessage(ContactMessengerPtr(parent), message);
@@ -74,15 +74,158 @@ PendingSendMessage *ContactMessenger::Private::sendMessage(const Message &messag
         parts << static_cast<QMap<QString, QDBusVariant> >(part);
     }
 
-    connect(new QDBusPendingCallWatcher(
-                cdMessagesInterface->SendMessage(QDBusObjectPath(account->objectPath()),
-                    contactIdentifier, parts, (uint) flags)),
-            SIGNAL(finished(QDBusPendingCallWatcher*)),
-            op,
-            SLOT(onCDMessageSent(QDBusPendingCallWatcher*)));
+    sendQueue->enqueue(op, contactIdentifier, parts, (uint) flags);
     return op;
 }
 
+/*
+ * Messages sent through the messengers of an account share one queue, which keeps at most
+ * maxInFlight SendMessage calls pending on the channel dispatcher, and at most
+ * maxInFlightPerTarget of them for the same target. Targets with queued messages take turns for
+ * the free slots.
+ *
+ * Several messages to the same target can be pending at once as the calls are made on the same
+ * connection to the same service, which receives them in the order they were made, so they still
+ * reach the dispatcher in the order they were sent. The per-target window only keeps a busy
+ * conversation from using up the slots of the others.
+ */
+static const int maxInFlight = 16;
+static const int maxInFlightPerTarget = 4;
+
+QHash<QString, WeakPtr<ContactMessenger::SendQueue> > ContactMessenger::SendQueue::sendQueues;
+
+static QString sendQueueKey(const AccountPtr &account)
+{
+    return QString(QLatin1String("%1 %2"))
+        .arg(account->dbusConnection().name())
+        .arg(account->objectPath());
+}
+
+SharedPtr<ContactMessenger::SendQueue> ContactMessenger::SendQueue::lookup(
+        const AccountPtr &account)
+{
+    return SharedPtr<SendQueue>(sendQueues.value(sendQueueKey(account)));
+}
+
+SharedPtr<ContactMessenger::SendQueue> ContactMessenger::SendQueue::forAccount(
+        const AccountPtr &account)
+{
+    QString key = sendQueueKey(account);
+
+    SharedPtr<SendQueue> queue(sendQueues.value(key));
+    if (!queue) {
+        QHash<QString, WeakPtr<SendQueue> >::iterator i = sendQueues.begin();
+        while (i != sendQueues.end()) {
+            if (i.value().isNull()) {
+                i = sendQueues.erase(i);
+            } else {
+                ++i;
+            }
+        }
+
+        queue = SharedPtr<SendQueue>(new SendQueue(account->dbusConnection(),
+                    account->objectPath()));
+        sendQueues.insert(key, WeakPtr<SendQueue>(queue));
+    }
+    return queue;
+}
+
+ContactMessenger::SendQueue::SendQueue(const QDBusConnection &bus, const QString &accountPath)
+    : mAccountPath(accountPath),
+      mCDMessagesInterface(new Tp::Client::ChannelDispatcherInterfaceMessages1Interface(bus,
+                  TP_QT_CHANNEL_DISPATCHER_BUS_NAME, TP_QT_CHANNEL_DISPATCHER_OBJECT_PATH, this))
+{
+}
+
+ContactMessenger::SendQueue::~SendQueue()
+{
+}
+
+void ContactMessenger::SendQueue::enqueue(PendingSendMessage *op, const QString &targetID,
+        const MessagePartList &parts, uint flags)
+{
+    Request request;
+    request.op = op;
+    request.targetID = targetID;
+    request.parts = parts;
+    request.flags = flags;
+
+    // a target with queued messages is already waiting for its turn, unless it has a full window
+    QQueue<Request> &queue = mQueues[targetID];
+    if (queue.isEmpty() && mInFlightPerTarget.value(targetID) < maxInFlightPerTarget) {
+        mReadyTargets.enqueue(targetID);
+    }
+    queue.enqueue(request);
+
+    dispatch();
+}
+
+QList<PendingSendMessage *> ContactMessenger::SendQueue::pendingOperations() const
+{
+    QList<PendingSendMessage *> ops;
+    foreach (const Request &request, mInFlight) {
+        ops.append(request.op);
+    }
+    foreach (const QQueue<Request> &queue, mQueues) {
+        foreach (const Request &request, queue) {
+            ops.append(request.op);
+        }
+    }
+    return ops;
+}
+
+void ContactMessenger::SendQueue::dispatch()
+{
+    while (mInFlight.size() < maxInFlight && !mReadyTargets.isEmpty()) {
+        QString targetID = mReadyTargets.dequeue();
+
+        QHash<QString, QQueue<Request> >::iterator i = mQueues.find(targetID);
+        Q_ASSERT(i != mQueues.end());
+        Request request = i.value().dequeue();
+        int targetInFlight = ++mInFlightPerTarget[targetID];
+        if (i.value().isEmpty()) {
+            mQueues.erase(i);
+        } else if (targetInFlight < maxInFlightPerTarget) {
+            mReadyTargets.enqueue(targetID);
+        }
+
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                mCDMessagesInterface->SendMessage(QDBusObjectPath(mAccountPath),
+                    targetID, request.parts, request.flags));
+        connect(watcher,
+                SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(onMessageSent(QDBusPendingCallWatcher*)));
+        connect(watcher,
+                SIGNAL(finished(QDBusPendingCallWatcher*)),
+                request.op,
+                SLOT(onCDMessageSent(QDBusPendingCallWatcher*)));
+
+        // the parts are not needed anymore
+        request.parts.clear();
+        mInFlight.insert(watcher, request);
+    }
+}
+
+void ContactMessenger::SendQueue::onMessageSent(QDBusPendingCallWatcher *watcher)
+{
+    // PendingSendMessage::onCDMessageSent() takes care of deleting the watcher
+    Request request = mInFlight.take(watcher);
+
+    QHash<QString, int>::iterator i = mInFlightPerTarget.find(request.targetID);
+    Q_ASSERT(i != mInFlightPerTarget.end());
+    int targetInFlight = --i.value();
+    if (targetInFlight == 0) {
+        mInFlightPerTarget.erase(i);
+    }
+
+    // the target stopped waiting for its turn once its window was full
+    if (targetInFlight == maxInFlightPerTarget - 1 && mQueues.contains(request.targetID)) {
+        mReadyTargets.enqueue(request.targetID);
+    }
+
+    dispatch();
+}
+
 /**
  * \class ContactMessenger
  * \ingroup clientaccount
@@ -193,6 +336,10 @@ QList<TextChannelPtr> ContactMessenger::textChats() const
  * messageSent() can be signalled either before or after the returned PendingSendMessage object
  * finishes.
  *
+ * Messages sent to the same contact are handed to the channel dispatcher in the order this
+ * method is called. The number of messages being handed to the dispatcher at the same time is
+ * bounded for each account, and further messages are queued until earlier ones are done.
+ *
  * \param text The message text.
  * \param type The message type.
  * \param flags The message flags.
@@ -215,6 +362,10 @@ PendingSendMessage *ContactMessenger::sendMessage(const QString &text,
  * messageSent() can be signalled either before or after the returned PendingSendMessage object
  * finishes.
  *
+ * Messages sent to the same contact are handed to the channel dispatcher in the order this
+ * method is called. The number of messages being handed to the dispatcher at the same time is
+ * bounded for each account, and further messages are queued until earlier ones are done.
+ *
  * \param parts The message parts.
  * \param flags The message flags.
  * \return A PendingSendMessage which will emit PendingSendMessage::finished
@@ -228,6 +379,36 @@ PendingSendMessage *ContactMessenger::sendMessage(const MessageContentPartList &
     return mPriv->sendMessage(message, flags);
 }
 
+/**
+ * Return a PendingOperation which finishes once all messages sent so far through
+ * the messengers of \a account have been handed to the channel dispatcher.
+ *
+ * This is useful to find out when a batch of messages sent to several contacts has been
+ * sent. The operation fails with the first error if any of these messages failed.
+ *
+ * \param account The account the messages were sent with.
+ * \return A PendingOperation which will emit PendingOperation::finished
+ *         once all the messages have been sent.
+ */
+PendingOperation *ContactMessenger::waitForPendingMessages(const AccountPtr &account)
+{
+    QList<PendingSendMessage *> messages;
+    SharedPtr<SendQueue> queue = SendQueue::lookup(account);
+    if (queue) {
+        messages = queue->pendingOperations();
+    }
+
+    if (messages.isEmpty()) {
+        return new PendingSuccess(account);
+    }
+
+    QList<PendingOperation *> ops;
+    foreach (PendingSendMessage *message, messages) {
+        ops.append(message);
+    }
+    return new PendingComposite(ops, false, account);
+}
+
 /**
  * \fn void ContactMessenger::messageSent(const Tp::Message &message,
  *                  Tp::MessageSendingFlags flags, const QString &sentMessageToken,
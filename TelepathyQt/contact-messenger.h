@@ -34,6 +34,7 @@
 namespace Tp
 {
 
+class PendingOperation;
 class PendingSendMessage;
 class MessageContentPartList;
 
@@ -59,12 +60,16 @@ public:
     PendingSendMessage *sendMessage(const MessageContentPartList &parts,
             MessageSendingFlags flags = 0);
 
+    static PendingOperation *waitForPendingMessages(const AccountPtr &account);
+
 Q_SIGNALS:
     void messageSent(const Tp::Message &message, Tp::MessageSendingFlags flags,
             const QString &sentMessageToken, const Tp::TextChannelPtr &channel);
     void messageReceived(const Tp::ReceivedMessage &message, const Tp::TextChannelPtr &channel);
 
 private:
+    class SendQueue;
+
     TP_QT_NO_EXPORT ContactMessenger(const AccountPtr &account,
             const QString &contactIdentifier);
 
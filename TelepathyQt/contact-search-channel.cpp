@@ -34,6 +34,8 @@
 #include <TelepathyQt/PendingFailure>
 #include <TelepathyQt/Types>
 
+#include <QSharedPointer>
+
 namespace Tp
 {
 
@@ -51,6 +53,8 @@ struct TP_QT_NO_EXPORT ContactSearchChannel::Private
     void processSearchStateChangeQueue();
     void processSearchResultQueue();
 
+    void requestSearchResultContacts();
+
     struct SearchStateChangeInfo
     {
         SearchStateChangeInfo(uint state, const QString &errorName,
@@ -64,6 +68,19 @@ struct TP_QT_NO_EXPORT ContactSearchChannel::Private
         ContactSearchChannel::SearchStateChangeDetails details;
     };
 
+    struct SearchResultBatch
+    {
+        SearchResultBatch(const ContactSearchResultMap &result)
+            : result(result)
+        {
+        }
+
+        ContactSearchResultMap result;
+    };
+
+    bool isSearchResultBatchResolved(const SearchResultBatch &batch) const;
+    void releaseSearchResultBatch(const SearchResultBatch &batch);
+
     // Public object
     ContactSearchChannel *parent;
 
@@ -82,8 +99,22 @@ struct TP_QT_NO_EXPORT ContactSearchChannel::Private
 
     QQueue<void (Private::*)()> signalsQueue;
     QQueue<SearchStateChangeInfo> searchStateChangeQueue;
-    QQueue<ContactSearchResultMap> searchResultQueue;
+    QQueue<QSharedPointer<SearchResultBatch> > searchResultQueue;
     bool processingSignalsQueue;
+    bool waitingForSearchResult;
+
+    // Search result contacts, resolved ahead of the signals queue and only kept while a queued
+    // batch refers to them
+    QQueue<QSharedPointer<SearchResultBatch> > unrequestedSearchResultQueue;
+    QHash<QString, uint> queuedSearchResultIds;
+    QHash<QString, ContactPtr> searchResultContacts;
+    QSet<QString> pendingSearchResultIds;
+    QSet<QString> invalidSearchResultIds;
+    QSet<QString> failedSearchResultIds;
+    uint pendingSearchResultRequests;
+    uint maxPendingSearchResultRequests;
+
+    SearchResult searchResults;
 };
 
 ContactSearchChannel::Private::Private(ContactSearchChannel *parent,
@@ -95,7 +126,10 @@ ContactSearchChannel::Private::Private(ContactSearchChannel *parent,
       readinessHelper(parent->readinessHelper()),
       searchState(ChannelContactSearchStateNotStarted),
       limit(0),
-      processingSignalsQueue(false)
+      processingSignalsQueue(false),
+      waitingForSearchResult(false),
+      pendingSearchResultRequests(0),
+      maxPendingSearchResultRequests(4)
 {
     ReadinessHelper::Introspectables introspectables;
 
@@ -202,21 +236,109 @@ void ContactSearchChannel::Private::processSearchStateChangeQueue()
 
 void ContactSearchChannel::Private::processSearchResultQueue()
 {
-    const ContactSearchResultMap &result = searchResultQueue.first();
-    if (!result.isEmpty()) {
-        ContactManagerPtr manager = parent->connection()->contactManager();
-        PendingContacts *pendingContacts = manager->contactsForIdentifiers(
-                result.keys());
+    QSharedPointer<SearchResultBatch> batch = searchResultQueue.first();
+    if (!isSearchResultBatchResolved(*batch)) {
+        // gotSearchResultContacts() will call us again
+        waitingForSearchResult = true;
+        return;
+    }
+
+    searchResultQueue.dequeue();
+
+    SearchResult ret;
+    bool failed = false;
+    for (ContactSearchResultMap::const_iterator it = batch->result.constBegin();
+                                                it != batch->result.constEnd();
+                                                ++it) {
+        if (failedSearchResultIds.contains(it.key())) {
+            failed = true;
+            break;
+        }
+
+        ContactPtr contact = searchResultContacts.value(it.key());
+        if (contact) {
+            ret.insert(contact, Contact::InfoFields(it.value()));
+        }
+    }
+
+    releaseSearchResultBatch(*batch);
+
+    if (failed) {
+        warning() << "Getting search result contacts failed. Ignoring search result";
+    } else {
+        // QHash::unite() would keep both entries for contacts found again
+        for (SearchResult::const_iterator it = ret.constBegin(); it != ret.constEnd(); ++it) {
+            searchResults.insert(it.key(), it.value());
+        }
+        emit parent->searchResultReceived(ret);
+    }
+
+    processingSignalsQueue = false;
+    processSignalsQueue();
+}
+
+void ContactSearchChannel::Private::requestSearchResultContacts()
+{
+    ContactManagerPtr manager = parent->connection()->contactManager();
+
+    while (!unrequestedSearchResultQueue.isEmpty() &&
+           (maxPendingSearchResultRequests == 0 ||
+            pendingSearchResultRequests < maxPendingSearchResultRequests)) {
+        QSharedPointer<SearchResultBatch> batch = unrequestedSearchResultQueue.dequeue();
+
+        // identifiers resolved or pending for other queued batches are not requested again,
+        // but the ones which failed to resolve are retried
+        QStringList identifiers;
+        foreach (const QString &identifier, batch->result.keys()) {
+            if (!searchResultContacts.contains(identifier) &&
+                !pendingSearchResultIds.contains(identifier) &&
+                !invalidSearchResultIds.contains(identifier)) {
+                failedSearchResultIds.remove(identifier);
+                identifiers.append(identifier);
+                pendingSearchResultIds.insert(identifier);
+            }
+        }
+
+        if (identifiers.isEmpty()) {
+            continue;
+        }
+
+        ++pendingSearchResultRequests;
+        PendingContacts *pendingContacts = manager->contactsForIdentifiers(identifiers);
         parent->connect(pendingContacts,
                 SIGNAL(finished(Tp::PendingOperation*)),
                 SLOT(gotSearchResultContacts(Tp::PendingOperation*)));
-    } else {
-        searchResultQueue.dequeue();
+    }
+}
 
-        emit parent->searchResultReceived(SearchResult());
+bool ContactSearchChannel::Private::isSearchResultBatchResolved(
+        const SearchResultBatch &batch) const
+{
+    for (ContactSearchResultMap::const_iterator it = batch.result.constBegin();
+                                                it != batch.result.constEnd();
+                                                ++it) {
+        if (!searchResultContacts.contains(it.key()) &&
+            !invalidSearchResultIds.contains(it.key()) &&
+            !failedSearchResultIds.contains(it.key())) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        processingSignalsQueue = false;
-        processSignalsQueue();
+void ContactSearchChannel::Private::releaseSearchResultBatch(const SearchResultBatch &batch)
+{
+    // forget about the identifiers no other queued batch refers to, so that the bookkeeping
+    // doesn't grow with the size of the whole search
+    foreach (const QString &identifier, batch.result.keys()) {
+        QHash<QString, uint>::iterator it = queuedSearchResultIds.find(identifier);
+        Q_ASSERT(it != queuedSearchResultIds.end());
+        if (--it.value() == 0) {
+            queuedSearchResultIds.erase(it);
+            searchResultContacts.remove(identifier);
+            invalidSearchResultIds.remove(identifier);
+            failedSearchResultIds.remove(identifier);
+        }
     }
 }
 
@@ -448,6 +570,49 @@ QString ContactSearchChannel::server() const
     return mPriv->server;
 }
 
+/**
+ * Return all the results received so far for the search started by search().
+ *
+ * This is updated just before each searchResultReceived() emission, and as such contains
+ * the union of all the results emitted until then.
+ *
+ * \return The accumulated search results.
+ * \sa searchResultReceived()
+ */
+ContactSearchChannel::SearchResult ContactSearchChannel::searchResults() const
+{
+    return mPriv->searchResults;
+}
+
+/**
+ * Return the maximum number of contact requests that can be in flight at the same time to
+ * resolve the contacts of search results, where 0 represents no limit.
+ *
+ * The contacts of each result batch are requested as soon as the batch is received, up to
+ * this limit, while searchResultReceived() is still emitted in the order the batches were
+ * received. The default is 4.
+ *
+ * \return The maximum number of concurrent contact requests, or 0 if there is no limit.
+ * \sa setMaxPendingResultRequests()
+ */
+uint ContactSearchChannel::maxPendingResultRequests() const
+{
+    return mPriv->maxPendingSearchResultRequests;
+}
+
+/**
+ * Set the maximum number of contact requests that can be in flight at the same time to
+ * resolve the contacts of search results, where 0 represents no limit.
+ *
+ * \param max The maximum number of concurrent contact requests.
+ * \sa maxPendingResultRequests()
+ */
+void ContactSearchChannel::setMaxPendingResultRequests(uint max)
+{
+    mPriv->maxPendingSearchResultRequests = max;
+    mPriv->requestSearchResultContacts();
+}
+
 /**
  * Send a request to start a search for contacts on this connection.
  *
@@ -612,7 +777,15 @@ void ContactSearchChannel::onSearchStateChanged(uint state, const QString &error
 
 void ContactSearchChannel::onSearchResultReceived(const ContactSearchResultMap &result)
 {
-    mPriv->searchResultQueue.enqueue(result);
+    // start resolving contacts right away, the queue only orders the emission
+    QSharedPointer<Private::SearchResultBatch> batch(new Private::SearchResultBatch(result));
+    mPriv->searchResultQueue.enqueue(batch);
+    mPriv->unrequestedSearchResultQueue.enqueue(batch);
+    foreach (const QString &identifier, result.keys()) {
+        ++mPriv->queuedSearchResultIds[identifier];
+    }
+    mPriv->requestSearchResultContacts();
+
     mPriv->signalsQueue.enqueue(&Private::processSearchResultQueue);
     mPriv->processSignalsQueue();
 }
@@ -621,31 +794,41 @@ void ContactSearchChannel::gotSearchResultContacts(PendingOperation *op)
 {
     PendingContacts *pc = qobject_cast<PendingContacts *>(op);
 
-    const ContactSearchResultMap &result = mPriv->searchResultQueue.dequeue();
+    Q_ASSERT(mPriv->pendingSearchResultRequests > 0);
+    --mPriv->pendingSearchResultRequests;
+
+    const QStringList identifiers = pc->identifiers();
+    foreach (const QString &identifier, identifiers) {
+        mPriv->pendingSearchResultIds.remove(identifier);
+    }
 
     if (!pc->isValid()) {
         warning().nospace() << "Getting search result contacts "
             "failed with " << pc->errorName() << ":" <<
-            pc->errorMessage() << ". Ignoring search result";
-        mPriv->processingSignalsQueue = false;
-        mPriv->processSignalsQueue();
-        return;
-    }
+            pc->errorMessage();
+        mPriv->failedSearchResultIds.unite(identifiers.toSet());
+    } else {
+        const QStringList validIdentifiers = pc->validIdentifiers();
+        const QList<ContactPtr> contacts = pc->contacts();
+        Q_ASSERT(validIdentifiers.count() == contacts.count());
 
-    const QList<ContactPtr> &contacts = pc->contacts();
-    Q_ASSERT(result.count() == contacts.count());
+        for (int i = 0; i < validIdentifiers.count() && i < contacts.count(); ++i) {
+            mPriv->searchResultContacts.insert(validIdentifiers.at(i), contacts.at(i));
+        }
 
-    SearchResult ret;
-    uint i = 0;
-    for (ContactSearchResultMap::const_iterator it = result.constBegin();
-                                                it != result.constEnd();
-                                                ++it, ++i) {
-        ret.insert(contacts.at(i), Contact::InfoFields(it.value()));
+        foreach (const QString &identifier, identifiers) {
+            if (!mPriv->searchResultContacts.contains(identifier)) {
+                mPriv->invalidSearchResultIds.insert(identifier);
+            }
+        }
     }
-    emit searchResultReceived(ret);
 
-    mPriv->processingSignalsQueue = false;
-    mPriv->processSignalsQueue();
+    mPriv->requestSearchResultContacts();
+
+    if (mPriv->waitingForSearchResult) {
+        mPriv->waitingForSearchResult = false;
+        mPriv->processSearchResultQueue();
+    }
 }
 
 /**
@@ -80,6 +80,11 @@ public:
     QStringList availableSearchKeys() const;
     QString server() const;
 
+    SearchResult searchResults() const;
+
+    uint maxPendingResultRequests() const;
+    void setMaxPendingResultRequests(uint max);
+
     PendingOperation *search(const QString &searchKey, const QString &searchTerm);
     PendingOperation *search(const ContactSearchMap &searchTerms);
     void continueSearch();
@@ -24,6 +24,7 @@
 
 #include "TelepathyQt/_gen/contact.moc.hpp"
 
+#include "TelepathyQt/contact-manager-internal.h"
 #include "TelepathyQt/debug-internal.h"
 #include "TelepathyQt/future-internal.h"
 
@@ -43,23 +44,67 @@
 namespace Tp
 {
 
+namespace
+{
+
+template <typename T>
+inline T attributeValue(const QVariant *value)
+{
+    return value ? qdbus_cast<T>(*value) : T();
+}
+
+}
+
 struct TP_QT_NO_EXPORT Contact::Private
 {
+    // Data only present for some features, allocated when first set so that contacts in large
+    // rosters only pay for what they use
+    struct ExtendedInfo
+    {
+        ExtendedInfo()
+            : isContactInfoKnown(false)
+        {
+        }
+
+        QMap<QString, QString> vcardAddresses;
+        QStringList uris;
+        LocationInfo location;
+
+        bool isContactInfoKnown;
+        InfoFields info;
+
+        AvatarData avatarData;
+
+        QStringList clientTypes;
+    };
+
     Private(Contact *parent, ContactManager *manager,
         const ReferencedHandles &handle)
         : parent(parent),
           manager(ContactManagerPtr(manager)),
           handle(handle),
-          caps(manager->supportedFeatures().contains(Contact::FeatureCapabilities) ?
-                   ContactCapabilities(true) :  ContactCapabilities(
-                           manager->connection()->capabilities().allClassSpecs(), false)),
-          isContactInfoKnown(false), isAvatarTokenKnown(false),
+          caps(manager->defaultContactCapabilities()),
+          extendedInfo(0),
+          isAvatarTokenKnown(false),
           subscriptionState(SubscriptionStateUnknown),
           publishState(SubscriptionStateUnknown),
           blocked(false)
     {
     }
 
+    ~Private()
+    {
+        delete extendedInfo;
+    }
+
+    ExtendedInfo *extended()
+    {
+        if (!extendedInfo) {
+            extendedInfo = new ExtendedInfo;
+        }
+        return extendedInfo;
+    }
+
     void updateAvatarData();
 
     Contact *parent;
@@ -72,18 +117,13 @@ struct TP_QT_NO_EXPORT Contact::Private
     Features actualFeatures;
 
     QString alias;
-    QMap<QString, QString> vcardAddresses;
-    QStringList uris;
     Presence presence;
     ContactCapabilities caps;
-    LocationInfo location;
 
-    bool isContactInfoKnown;
-    InfoFields info;
+    ExtendedInfo *extendedInfo;
 
     bool isAvatarTokenKnown;
     QString avatarToken;
-    AvatarData avatarData;
 
     SubscriptionState subscriptionState;
     SubscriptionState publishState;
@@ -91,8 +131,6 @@ struct TP_QT_NO_EXPORT Contact::Private
     bool blocked;
 
     QSet<QString> groups;
-
-    QStringList clientTypes;
 };
 
 void Contact::Private::updateAvatarData()
@@ -108,8 +146,10 @@ void Contact::Private::updateAvatarData()
     /* If token is empty (""), it means the contact has no avatar. */
     if (avatarToken.isEmpty()) {
         debug() << "Contact" << parent->id() << "has no avatar";
-        avatarData = AvatarData();
-        emit parent->avatarDataChanged(avatarData);
+        if (extendedInfo) {
+            extendedInfo->avatarData = AvatarData();
+        }
+        emit parent->avatarDataChanged(AvatarData());
         return;
     }
 
@@ -321,9 +361,11 @@ Contact::Contact(ContactManager *manager, const ReferencedHandles &handle,
     : Object(),
       mPriv(new Private(this, manager, handle))
 {
-    mPriv->requestedFeatures.unite(requestedFeatures);
-    mPriv->id = qdbus_cast<QString>(attributes[
-            TP_QT_IFACE_CONNECTION + QLatin1String("/contact-id")]);
+    // Share the feature set with the other contacts built with the same features
+    mPriv->requestedFeatures = requestedFeatures;
+
+    static const QString contactIdKey = TP_QT_IFACE_CONNECTION + QLatin1String("/contact-id");
+    mPriv->id = qdbus_cast<QString>(attributes.value(contactIdKey));
 }
 
 /**
@@ -415,7 +457,11 @@ QString Contact::alias() const
  */
 QMap<QString, QString> Contact::vcardAddresses() const
 {
-    return mPriv->vcardAddresses;
+    if (!mPriv->extendedInfo) {
+        return QMap<QString, QString>();
+    }
+
+    return mPriv->extendedInfo->vcardAddresses;
 }
 
 /**
@@ -428,7 +474,11 @@ QMap<QString, QString> Contact::vcardAddresses() const
  */
 QStringList Contact::uris() const
 {
-    return mPriv->uris;
+    if (!mPriv->extendedInfo) {
+        return QStringList();
+    }
+
+    return mPriv->extendedInfo->uris;
 }
 
 /**
@@ -491,9 +541,11 @@ AvatarData Contact::avatarData() const
         warning() << "Contact::avatarData() used on" << this
             << "for which FeatureAvatarData hasn't been requested - returning \"\"";
         return AvatarData();
+    } else if (!mPriv->extendedInfo) {
+        return AvatarData();
     }
 
-    return mPriv->avatarData;
+    return mPriv->extendedInfo->avatarData;
 }
 
 /**
@@ -586,9 +638,11 @@ LocationInfo Contact::location() const
         warning() << "Contact::location() used on" << this
             << "for which FeatureLocation hasn't been requested - returning 0";
         return LocationInfo();
+    } else if (!mPriv->extendedInfo) {
+        return LocationInfo();
     }
 
-    return mPriv->location;
+    return mPriv->extendedInfo->location;
 }
 
 /**
@@ -609,9 +663,11 @@ bool Contact::isContactInfoKnown() const
         warning() << "Contact::isContactInfoKnown() used on" << this
             << "for which FeatureInfo hasn't been requested - returning false";
         return false;
+    } else if (!mPriv->extendedInfo) {
+        return false;
     }
 
-    return mPriv->isContactInfoKnown;
+    return mPriv->extendedInfo->isContactInfoKnown;
 }
 
 /**
@@ -633,9 +689,11 @@ Contact::InfoFields Contact::infoFields() const
             << "for which FeatureInfo hasn't been requested - returning empty "
                "InfoFields";
         return InfoFields();
+    } else if (!mPriv->extendedInfo) {
+        return InfoFields();
     }
 
-    return mPriv->info;
+    return mPriv->extendedInfo->info;
 }
 
 /**
@@ -951,9 +1009,11 @@ QStringList Contact::clientTypes() const
         warning() << "Contact::clientTypes() used on" << this
             << "for which FeatureClientTypes hasn't been requested - returning an empty list";
         return QStringList();
+    } else if (!mPriv->extendedInfo) {
+        return QStringList();
     }
 
-    return mPriv->clientTypes;
+    return mPriv->extendedInfo->clientTypes;
 }
 
 /**
@@ -987,24 +1047,28 @@ PendingStringList *Contact::requestClientTypes()
 
 void Contact::augment(const Features &requestedFeatures, const QVariantMap &attributes)
 {
-    mPriv->requestedFeatures.unite(requestedFeatures);
+    // Keep sharing the feature set with the other contacts unless new features were requested
+    if (!mPriv->requestedFeatures.contains(requestedFeatures)) {
+        mPriv->requestedFeatures.unite(requestedFeatures);
+    }
+
+    // Find all the attributes we know about in one pass, using the keys precomputed by the
+    // manager
+    const QVariant *values[ContactAttributeKeys::NumKeys];
+    manager()->contactAttributeKeys().lookup(attributes, values);
 
-    mPriv->id = qdbus_cast<QString>(attributes[
-            TP_QT_IFACE_CONNECTION + QLatin1String("/contact-id")]);
+    mPriv->id = attributeValue<QString>(values[ContactAttributeKeys::KeyContactId]);
 
-    if (attributes.contains(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST +
-                QLatin1String("/subscribe"))) {
-        uint subscriptionState = qdbus_cast<uint>(attributes.value(
-                     TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST + QLatin1String("/subscribe")));
+    if (values[ContactAttributeKeys::KeySubscribe]) {
+        uint subscriptionState = attributeValue<uint>(
+                values[ContactAttributeKeys::KeySubscribe]);
         setSubscriptionState((SubscriptionState) subscriptionState);
     }
 
-    if (attributes.contains(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST +
-                QLatin1String("/publish"))) {
-        uint publishState = qdbus_cast<uint>(attributes.value(
-                    TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST + QLatin1String("/publish")));
-        QString publishRequest = qdbus_cast<QString>(attributes.value(
-                    TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST + QLatin1String("/publish-request")));
+    if (values[ContactAttributeKeys::KeyPublish]) {
+        uint publishState = attributeValue<uint>(values[ContactAttributeKeys::KeyPublish]);
+        QString publishRequest = attributeValue<QString>(
+                values[ContactAttributeKeys::KeyPublishRequest]);
         setPublishState((SubscriptionState) publishState, publishRequest);
     }
 
@@ -1016,8 +1080,7 @@ void Contact::augment(const Features &requestedFeatures, const QVariantMap &attr
         ContactInfoFieldList maybeInfo;
 
         if (feature == FeatureAlias) {
-            maybeAlias = qdbus_cast<QString>(attributes.value(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_ALIASING + QLatin1String("/alias")));
+            maybeAlias = attributeValue<QString>(values[ContactAttributeKeys::KeyAlias]);
 
             if (!maybeAlias.isEmpty()) {
                 receiveAlias(maybeAlias);
@@ -1030,10 +1093,9 @@ void Contact::augment(const Features &requestedFeatures, const QVariantMap &attr
                 mPriv->updateAvatarData();
             }
         } else if (feature == FeatureAvatarToken) {
-            if (attributes.contains(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_AVATARS + QLatin1String("/token"))) {
-                receiveAvatarToken(qdbus_cast<QString>(attributes.value(
-                                TP_QT_IFACE_CONNECTION_INTERFACE_AVATARS + QLatin1String("/token"))));
+            if (values[ContactAttributeKeys::KeyAvatarToken]) {
+                receiveAvatarToken(attributeValue<QString>(
+                            values[ContactAttributeKeys::KeyAvatarToken]));
             } else {
                 if (manager()->supportedFeatures().contains(FeatureAvatarToken)) {
                     // AvatarToken being supported but not included in the mapping indicates
@@ -1045,8 +1107,8 @@ void Contact::augment(const Features &requestedFeatures, const QVariantMap &attr
                 mPriv->avatarToken = QLatin1String("");
             }
         } else if (feature == FeatureCapabilities) {
-            maybeCaps = qdbus_cast<RequestableChannelClassList>(attributes.value(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_CAPABILITIES + QLatin1String("/capabilities")));
+            maybeCaps = attributeValue<RequestableChannelClassList>(
+                    values[ContactAttributeKeys::KeyCapabilities]);
 
             if (!maybeCaps.isEmpty()) {
                 receiveCapabilities(maybeCaps);
@@ -1060,8 +1122,8 @@ void Contact::augment(const Features &requestedFeatures, const QVariantMap &attr
                 }
             }
         } else if (feature == FeatureInfo) {
-            maybeInfo = qdbus_cast<ContactInfoFieldList>(attributes.value(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_INFO + QLatin1String("/info")));
+            maybeInfo = attributeValue<ContactInfoFieldList>(
+                    values[ContactAttributeKeys::KeyInfo]);
 
             if (!maybeInfo.isEmpty()) {
                 receiveInfo(maybeInfo);
@@ -1075,8 +1137,8 @@ void Contact::augment(const Features &requestedFeatures, const QVariantMap &attr
                 }
             }
         } else if (feature == FeatureLocation) {
-            maybeLocation = qdbus_cast<QVariantMap>(attributes.value(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_LOCATION + QLatin1String("/location")));
+            maybeLocation = attributeValue<QVariantMap>(
+                    values[ContactAttributeKeys::KeyLocation]);
 
             if (!maybeLocation.isEmpty()) {
                 receiveLocation(maybeLocation);
@@ -1090,28 +1152,34 @@ void Contact::augment(const Features &requestedFeatures, const QVariantMap &attr
                 }
             }
         } else if (feature == FeatureSimplePresence) {
-            maybePresence = qdbus_cast<SimplePresence>(attributes.value(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE + QLatin1String("/presence")));
+            maybePresence = attributeValue<SimplePresence>(
+                    values[ContactAttributeKeys::KeyPresence]);
 
             if (!maybePresence.status.isEmpty()) {
                 receiveSimplePresence(maybePresence);
             } else {
-                mPriv->presence.setStatus(ConnectionPresenceTypeUnknown,
-                        QLatin1String("unknown"), QLatin1String(""));
+                SimplePresence unknownPresence;
+                unknownPresence.type = ConnectionPresenceTypeUnknown;
+                unknownPresence.status = QLatin1String("unknown");
+                unknownPresence.statusMessage = QLatin1String("");
+                mPriv->presence = manager()->internedPresence(unknownPresence);
             }
         } else if (feature == FeatureRosterGroups) {
-            QStringList groups = qdbus_cast<QStringList>(attributes.value(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_GROUPS + QLatin1String("/groups")));
-            mPriv->groups = groups.toSet();
+            QStringList groups = attributeValue<QStringList>(
+                    values[ContactAttributeKeys::KeyGroups]);
+            ContactManagerPtr contactManager = manager();
+            mPriv->groups.clear();
+            foreach (const QString &group, groups) {
+                mPriv->groups.insert(contactManager->internedString(group));
+            }
         } else if (feature == FeatureAddresses) {
-            VCardFieldAddressMap addresses = qdbus_cast<VCardFieldAddressMap>(attributes.value(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING + QLatin1String("/addresses")));
-            QStringList uris = qdbus_cast<QStringList>(attributes.value(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING + QLatin1String("/uris")));
+            VCardFieldAddressMap addresses = attributeValue<VCardFieldAddressMap>(
+                    values[ContactAttributeKeys::KeyAddresses]);
+            QStringList uris = attributeValue<QStringList>(values[ContactAttributeKeys::KeyUris]);
             receiveAddresses(addresses, uris);
         } else if (feature == FeatureClientTypes) {
-            QStringList maybeClientTypes = qdbus_cast<QStringList>(attributes.value(
-                        TP_QT_IFACE_CONNECTION_INTERFACE_CLIENT_TYPES + QLatin1String("/client-types")));
+            QStringList maybeClientTypes = attributeValue<QStringList>(
+                    values[ContactAttributeKeys::KeyClientTypes]);
 
             if (!maybeClientTypes.isEmpty()) {
                 receiveClientTypes(maybeClientTypes);
@@ -1170,9 +1238,14 @@ void Contact::setAvatarToken(const QString &token)
 
 void Contact::receiveAvatarData(const AvatarData &avatar)
 {
-    if (mPriv->avatarData.fileName != avatar.fileName) {
-        mPriv->avatarData = avatar;
-        emit avatarDataChanged(mPriv->avatarData);
+    if (!mPriv->extendedInfo && avatar.fileName.isNull()) {
+        return;
+    }
+
+    Private::ExtendedInfo *extended = mPriv->extended();
+    if (extended->avatarData.fileName != avatar.fileName) {
+        extended->avatarData = avatar;
+        emit avatarDataChanged(extended->avatarData);
     }
 }
 
@@ -1186,7 +1259,7 @@ void Contact::receiveSimplePresence(const SimplePresence &presence)
 
     if (mPriv->presence.status() != presence.status ||
         mPriv->presence.statusMessage() != presence.statusMessage) {
-        mPriv->presence.setStatus(presence);
+        mPriv->presence = manager()->internedPresence(presence);
         emit presenceChanged(mPriv->presence);
     }
 }
@@ -1213,9 +1286,14 @@ void Contact::receiveLocation(const QVariantMap &location)
 
     mPriv->actualFeatures.insert(FeatureLocation);
 
-    if (mPriv->location.allDetails() != location) {
-        mPriv->location.updateData(location);
-        emit locationUpdated(mPriv->location);
+    if (!mPriv->extendedInfo && location.isEmpty()) {
+        return;
+    }
+
+    Private::ExtendedInfo *extended = mPriv->extended();
+    if (extended->location.allDetails() != location) {
+        extended->location.updateData(location);
+        emit locationUpdated(extended->location);
     }
 }
 
@@ -1226,11 +1304,13 @@ void Contact::receiveInfo(const ContactInfoFieldList &info)
     }
 
     mPriv->actualFeatures.insert(FeatureInfo);
-    mPriv->isContactInfoKnown = true;
 
-    if (mPriv->info.allFields() != info) {
-        mPriv->info = InfoFields(info);
-        emit infoFieldsChanged(mPriv->info);
+    Private::ExtendedInfo *extended = mPriv->extended();
+    extended->isContactInfoKnown = true;
+
+    if (extended->info.allFields() != info) {
+        extended->info = InfoFields(info);
+        emit infoFieldsChanged(extended->info);
     }
 }
 
@@ -1242,8 +1322,14 @@ void Contact::receiveAddresses(const QMap<QString, QString> &addresses,
     }
 
     mPriv->actualFeatures.insert(FeatureAddresses);
-    mPriv->vcardAddresses = addresses;
-    mPriv->uris = uris;
+
+    if (!mPriv->extendedInfo && addresses.isEmpty() && uris.isEmpty()) {
+        return;
+    }
+
+    Private::ExtendedInfo *extended = mPriv->extended();
+    extended->vcardAddresses = addresses;
+    extended->uris = uris;
 }
 
 void Contact::receiveClientTypes(const QStringList &clientTypes)
@@ -1254,9 +1340,11 @@ void Contact::receiveClientTypes(const QStringList &clientTypes)
 
     mPriv->actualFeatures.insert(FeatureClientTypes);
 
-    if (mPriv->clientTypes != clientTypes) {
-        mPriv->clientTypes = clientTypes;
-        emit clientTypesChanged(mPriv->clientTypes);
+    QStringList currentClientTypes =
+        mPriv->extendedInfo ? mPriv->extendedInfo->clientTypes : QStringList();
+    if (currentClientTypes != clientTypes) {
+        mPriv->extended()->clientTypes = clientTypes;
+        emit clientTypesChanged(clientTypes);
     }
 }
 
@@ -1309,7 +1397,7 @@ void Contact::setBlocked(bool value)
 void Contact::setAddedToGroup(const QString &group)
 {
     if (!mPriv->groups.contains(group)) {
-        mPriv->groups.insert(group);
+        mPriv->groups.insert(manager()->internedString(group));
         emit addedToGroup(group);
     }
 }
@@ -0,0 +1,96 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2026 TelepathyQt contributors
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_dbus_metrics_internal_h_HEADER_GUARD_
+#define _TelepathyQt_dbus_metrics_internal_h_HEADER_GUARD_
+
+#include <TelepathyQt/Global>
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QObject>
+#include <QString>
+#include <QTime>
+
+namespace Tp
+{
+
+class TP_QT_NO_EXPORT DBusMetricsCallWatcher : public QDBusPendingCallWatcher
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(DBusMetricsCallWatcher)
+
+public:
+    DBusMetricsCallWatcher(const QDBusPendingCall &call, const QString &interfaceName,
+            const QString &memberName, QObject *parent = 0);
+    ~DBusMetricsCallWatcher();
+
+private Q_SLOTS:
+    void onCallFinished();
+
+private:
+    QString mInterfaceName;
+    QString mMemberName;
+    QTime mTime;
+};
+
+class TP_QT_NO_EXPORT DBusMetricsSignalWatcher : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(DBusMetricsSignalWatcher)
+
+public:
+    DBusMetricsSignalWatcher(const QDBusConnection &bus, const QString &service,
+            const QString &path, const QString &interfaceName, QObject *parent);
+    ~DBusMetricsSignalWatcher();
+
+private Q_SLOTS:
+    void onSignal(const QDBusMessage &message);
+
+private:
+    QDBusConnection mBus;
+    QString mService;
+    QString mPath;
+    QString mInterfaceName;
+};
+
+class TP_QT_NO_EXPORT DBusMetricsSignalCounter : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(DBusMetricsSignalCounter)
+
+public:
+    DBusMetricsSignalCounter(const QString &interfaceName, const QString &memberName,
+            QObject *parent);
+    ~DBusMetricsSignalCounter();
+
+private Q_SLOTS:
+    void onSignalEmitted();
+
+private:
+    QString mInterfaceName;
+    QString mMemberName;
+};
+
+} // Tp
+
+#endif
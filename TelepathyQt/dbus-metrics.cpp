@@ -0,0 +1,507 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2026 TelepathyQt contributors
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <TelepathyQt/DBusMetrics>
+#include "TelepathyQt/dbus-metrics-internal.h"
+
+#include "TelepathyQt/_gen/dbus-metrics-internal.moc.hpp"
+
+#include "TelepathyQt/debug-internal.h"
+
+#include <QAtomicInt>
+#include <QDBusPendingCall>
+#include <QHash>
+#include <QMetaMethod>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedData>
+
+namespace Tp
+{
+
+namespace
+{
+
+// Upper bounds, in milliseconds, of the latency histogram buckets. Anything slower than the last
+// one goes to an extra overflow bucket.
+const uint latencyBuckets[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+const int numLatencyBuckets = sizeof(latencyBuckets) / sizeof(latencyBuckets[0]);
+
+// Set from any thread, and checked by every call going through the proxies and adaptors
+QAtomicInt metricsEnabled(0);
+
+inline bool isMetricsEnabled()
+{
+    // A plain load is enough for a flag which doesn't guard any other data
+#if QT_VERSION >= 0x050000
+    return metricsEnabled.load() != 0;
+#else
+    return metricsEnabled != 0;
+#endif
+}
+
+QMutex metricsLock;
+QHash<QString, DBusMetrics::Entry> metricsEntries;
+
+inline QString metricsKey(DBusMetrics::Kind kind, const QString &interfaceName,
+        const QString &memberName)
+{
+    return QString::number(kind) + QLatin1Char(':') + interfaceName + QLatin1Char('.') +
+        memberName;
+}
+
+}
+
+struct TP_QT_NO_EXPORT DBusMetrics::Entry::Private : public QSharedData
+{
+    Private(Kind kind, const QString &interfaceName, const QString &memberName)
+        : kind(kind),
+          interfaceName(interfaceName),
+          memberName(memberName),
+          count(0),
+          errorCount(0),
+          totalLatency(0)
+    {
+        for (int i = 0; i <= numLatencyBuckets; ++i) {
+            histogram.append(0);
+        }
+    }
+
+    Kind kind;
+    QString interfaceName;
+    QString memberName;
+    uint count;
+    uint errorCount;
+    quint64 totalLatency;
+    QList<uint> histogram;
+};
+
+/**
+ * \class DBusMetrics
+ * \ingroup utils
+ * \headerfile TelepathyQt/dbus-metrics.h <TelepathyQt/DBusMetrics>
+ *
+ * \brief The DBusMetrics class collects counters and latency histograms for the D-Bus traffic
+ * going through the library.
+ *
+ * When enabled with setEnabled(), method calls made through the client-side interface proxies,
+ * the signals they receive, and the method calls and signals handled by the service-side
+ * adaptors are counted per interface and member. Method calls additionally get their latency
+ * recorded in a histogram, whose bucket limits are given by latencyBucketLimits().
+ *
+ * For client-side calls the latency is the time between sending the call and receiving its
+ * reply, while for service-side calls it is the time taken to dispatch the call to the
+ * implementation. Calls whose reply is sent asynchronously by the implementation are only
+ * accounted for up to that point.
+ *
+ * Collection is disabled by default, in which case its overhead is a single check of a flag.
+ * Note that the signals received by the client-side proxies and the signals emitted by the
+ * service-side adaptors are only counted for the proxies and adaptors created while collection is
+ * enabled. Services which want their signals accounted for should thus enable collection before
+ * registering their objects on the bus.
+ *
+ * Services built on BaseConnection can also expose the collected metrics on the bus, by plugging
+ * a BaseConnectionDBusMetricsInterface into the connection.
+ */
+
+/**
+ * \enum DBusMetrics::Kind
+ *
+ * The kind of D-Bus traffic an entry accounts for.
+ *
+ * \var DBusMetrics::OutgoingCall Method calls made by client-side proxies.
+ * \var DBusMetrics::IncomingCall Method calls handled by service-side adaptors.
+ * \var DBusMetrics::OutgoingSignal Signals emitted by service-side adaptors.
+ * \var DBusMetrics::IncomingSignal Signals received by client-side proxies.
+ */
+
+/**
+ * Return whether metrics are currently being collected.
+ *
+ * \return \c true if metrics are being collected, \c false otherwise.
+ * \sa setEnabled()
+ */
+bool DBusMetrics::isEnabled()
+{
+    return isMetricsEnabled();
+}
+
+/**
+ * Set whether metrics should be collected.
+ *
+ * Disabling the collection keeps the metrics collected so far, use reset() to clear them.
+ *
+ * \param enabled Whether metrics should be collected.
+ * \sa isEnabled()
+ */
+void DBusMetrics::setEnabled(bool enabled)
+{
+    metricsEnabled.fetchAndStoreOrdered(enabled ? 1 : 0);
+}
+
+/**
+ * Return the metrics collected so far, one entry per kind, interface and member.
+ *
+ * \return A list of DBusMetrics::Entry objects.
+ */
+QList<DBusMetrics::Entry> DBusMetrics::entries()
+{
+    QMutexLocker locker(&metricsLock);
+    return metricsEntries.values();
+}
+
+/**
+ * Clear all the metrics collected so far.
+ */
+void DBusMetrics::reset()
+{
+    QMutexLocker locker(&metricsLock);
+    metricsEntries.clear();
+}
+
+/**
+ * Return the upper bounds, in milliseconds, of the latency histogram buckets.
+ *
+ * The histograms returned by Entry::latencyHistogram() have one more bucket than the number of
+ * limits returned here, for the calls slower than the last limit.
+ *
+ * \return The bucket limits in milliseconds, in increasing order.
+ */
+QList<uint> DBusMetrics::latencyBucketLimits()
+{
+    QList<uint> limits;
+    for (int i = 0; i < numLatencyBuckets; ++i) {
+        limits.append(latencyBuckets[i]);
+    }
+    return limits;
+}
+
+void DBusMetrics::recordCall(Kind kind, const QString &interfaceName, const QString &memberName,
+        uint latency, bool error)
+{
+    int bucket = 0;
+    while (bucket < numLatencyBuckets && latency > latencyBuckets[bucket]) {
+        ++bucket;
+    }
+
+    QMutexLocker locker(&metricsLock);
+    Entry &entry = metricsEntries[metricsKey(kind, interfaceName, memberName)];
+    if (!entry.isValid()) {
+        entry.mPriv = new Entry::Private(kind, interfaceName, memberName);
+    }
+    ++entry.mPriv->count;
+    if (error) {
+        ++entry.mPriv->errorCount;
+    }
+    entry.mPriv->totalLatency += latency;
+    ++entry.mPriv->histogram[bucket];
+}
+
+void DBusMetrics::recordSignal(Kind kind, const QString &interfaceName, const QString &memberName)
+{
+    QMutexLocker locker(&metricsLock);
+    Entry &entry = metricsEntries[metricsKey(kind, interfaceName, memberName)];
+    if (!entry.isValid()) {
+        entry.mPriv = new Entry::Private(kind, interfaceName, memberName);
+    }
+    ++entry.mPriv->count;
+}
+
+// Connects to the signals of a freshly created adaptor, which would cost every adaptor a connection
+// per signal if done unconditionally. So this does nothing while collection is disabled, and the
+// signals of the adaptors created at that point are never counted, even once it is enabled.
+void DBusMetrics::trackAdaptorSignals(QObject *adaptor)
+{
+    if (!isMetricsEnabled()) {
+        return;
+    }
+
+    const QMetaObject *mo = adaptor->metaObject();
+    int classInfoIndex = mo->indexOfClassInfo("D-Bus Interface");
+    if (classInfoIndex < 0) {
+        return;
+    }
+    QString interfaceName = QLatin1String(mo->classInfo(classInfoIndex).value());
+
+    for (int i = mo->methodOffset(); i < mo->methodCount(); ++i) {
+        QMetaMethod method = mo->method(i);
+        if (method.methodType() != QMetaMethod::Signal) {
+            continue;
+        }
+
+#if QT_VERSION >= 0x050000
+        QByteArray signature = method.methodSignature();
+#else
+        QByteArray signature = method.signature();
+#endif
+        QString memberName = QLatin1String(signature.left(signature.indexOf('(')));
+
+        DBusMetricsSignalCounter *counter = new DBusMetricsSignalCounter(interfaceName,
+                memberName, adaptor);
+        QByteArray signal = QByteArray::number(QSIGNAL_CODE) + signature;
+        QObject::connect(adaptor, signal.constData(), counter, SLOT(onSignalEmitted()));
+    }
+}
+
+/**
+ * \class DBusMetrics::Entry
+ * \ingroup utils
+ * \headerfile TelepathyQt/dbus-metrics.h <TelepathyQt/DBusMetrics>
+ *
+ * \brief The DBusMetrics::Entry class holds the metrics collected for a given D-Bus member.
+ */
+
+DBusMetrics::Entry::Entry()
+{
+}
+
+DBusMetrics::Entry::Entry(const Entry &other)
+    : mPriv(other.mPriv)
+{
+}
+
+DBusMetrics::Entry::~Entry()
+{
+}
+
+DBusMetrics::Entry &DBusMetrics::Entry::operator=(const Entry &other)
+{
+    this->mPriv = other.mPriv;
+    return *this;
+}
+
+/**
+ * Return the kind of traffic this entry accounts for.
+ *
+ * \return The kind as DBusMetrics::Kind.
+ */
+DBusMetrics::Kind DBusMetrics::Entry::kind() const
+{
+    if (!isValid()) {
+        return OutgoingCall;
+    }
+
+    return mPriv->kind;
+}
+
+/**
+ * Return the name of the D-Bus interface of the member this entry accounts for.
+ *
+ * \return The interface name.
+ */
+QString DBusMetrics::Entry::interfaceName() const
+{
+    if (!isValid()) {
+        return QString();
+    }
+
+    return mPriv->interfaceName;
+}
+
+/**
+ * Return the name of the D-Bus method or signal this entry accounts for.
+ *
+ * \return The member name.
+ */
+QString DBusMetrics::Entry::memberName() const
+{
+    if (!isValid()) {
+        return QString();
+    }
+
+    return mPriv->memberName;
+}
+
+/**
+ * Return the number of method calls or signals accounted for.
+ *
+ * \return The count.
+ */
+uint DBusMetrics::Entry::count() const
+{
+    if (!isValid()) {
+        return 0;
+    }
+
+    return mPriv->count;
+}
+
+/**
+ * Return the number of method calls which failed.
+ *
+ * This is always 0 for signals.
+ *
+ * \return The error count.
+ */
+uint DBusMetrics::Entry::errorCount() const
+{
+    if (!isValid()) {
+        return 0;
+    }
+
+    return mPriv->errorCount;
+}
+
+/**
+ * Return the sum of the latencies of all the method calls accounted for, in milliseconds.
+ *
+ * This is always 0 for signals.
+ *
+ * \return The total latency in milliseconds.
+ */
+quint64 DBusMetrics::Entry::totalLatency() const
+{
+    if (!isValid()) {
+        return 0;
+    }
+
+    return mPriv->totalLatency;
+}
+
+/**
+ * Return the number of method calls in each latency bucket.
+ *
+ * The bucket at index \a i counts the calls which took at most
+ * DBusMetrics::latencyBucketLimits()[i] milliseconds and more than the previous limit, and the
+ * last bucket the calls slower than all the limits.
+ *
+ * \return The histogram, or an empty list if this entry is not valid.
+ */
+QList<uint> DBusMetrics::Entry::latencyHistogram() const
+{
+    if (!isValid()) {
+        return QList<uint>();
+    }
+
+    return mPriv->histogram;
+}
+
+struct TP_QT_NO_EXPORT DBusMetrics::CallScope::Private
+{
+    Private(const QLatin1String &interfaceName, const QLatin1String &memberName)
+        : interfaceName(interfaceName),
+          memberName(memberName),
+          error(false)
+    {
+        time.start();
+    }
+
+    QLatin1String interfaceName;
+    QLatin1String memberName;
+    QTime time;
+    bool error;
+};
+
+DBusMetrics::CallScope::CallScope(const QLatin1String &interfaceName,
+        const QLatin1String &memberName)
+    : mPriv(isMetricsEnabled() ? new Private(interfaceName, memberName) : 0)
+{
+}
+
+DBusMetrics::CallScope::~CallScope()
+{
+    if (mPriv) {
+        recordCall(IncomingCall, mPriv->interfaceName, mPriv->memberName, mPriv->time.elapsed(),
+                mPriv->error);
+        delete mPriv;
+    }
+}
+
+void DBusMetrics::CallScope::setError()
+{
+    if (mPriv) {
+        mPriv->error = true;
+    }
+}
+
+DBusMetricsCallWatcher::DBusMetricsCallWatcher(const QDBusPendingCall &call,
+        const QString &interfaceName, const QString &memberName, QObject *parent)
+    : QDBusPendingCallWatcher(call, parent),
+      mInterfaceName(interfaceName),
+      mMemberName(memberName)
+{
+    mTime.start();
+    connect(this, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(onCallFinished()));
+}
+
+DBusMetricsCallWatcher::~DBusMetricsCallWatcher()
+{
+}
+
+void DBusMetricsCallWatcher::onCallFinished()
+{
+    if (DBusMetrics::isEnabled()) {
+        DBusMetrics::recordCall(DBusMetrics::OutgoingCall, mInterfaceName, mMemberName,
+                mTime.elapsed(), isError());
+    }
+    deleteLater();
+}
+
+DBusMetricsSignalWatcher::DBusMetricsSignalWatcher(const QDBusConnection &bus,
+        const QString &service, const QString &path, const QString &interfaceName,
+        QObject *parent)
+    : QObject(parent),
+      mBus(bus),
+      mService(service),
+      mPath(path),
+      mInterfaceName(interfaceName)
+{
+    // An empty member name matches all the signals of the interface
+    if (!mBus.connect(mService, mPath, mInterfaceName, QString(),
+                this, SLOT(onSignal(QDBusMessage)))) {
+        warning() << "Unable to watch the signals of" << mInterfaceName << "on" << mPath;
+    }
+}
+
+DBusMetricsSignalWatcher::~DBusMetricsSignalWatcher()
+{
+    mBus.disconnect(mService, mPath, mInterfaceName, QString(),
+            this, SLOT(onSignal(QDBusMessage)));
+}
+
+void DBusMetricsSignalWatcher::onSignal(const QDBusMessage &message)
+{
+    if (DBusMetrics::isEnabled()) {
+        DBusMetrics::recordSignal(DBusMetrics::IncomingSignal, mInterfaceName, message.member());
+    }
+}
+
+DBusMetricsSignalCounter::DBusMetricsSignalCounter(const QString &interfaceName,
+        const QString &memberName, QObject *parent)
+    : QObject(parent),
+      mInterfaceName(interfaceName),
+      mMemberName(memberName)
+{
+}
+
+DBusMetricsSignalCounter::~DBusMetricsSignalCounter()
+{
+}
+
+void DBusMetricsSignalCounter::onSignalEmitted()
+{
+    if (DBusMetrics::isEnabled()) {
+        DBusMetrics::recordSignal(DBusMetrics::OutgoingSignal, mInterfaceName, mMemberName);
+    }
+}
+
+} // Tp
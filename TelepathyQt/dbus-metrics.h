@@ -0,0 +1,115 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2026 TelepathyQt contributors
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_dbus_metrics_h_HEADER_GUARD_
+#define _TelepathyQt_dbus_metrics_h_HEADER_GUARD_
+
+#ifndef IN_TP_QT_HEADER
+#error IN_TP_QT_HEADER
+#endif
+
+#include <TelepathyQt/Global>
+
+#include <QList>
+#include <QSharedDataPointer>
+#include <QString>
+
+class QObject;
+
+namespace Tp
+{
+
+class TP_QT_EXPORT DBusMetrics
+{
+public:
+    enum Kind {
+        OutgoingCall = 0,
+        IncomingCall = 1,
+        OutgoingSignal = 2,
+        IncomingSignal = 3
+    };
+
+    class TP_QT_EXPORT Entry
+    {
+    public:
+        Entry();
+        Entry(const Entry &other);
+        ~Entry();
+
+        bool isValid() const { return mPriv.constData() != 0; }
+
+        Entry &operator=(const Entry &other);
+
+        Kind kind() const;
+        QString interfaceName() const;
+        QString memberName() const;
+
+        uint count() const;
+        uint errorCount() const;
+        quint64 totalLatency() const;
+        QList<uint> latencyHistogram() const;
+
+    private:
+        friend class DBusMetrics;
+
+        struct Private;
+        friend struct Private;
+        QSharedDataPointer<Private> mPriv;
+    };
+
+    static bool isEnabled();
+    static void setEnabled(bool enabled);
+
+    static QList<Entry> entries();
+    static void reset();
+
+    static QList<uint> latencyBucketLimits();
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+    // Used by the generated client proxies and service adaptors
+    class TP_QT_EXPORT CallScope
+    {
+    public:
+        CallScope(const QLatin1String &interfaceName, const QLatin1String &memberName);
+        ~CallScope();
+
+        void setError();
+
+    private:
+        Q_DISABLE_COPY(CallScope)
+
+        struct Private;
+        Private *mPriv;
+    };
+
+    static void recordCall(Kind kind, const QString &interfaceName, const QString &memberName,
+            uint latency, bool error);
+    static void recordSignal(Kind kind, const QString &interfaceName, const QString &memberName);
+    static void trackAdaptorSignals(QObject *adaptor);
+#endif
+
+private:
+    DBusMetrics();
+};
+
+} // Tp
+
+#endif
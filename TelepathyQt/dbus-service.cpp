@@ -207,13 +207,23 @@ struct AbstractDBusServiceInterface::Private
     Private(const QString &interfaceName)
         : interfaceName(interfaceName),
           dbusObject(0),
-          registered(false)
+          registered(false),
+          batchDepth(0),
+          flushScheduled(false),
+          signalsSent(0),
+          changesCoalesced(0)
     {
     }
 
     QString interfaceName;
     DBusObject *dbusObject;
     bool registered;
+
+    QVariantMap pendingChangedProperties;
+    uint batchDepth;
+    bool flushScheduled;
+    uint signalsSent;
+    uint changesCoalesced;
 };
 
 /**
@@ -225,6 +235,16 @@ struct AbstractDBusServiceInterface::Private
  *
  * This class serves as a base for all the classes that are used to implement
  * interfaces that sit on top of D-Bus services.
+ *
+ * Property changes notified with notifyPropertyChanged() are not sent immediately, but
+ * accumulated and sent as a single org.freedesktop.DBus.Properties.PropertiesChanged signal
+ * when control returns to the event loop. Implementations changing several properties at once
+ * may also wrap the changes between beginPropertyChangeBatch() and endPropertyChangeBatch() to
+ * have them sent as soon as the batch ends.
+ *
+ * As a consequence, a property changed while handling a D-Bus method call is announced after the
+ * method reply has been sent, unless the change is made within a batch which ends before the
+ * method returns, as BaseChannelRoomConfigInterface::updateConfiguration() does.
  */
 
 /**
@@ -284,12 +304,17 @@ bool AbstractDBusServiceInterface::isRegistered() const
 }
 
 /**
- * Emit PropertiesChanged signal on object org.freedesktop.DBus.Properties interface
- * with the property \a propertyName.
+ * Notify that the property \a propertyName of this interface has changed.
+ *
+ * The change is queued and sent as part of a single PropertiesChanged signal on the
+ * org.freedesktop.DBus.Properties interface, together with the other properties changed before
+ * control returns to the event loop or before the current batch ends.
+ * If the same property changes more than once, only its latest value is sent.
  *
  * \param propertyName The name of the changed property.
  * \param propertyValue The actual value of the changed property.
  * \return \c false if the signal can not be emmited or \a true otherwise.
+ * \sa beginPropertyChangeBatch(), flushPropertyChanges()
  */
 bool AbstractDBusServiceInterface::notifyPropertyChanged(const QString &propertyName, const QVariant &propertyValue)
 {
@@ -297,19 +322,120 @@ bool AbstractDBusServiceInterface::notifyPropertyChanged(const QString &property
         return false;
     }
 
+    if (!mPriv->pendingChangedProperties.isEmpty()) {
+        ++mPriv->changesCoalesced;
+    }
+    mPriv->pendingChangedProperties.insert(propertyName, propertyValue);
+
+    if (mPriv->batchDepth == 0 && !mPriv->flushScheduled) {
+        mPriv->flushScheduled = true;
+        QMetaObject::invokeMethod(this, "onFlushPropertyChangesScheduled", Qt::QueuedConnection);
+    }
+
+    return true;
+}
+
+/**
+ * Start a batch of property changes.
+ *
+ * The properties changed with notifyPropertyChanged() until the matching call to
+ * endPropertyChangeBatch() are sent as a single PropertiesChanged signal when the batch ends.
+ * Batches may be nested, in which case the signal is sent when the outermost batch ends.
+ *
+ * \sa endPropertyChangeBatch()
+ */
+void AbstractDBusServiceInterface::beginPropertyChangeBatch()
+{
+    ++mPriv->batchDepth;
+}
+
+/**
+ * End a batch of property changes started with beginPropertyChangeBatch().
+ *
+ * If this ends the outermost batch, the properties changed during the batch are sent
+ * immediately.
+ *
+ * \return \c false if the signal can not be emmited or \a true otherwise.
+ * \sa beginPropertyChangeBatch()
+ */
+bool AbstractDBusServiceInterface::endPropertyChangeBatch()
+{
+    if (mPriv->batchDepth == 0) {
+        warning() << "AbstractDBusServiceInterface::endPropertyChangeBatch() called without "
+            "matching beginPropertyChangeBatch() on" << interfaceName();
+        return false;
+    }
+
+    if (--mPriv->batchDepth > 0) {
+        return true;
+    }
+
+    return flushPropertyChanges();
+}
+
+/**
+ * Send the property changes notified with notifyPropertyChanged() which have not been sent yet
+ * as a single PropertiesChanged signal.
+ *
+ * \return \c false if the signal can not be emmited or \a true otherwise.
+ */
+bool AbstractDBusServiceInterface::flushPropertyChanges()
+{
+    if (mPriv->pendingChangedProperties.isEmpty()) {
+        return true;
+    }
+
+    if (!isRegistered()) {
+        mPriv->pendingChangedProperties.clear();
+        return false;
+    }
+
     QDBusMessage signal = QDBusMessage::createSignal(dbusObject()->objectPath(),
                                                      TP_QT_IFACE_PROPERTIES,
                                                      QLatin1String("PropertiesChanged"));
-    QVariantMap changedProperties;
-    changedProperties.insert(propertyName, propertyValue);
-
     signal << interfaceName();
-    signal << changedProperties;
+    signal << mPriv->pendingChangedProperties;
     signal << QStringList();
 
+    mPriv->pendingChangedProperties.clear();
+    ++mPriv->signalsSent;
+
     return dbusObject()->dbusConnection().send(signal);
 }
 
+/**
+ * Return the number of PropertiesChanged signals sent by this interface.
+ *
+ * \return The number of signals sent.
+ * \sa propertyChangesCoalesced()
+ */
+uint AbstractDBusServiceInterface::propertiesChangedSignalsSent() const
+{
+    return mPriv->signalsSent;
+}
+
+/**
+ * Return the number of property changes which have been merged into a PropertiesChanged
+ * signal that was already pending, instead of being sent as a signal of their own.
+ *
+ * \return The number of coalesced property changes.
+ * \sa propertiesChangedSignalsSent()
+ */
+uint AbstractDBusServiceInterface::propertyChangesCoalesced() const
+{
+    return mPriv->changesCoalesced;
+}
+
+void AbstractDBusServiceInterface::onFlushPropertyChangesScheduled()
+{
+    mPriv->flushScheduled = false;
+    if (mPriv->batchDepth > 0) {
+        return;
+    }
+
+    flushPropertyChanges();
+}
+
 /**
  * Registers this interface by plugging its adaptor
  * on the given \a dbusObject.
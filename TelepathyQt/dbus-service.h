@@ -93,6 +93,16 @@ protected:
 public:
     bool notifyPropertyChanged(const QString &propertyName, const QVariant &propertyValue);
 
+    void beginPropertyChangeBatch();
+    bool endPropertyChangeBatch();
+    bool flushPropertyChanges();
+
+    uint propertiesChangedSignalsSent() const;
+    uint propertyChangesCoalesced() const;
+
+private Q_SLOTS:
+    TP_QT_NO_EXPORT void onFlushPropertyChangesScheduled();
+
 private:
     struct Private;
     friend struct Private;
@@ -29,23 +29,65 @@
 #include <QtCore/QByteArray>
 #include <QtCore/QFile>
 #include <QtCore/QHash>
+#include <QtCore/QSharedData>
 #include <QtCore/QString>
 #include <QtCore/QStringList>
 
+#include <climits>
+#include <cstring>
+
 namespace Tp
 {
 
 struct TP_QT_NO_EXPORT KeyFile::Private
 {
+    // The file contents, memory-mapped when possible, shared between copies.
+    //
+    // The mapping is kept for as long as the KeyFile uses it: the files read are installed
+    // data files, which get replaced by renaming rather than rewritten in place, and KeyFile
+    // objects only live while a manager file is being parsed.
+    struct Contents : public QSharedData
+    {
+        Contents() : file(0), data(0), size(0) {}
+        ~Contents() { delete file; }
+
+        QFile *file;
+        QByteArray buffer;
+        const char *data;
+        int size;
+    };
+
+    // A value is kept as offsets into the contents. Values with escape sequences are unescaped
+    // on first use and cached, the others are cheap enough to convert on every read.
+    struct Entry
+    {
+        Entry() : from(0), to(0), escaped(false), cached(false), valid(false) {}
+        Entry(int from, int to, bool escaped)
+            : from(from), to(to), escaped(escaped), cached(false), valid(false) {}
+
+        int from;
+        int to;
+        bool escaped;
+        mutable bool cached;
+        mutable bool valid;
+        mutable QString unescaped;
+    };
+
+    typedef QHash<QString, Entry> Group;
+
     Private();
     Private(const QString &fName);
 
     void setFileName(const QString &fName);
     void setError(KeyFile::Status status, const QString &reason);
     bool read();
+    bool parse();
 
     bool validateKey(const QByteArray &data, int from, int to, QString &result);
 
+    const Entry *entry(const QString &key) const;
+    QByteArray entryBytes(const Entry *e) const;
+
     QStringList allGroups() const;
     QStringList allKeys() const;
     QStringList keys() const;
@@ -56,10 +98,16 @@ struct TP_QT_NO_EXPORT KeyFile::Private
 
     QString fileName;
     KeyFile::Status status;
-    QHash<QString, QHash<QString, QByteArray> > groups;
+    QExplicitlySharedDataPointer<Contents> contents;
+    QHash<QString, Group> groups;
     QString currentGroup;
 };
 
+static inline bool isSpace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r';
+}
+
 KeyFile::Private::Private()
     : status(KeyFile::None)
 {
@@ -78,6 +126,7 @@ void KeyFile::Private::setFileName(const QString &fName)
     status = KeyFile::NoError;
     currentGroup = QString();
     groups.clear();
+    contents.reset();
     read();
 }
 
@@ -87,40 +136,84 @@ void KeyFile::Private::setError(KeyFile::Status st, const QString &reason)
                          .arg(fileName).arg(reason);
     status = st;
     groups.clear();
+    contents.reset();
 }
 
 bool KeyFile::Private::read()
 {
-    QFile file(fileName);
-    if (!file.exists()) {
+    QFile *file = new QFile(fileName);
+    if (!file->exists()) {
+        delete file;
         setError(KeyFile::NotFoundError,
                  QLatin1String("file does not exist"));
         return false;
     }
 
-    if (!file.open(QFile::ReadOnly)) {
+    if (!file->open(QFile::ReadOnly)) {
+        delete file;
         setError(KeyFile::AccessError,
                  QLatin1String("cannot open file for readonly access"));
         return false;
     }
 
-    QByteArray data;
-    QByteArray group;
+    contents = new Contents;
+
+    // the mapping stays valid for as long as the file is open; fall back to
+    // reading the file for empty files and file systems that cannot be mapped
+    uchar *mapped = 0;
+    if (file->size() > 0 && file->size() <= INT_MAX) {
+        mapped = file->map(0, file->size());
+    }
+
+    if (mapped) {
+        contents->file = file;
+        contents->data = reinterpret_cast<const char *>(mapped);
+        contents->size = (int) file->size();
+    } else {
+        contents->buffer = file->readAll();
+        contents->data = contents->buffer.constData();
+        contents->size = contents->buffer.size();
+        delete file;
+    }
+
+    return parse();
+}
+
+bool KeyFile::Private::parse()
+{
+    const char *data = contents->data;
+    const int size = contents->size;
+
     QString currentGroup;
-    QHash<QString, QByteArray> groupMap;
-    QByteArray rawValue;
+    Group groupMap;
     int line = 0;
-    int idx;
-    while (!file.atEnd()) {
-        data = file.readLine().trimmed();
+    int lineStart = 0;
+    while (lineStart < size) {
+        const char *newline = static_cast<const char *>(
+                memchr(data + lineStart, '\n', size - lineStart));
+        int lineEnd = newline ? (int) (newline - data) : size;
+        int nextLineStart = lineEnd + 1;
         line++;
 
-        if (data.size() == 0) {
+        // trim the line in place
+        int from = lineStart;
+        int to = lineEnd;
+        while (from < to && isSpace(data[from])) {
+            ++from;
+        }
+        while (to > from && isSpace(data[to - 1])) {
+            --to;
+        }
+        lineStart = nextLineStart;
+
+        if (from == to) {
             // skip empty lines
             continue;
         }
 
-        char ch = data.at(0);
+        QByteArray lineData = QByteArray::fromRawData(data + from, to - from);
+
+        char ch = lineData.at(0);
         if (ch == '#') {
             // skip comments
             continue;
@@ -131,7 +224,7 @@ bool KeyFile::Private::read()
                 groupMap.clear();
             }
 
-            idx = data.indexOf(']');
+            int idx = lineData.indexOf(']');
             if (idx == -1) {
                 // line starts with [ and it's not a group
                 setError(KeyFile::FormatError,
@@ -140,24 +233,32 @@ bool KeyFile::Private::read()
                 return false;
             }
 
-            group = data.mid(1, idx - 1).trimmed();
-            if (groups.contains(QLatin1String(group))) {
-                setError(KeyFile::FormatError,
-                         QString(QLatin1String("duplicated group '%1' at line %2"))
-                                 .arg(QLatin1String(group)).arg(line));
-                return false;
+            int groupFrom = 1;
+            int groupTo = idx;
+            while (groupFrom < groupTo && isSpace(lineData.at(groupFrom))) {
+                ++groupFrom;
+            }
+            while (groupTo > groupFrom && isSpace(lineData.at(groupTo - 1))) {
+                --groupTo;
             }
 
             currentGroup = QLatin1String("");
-            if (!unescapeString(group, 0, group.size(), currentGroup)) {
+            if (!unescapeString(lineData, groupFrom, groupTo, currentGroup)) {
                 setError(KeyFile::FormatError,
                          QString(QLatin1String("invalid group '%1' at line %2"))
                                  .arg(currentGroup).arg(line));
                 return false;
             }
+
+            if (groups.contains(currentGroup)) {
+                setError(KeyFile::FormatError,
+                         QString(QLatin1String("duplicated group '%1' at line %2"))
+                                 .arg(currentGroup).arg(line));
+                return false;
+            }
         }
         else {
-            idx = data.indexOf('=');
+            int idx = lineData.indexOf('=');
             if (idx == -1) {
                 setError(KeyFile::FormatError,
                          QString(QLatin1String("format error at line %1 - missing '='"))
@@ -166,14 +267,14 @@ bool KeyFile::Private::read()
             }
 
             // remove trailing spaces
-            char ch;
             int idxKeyEnd = idx;
-            while ((ch = data.at(idxKeyEnd - 1)) == ' ' || ch == '\t') {
+            while (idxKeyEnd > 0 &&
+                   ((ch = lineData.at(idxKeyEnd - 1)) == ' ' || ch == '\t')) {
                 --idxKeyEnd;
             }
 
             QString key;
-            if (!validateKey(data, 0, idxKeyEnd, key)) {
+            if (!validateKey(lineData, 0, idxKeyEnd, key)) {
                 setError(KeyFile::FormatError,
                          QString(QLatin1String("invalid key '%1' at line %2"))
                                  .arg(key).arg(line));
@@ -187,9 +288,12 @@ bool KeyFile::Private::read()
                 return false;
             }
 
-            data = data.mid(idx + 1).trimmed();
-            rawValue = data.mid(0, data.size());
-            groupMap[key] = rawValue;
+            int valueFrom = from + idx + 1;
+            while (valueFrom < to && isSpace(data[valueFrom])) {
+                ++valueFrom;
+            }
+            bool escaped = memchr(data + valueFrom, '\\', to - valueFrom) != 0;
+            groupMap.insert(key, Entry(valueFrom, to, escaped));
         }
     }
 
@@ -224,6 +328,26 @@ bool KeyFile::Private::validateKey(const QByteArray &data, int from, int to, QSt
     return ret;
 }
 
+const KeyFile::Private::Entry *KeyFile::Private::entry(const QString &key) const
+{
+    QHash<QString, Group>::const_iterator itrGroup = groups.constFind(currentGroup);
+    if (itrGroup == groups.constEnd()) {
+        return 0;
+    }
+
+    Group::const_iterator itrEntry = itrGroup.value().constFind(key);
+    if (itrEntry == itrGroup.value().constEnd()) {
+        return 0;
+    }
+
+    return &itrEntry.value();
+}
+
+QByteArray KeyFile::Private::entryBytes(const Entry *e) const
+{
+    return QByteArray::fromRawData(contents->data + e->from, e->to - e->from);
+}
+
 QStringList KeyFile::Private::allGroups() const
 {
     return groups.keys();
@@ -232,7 +356,7 @@ QStringList KeyFile::Private::allGroups() const
 QStringList KeyFile::Private::allKeys() const
 {
     QStringList keys;
-    QHash<QString, QHash<QString, QByteArray> >::const_iterator itrGroups = groups.begin();
+    QHash<QString, Group>::const_iterator itrGroups = groups.begin();
     while (itrGroups != groups.end()) {
         keys << itrGroups.value().keys();
         ++itrGroups;
@@ -242,40 +366,55 @@ QStringList KeyFile::Private::allKeys() const
 
 QStringList KeyFile::Private::keys() const
 {
-    QHash<QString, QByteArray> groupMap = groups[currentGroup];
-    return groupMap.keys();
+    return groups.value(currentGroup).keys();
 }
 
 bool KeyFile::Private::contains(const QString &key) const
 {
-    QHash<QString, QByteArray> groupMap = groups[currentGroup];
-    return groupMap.contains(key);
+    return entry(key) != 0;
 }
 
 QString KeyFile::Private::rawValue(const QString &key) const
 {
-    QHash<QString, QByteArray> groupMap = groups[currentGroup];
-    QByteArray rawValue = groupMap.value(key);
-    return QLatin1String(rawValue);
+    const Entry *e = entry(key);
+    if (!e) {
+        return QString();
+    }
+    return QString::fromLatin1(contents->data + e->from, e->to - e->from);
 }
 
 QString KeyFile::Private::value(const QString &key) const
 {
-    QHash<QString, QByteArray> groupMap = groups[currentGroup];
-    QString result;
-    QByteArray rawValue = groupMap.value(key);
-    if (unescapeString(rawValue, 0, rawValue.size(), result)) {
+    const Entry *e = entry(key);
+    if (!e) {
+        return QString();
+    }
+
+    if (!e->escaped) {
+        QString result;
+        unescapeString(entryBytes(e), 0, e->to - e->from, result);
         return result;
     }
-    return QString();
+
+    if (!e->cached) {
+        e->valid = unescapeString(entryBytes(e), 0, e->to - e->from, e->unescaped);
+        if (!e->valid) {
+            e->unescaped = QString();
+        }
+        e->cached = true;
+    }
+    return e->unescaped;
 }
 
 QStringList KeyFile::Private::valueAsStringList(const QString &key) const
 {
-    QHash<QString, QByteArray> groupMap = groups[currentGroup];
+    const Entry *e = entry(key);
+    if (!e) {
+        return QStringList();
+    }
+
     QStringList result;
-    QByteArray rawValue = groupMap.value(key);
-    if (unescapeStringList(rawValue, 0, rawValue.size(), result)) {
+    if (unescapeStringList(entryBytes(e), 0, e->to - e->from, result)) {
         return result;
     }
     return QStringList();
@@ -322,6 +461,7 @@ KeyFile::KeyFile(const KeyFile &other)
 {
     mPriv->fileName = other.mPriv->fileName;
     mPriv->status = other.mPriv->status;
+    mPriv->contents = other.mPriv->contents;
     mPriv->groups = other.mPriv->groups;
     mPriv->currentGroup = other.mPriv->currentGroup;
 }
@@ -338,6 +478,7 @@ KeyFile &KeyFile::operator=(const KeyFile &other)
 {
     mPriv->fileName = other.mPriv->fileName;
     mPriv->status = other.mPriv->status;
+    mPriv->contents = other.mPriv->contents;
     mPriv->groups = other.mPriv->groups;
     mPriv->currentGroup = other.mPriv->currentGroup;
     return *this;
@@ -82,11 +82,10 @@ struct TP_QT_NO_EXPORT Message::Private : public QSharedData
     Private(const MessagePartList &parts);
     ~Private();
 
-    uint senderHandle() const;
-    QString senderId() const;
-    uint pendingId() const;
     void clearSenderHandle();
 
+    void indexParts();
+
     MessagePartList parts;
 
     // if the Text interface says "non-text" we still only have the text,
@@ -96,6 +95,25 @@ struct TP_QT_NO_EXPORT Message::Private : public QSharedData
     // for received messages only
     WeakPtr<TextChannel> textChannel;
     ContactPtr sender;
+
+    // The typed header fields and the body text, extracted by indexParts() once the parts are
+    // complete, and then read by the accessors. They are filled in before the data is shared and
+    // only change along with the parts, so reading them is as thread-safe as reading the parts.
+    uint sent;
+    uint received;
+    uint messageType;
+    uint pendingId;
+    uint senderHandle;
+    QString senderId;
+    QString senderNickname;
+    QString messageToken;
+    QString supersededToken;
+    QString dbusInterface;
+    QString text;
+    uint scrollback : 1;
+    uint rescued : 1;
+    uint truncated : 1;
+    uint nonTextContent : 1;
 };
 
 Message::Private::Private(const MessagePartList &parts)
@@ -103,30 +121,94 @@ Message::Private::Private(const MessagePartList &parts)
       forceNonText(false),
       sender(0)
 {
+    indexParts();
 }
 
 Message::Private::~Private()
 {
 }
 
-inline uint Message::Private::senderHandle() const
+void Message::Private::indexParts()
 {
-    return uintOrZeroFromPart(parts, 0, "message-sender");
-}
+    if (parts.isEmpty()) {
+        sent = received = messageType = pendingId = senderHandle = 0;
+        scrollback = rescued = truncated = nonTextContent = false;
+        return;
+    }
 
-inline QString Message::Private::senderId() const
-{
-    return stringOrEmptyFromPart(parts, 0, "message-sender-id");
-}
+    sent = uintOrZeroFromPart(parts, 0, "message-sent");
+    received = uintOrZeroFromPart(parts, 0, "message-received");
+    messageType = uintOrZeroFromPart(parts, 0, "message-type");
+    pendingId = uintOrZeroFromPart(parts, 0, "pending-message-id");
+    senderHandle = uintOrZeroFromPart(parts, 0, "message-sender");
+    senderId = stringOrEmptyFromPart(parts, 0, "message-sender-id");
+    senderNickname = stringOrEmptyFromPart(parts, 0, "sender-nickname");
+    messageToken = stringOrEmptyFromPart(parts, 0, "message-token");
+    supersededToken = stringOrEmptyFromPart(parts, 0, "supersedes");
+    dbusInterface = stringOrEmptyFromPart(parts, 0, "interface");
+    scrollback = booleanFromPart(parts, 0, "scrollback", false);
+    rescued = booleanFromPart(parts, 0, "rescued", false);
+
+    text.clear();
+    truncated = false;
+    nonTextContent = false;
 
-inline uint Message::Private::pendingId() const
-{
-    return uintOrZeroFromPart(parts, 0, "pending-message-id");
+    // Alternative-groups for which we've already emitted an alternative
+    QSet<QString> altGroupsUsed;
+    // Alternative-groups having a text/plain alternative, and the ones needing one
+    QSet<QString> texts;
+    QSet<QString> textNeeded;
+
+    for (int i = 1; i < parts.size(); i++) {
+        if (booleanFromPart(parts, i, "truncated", false)) {
+            truncated = true;
+        }
+
+        QString altGroup = stringOrEmptyFromPart(parts, i, "alternative");
+        QString contentType = stringOrEmptyFromPart(parts, i, "content-type");
+
+        if (contentType == QLatin1String("text/plain")) {
+            if (!altGroup.isEmpty()) {
+                // we can use this as an alternative for a non-text part
+                // with the same altGroup
+                texts << altGroup;
+
+                if (altGroupsUsed.contains(altGroup)) {
+                    continue;
+                } else {
+                    altGroupsUsed << altGroup;
+                }
+            }
+
+            QVariant content = valueFromPart(parts, i, "content");
+            if (content.type() == QVariant::String) {
+                text += content.toString();
+            } else {
+                // O RLY?
+                debug() << "allegedly text/plain part wasn't";
+            }
+        } else {
+            if (altGroup.isEmpty()) {
+                // we can't possibly rescue this part by using a text/plain
+                // alternative, because it's not in any alternative group
+                nonTextContent = true;
+            } else {
+                // maybe we'll find a text/plain alternative for this
+                textNeeded << altGroup;
+            }
+        }
+    }
+
+    textNeeded -= texts;
+    if (!textNeeded.isEmpty()) {
+        nonTextContent = true;
+    }
 }
 
 void Message::Private::clearSenderHandle()
 {
     parts[0].remove(QLatin1String("message-sender"));
+    senderHandle = 0;
 }
 
 /**
@@ -177,6 +259,7 @@ Message::Message(uint timestamp, uint type, const QString &text)
     mPriv->parts[1].insert(QLatin1String("content-type"),
             QDBusVariant(QLatin1String("text/plain")));
     mPriv->parts[1].insert(QLatin1String("content"), QDBusVariant(text));
+    mPriv->indexParts();
 }
 
 /**
@@ -194,6 +277,7 @@ Message::Message(ChannelTextMessageType type, const QString &text)
     mPriv->parts[1].insert(QLatin1String("content-type"),
             QDBusVariant(QLatin1String("text/plain")));
     mPriv->parts[1].insert(QLatin1String("content"), QDBusVariant(text));
+    mPriv->indexParts();
 }
 
 /**
@@ -240,7 +324,7 @@ Message::~Message()
 QDateTime Message::sent() const
 {
     // FIXME See http://bugs.freedesktop.org/show_bug.cgi?id=21690
-    uint stamp = valueFromPart(mPriv->parts, 0, "message-sent").toUInt();
+    uint stamp = mPriv->sent;
     if (stamp != 0) {
         return QDateTime::fromTime_t(stamp);
     } else {
@@ -256,7 +340,7 @@ QDateTime Message::sent() const
  */
 ChannelTextMessageType Message::messageType() const
 {
-    uint raw = valueFromPart(mPriv->parts, 0, "message-type").toUInt();
+    uint raw = mPriv->messageType;
 
     if (raw < static_cast<uint>(NUM_CHANNEL_TEXT_MESSAGE_TYPES)) {
         return ChannelTextMessageType(raw);
@@ -272,12 +356,7 @@ ChannelTextMessageType Message::messageType() const
  */
 bool Message::isTruncated() const
 {
-    for (int i = 1; i < size(); i++) {
-        if (booleanFromPart(mPriv->parts, i, "truncated", false)) {
-            return true;
-        }
-    }
-    return false;
+    return mPriv->truncated;
 }
 
 /**
@@ -293,34 +372,7 @@ bool Message::hasNonTextContent() const
         return true;
     }
 
-    QSet<QString> texts;
-    QSet<QString> textNeeded;
-
-    for (int i = 1; i < size(); i++) {
-        QString altGroup = stringOrEmptyFromPart(mPriv->parts, i, "alternative");
-        QString contentType = stringOrEmptyFromPart(mPriv->parts, i, "content-type");
-
-        if (contentType == QLatin1String("text/plain")) {
-            if (!altGroup.isEmpty()) {
-                // we can use this as an alternative for a non-text part
-                // with the same altGroup
-                texts << altGroup;
-            }
-        } else {
-            QString alt = stringOrEmptyFromPart(mPriv->parts, i, "alternative");
-            if (altGroup.isEmpty()) {
-                // we can't possibly rescue this part by using a text/plain
-                // alternative, because it's not in any alternative group
-                return true;
-            } else {
-                // maybe we'll find a text/plain alternative for this
-                textNeeded << altGroup;
-            }
-        }
-    }
-
-    textNeeded -= texts;
-    return !textNeeded.isEmpty();
+    return mPriv->nonTextContent;
 }
 
 /**
@@ -331,7 +383,7 @@ bool Message::hasNonTextContent() const
  */
 QString Message::messageToken() const
 {
-    return stringOrEmptyFromPart(mPriv->parts, 0, "message-token");
+    return mPriv->messageToken;
 }
 
 /**
@@ -361,7 +413,7 @@ bool Message::isSpecificToDBusInterface() const
  */
 QString Message::dbusInterface() const
 {
-    return stringOrEmptyFromPart(mPriv->parts, 0, "interface");
+    return mPriv->dbusInterface;
 }
 
 /**
@@ -371,34 +423,7 @@ QString Message::dbusInterface() const
  */
 QString Message::text() const
 {
-    // Alternative-groups for which we've already emitted an alternative
-    QSet<QString> altGroupsUsed;
-    QString text;
-
-    for (int i = 1; i < size(); i++) {
-        QString altGroup = stringOrEmptyFromPart(mPriv->parts, i, "alternative");
-        QString contentType = stringOrEmptyFromPart(mPriv->parts, i, "content-type");
-
-        if (contentType == QLatin1String("text/plain")) {
-            if (!altGroup.isEmpty()) {
-                if (altGroupsUsed.contains(altGroup)) {
-                    continue;
-                } else {
-                    altGroupsUsed << altGroup;
-                }
-            }
-
-            QVariant content = valueFromPart(mPriv->parts, i, "content");
-            if (content.type() == QVariant::String) {
-                text += content.toString();
-            } else {
-                // O RLY?
-                debug() << "allegedly text/plain part wasn't";
-            }
-        }
-    }
-
-    return text;
+    return mPriv->text;
 }
 
 /**
@@ -723,9 +748,10 @@ ReceivedMessage::ReceivedMessage(const MessagePartList &parts,
     : Message(parts)
 {
     if (!mPriv->parts[0].contains(QLatin1String("message-received"))) {
+        uint received = QDateTime::currentDateTime().toTime_t();
         mPriv->parts[0].insert(QLatin1String("message-received"),
-                QDBusVariant(static_cast<qlonglong>(
-                        QDateTime::currentDateTime().toTime_t())));
+                QDBusVariant(static_cast<qlonglong>(received)));
+        mPriv->received = received;
     }
     mPriv->textChannel = channel;
 }
@@ -765,7 +791,7 @@ ReceivedMessage::~ReceivedMessage()
 QDateTime ReceivedMessage::received() const
 {
     // FIXME See http://bugs.freedesktop.org/show_bug.cgi?id=21690
-    uint stamp = valueFromPart(mPriv->parts, 0, "message-received").toUInt();
+    uint stamp = mPriv->received;
     if (stamp != 0) {
         return QDateTime::fromTime_t(stamp);
     } else {
@@ -793,7 +819,7 @@ ContactPtr ReceivedMessage::sender() const
  */
 QString ReceivedMessage::senderNickname() const
 {
-    QString ret = stringOrEmptyFromPart(mPriv->parts, 0, "sender-nickname");
+    QString ret = mPriv->senderNickname;
     if (ret.isEmpty() && mPriv->sender) {
         ret = mPriv->sender->alias();
     }
@@ -811,7 +837,7 @@ QString ReceivedMessage::senderNickname() const
  */
 QString ReceivedMessage::supersededToken() const
 {
-    return stringOrEmptyFromPart(mPriv->parts, 0, "supersedes");
+    return mPriv->supersededToken;
 }
 
 /**
@@ -826,7 +852,7 @@ QString ReceivedMessage::supersededToken() const
  */
 bool ReceivedMessage::isScrollback() const
 {
-    return booleanFromPart(mPriv->parts, 0, "scrollback", false);
+    return mPriv->scrollback;
 }
 
 /**
@@ -840,7 +866,7 @@ bool ReceivedMessage::isScrollback() const
  */
 bool ReceivedMessage::isRescued() const
 {
-    return booleanFromPart(mPriv->parts, 0, "rescued", false);
+    return mPriv->rescued;
 }
 
 /**
@@ -879,17 +905,17 @@ bool ReceivedMessage::isFromChannel(const TextChannelPtr &channel) const
 
 uint ReceivedMessage::pendingId() const
 {
-    return mPriv->pendingId();
+    return mPriv->pendingId;
 }
 
 uint ReceivedMessage::senderHandle() const
 {
-    return mPriv->senderHandle();
+    return mPriv->senderHandle;
 }
 
 QString ReceivedMessage::senderId() const
 {
-    return mPriv->senderId();
+    return mPriv->senderId;
 }
 
 void ReceivedMessage::setForceNonText()
@@ -30,6 +30,7 @@
 
 #include <TelepathyQt/Channel>
 #include <TelepathyQt/ChannelFactory>
+#include <TelepathyQt/ChannelRequest>
 #include <TelepathyQt/ClientRegistrar>
 #include <TelepathyQt/Connection>
 #include <TelepathyQt/ConnectionLowlevel>
@@ -43,8 +44,6 @@ namespace Tp
 
 struct TP_QT_NO_EXPORT PendingChannel::Private
 {
-    class FakeAccountFactory;
-
     ConnectionPtr connection;
     bool create;
     bool yours;
@@ -57,43 +56,6 @@ struct TP_QT_NO_EXPORT PendingChannel::Private
     ClientRegistrarPtr cr;
     SharedPtr<RequestTemporaryHandler> handler;
     HandledChannelNotifier *notifier;
-    static uint numHandlers;
-};
-
-uint PendingChannel::Private::numHandlers = 0;
-
-class TP_QT_NO_EXPORT PendingChannel::Private::FakeAccountFactory : public AccountFactory
-{
-public:
-    static AccountFactoryPtr create(const AccountPtr &account)
-    {
-        return AccountFactoryPtr(new FakeAccountFactory(account));
-    }
-
-    ~FakeAccountFactory() { }
-
-    AccountPtr account() const { return mAccount; }
-
-protected:
-    AccountPtr construct(const QString &busName, const QString &objectPath,
-            const ConnectionFactoryConstPtr &connFactory,
-            const ChannelFactoryConstPtr &chanFactory,
-            const ContactFactoryConstPtr &contactFactory) const
-    {
-        if (mAccount->objectPath() != objectPath) {
-            warning() << "Account received by the fake factory is different from original account";
-        }
-        return mAccount;
-    }
-
-private:
-    FakeAccountFactory(const AccountPtr &account)
-        : AccountFactory(account->dbusConnection(), Features()),
-          mAccount(account)
-    {
-    }
-
-    AccountPtr mAccount;
 };
 
 /**
@@ -181,27 +143,22 @@ PendingChannel::PendingChannel(const AccountPtr &account,
     mPriv->handleType = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType")).toUInt();
     mPriv->handle = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle")).toUInt();
 
-    mPriv->cr = ClientRegistrar::create(
-            Private::FakeAccountFactory::create(account),
-            account->connectionFactory(),
-            account->channelFactory(),
-            account->contactFactory());
-    mPriv->handler = RequestTemporaryHandler::create(account);
     mPriv->notifier = 0;
     mPriv->create = create;
 
-    QString handlerName = QString(QLatin1String("TpQtRaH_%1_%2"))
-        .arg(account->dbusConnection().baseService()
-            .replace(QLatin1String(":"), QLatin1String("_"))
-            .replace(QLatin1String("."), QLatin1String("_")))
-        .arg(Private::numHandlers++);
-    if (!mPriv->cr->registerClient(mPriv->handler, handlerName, false)) {
-        warning() << "Unable to register handler" << handlerName;
+    // The handler registered on the bus is shared by all requests made through accounts on the
+    // same bus, only the first request pays for registering it
+    SharedPtr<SharedRequestTemporaryHandler> sharedHandler =
+        SharedRequestTemporaryHandler::forAccount(account);
+    if (!sharedHandler) {
         setFinishedWithError(TP_QT_ERROR_NOT_AVAILABLE,
                 QLatin1String("Unable to register handler"));
         return;
     }
 
+    mPriv->cr = sharedHandler->registrar();
+    mPriv->handler = RequestTemporaryHandler::create(sharedHandler, account);
+
     connect(mPriv->handler.data(),
             SIGNAL(error(QString,QString)),
             SLOT(onHandlerError(QString,QString)));
@@ -209,7 +166,7 @@ PendingChannel::PendingChannel(const AccountPtr &account,
             SIGNAL(channelReceived(Tp::ChannelPtr,QDateTime,Tp::ChannelRequestHints)),
             SLOT(onHandlerChannelReceived(Tp::ChannelPtr)));
 
-    handlerName = QString(QLatin1String("org.freedesktop.Telepathy.Client.%1")).arg(handlerName);
+    QString handlerName = sharedHandler->handlerBusName();
 
     debug() << "Requesting channel through account using handler" << handlerName;
     PendingChannelRequest *pcr;
@@ -218,6 +175,11 @@ PendingChannel::PendingChannel(const AccountPtr &account,
     } else {
         pcr = account->ensureChannel(request, userActionTime, handlerName, ChannelRequestHints());
     }
+    // channelRequestCreated is emitted before the request proceeds, so the shared handler knows
+    // where to route the request before the channel dispatcher can invoke it
+    connect(pcr,
+            SIGNAL(channelRequestCreated(Tp::ChannelRequestPtr)),
+            SLOT(onAccountChannelRequestCreated(Tp::ChannelRequestPtr)));
     connect(pcr,
             SIGNAL(finished(Tp::PendingOperation*)),
             SLOT(onAccountCreateChannelFinished(Tp::PendingOperation*)));
@@ -515,6 +477,11 @@ void PendingChannel::onHandlerChannelReceived(const ChannelPtr &channel)
     setFinished();
 }
 
+void PendingChannel::onAccountChannelRequestCreated(const ChannelRequestPtr &channelRequest)
+{
+    mPriv->handler->addRequest(channelRequest->objectPath());
+}
+
 void PendingChannel::onAccountCreateChannelFinished(PendingOperation *op)
 {
     if (isFinished()) {
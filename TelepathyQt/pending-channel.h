@@ -76,6 +76,8 @@ private Q_SLOTS:
             const QString &errorMessage);
     TP_QT_NO_EXPORT void onHandlerChannelReceived(
             const Tp::ChannelPtr &channel);
+    TP_QT_NO_EXPORT void onAccountChannelRequestCreated(
+            const Tp::ChannelRequestPtr &channelRequest);
     TP_QT_NO_EXPORT void onAccountCreateChannelFinished(
             Tp::PendingOperation *op);
 
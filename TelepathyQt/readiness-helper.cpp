@@ -24,6 +24,7 @@
 
 #include "TelepathyQt/_gen/readiness-helper.moc.hpp"
 
+#include "TelepathyQt/async-result-internal.h"
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/Constants>
@@ -33,8 +34,9 @@
 #include <TelepathyQt/SharedPtr>
 
 #include <QDBusError>
+#include <QMetaObject>
+#include <QPointer>
 #include <QSharedData>
-#include <QTimer>
 
 namespace Tp
 {
@@ -107,6 +109,7 @@ struct TP_QT_NO_EXPORT ReadinessHelper::Private
     void setIntrospectCompleted(const Feature &feature, bool success,
             const QString &errorName = QString(),
             const QString &errorMessage = QString());
+    void scheduleIteration();
     void iterateIntrospection();
     Features depsFor(const Feature &feature); // Recursive dependencies for a feature
 
@@ -130,6 +133,8 @@ struct TP_QT_NO_EXPORT ReadinessHelper::Private
 
     bool pendingStatusChange;
     uint pendingStatus;
+
+    bool iterationScheduled;
 };
 
 ReadinessHelper::Private::Private(
@@ -143,7 +148,8 @@ ReadinessHelper::Private::Private(
       currentStatus(currentStatus),
       introspectables(introspectables),
       pendingStatusChange(false),
-      pendingStatus(-1)
+      pendingStatus(-1),
+      iterationScheduled(false)
 {
     for (Introspectables::const_iterator i = introspectables.constBegin();
             i != introspectables.constEnd(); ++i) {
@@ -166,7 +172,8 @@ ReadinessHelper::Private::Private(
       currentStatus(currentStatus),
       introspectables(introspectables),
       pendingStatusChange(false),
-      pendingStatus(-1)
+      pendingStatus(-1),
+      iterationScheduled(false)
 {
     Q_ASSERT(proxy != 0);
 
@@ -205,7 +212,7 @@ void ReadinessHelper::Private::setCurrentStatus(uint newStatus)
         // in the requested set, so we don't have to re-add them here
 
         if (supportedStatuses.contains(currentStatus)) {
-            QTimer::singleShot(0, parent, SLOT(iterateIntrospection()));
+            scheduleIteration();
         } else {
             emit parent->statusReady(currentStatus);
         }
@@ -255,11 +262,25 @@ void ReadinessHelper::Private::setIntrospectCompleted(const Feature &feature,
     pendingFeatures.remove(feature);
     inFlightFeatures.remove(feature);
 
-    QTimer::singleShot(0, parent, SLOT(iterateIntrospection()));
+    scheduleIteration();
+}
+
+void ReadinessHelper::Private::scheduleIteration()
+{
+    // Several features typically finish introspecting in the same mainloop iteration, and a single
+    // pass over the state handles all of them
+    if (iterationScheduled) {
+        return;
+    }
+
+    iterationScheduled = true;
+    QMetaObject::invokeMethod(parent, "iterateIntrospection", Qt::QueuedConnection);
 }
 
 void ReadinessHelper::Private::iterateIntrospection()
 {
+    iterationScheduled = false;
+
     if (proxy && !proxy->isValid()) {
         debug() << "ReadinessHelper: not iterating as the proxy is invalidated";
         return;
@@ -348,13 +369,16 @@ void ReadinessHelper::Private::iterateIntrospection()
 
         Introspectable introspectable = introspectables[feature];
 
+        // Features completed right away here only schedule another iteration, so keep going with
+        // the others, which would otherwise wait for a mainloop iteration before being started
         if (!introspectable.mPriv->makesSenseForStatuses.contains(currentStatus)) {
             // No-op satisfy features for which nothing has to be done in
             // the current state
             setIntrospectCompleted(feature, true);
-            return; // will be called with a single-shot soon again
+            continue;
         }
 
+        bool interfacesMissing = false;
         foreach (const QString &interface, introspectable.mPriv->dependsOnInterfaces) {
             if (!interfaces.contains(interface)) {
                 // If a feature is ready to introspect and depends on a interface
@@ -365,9 +389,13 @@ void ReadinessHelper::Private::iterateIntrospection()
                 setIntrospectCompleted(feature, false,
                         TP_QT_ERROR_NOT_AVAILABLE,
                         QLatin1String("Feature depend on interfaces that are not available"));
-                return; // will be called with a single-shot soon again
+                interfacesMissing = true;
+                break;
             }
         }
+        if (interfacesMissing) {
+            continue;
+        }
 
         // yes, with the dependency info, we can even parallelize
         // introspection of several features at once, reducing total round trip
@@ -645,7 +673,7 @@ PendingReady *ReadinessHelper::becomeReady(const Features &requestedFeatures)
     // Only we finish these PendingReadys, so we don't need destroyed or finished handling for them
     // - we already know when that happens, as we caused it!
 
-    QTimer::singleShot(0, this, SLOT(iterateIntrospection()));
+    mPriv->scheduleIteration();
 
     return operation;
 }
@@ -666,6 +694,50 @@ void ReadinessHelper::setIntrospectCompleted(const Feature &feature, bool succes
     setIntrospectCompleted(feature, success, error.name(), error.message());
 }
 
+namespace
+{
+
+struct IntrospectionCompleter
+{
+    IntrospectionCompleter(ReadinessHelper *helper, const Feature &feature)
+        : helper(helper), feature(feature)
+    {
+    }
+
+    void operator()(const AsyncResult &result) const
+    {
+        if (!helper) {
+            return;
+        }
+
+        if (result.isError()) {
+            warning().nospace() << "Introspecting " << feature << " failed with " <<
+                result.errorName() << ": " << result.errorMessage();
+            helper->setIntrospectCompleted(feature, false,
+                    result.errorName(), result.errorMessage());
+            return;
+        }
+
+        helper->setIntrospectCompleted(feature, true);
+    }
+
+    QPointer<ReadinessHelper> helper;
+    Feature feature;
+};
+
+}
+
+/*
+ * Complete the introspection of \a feature on \a helper once \a result has finished,
+ * successfully or not depending on \a result. Nothing happens if \a helper is deleted first,
+ * or if \a result is cancelled.
+ */
+void setIntrospectCompletedWhen(ReadinessHelper *helper, const Feature &feature,
+        const AsyncResult &result)
+{
+    result.then(IntrospectionCompleter(helper, feature));
+}
+
 void ReadinessHelper::iterateIntrospection()
 {
     mPriv->iterateIntrospection();
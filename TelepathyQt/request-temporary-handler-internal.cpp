@@ -26,48 +26,156 @@
 
 #include "TelepathyQt/debug-internal.h"
 
+#include <TelepathyQt/AccountFactory>
 #include <TelepathyQt/ChannelClassSpecList>
+#include <TelepathyQt/ChannelRequest>
 
 namespace Tp
 {
 
-SharedPtr<RequestTemporaryHandler> RequestTemporaryHandler::create(const AccountPtr &account)
+namespace
 {
-    return SharedPtr<RequestTemporaryHandler>(new RequestTemporaryHandler(account));
+
+// How long the shared handler stays registered after the last request using it is gone
+const int sharedHandlerIdleTimeout = 2000;
+
+// The handler registered for Request & Handle is shared by all requests made on the same bus
+// with the same factories, as the registrar builds the channels given to PendingChannel with
+// them.
+struct SharedHandlerKey
+{
+    SharedHandlerKey()
+        : connFactory(0), chanFactory(0), contactFactory(0)
+    {
+    }
+
+    SharedHandlerKey(const AccountPtr &account)
+        : busName(account->dbusConnection().name()),
+          baseService(account->dbusConnection().baseService()),
+          connFactory(account->connectionFactory().data()),
+          chanFactory(account->channelFactory().data()),
+          contactFactory(account->contactFactory().data())
+    {
+    }
+
+    bool operator==(const SharedHandlerKey &other) const
+    {
+        return connFactory == other.connFactory &&
+            chanFactory == other.chanFactory &&
+            contactFactory == other.contactFactory &&
+            baseService == other.baseService &&
+            busName == other.busName;
+    }
+
+    QString busName;
+    QString baseService;
+    const void *connFactory;
+    const void *chanFactory;
+    const void *contactFactory;
+};
+
+uint qHash(const SharedHandlerKey &key)
+{
+    return ::qHash(key.baseService) ^ ::qHash(key.connFactory) ^ ::qHash(key.chanFactory) ^
+        ::qHash(key.contactFactory);
 }
 
-RequestTemporaryHandler::RequestTemporaryHandler(const AccountPtr &account)
-    : AbstractClient(),
-      QObject(),
-      AbstractClientHandler(ChannelClassSpecList(), AbstractClientHandler::Capabilities(), false),
+// The registrar is kept alive by the shared handler until it has been idle for
+// sharedHandlerIdleTimeout, and by FakeHandlerManager while channels requested through it are
+// around, so the handler gets unregistered once it is not used anymore.
+struct SharedHandlerEntry
+{
+    WeakPtr<ClientRegistrar> registrar;
+    WeakPtr<SharedRequestTemporaryHandler> handler;
+};
+
+QHash<SharedHandlerKey, SharedHandlerEntry> sharedHandlers;
+
+}
+
+class TP_QT_NO_EXPORT SharedRequestTemporaryHandler::FakeAccountFactory : public AccountFactory
+{
+public:
+    static SharedPtr<FakeAccountFactory> create(const QDBusConnection &bus)
+    {
+        return SharedPtr<FakeAccountFactory>(new FakeAccountFactory(bus));
+    }
+
+    ~FakeAccountFactory() { }
+
+    void registerAccount(const AccountPtr &account)
+    {
+        mAccounts.insert(account->objectPath(), WeakPtr<Account>(account));
+    }
+
+protected:
+    AccountPtr construct(const QString &busName, const QString &objectPath,
+            const ConnectionFactoryConstPtr &connFactory,
+            const ChannelFactoryConstPtr &chanFactory,
+            const ContactFactoryConstPtr &contactFactory) const
+    {
+        AccountPtr account(mAccounts.value(objectPath));
+        if (!account) {
+            warning() << "Account received by the request handler factory is not one which "
+                "requested a channel";
+            return AccountFactory::construct(busName, objectPath, connFactory, chanFactory,
+                    contactFactory);
+        }
+        return account;
+    }
+
+private:
+    FakeAccountFactory(const QDBusConnection &bus)
+        : AccountFactory(bus, Features())
+    {
+    }
+
+    QHash<QString, WeakPtr<Account> > mAccounts;
+};
+
+SharedPtr<RequestTemporaryHandler> RequestTemporaryHandler::create(
+        const SharedPtr<SharedRequestTemporaryHandler> &sharedHandler,
+        const AccountPtr &account)
+{
+    return SharedPtr<RequestTemporaryHandler>(new RequestTemporaryHandler(sharedHandler, account));
+}
+
+RequestTemporaryHandler::RequestTemporaryHandler(
+        const SharedPtr<SharedRequestTemporaryHandler> &sharedHandler,
+        const AccountPtr &account)
+    : QObject(),
+      mSharedHandler(sharedHandler),
       mAccount(account),
       mQueueChannelReceived(true),
       dbusHandlerInvoked(false)
 {
+    mSharedHandler->registerHandler(this);
 }
 
 RequestTemporaryHandler::~RequestTemporaryHandler()
 {
+    mSharedHandler->unregisterHandler(this);
+}
+
+void RequestTemporaryHandler::addRequest(const QString &requestPath)
+{
+    mSharedHandler->registerRequest(requestPath, this);
 }
 
 void RequestTemporaryHandler::handleChannels(
         const MethodInvocationContextPtr<> &context,
         const AccountPtr &account,
-        const ConnectionPtr &connection,
         const QList<ChannelPtr> &channels,
         const QList<ChannelRequestPtr> &requestsSatisfied,
-        const QDateTime &userActionTime,
-        const HandlerInfo &handlerInfo)
+        const QDateTime &userActionTime)
 {
-    Q_ASSERT(dbusHandlerInvoked);
-
     QString errorMessage;
 
     ChannelPtr oldChannel = channel();
     if (channels.size() != 1 || requestsSatisfied.size() != 1) {
         errorMessage = QLatin1String("Only one channel and one channel request should be given "
                 "to HandleChannels");
-    } else if (account != mAccount) {
+    } else if (!account || account->objectPath() != mAccount->objectPath()) {
         errorMessage = QLatin1String("Account received is not the same as the account which made "
                 "the request");
     } else if (oldChannel && oldChannel != channels.first()) {
@@ -93,16 +201,27 @@ void RequestTemporaryHandler::handleChannels(
         mChannel = WeakPtr<Channel>(channels.first());
         emit channelReceived(channel(), userActionTime, channelRequest->hints());
     } else {
-        if (mQueueChannelReceived) {
-            mChannelReceivedQueue.enqueue(qMakePair(userActionTime, channelRequest->hints()));
-        } else {
-            emit channelReceived(oldChannel, userActionTime, channelRequest->hints());
-        }
+        handleChannelAgain(userActionTime, channelRequest->hints());
     }
 
     context->setFinished();
 }
 
+void RequestTemporaryHandler::handleChannelAgain(const QDateTime &userActionTime,
+        const ChannelRequestHints &requestHints)
+{
+    ChannelPtr oldChannel = channel();
+    if (!oldChannel) {
+        return;
+    }
+
+    if (mQueueChannelReceived) {
+        mChannelReceivedQueue.enqueue(qMakePair(userActionTime, requestHints));
+    } else {
+        emit channelReceived(oldChannel, userActionTime, requestHints);
+    }
+}
+
 void RequestTemporaryHandler::setQueueChannelReceived(bool queue)
 {
     mQueueChannelReceived = queue;
@@ -132,4 +251,317 @@ void RequestTemporaryHandler::processChannelReceivedQueue()
     }
 }
 
+SharedPtr<SharedRequestTemporaryHandler> SharedRequestTemporaryHandler::forAccount(
+        const AccountPtr &account)
+{
+    static uint numHandlers = 0;
+
+    SharedHandlerKey key(account);
+    SharedHandlerEntry entry = sharedHandlers.value(key);
+    ClientRegistrarPtr registrar(entry.registrar);
+    if (registrar) {
+        SharedPtr<SharedRequestTemporaryHandler> handler(entry.handler);
+        handler->mAccountFactory->registerAccount(account);
+        return handler;
+    }
+
+    SharedPtr<FakeAccountFactory> accountFactory =
+        FakeAccountFactory::create(account->dbusConnection());
+    accountFactory->registerAccount(account);
+    registrar = ClientRegistrar::create(
+            accountFactory,
+            account->connectionFactory(),
+            account->channelFactory(),
+            account->contactFactory());
+    SharedPtr<SharedRequestTemporaryHandler> handler(
+            new SharedRequestTemporaryHandler(accountFactory));
+    handler->mRegistrar = WeakPtr<ClientRegistrar>(registrar);
+
+    QString handlerName = QString(QLatin1String("TpQtRaH_%1_%2"))
+        .arg(account->dbusConnection().baseService()
+            .replace(QLatin1String(":"), QLatin1String("_"))
+            .replace(QLatin1String("."), QLatin1String("_")))
+        .arg(numHandlers++);
+    if (!registrar->registerClient(handler, handlerName, false)) {
+        warning() << "Unable to register handler" << handlerName;
+        return SharedPtr<SharedRequestTemporaryHandler>();
+    }
+
+    debug() << "Registered shared Request & Handle handler" << handlerName;
+    handler->mRegistrarRef = registrar;
+    handler->mHandlerBusName =
+        QString(QLatin1String("org.freedesktop.Telepathy.Client.%1")).arg(handlerName);
+
+    // drop the entries of handlers already gone before adding a new one
+    QHash<SharedHandlerKey, SharedHandlerEntry>::iterator i = sharedHandlers.begin();
+    while (i != sharedHandlers.end()) {
+        if (!ClientRegistrarPtr(i->registrar)) {
+            i = sharedHandlers.erase(i);
+        } else {
+            ++i;
+        }
+    }
+
+    entry.registrar = WeakPtr<ClientRegistrar>(registrar);
+    entry.handler = WeakPtr<SharedRequestTemporaryHandler>(handler);
+    sharedHandlers.insert(key, entry);
+    return handler;
+}
+
+SharedRequestTemporaryHandler::SharedRequestTemporaryHandler(
+        const SharedPtr<FakeAccountFactory> &accountFactory)
+    : AbstractClient(),
+      QObject(),
+      AbstractClientHandler(ChannelClassSpecList(), AbstractClientHandler::Capabilities(), false),
+      mAccountFactory(accountFactory),
+      mHandlers(0),
+      mIdleTimer(new QTimer(this)),
+      mUnresolvedHandlers(0)
+{
+    mIdleTimer->setSingleShot(true);
+    mIdleTimer->setInterval(sharedHandlerIdleTimeout);
+    connect(mIdleTimer, SIGNAL(timeout()), SLOT(onIdleTimeout()));
+}
+
+SharedRequestTemporaryHandler::~SharedRequestTemporaryHandler()
+{
+}
+
+void SharedRequestTemporaryHandler::handleChannels(
+        const MethodInvocationContextPtr<> &context,
+        const AccountPtr &account,
+        const ConnectionPtr &connection,
+        const QList<ChannelPtr> &channels,
+        const QList<ChannelRequestPtr> &requestsSatisfied,
+        const QDateTime &userActionTime,
+        const HandlerInfo &handlerInfo)
+{
+    Q_UNUSED(connection);
+    Q_UNUSED(handlerInfo);
+
+    // ClientHandlerAdaptor calls handleRequestedChannels() instead, with the object paths of all
+    // the satisfied requests
+    ObjectPathList requestPaths;
+    foreach (const ChannelRequestPtr &channelRequest, requestsSatisfied) {
+        requestPaths << QDBusObjectPath(channelRequest->objectPath());
+    }
+
+    handleRequestedChannels(context, account, channels, requestsSatisfied, requestPaths,
+            userActionTime);
+}
+
+void SharedRequestTemporaryHandler::handleRequestedChannels(
+        const MethodInvocationContextPtr<> &context,
+        const AccountPtr &account,
+        const QList<ChannelPtr> &channels,
+        const QList<ChannelRequestPtr> &requestsSatisfied,
+        const ObjectPathList &requestPaths,
+        const QDateTime &userActionTime)
+{
+    Invocation invocation;
+    invocation.context = context;
+    invocation.account = account;
+    invocation.channels = channels;
+    invocation.requestsSatisfied = requestsSatisfied;
+    invocation.requestPaths = requestPaths;
+    invocation.userActionTime = userActionTime;
+
+    if (dispatch(invocation)) {
+        return;
+    }
+
+    if (mUnresolvedHandlers > 0) {
+        // The channel dispatcher may invoke us before we got to know the object path of the
+        // request (e.g. before CreateChannel returned), wait for it
+        debug() << "Shared Request & Handle handler received channels for an unknown request,"
+            << "waiting for pending requests to be created";
+        mEarlyInvocations.append(invocation);
+        return;
+    }
+
+    // Neither the request nor the channel is known anymore, which happens when a channel is
+    // re-requested after its PendingChannel and HandledChannelNotifier are gone. Keep
+    // handling it, as nobody is interested in being notified.
+    debug() << "Shared Request & Handle handler received" << channels.size() <<
+        "channels nobody is waiting for, accepting them";
+    context->setFinished();
+}
+
+void SharedRequestTemporaryHandler::setDBusHandlerInvoked(const ObjectPathList &requestsSatisfied)
+{
+    RequestTemporaryHandler *handler = handlerForRequests(requestsSatisfied);
+    if (handler) {
+        handler->setDBusHandlerInvoked();
+    } else if (mUnresolvedHandlers > 0) {
+        foreach (const QDBusObjectPath &requestPath, requestsSatisfied) {
+            mEarlyInvokedRequests.insert(requestPath.path());
+        }
+    }
+}
+
+void SharedRequestTemporaryHandler::setDBusHandlerErrored(const ObjectPathList &requestsSatisfied,
+        const QString &errorName, const QString &errorMessage)
+{
+    RequestTemporaryHandler *handler = handlerForRequests(requestsSatisfied);
+    if (handler) {
+        handler->setDBusHandlerErrored(errorName, errorMessage);
+    } else if (mUnresolvedHandlers > 0) {
+        foreach (const QDBusObjectPath &requestPath, requestsSatisfied) {
+            mEarlyErrors.insert(requestPath.path(), qMakePair(errorName, errorMessage));
+        }
+    }
+}
+
+void SharedRequestTemporaryHandler::registerHandler(RequestTemporaryHandler *handler)
+{
+    Q_UNUSED(handler);
+    ++mUnresolvedHandlers;
+
+    ++mHandlers;
+    mIdleTimer->stop();
+    if (!mRegistrarRef) {
+        mRegistrarRef = ClientRegistrarPtr(mRegistrar);
+    }
+}
+
+void SharedRequestTemporaryHandler::registerRequest(const QString &requestPath,
+        RequestTemporaryHandler *handler)
+{
+    bool resolved = handler->mRequestPaths.isEmpty();
+    handler->mRequestPaths.append(requestPath);
+    mHandlersByRequest.insert(requestPath, handler);
+
+    if (mEarlyInvokedRequests.remove(requestPath)) {
+        handler->setDBusHandlerInvoked();
+    }
+    if (mEarlyErrors.contains(requestPath)) {
+        QPair<QString, QString> error = mEarlyErrors.take(requestPath);
+        handler->setDBusHandlerErrored(error.first, error.second);
+    }
+
+    QList<Invocation>::iterator i = mEarlyInvocations.begin();
+    while (i != mEarlyInvocations.end()) {
+        if (i->requestPaths.contains(QDBusObjectPath(requestPath))) {
+            Invocation invocation = *i;
+            i = mEarlyInvocations.erase(i);
+            dispatch(invocation);
+        } else {
+            ++i;
+        }
+    }
+
+    if (resolved) {
+        handlerResolved();
+    }
+}
+
+void SharedRequestTemporaryHandler::unregisterHandler(RequestTemporaryHandler *handler)
+{
+    foreach (const QString &requestPath, handler->mRequestPaths) {
+        if (mHandlersByRequest.value(requestPath) == handler) {
+            mHandlersByRequest.remove(requestPath);
+        }
+    }
+
+    if (!handler->mChannelPath.isEmpty() &&
+            mHandlersByChannel.value(handler->mChannelPath) == handler) {
+        mHandlersByChannel.remove(handler->mChannelPath);
+    }
+
+    if (handler->mRequestPaths.isEmpty()) {
+        handlerResolved();
+    }
+
+    if (--mHandlers == 0) {
+        mIdleTimer->start();
+    }
+}
+
+void SharedRequestTemporaryHandler::onIdleTimeout()
+{
+    if (mHandlers > 0) {
+        return;
+    }
+
+    debug() << "Shared Request & Handle handler" << mHandlerBusName << "is idle, releasing it";
+
+    // This destroys the registrar, and so us, unless FakeHandlerManager still needs them to
+    // report the channels they handled. Nothing must be done after this.
+    mRegistrarRef.reset();
+}
+
+void SharedRequestTemporaryHandler::handlerResolved()
+{
+    Q_ASSERT(mUnresolvedHandlers > 0);
+    if (--mUnresolvedHandlers > 0) {
+        return;
+    }
+
+    // Every request we made is known by now, what is left was not requested by us
+    mEarlyInvokedRequests.clear();
+    mEarlyErrors.clear();
+    while (!mEarlyInvocations.isEmpty()) {
+        Invocation invocation = mEarlyInvocations.takeFirst();
+        if (!dispatch(invocation)) {
+            invocation.context->setFinished();
+        }
+    }
+}
+
+RequestTemporaryHandler *SharedRequestTemporaryHandler::handlerForRequests(
+        const ObjectPathList &requestsSatisfied) const
+{
+    foreach (const QDBusObjectPath &requestPath, requestsSatisfied) {
+        RequestTemporaryHandler *handler = mHandlersByRequest.value(requestPath.path());
+        if (handler) {
+            return handler;
+        }
+    }
+    return 0;
+}
+
+bool SharedRequestTemporaryHandler::dispatch(const Invocation &invocation)
+{
+    SharedPtr<RequestTemporaryHandler> handler(handlerForRequests(invocation.requestPaths));
+
+    SharedPtr<RequestTemporaryHandler> owner;
+    foreach (const ChannelPtr &channel, invocation.channels) {
+        owner = SharedPtr<RequestTemporaryHandler>(mHandlersByChannel.value(channel->objectPath()));
+        if (owner) {
+            break;
+        }
+    }
+
+    if (!handler && !owner) {
+        return false;
+    }
+
+    if (!handler) {
+        // The channel was re-requested by someone else, its current owner decides what to do
+        owner->handleChannels(invocation.context, invocation.account, invocation.channels,
+                invocation.requestsSatisfied, invocation.userActionTime);
+        return true;
+    }
+
+    handler->handleChannels(invocation.context, invocation.account, invocation.channels,
+            invocation.requestsSatisfied, invocation.userActionTime);
+
+    ChannelPtr channel = handler->channel();
+    if (!channel) {
+        return true;
+    }
+
+    if (!owner) {
+        handler->mChannelPath = channel->objectPath();
+        mHandlersByChannel.insert(handler->mChannelPath, handler.data());
+    } else if (owner != handler && owner->channel() == channel &&
+            invocation.requestsSatisfied.size() == 1) {
+        // With one handler per request the channel dispatcher would have re-invoked the
+        // handler owning the channel, let it know the channel was handled again
+        owner->handleChannelAgain(invocation.userActionTime,
+                invocation.requestsSatisfied.first()->hints());
+    }
+    return true;
+}
+
 } // Tp
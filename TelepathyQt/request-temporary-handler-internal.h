@@ -26,39 +26,42 @@
 #include <TelepathyQt/AbstractClientHandler>
 #include <TelepathyQt/Account>
 #include <TelepathyQt/Channel>
+#include <TelepathyQt/ClientRegistrar>
+
+#include <QHash>
+#include <QQueue>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
 
 namespace Tp
 {
 
-class TP_QT_NO_EXPORT RequestTemporaryHandler : public QObject, public AbstractClientHandler
+class SharedRequestTemporaryHandler;
+
+class TP_QT_NO_EXPORT RequestTemporaryHandler : public QObject, public RefCounted
 {
     Q_OBJECT
 
 public:
-    static SharedPtr<RequestTemporaryHandler> create(const AccountPtr &account);
+    static SharedPtr<RequestTemporaryHandler> create(
+            const SharedPtr<SharedRequestTemporaryHandler> &sharedHandler,
+            const AccountPtr &account);
 
     ~RequestTemporaryHandler();
 
     AccountPtr account() const { return mAccount; }
     ChannelPtr channel() const { return ChannelPtr(mChannel); }
 
-    /**
-     * Handlers we request ourselves never go through the approvers but this
-     * handler shouldn't get any channels we didn't request - hence let's make
-     * this always false to leave slightly less room for the CD to get confused and
-     * give some channel we didn't request to us, without even asking an approver
-     * first. Though if the CD isn't confused it shouldn't really matter - our filter
-     * is empty anyway.
-     */
-    bool bypassApproval() const { return false; }
+    void addRequest(const QString &requestPath);
 
     void handleChannels(const MethodInvocationContextPtr<> &context,
             const AccountPtr &account,
-            const ConnectionPtr &connection,
             const QList<ChannelPtr> &channels,
             const QList<ChannelRequestPtr> &requestsSatisfied,
-            const QDateTime &userActionTime,
-            const HandlerInfo &handlerInfo);
+            const QDateTime &userActionTime);
+    void handleChannelAgain(const QDateTime &userActionTime,
+            const ChannelRequestHints &requestHints);
 
     void setQueueChannelReceived(bool queue);
 
@@ -73,17 +76,118 @@ Q_SIGNALS:
             const Tp::ChannelRequestHints &requestHints);
 
 private:
-    RequestTemporaryHandler(const AccountPtr &account);
+    friend class SharedRequestTemporaryHandler;
+
+    RequestTemporaryHandler(const SharedPtr<SharedRequestTemporaryHandler> &sharedHandler,
+            const AccountPtr &account);
 
     void processChannelReceivedQueue();
 
+    SharedPtr<SharedRequestTemporaryHandler> mSharedHandler;
     AccountPtr mAccount;
     WeakPtr<Channel> mChannel;
+    QStringList mRequestPaths;
+    QString mChannelPath;
     bool mQueueChannelReceived;
     QQueue<QPair<QDateTime, ChannelRequestHints> > mChannelReceivedQueue;
     bool dbusHandlerInvoked;
 };
 
+/*
+ * The single handler registered on the bus for all Request & Handle channel requests sharing the
+ * same bus and factories. HandleChannels calls are dispatched to the RequestTemporaryHandler
+ * which made the satisfied request, or to the one which already owns the channel.
+ *
+ * The handler keeps its registrar, and so itself and its bus name, alive while requests are
+ * using it and for a while after the last one is gone, so that subsequent requests don't have
+ * to register a new handler on the bus.
+ */
+class TP_QT_NO_EXPORT SharedRequestTemporaryHandler : public QObject, public AbstractClientHandler
+{
+    Q_OBJECT
+
+public:
+    static SharedPtr<SharedRequestTemporaryHandler> forAccount(const AccountPtr &account);
+
+    ~SharedRequestTemporaryHandler();
+
+    ClientRegistrarPtr registrar() const { return ClientRegistrarPtr(mRegistrar); }
+    QString handlerBusName() const { return mHandlerBusName; }
+
+    /**
+     * Handlers we request ourselves never go through the approvers but this
+     * handler shouldn't get any channels we didn't request - hence let's make
+     * this always false to leave slightly less room for the CD to get confused and
+     * give some channel we didn't request to us, without even asking an approver
+     * first. Though if the CD isn't confused it shouldn't really matter - our filter
+     * is empty anyway.
+     */
+    bool bypassApproval() const { return false; }
+
+    void handleChannels(const MethodInvocationContextPtr<> &context,
+            const AccountPtr &account,
+            const ConnectionPtr &connection,
+            const QList<ChannelPtr> &channels,
+            const QList<ChannelRequestPtr> &requestsSatisfied,
+            const QDateTime &userActionTime,
+            const HandlerInfo &handlerInfo);
+    void handleRequestedChannels(const MethodInvocationContextPtr<> &context,
+            const AccountPtr &account,
+            const QList<ChannelPtr> &channels,
+            const QList<ChannelRequestPtr> &requestsSatisfied,
+            const ObjectPathList &requestPaths,
+            const QDateTime &userActionTime);
+
+    void setDBusHandlerInvoked(const ObjectPathList &requestsSatisfied);
+    void setDBusHandlerErrored(const ObjectPathList &requestsSatisfied,
+            const QString &errorName, const QString &errorMessage);
+
+private Q_SLOTS:
+    void onIdleTimeout();
+
+private:
+    friend class RequestTemporaryHandler;
+
+    class FakeAccountFactory;
+
+    struct Invocation
+    {
+        MethodInvocationContextPtr<> context;
+        AccountPtr account;
+        QList<ChannelPtr> channels;
+        QList<ChannelRequestPtr> requestsSatisfied;
+        ObjectPathList requestPaths;
+        QDateTime userActionTime;
+    };
+
+    SharedRequestTemporaryHandler(const SharedPtr<FakeAccountFactory> &accountFactory);
+
+    void registerHandler(RequestTemporaryHandler *handler);
+    void registerRequest(const QString &requestPath, RequestTemporaryHandler *handler);
+    void unregisterHandler(RequestTemporaryHandler *handler);
+    void handlerResolved();
+    RequestTemporaryHandler *handlerForRequests(const ObjectPathList &requestsSatisfied) const;
+    bool dispatch(const Invocation &invocation);
+
+    SharedPtr<FakeAccountFactory> mAccountFactory;
+    WeakPtr<ClientRegistrar> mRegistrar;
+    QString mHandlerBusName;
+    QHash<QString, RequestTemporaryHandler *> mHandlersByRequest;
+    QHash<QString, RequestTemporaryHandler *> mHandlersByChannel;
+
+    // The registrar is referenced until mIdleTimer fires after the last handler is gone
+    ClientRegistrarPtr mRegistrarRef;
+    int mHandlers;
+    QTimer *mIdleTimer;
+
+    // Handlers whose channel request object path is not known yet, and the invocations which
+    // arrived meanwhile for requests we can't route yet
+    int mUnresolvedHandlers;
+    QSet<QString> mEarlyInvokedRequests;
+    QHash<QString, QPair<QString, QString> > mEarlyErrors;
+    QList<Invocation> mEarlyInvocations;
+};
+
 } // Tp
 
 #endif
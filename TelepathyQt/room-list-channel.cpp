@@ -26,24 +26,307 @@
 #include "TelepathyQt/debug-internal.h"
 
 #include <TelepathyQt/Connection>
+#include <TelepathyQt/PendingFailure>
+#include <TelepathyQt/PendingVoid>
+
+#include <QMap>
+#include <QSet>
+
+#include <algorithm>
 
 namespace Tp
 {
 
 struct TP_QT_NO_EXPORT RoomListChannel::Private
 {
-    inline Private();
-    inline ~Private();
+    Private(RoomListChannel *parent, const QVariantMap &immutableProperties);
+    ~Private();
+
+    static void introspectMain(Private *self);
+
+    static QStringList wordsFor(const RoomInfo &room);
+    static QStringList wordsFor(const QString &text);
+    static uint membersFor(const RoomInfo &room);
+
+    struct MoreMembers;
+    struct AtLeastMembers;
+
+    void addRooms(const RoomInfoList &newRooms);
+    void indexRoom(int position);
+    void unindexRoom(int position);
+    void sortPositionsByMembers() const;
+    QList<int> matchingRooms(const QString &text, uint minimumMembers) const;
+    RoomInfoList page(const QList<int> &positions, int offset, int limit) const;
+
+    // Public object
+    RoomListChannel *parent;
+
+    QVariantMap immutableProperties;
+
+    Client::ChannelTypeRoomListInterface *roomListInterface;
+
+    ReadinessHelper *readinessHelper;
+
+    // Introspection
+    QString server;
+    bool listingRooms;
+
+    // Room index, built incrementally as GotRooms batches are received
+    RoomInfoList rooms;
+    QHash<uint, int> positionsByHandle;
+    QMap<QString, QList<int> > positionsByWord;
+    // All the positions, by decreasing number of members and then in arrival order. Sorted
+    // lazily when queried, so that receiving a batch of rooms doesn't resort the whole list
+    mutable QList<int> positionsByMembers;
+    mutable bool positionsByMembersSorted;
+};
+
+struct TP_QT_NO_EXPORT RoomListChannel::Private::MoreMembers
+{
+    MoreMembers(const RoomInfoList &rooms) : rooms(rooms) { }
+
+    bool operator()(int position, int otherPosition) const
+    {
+        uint members = membersFor(rooms.at(position));
+        uint otherMembers = membersFor(rooms.at(otherPosition));
+        if (members != otherMembers) {
+            return members > otherMembers;
+        }
+        return position < otherPosition;
+    }
+
+    const RoomInfoList &rooms;
+};
+
+struct TP_QT_NO_EXPORT RoomListChannel::Private::AtLeastMembers
+{
+    AtLeastMembers(const RoomInfoList &rooms) : rooms(rooms) { }
+
+    bool operator()(int position, uint minimumMembers) const
+    {
+        return membersFor(rooms.at(position)) >= minimumMembers;
+    }
+
+    const RoomInfoList &rooms;
 };
 
-RoomListChannel::Private::Private()
+RoomListChannel::Private::Private(RoomListChannel *parent,
+        const QVariantMap &immutableProperties)
+    : parent(parent),
+      immutableProperties(immutableProperties),
+      roomListInterface(parent->interface<Client::ChannelTypeRoomListInterface>()),
+      readinessHelper(parent->readinessHelper()),
+      listingRooms(false),
+      positionsByMembersSorted(true)
 {
+    ReadinessHelper::Introspectables introspectables;
+
+    ReadinessHelper::Introspectable introspectableCore(
+        QSet<uint>() << 0,                                                      // makesSenseForStatuses
+        Features() << Channel::FeatureCore,                                     // dependsOnFeatures (core)
+        QStringList(),                                                          // dependsOnInterfaces
+        (ReadinessHelper::IntrospectFunc) &Private::introspectMain,
+        this);
+    introspectables[FeatureCore] = introspectableCore;
+
+    readinessHelper->addIntrospectables(introspectables);
 }
 
 RoomListChannel::Private::~Private()
 {
 }
 
+void RoomListChannel::Private::introspectMain(RoomListChannel::Private *self)
+{
+    self->parent->connect(self->roomListInterface,
+            SIGNAL(GotRooms(Tp::RoomInfoList)),
+            SLOT(onGotRooms(Tp::RoomInfoList)));
+    self->parent->connect(self->roomListInterface,
+            SIGNAL(ListingRooms(bool)),
+            SLOT(onListingRooms(bool)));
+
+    self->server = qdbus_cast<QString>(self->immutableProperties.value(
+                TP_QT_IFACE_CHANNEL_TYPE_ROOM_LIST + QLatin1String(".Server")));
+
+    /* the channel may be a singleton which is already listing rooms */
+    QDBusPendingCallWatcher *watcher =
+        new QDBusPendingCallWatcher(
+                self->roomListInterface->GetListingRooms(),
+                self->parent);
+    self->parent->connect(watcher,
+            SIGNAL(finished(QDBusPendingCallWatcher*)),
+            SLOT(gotListingRooms(QDBusPendingCallWatcher*)));
+}
+
+QStringList RoomListChannel::Private::wordsFor(const RoomInfo &room)
+{
+    QStringList words;
+    words << wordsFor(qdbus_cast<QString>(room.info.value(QLatin1String("handle-name"))));
+    words << wordsFor(qdbus_cast<QString>(room.info.value(QLatin1String("name"))));
+    words << wordsFor(qdbus_cast<QString>(room.info.value(QLatin1String("subject"))));
+    words.removeDuplicates();
+    return words;
+}
+
+QStringList RoomListChannel::Private::wordsFor(const QString &text)
+{
+    QStringList words;
+    QString word;
+    foreach (const QChar &c, text) {
+        if (c.isLetterOrNumber()) {
+            word.append(c.toLower());
+        } else if (!word.isEmpty()) {
+            words << word;
+            word.clear();
+        }
+    }
+    if (!word.isEmpty()) {
+        words << word;
+    }
+    return words;
+}
+
+uint RoomListChannel::Private::membersFor(const RoomInfo &room)
+{
+    return qdbus_cast<uint>(room.info.value(QLatin1String("members")));
+}
+
+void RoomListChannel::Private::addRooms(const RoomInfoList &newRooms)
+{
+    foreach (const RoomInfo &room, newRooms) {
+        int position = room.handle ? positionsByHandle.value(room.handle, -1) : -1;
+        if (position >= 0) {
+            // Already known room, update its information
+            unindexRoom(position);
+            rooms[position] = room;
+        } else {
+            position = rooms.size();
+            rooms.append(room);
+            if (room.handle) {
+                positionsByHandle.insert(room.handle, position);
+            }
+            positionsByMembers.append(position);
+        }
+        indexRoom(position);
+    }
+
+    if (!newRooms.isEmpty()) {
+        positionsByMembersSorted = false;
+    }
+}
+
+void RoomListChannel::Private::indexRoom(int position)
+{
+    const RoomInfo &room = rooms.at(position);
+    foreach (const QString &word, wordsFor(room)) {
+        QList<int> &positions = positionsByWord[word];
+        // Keep the positions sorted, new rooms are always appended
+        if (positions.isEmpty() || positions.last() < position) {
+            positions.append(position);
+        } else {
+            positions.insert(std::lower_bound(positions.begin(), positions.end(), position),
+                    position);
+        }
+    }
+}
+
+void RoomListChannel::Private::unindexRoom(int position)
+{
+    const RoomInfo &room = rooms.at(position);
+    foreach (const QString &word, wordsFor(room)) {
+        QMap<QString, QList<int> >::iterator it = positionsByWord.find(word);
+        if (it == positionsByWord.end()) {
+            continue;
+        }
+        it.value().removeOne(position);
+        if (it.value().isEmpty()) {
+            positionsByWord.erase(it);
+        }
+    }
+}
+
+void RoomListChannel::Private::sortPositionsByMembers() const
+{
+    if (positionsByMembersSorted) {
+        return;
+    }
+
+    std::sort(positionsByMembers.begin(), positionsByMembers.end(), MoreMembers(rooms));
+    positionsByMembersSorted = true;
+}
+
+QList<int> RoomListChannel::Private::matchingRooms(const QString &text,
+        uint minimumMembers) const
+{
+    QList<int> ret;
+    QStringList queryWords = wordsFor(text);
+
+    if (queryWords.isEmpty()) {
+        if (minimumMembers == 0) {
+            for (int i = 0; i < rooms.size(); ++i) {
+                ret << i;
+            }
+            return ret;
+        }
+
+        // The rooms with enough members are at the beginning of positionsByMembers
+        sortPositionsByMembers();
+        QList<int>::const_iterator end = std::lower_bound(positionsByMembers.constBegin(),
+                positionsByMembers.constEnd(), minimumMembers, AtLeastMembers(rooms));
+        for (QList<int>::const_iterator it = positionsByMembers.constBegin(); it != end; ++it) {
+            ret << *it;
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    }
+
+    // Each query word must be a prefix of a word of the room name, identifier or subject
+    QSet<int> matches;
+    bool first = true;
+    foreach (const QString &queryWord, queryWords) {
+        QSet<int> wordMatches;
+        QMap<QString, QList<int> >::const_iterator it = positionsByWord.lowerBound(queryWord);
+        for (; it != positionsByWord.constEnd() && it.key().startsWith(queryWord); ++it) {
+            foreach (int position, it.value()) {
+                if (first || matches.contains(position)) {
+                    wordMatches.insert(position);
+                }
+            }
+        }
+        matches = wordMatches;
+        first = false;
+        if (matches.isEmpty()) {
+            return ret;
+        }
+    }
+
+    foreach (int position, matches) {
+        if (minimumMembers == 0 || membersFor(rooms.at(position)) >= minimumMembers) {
+            ret << position;
+        }
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+RoomInfoList RoomListChannel::Private::page(const QList<int> &positions, int offset,
+        int limit) const
+{
+    RoomInfoList ret;
+    if (offset < 0) {
+        offset = 0;
+    }
+    int end = positions.size();
+    // offset + limit could overflow, with INT_MAX as no limit
+    if (limit >= 0 && limit < end - offset) {
+        end = offset + limit;
+    }
+    for (int i = offset; i < end; ++i) {
+        ret << rooms.at(positions.at(i));
+    }
+    return ret;
+}
+
 /**
  * \class RoomListChannel
  * \ingroup clientchannel
@@ -51,14 +334,30 @@ RoomListChannel::Private::~Private()
  *
  * \brief The RoomListChannel class represents a Telepathy Channel of type RoomList.
  *
- * Note that this subclass of Channel will eventually provide a high-level API for the
- * RoomList interface. Until then, it's just a Channel.
+ * Once RoomListChannel::FeatureCore is ready, the rooms announced by the service after
+ * listRooms() has been called are added to an in-memory index as they are received, which can
+ * be browsed page by page with rooms() and roomsByMemberCount(), and searched by room name,
+ * identifier and subject with searchRooms(). Each batch of received rooms is also signalled by
+ * roomsReceived().
  *
  * For more details, please refer to \telepathy_spec.
  *
  * See \ref async_model, \ref shared_ptr
  */
 
+/**
+ * Feature representing the core that needs to become ready to make the
+ * RoomListChannel object usable.
+ *
+ * Note that this feature must be enabled in order to use most
+ * RoomListChannel methods.
+ * See specific methods documentation for more details.
+ *
+ * When calling isReady(), becomeReady(), this feature is implicitly added
+ * to the requested features.
+ */
+const Feature RoomListChannel::FeatureCore = Feature(QLatin1String(RoomListChannel::staticMetaObject.className()), 0);
+
 /**
  * Create a new RoomListChannel object.
  *
@@ -73,7 +372,7 @@ RoomListChannelPtr RoomListChannel::create(const ConnectionPtr &connection,
         const QString &objectPath, const QVariantMap &immutableProperties)
 {
     return RoomListChannelPtr(new RoomListChannel(connection, objectPath,
-                immutableProperties));
+                immutableProperties, RoomListChannel::FeatureCore));
 }
 
 /**
@@ -84,14 +383,14 @@ RoomListChannelPtr RoomListChannel::create(const ConnectionPtr &connection,
  * \param objectPath The channel object path.
  * \param immutableProperties The channel immutable properties.
  * \param coreFeature The core feature of the channel type, if any. The corresponding introspectable should
- *                    should depend on Channel::FeatureCore.
+ *                    depend on RoomListChannel::FeatureCore.
  */
 RoomListChannel::RoomListChannel(const ConnectionPtr &connection,
         const QString &objectPath,
         const QVariantMap &immutableProperties,
         const Feature &coreFeature)
     : Channel(connection, objectPath, immutableProperties, coreFeature),
-      mPriv(new Private())
+      mPriv(new Private(this, immutableProperties))
 {
 }
 
@@ -103,4 +402,294 @@ RoomListChannel::~RoomListChannel()
     delete mPriv;
 }
 
+/**
+ * Return the DNS name of the server whose rooms are listed by this channel.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \return For protocols with a concept of chatrooms on multiple servers with different DNS
+ *         names (like XMPP), the DNS name of the server whose rooms are listed by this channel,
+ *         e.g. "conference.jabber.org". Otherwise, an empty string.
+ */
+QString RoomListChannel::server() const
+{
+    return mPriv->server;
+}
+
+/**
+ * Return whether a room listing is in progress on this channel.
+ *
+ * Change notification is via the listingRoomsChanged() signal.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \return \c true if rooms are being listed, \c false otherwise.
+ * \sa listRooms(), stopListing()
+ */
+bool RoomListChannel::isListingRooms() const
+{
+    return mPriv->listingRooms;
+}
+
+/**
+ * Request the list of rooms from the server.
+ *
+ * The rooms are added to the room index as they are received, and each received batch is
+ * signalled by roomsReceived().
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \return A PendingOperation which will emit PendingOperation::finished
+ *         when the call has finished.
+ * \sa stopListing(), isListingRooms()
+ */
+PendingOperation *RoomListChannel::listRooms()
+{
+    if (!isReady(FeatureCore)) {
+        return new PendingFailure(TP_QT_ERROR_NOT_AVAILABLE,
+                QLatin1String("Channel not ready"),
+                RoomListChannelPtr(this));
+    }
+
+    return new PendingVoid(mPriv->roomListInterface->ListRooms(),
+            RoomListChannelPtr(this));
+}
+
+/**
+ * Stop the room listing if it's in progress, without closing the channel.
+ *
+ * The rooms already received are kept in the room index.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \return A PendingOperation which will emit PendingOperation::finished
+ *         when the call has finished.
+ * \sa listRooms(), clearRooms()
+ */
+PendingOperation *RoomListChannel::stopListing()
+{
+    if (!isReady(FeatureCore)) {
+        return new PendingFailure(TP_QT_ERROR_NOT_AVAILABLE,
+                QLatin1String("Channel not ready"),
+                RoomListChannelPtr(this));
+    }
+
+    return new PendingVoid(mPriv->roomListInterface->StopListing(),
+            RoomListChannelPtr(this));
+}
+
+/**
+ * Return the number of rooms received so far.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \return The number of rooms in the room index.
+ */
+int RoomListChannel::roomCount() const
+{
+    return mPriv->rooms.size();
+}
+
+/**
+ * Return whether the room with the given \a handle has been received.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \param handle The handle of the room.
+ * \return \c true if the room is in the room index, \c false otherwise.
+ * \sa room()
+ */
+bool RoomListChannel::hasRoom(uint handle) const
+{
+    return mPriv->positionsByHandle.contains(handle);
+}
+
+/**
+ * Return the information about the room with the given \a handle.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \param handle The handle of the room.
+ * \return The room information, or a RoomInfo with a zero handle if the room has not been
+ *         received.
+ * \sa hasRoom()
+ */
+RoomInfo RoomListChannel::room(uint handle) const
+{
+    int position = mPriv->positionsByHandle.value(handle, -1);
+    if (position < 0) {
+        RoomInfo ret;
+        ret.handle = 0;
+        return ret;
+    }
+    return mPriv->rooms.at(position);
+}
+
+/**
+ * Return a page of the rooms received so far, in the order they were received.
+ *
+ * The cost of this method only depends on the number of returned rooms.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \param offset The position of the first room to return.
+ * \param limit The maximum number of rooms to return, or -1 to return all the remaining rooms.
+ * \return A list of rooms.
+ * \sa roomsByMemberCount(), searchRooms()
+ */
+RoomInfoList RoomListChannel::rooms(int offset, int limit) const
+{
+    if (offset <= 0 && limit < 0) {
+        return mPriv->rooms;
+    }
+
+    if (offset < 0) {
+        offset = 0;
+    }
+    return mPriv->rooms.mid(offset, limit);
+}
+
+/**
+ * Return a page of the rooms received so far, ordered by decreasing number of members.
+ *
+ * The number of members of a room is taken from its "members" information, rooms without it
+ * being considered as having no members. Rooms with the same number of members are returned in
+ * the order they were received.
+ *
+ * The rooms are sorted the first time this method is called after new rooms have been received,
+ * which costs O(N log N) for N rooms. Until more rooms are received, the cost of getting any page
+ * then only depends on the number of returned rooms.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \param offset The position of the first room to return.
+ * \param limit The maximum number of rooms to return, or -1 to return all the remaining rooms.
+ * \return A list of rooms.
+ * \sa rooms(), searchRooms()
+ */
+RoomInfoList RoomListChannel::roomsByMemberCount(int offset, int limit) const
+{
+    mPriv->sortPositionsByMembers();
+    return mPriv->page(mPriv->positionsByMembers, offset, limit);
+}
+
+/**
+ * Return a page of the rooms received so far matching the given search \a text, in the order
+ * they were received.
+ *
+ * The \a text is split into words, and a room matches if each of these words is the
+ * beginning of a word of its identifier, name or subject, ignoring case. If \a text contains no
+ * words, all rooms match.
+ *
+ * The matching rooms are looked up in a word index, and all of them have to be collected before
+ * the requested page can be returned, so that the cost of this method grows with the number of
+ * matching rooms rather than with the size of the page. When \a text contains no words and
+ * \a minimumMembers is 0, this is the same as rooms() and only depends on the size of the page.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \param text The text to search for.
+ * \param minimumMembers The minimum number of members of the matching rooms.
+ * \param offset The position of the first matching room to return.
+ * \param limit The maximum number of rooms to return, or -1 to return all the remaining
+ *              matching rooms.
+ * \return A list of rooms.
+ * \sa searchRoomsCount()
+ */
+RoomInfoList RoomListChannel::searchRooms(const QString &text, uint minimumMembers,
+        int offset, int limit) const
+{
+    if (minimumMembers == 0 && Private::wordsFor(text).isEmpty()) {
+        return rooms(offset, limit);
+    }
+
+    return mPriv->page(mPriv->matchingRooms(text, minimumMembers), offset, limit);
+}
+
+/**
+ * Return the number of rooms received so far matching the given search \a text.
+ *
+ * This method requires RoomListChannel::FeatureCore to be ready.
+ *
+ * \param text The text to search for.
+ * \param minimumMembers The minimum number of members of the matching rooms.
+ * \return The number of matching rooms.
+ * \sa searchRooms()
+ */
+int RoomListChannel::searchRoomsCount(const QString &text, uint minimumMembers) const
+{
+    if (minimumMembers == 0 && Private::wordsFor(text).isEmpty()) {
+        return mPriv->rooms.size();
+    }
+
+    return mPriv->matchingRooms(text, minimumMembers).size();
+}
+
+/**
+ * Remove all the rooms received so far from the room index.
+ *
+ * \sa listRooms()
+ */
+void RoomListChannel::clearRooms()
+{
+    mPriv->rooms.clear();
+    mPriv->positionsByHandle.clear();
+    mPriv->positionsByWord.clear();
+    mPriv->positionsByMembers.clear();
+    mPriv->positionsByMembersSorted = true;
+}
+
+void RoomListChannel::gotListingRooms(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<bool> reply = *watcher;
+
+    if (!reply.isError()) {
+        mPriv->listingRooms = reply.value();
+
+        debug() << "Got reply to RoomList::GetListingRooms()";
+        mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, true);
+    } else {
+        warning().nospace() << "RoomList::GetListingRooms() failed "
+            "with " << reply.error().name() << ": " << reply.error().message();
+        mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false,
+                reply.error());
+    }
+
+    watcher->deleteLater();
+}
+
+void RoomListChannel::onListingRooms(bool listing)
+{
+    if (mPriv->listingRooms == listing) {
+        return;
+    }
+
+    mPriv->listingRooms = listing;
+    emit listingRoomsChanged(listing);
+}
+
+void RoomListChannel::onGotRooms(const Tp::RoomInfoList &rooms)
+{
+    mPriv->addRooms(rooms);
+    emit roomsReceived(rooms);
+}
+
+/**
+ * \fn void RoomListChannel::listingRoomsChanged(bool listing)
+ *
+ * Emitted when the value of isListingRooms() changes.
+ *
+ * \param listing Whether rooms are being listed.
+ * \sa isListingRooms()
+ */
+
+/**
+ * \fn void RoomListChannel::roomsReceived(const Tp::RoomInfoList &rooms)
+ *
+ * Emitted when a batch of rooms has been received and added to the room index.
+ *
+ * \param rooms The received rooms.
+ * \sa rooms(), searchRooms()
+ */
+
 } // Tp
@@ -28,25 +28,55 @@
 #endif
 
 #include <TelepathyQt/Channel>
+#include <TelepathyQt/Types>
 
 namespace Tp
 {
 
+class PendingOperation;
+
 class TP_QT_EXPORT RoomListChannel : public Channel
 {
     Q_OBJECT
     Q_DISABLE_COPY(RoomListChannel)
 
 public:
+    static const Feature FeatureCore;
+
     static RoomListChannelPtr create(const ConnectionPtr &connection,
             const QString &objectPath, const QVariantMap &immutableProperties);
 
     virtual ~RoomListChannel();
 
+    QString server() const;
+    bool isListingRooms() const;
+
+    PendingOperation *listRooms();
+    PendingOperation *stopListing();
+
+    int roomCount() const;
+    bool hasRoom(uint handle) const;
+    RoomInfo room(uint handle) const;
+    RoomInfoList rooms(int offset = 0, int limit = -1) const;
+    RoomInfoList roomsByMemberCount(int offset = 0, int limit = -1) const;
+    RoomInfoList searchRooms(const QString &text, uint minimumMembers = 0,
+            int offset = 0, int limit = -1) const;
+    int searchRoomsCount(const QString &text, uint minimumMembers = 0) const;
+    void clearRooms();
+
+Q_SIGNALS:
+    void listingRoomsChanged(bool listing);
+    void roomsReceived(const Tp::RoomInfoList &rooms);
+
 protected:
     RoomListChannel(const ConnectionPtr &connection, const QString &objectPath,
             const QVariantMap &immutableProperties,
-            const Feature &coreFeature = Channel::FeatureCore);
+            const Feature &coreFeature = RoomListChannel::FeatureCore);
+
+private Q_SLOTS:
+    TP_QT_NO_EXPORT void gotListingRooms(QDBusPendingCallWatcher *watcher);
+    TP_QT_NO_EXPORT void onListingRooms(bool listing);
+    TP_QT_NO_EXPORT void onGotRooms(const Tp::RoomInfoList &rooms);
 
 private:
     struct Private;
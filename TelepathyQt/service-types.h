@@ -51,10 +51,12 @@ class BaseConnectionAliasingInterface;
 class BaseConnectionAvatarsInterface;
 class BaseConnectionClientTypesInterface;
 class BaseConnectionContactCapabilitiesInterface;
+class BaseConnectionDBusMetricsInterface;
 class BaseConnectionManager;
 class BaseProtocol;
 class BaseProtocolAddressingInterface;
 class BaseProtocolAvatarsInterface;
+class BaseProtocolBulkNormalizationInterface;
 class BaseProtocolPresenceInterface;
 class BaseChannel;
 class BaseChannelTextType;
@@ -98,10 +100,12 @@ typedef SharedPtr<BaseConnectionAliasingInterface> BaseConnectionAliasingInterfa
 typedef SharedPtr<BaseConnectionAvatarsInterface> BaseConnectionAvatarsInterfacePtr;
 typedef SharedPtr<BaseConnectionClientTypesInterface> BaseConnectionClientTypesInterfacePtr;
 typedef SharedPtr<BaseConnectionContactCapabilitiesInterface> BaseConnectionContactCapabilitiesInterfacePtr;
+typedef SharedPtr<BaseConnectionDBusMetricsInterface> BaseConnectionDBusMetricsInterfacePtr;
 typedef SharedPtr<BaseConnectionManager> BaseConnectionManagerPtr;
 typedef SharedPtr<BaseProtocol> BaseProtocolPtr;
 typedef SharedPtr<BaseProtocolAddressingInterface> BaseProtocolAddressingInterfacePtr;
 typedef SharedPtr<BaseProtocolAvatarsInterface> BaseProtocolAvatarsInterfacePtr;
+typedef SharedPtr<BaseProtocolBulkNormalizationInterface> BaseProtocolBulkNormalizationInterfacePtr;
 typedef SharedPtr<BaseProtocolPresenceInterface> BaseProtocolPresenceInterfacePtr;
 typedef SharedPtr<BaseChannel> BaseChannelPtr;
 typedef SharedPtr<BaseChannelCallType> BaseChannelCallTypePtr;
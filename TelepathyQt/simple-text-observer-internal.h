@@ -24,6 +24,10 @@
 #include <TelepathyQt/Message>
 #include <TelepathyQt/SimpleObserver>
 #include <TelepathyQt/TextChannel>
+#include "TelepathyQt/text-channel-internal.h"
+
+#include <QList>
+#include <QSet>
 
 namespace Tp
 {
@@ -34,37 +38,21 @@ struct TP_QT_NO_EXPORT SimpleTextObserver::Private
             const QString &contactIdentifier, bool requiresNormalization);
     ~Private();
 
-    class TextChannelWrapper;
+    void queueReceivedMessage(const ReceivedMessage &message, const TextChannelPtr &channel);
 
     SimpleTextObserver *parent;
     AccountPtr account;
     QString contactIdentifier;
     SimpleObserverPtr observer;
-    QHash<ChannelPtr, TextChannelWrapper*> channels;
-};
-
-class TP_QT_NO_EXPORT SimpleTextObserver::Private::TextChannelWrapper :
-                public QObject
-{
-    Q_OBJECT
-    Q_DISABLE_COPY(TextChannelWrapper)
-
-public:
-    TextChannelWrapper(const Tp::TextChannelPtr &channel);
-    ~TextChannelWrapper() { }
-
-Q_SIGNALS:
-    void channelMessageSent(const Tp::Message &message, Tp::MessageSendingFlags flags,
-            const QString &sentMessageToken, const Tp::TextChannelPtr &channel);
-    void channelMessageReceived(const Tp::ReceivedMessage &message, const Tp::TextChannelPtr &channel);
+    QSet<ChannelPtr> channels;
 
-private Q_SLOTS:
-    void onChannelMessageSent(const Tp::Message &message, Tp::MessageSendingFlags flags,
-            const QString &sentMessageToken);
-    void onChannelMessageReceived(const Tp::ReceivedMessage &message);
+    // Feeds the Messages signals of the channels on the connection of the account
+    SharedPtr<TextMessagesSubscription> messagesSubscription;
 
-private:
-    TextChannelPtr mChannel;
+    // Received messages waiting to be signalled with messagesReceived()
+    bool flushReceivedMessagesScheduled;
+    QList<ReceivedMessage> receivedMessages;
+    QList<TextChannelPtr> receivedMessagesChannels;
 };
 
 } // Tp
@@ -24,7 +24,6 @@
 #include "TelepathyQt/simple-text-observer-internal.h"
 
 #include "TelepathyQt/_gen/simple-text-observer.moc.hpp"
-#include "TelepathyQt/_gen/simple-text-observer-internal.moc.hpp"
 
 #include "TelepathyQt/debug-internal.h"
 
@@ -39,6 +38,8 @@
 #include <TelepathyQt/PendingReady>
 #include <TelepathyQt/PendingSuccess>
 
+#include <QTimer>
+
 namespace Tp
 {
 
@@ -47,7 +48,8 @@ SimpleTextObserver::Private::Private(SimpleTextObserver *parent,
         const QString &contactIdentifier, bool requiresNormalization)
     : parent(parent),
       account(account),
-      contactIdentifier(contactIdentifier)
+      contactIdentifier(contactIdentifier),
+      flushReceivedMessagesScheduled(false)
 {
     debug() << "Creating a new SimpleTextObserver";
     ChannelClassSpec channelFilter = ChannelClassSpec::textChat();
@@ -56,6 +58,15 @@ SimpleTextObserver::Private::Private(SimpleTextObserver *parent,
             QList<ChannelClassFeatures>() << ChannelClassFeatures(channelFilter,
                 TextChannel::FeatureMessageQueue | TextChannel::FeatureMessageSentSignal));
 
+    // the channels observed from now on get their messages from a single subscription to the
+    // signals of the connection, as long as it is in place before they become ready
+    parent->connect(account.data(),
+            SIGNAL(connectionChanged(Tp::ConnectionPtr)),
+            SLOT(onAccountConnectionChanged(Tp::ConnectionPtr)));
+    if (account->connection()) {
+        messagesSubscription = TextMessagesSubscription::forConnection(account->connection());
+    }
+
     parent->connect(observer.data(),
             SIGNAL(newChannels(QList<Tp::ChannelPtr>)),
             SLOT(onNewChannels(QList<Tp::ChannelPtr>)));
@@ -66,33 +77,24 @@ SimpleTextObserver::Private::Private(SimpleTextObserver *parent,
 
 SimpleTextObserver::Private::~Private()
 {
-    foreach (TextChannelWrapper *wrapper, channels) {
-        delete wrapper;
-    }
 }
 
-SimpleTextObserver::Private::TextChannelWrapper::TextChannelWrapper(const TextChannelPtr &channel)
-    : mChannel(channel)
+void SimpleTextObserver::Private::queueReceivedMessage(const ReceivedMessage &message,
+        const TextChannelPtr &channel)
 {
-    connect(mChannel.data(),
-            SIGNAL(messageSent(Tp::Message,Tp::MessageSendingFlags,QString)),
-            SLOT(onChannelMessageSent(Tp::Message,Tp::MessageSendingFlags,QString)));
-    connect(mChannel.data(),
-            SIGNAL(messageReceived(Tp::ReceivedMessage)),
-            SLOT(onChannelMessageReceived(Tp::ReceivedMessage)));
-}
+    // only keep messages around if someone is interested in them
+    if (parent->receivers(SIGNAL(messagesReceived(QList<Tp::ReceivedMessage>,
+                        QList<Tp::TextChannelPtr>))) == 0) {
+        return;
+    }
 
-void SimpleTextObserver::Private::TextChannelWrapper::onChannelMessageSent(
-        const Tp::Message &message, Tp::MessageSendingFlags flags,
-        const QString &sentMessageToken)
-{
-    emit channelMessageSent(message, flags, sentMessageToken, mChannel);
-}
+    receivedMessages.append(message);
+    receivedMessagesChannels.append(channel);
 
-void SimpleTextObserver::Private::TextChannelWrapper::onChannelMessageReceived(
-        const Tp::ReceivedMessage &message)
-{
-    emit channelMessageReceived(message, mChannel);
+    if (!flushReceivedMessagesScheduled) {
+        flushReceivedMessagesScheduled = true;
+        QTimer::singleShot(0, parent, SLOT(flushReceivedMessages()));
+    }
 }
 
 /**
@@ -223,6 +225,15 @@ QList<TextChannelPtr> SimpleTextObserver::textChats() const
     return ret;
 }
 
+void SimpleTextObserver::onAccountConnectionChanged(const ConnectionPtr &connection)
+{
+    if (connection) {
+        mPriv->messagesSubscription = TextMessagesSubscription::forConnection(connection);
+    } else {
+        mPriv->messagesSubscription.reset();
+    }
+}
+
 void SimpleTextObserver::onNewChannels(const QList<ChannelPtr> &channels)
 {
     foreach (const ChannelPtr &channel, channels) {
@@ -244,17 +255,17 @@ void SimpleTextObserver::onNewChannels(const QList<ChannelPtr> &channels)
             continue;
         }
 
-        Private::TextChannelWrapper *wrapper = new Private::TextChannelWrapper(textChannel);
-        mPriv->channels.insert(channel, wrapper);
-        connect(wrapper,
-                SIGNAL(channelMessageSent(Tp::Message,Tp::MessageSendingFlags,QString,Tp::TextChannelPtr)),
-                SIGNAL(messageSent(Tp::Message,Tp::MessageSendingFlags,QString,Tp::TextChannelPtr)));
-        connect(wrapper,
-                SIGNAL(channelMessageReceived(Tp::ReceivedMessage,Tp::TextChannelPtr)),
-                SIGNAL(messageReceived(Tp::ReceivedMessage,Tp::TextChannelPtr)));
+        mPriv->channels.insert(channel);
+        connect(textChannel.data(),
+                SIGNAL(messageSent(Tp::Message,Tp::MessageSendingFlags,QString)),
+                SLOT(onChannelMessageSent(Tp::Message,Tp::MessageSendingFlags,QString)));
+        connect(textChannel.data(),
+                SIGNAL(messageReceived(Tp::ReceivedMessage)),
+                SLOT(onChannelMessageReceived(Tp::ReceivedMessage)));
 
         foreach (const ReceivedMessage &message, textChannel->messageQueue()) {
             emit messageReceived(message, textChannel);
+            mPriv->queueReceivedMessage(message, textChannel);
         }
     }
 }
@@ -263,8 +274,36 @@ void SimpleTextObserver::onChannelInvalidated(const ChannelPtr &channel)
 {
     // it may happen that the channel received in onNewChannels is not a text channel somehow, thus
     // the channel won't be added to mPriv->channels
-    if (mPriv->channels.contains(channel)) {
-        delete mPriv->channels.take(channel);
+    if (mPriv->channels.remove(channel)) {
+        channel->disconnect(this);
+    }
+}
+
+void SimpleTextObserver::onChannelMessageSent(const Message &message,
+        MessageSendingFlags flags, const QString &sentMessageToken)
+{
+    TextChannelPtr channel(qobject_cast<TextChannel *>(sender()));
+    emit messageSent(message, flags, sentMessageToken, channel);
+}
+
+void SimpleTextObserver::onChannelMessageReceived(const ReceivedMessage &message)
+{
+    TextChannelPtr channel(qobject_cast<TextChannel *>(sender()));
+    emit messageReceived(message, channel);
+    mPriv->queueReceivedMessage(message, channel);
+}
+
+void SimpleTextObserver::flushReceivedMessages()
+{
+    mPriv->flushReceivedMessagesScheduled = false;
+
+    QList<ReceivedMessage> messages = mPriv->receivedMessages;
+    QList<TextChannelPtr> channels = mPriv->receivedMessagesChannels;
+    mPriv->receivedMessages.clear();
+    mPriv->receivedMessagesChannels.clear();
+
+    if (!messages.isEmpty()) {
+        emit messagesReceived(messages, channels);
     }
 }
 
@@ -295,4 +334,25 @@ void SimpleTextObserver::onChannelInvalidated(const ChannelPtr &channel)
  * \param channel The channel which received the message.
  */
 
+/**
+ * \fn void SimpleTextObserver::messagesReceived(const QList<Tp::ReceivedMessage> &messages,
+ *                  const QList<Tp::TextChannelPtr> &channels);
+ *
+ * Emitted once per main loop iteration with all the text messages on account() received
+ * since the last emission, in the order they were received.
+ *
+ * This carries the same messages as messageReceived() and is meant for applications observing
+ * many channels, such as loggers, which prefer handling messages in bulk. Messages are only
+ * collected while this signal is connected to.
+ *
+ * The observed channels of a connection share a single subscription to its Messages signals,
+ * and the senders of the messages queued on them are resolved together, so that a batch of new
+ * channels with pending messages becomes ready at once. Messages received on a channel are still
+ * signalled in the order the channel received them.
+ *
+ * \param messages The messages received.
+ * \param channels The channels which received the messages, \a channels[i] being the channel
+ *                 which received \a messages[i].
+ */
+
 } // Tp
@@ -26,6 +26,7 @@
 #include <TelepathyQt/Constants>
 #include <TelepathyQt/Types>
 
+#include <QList>
 #include <QObject>
 
 namespace Tp
@@ -58,10 +59,17 @@ Q_SIGNALS:
     void messageSent(const Tp::Message &message, Tp::MessageSendingFlags flags,
             const QString &sentMessageToken, const Tp::TextChannelPtr &channel);
     void messageReceived(const Tp::ReceivedMessage &message, const Tp::TextChannelPtr &channel);
+    void messagesReceived(const QList<Tp::ReceivedMessage> &messages,
+            const QList<Tp::TextChannelPtr> &channels);
 
 private Q_SLOTS:
+    TP_QT_NO_EXPORT void onAccountConnectionChanged(const Tp::ConnectionPtr &connection);
     TP_QT_NO_EXPORT void onNewChannels(const QList<Tp::ChannelPtr> &channels);
     TP_QT_NO_EXPORT void onChannelInvalidated(const Tp::ChannelPtr &channel);
+    TP_QT_NO_EXPORT void onChannelMessageSent(const Tp::Message &message,
+            Tp::MessageSendingFlags flags, const QString &sentMessageToken);
+    TP_QT_NO_EXPORT void onChannelMessageReceived(const Tp::ReceivedMessage &message);
+    TP_QT_NO_EXPORT void flushReceivedMessages();
 
 private:
     TP_QT_NO_EXPORT static SimpleTextObserverPtr create(const AccountPtr &account,
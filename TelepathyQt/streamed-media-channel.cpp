@@ -34,6 +34,7 @@
 #include <TelepathyQt/PendingVoid>
 
 #include <QHash>
+#include <QTimer>
 
 namespace Tp
 {
@@ -264,15 +265,9 @@ void StreamedMediaStream::Private::introspectContact(StreamedMediaStream::Privat
     }
 
     debug() << "Introspecting stream contact";
-    ContactManagerPtr contactManager =
-        self->parent->channel()->connection()->contactManager();
-    debug() << "contact manager" << contactManager;
     // TODO: pass id hints to ContactManager if we ever gain support to retrieve contact ids
     //       from MediaStreamInfo or something similar.
-    self->parent->connect(contactManager->contactsForHandles(
-                UIntList() << self->contactHandle),
-            SIGNAL(finished(Tp::PendingOperation*)),
-            SLOT(gotContact(Tp::PendingOperation*)));
+    self->parent->channel()->requestStreamContact(self->parent, self->contactHandle);
 }
 
 PendingOperation *StreamedMediaStream::Private::updateDirection(
@@ -686,18 +681,20 @@ void StreamedMediaStream::gotContact(PendingOperation *op)
         return;
     }
 
-    QList<ContactPtr> contacts = pc->contacts();
-    UIntList invalidHandles = pc->invalidHandles();
-    if (contacts.size()) {
-        Q_ASSERT(contacts.size() == 1);
-        Q_ASSERT(invalidHandles.size() == 0);
-        mPriv->contact = contacts.first();
+    // the request is shared by all the streams of the channel, pick our own contact
+    foreach (const ContactPtr &contact, pc->contacts()) {
+        if (contact->handle()[0] == mPriv->contactHandle) {
+            mPriv->contact = contact;
+            break;
+        }
+    }
 
+    if (mPriv->contact) {
         debug() << "Got stream contact";
         debug() << "Stream ready";
         mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, true);
     } else {
-        Q_ASSERT(invalidHandles.size() == 1);
+        Q_ASSERT(pc->invalidHandles().contains(mPriv->contactHandle));
         warning().nospace() << "Error retrieving media stream contact (invalid handle)";
         mPriv->readinessHelper->setIntrospectCompleted(FeatureCore, false,
                 TP_QT_ERROR_INVALID_ARGUMENT,
@@ -765,6 +762,11 @@ struct TP_QT_NO_EXPORT StreamedMediaChannel::Private
     StreamedMediaStreams incompleteStreams;
     StreamedMediaStreams streams;
 
+    // Batched resolution of stream contacts
+    bool requestStreamContactsScheduled;
+    QSet<uint> streamContactsHandles;
+    QList<WeakPtr<StreamedMediaStream> > streamContactsQueue;
+
     LocalHoldState localHoldState;
     LocalHoldStateReason localHoldStateReason;
 };
@@ -773,6 +775,7 @@ StreamedMediaChannel::Private::Private(StreamedMediaChannel *parent)
     : parent(parent),
       properties(parent->interface<Client::DBus::PropertiesInterface>()),
       readinessHelper(parent->readinessHelper()),
+      requestStreamContactsScheduled(false),
       localHoldState(LocalHoldStateUnheld),
       localHoldStateReason(LocalHoldStateReasonNone)
 {
@@ -1536,4 +1539,46 @@ StreamedMediaStreamPtr StreamedMediaChannel::lookupStreamById(uint streamId)
     return StreamedMediaStreamPtr();
 }
 
+/*
+ * Streams do not resolve their contact on their own. Instead, the handles of all
+ * streams becoming ready within the same main loop iteration, such as the ones
+ * listed by ListStreams or added in a burst of StreamAdded signals, are resolved
+ * with a single contacts request.
+ */
+void StreamedMediaChannel::requestStreamContact(StreamedMediaStream *stream, uint contactHandle)
+{
+    mPriv->streamContactsHandles.insert(contactHandle);
+    mPriv->streamContactsQueue.append(
+            WeakPtr<StreamedMediaStream>(StreamedMediaStreamPtr(stream)));
+
+    if (!mPriv->requestStreamContactsScheduled) {
+        mPriv->requestStreamContactsScheduled = true;
+        QTimer::singleShot(0, this, SLOT(doRequestStreamContacts()));
+    }
+}
+
+void StreamedMediaChannel::doRequestStreamContacts()
+{
+    mPriv->requestStreamContactsScheduled = false;
+
+    debug() << "Requesting" << mPriv->streamContactsHandles.size() <<
+        "stream contacts for" << mPriv->streamContactsQueue.size() << "streams";
+
+    ContactManagerPtr contactManager = connection()->contactManager();
+    PendingContacts *contacts = contactManager->contactsForHandles(
+            mPriv->streamContactsHandles.toList());
+
+    foreach (const WeakPtr<StreamedMediaStream> &weakStream, mPriv->streamContactsQueue) {
+        StreamedMediaStreamPtr stream(weakStream);
+        if (stream) {
+            stream->connect(contacts,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(gotContact(Tp::PendingOperation*)));
+        }
+    }
+
+    mPriv->streamContactsHandles.clear();
+    mPriv->streamContactsQueue.clear();
+}
+
 } // Tp
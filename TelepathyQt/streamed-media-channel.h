@@ -212,11 +212,15 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void gotLocalHoldState(QDBusPendingCallWatcher *);
     TP_QT_NO_EXPORT void onLocalHoldStateChanged(uint, uint);
 
+    TP_QT_NO_EXPORT void doRequestStreamContacts();
+
 private:
     friend class PendingStreamedMediaStreams;
+    friend class StreamedMediaStream;
 
     StreamedMediaStreamPtr addStream(const MediaStreamInfo &streamInfo);
     StreamedMediaStreamPtr lookupStreamById(uint streamId);
+    TP_QT_NO_EXPORT void requestStreamContact(StreamedMediaStream *stream, uint contactHandle);
 
     struct Private;
     friend struct Private;
@@ -0,0 +1,87 @@
+/**
+ * This file is part of TelepathyQt
+ *
+ * @copyright Copyright (C) 2026 TelepathyQt contributors
+ * @license LGPL 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TelepathyQt_text_channel_internal_h_HEADER_GUARD_
+#define _TelepathyQt_text_channel_internal_h_HEADER_GUARD_
+
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/SharedPtr>
+#include <TelepathyQt/TextChannel>
+#include <TelepathyQt/Types>
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+namespace Tp
+{
+
+class TP_QT_NO_EXPORT TextMessagesSubscription : public QObject, public RefCounted
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(TextMessagesSubscription)
+
+public:
+    static SharedPtr<TextMessagesSubscription> lookup(const ConnectionPtr &connection);
+    static SharedPtr<TextMessagesSubscription> forConnection(const ConnectionPtr &connection);
+    ~TextMessagesSubscription();
+
+    void addMessageQueueChannel(TextChannel *channel);
+    void addMessageSentChannel(TextChannel *channel);
+    void removeChannel(TextChannel *channel, const QString &objectPath);
+
+    void requestContacts(TextChannel *channel, const HandleIdentifierMap &contacts);
+
+private Q_SLOTS:
+    void onMessageReceived(const QDBusMessage &message);
+    void onPendingMessagesRemoved(const QDBusMessage &message);
+    void onMessageSent(const QDBusMessage &message);
+    void flushContactRequests();
+
+private:
+    typedef QHash<QString, QList<TextChannel *> > ChannelsByPath;
+
+    TextMessagesSubscription(const ConnectionPtr &connection);
+
+    static QList<QPointer<TextChannel> > channelsAt(const ChannelsByPath &channels,
+            const QString &objectPath);
+
+    WeakPtr<Connection> mConnection;
+    QDBusConnection mBus;
+    QString mBusName;
+    ChannelsByPath mMessageQueueChannels;
+    ChannelsByPath mMessageSentChannels;
+
+    // Senders to resolve with the next contactsForHandles() call
+    bool mContactRequestsScheduled;
+    HandleIdentifierMap mContactsRequired;
+    QList<QPointer<TextChannel> > mContactsChannels;
+
+    static QHash<QString, WeakPtr<TextMessagesSubscription> > subscriptions;
+};
+
+} // Tp
+
+#endif
@@ -21,8 +21,10 @@
  */
 
 #include <TelepathyQt/TextChannel>
+#include "TelepathyQt/text-channel-internal.h"
 
 #include "TelepathyQt/_gen/text-channel.moc.hpp"
+#include "TelepathyQt/_gen/text-channel-internal.moc.hpp"
 
 #include "TelepathyQt/debug-internal.h"
 
@@ -37,6 +39,7 @@
 #include <TelepathyQt/ReferencedHandles>
 
 #include <QDateTime>
+#include <QTimer>
 
 namespace Tp
 {
@@ -51,6 +54,7 @@ struct TP_QT_NO_EXPORT TextChannel::Private
     static void introspectMessageSentSignal(Private *self);
     static void enableChatStateNotifications(Private *self);
 
+    bool useMessagesSubscription();
     void updateInitialMessages();
     void updateCapabilities();
 
@@ -68,6 +72,9 @@ struct TP_QT_NO_EXPORT TextChannel::Private
 
     ReadinessHelper *readinessHelper;
 
+    // FeatureMessageQueue and FeatureMessageSentSignal, if the connection has one
+    SharedPtr<TextMessagesSubscription> messagesSubscription;
+
     // FeatureMessageCapabilities and FeatureMessageQueue
     QVariantMap props;
     bool getAllInFlight;
@@ -166,6 +173,10 @@ TextChannel::Private::Private(TextChannel *parent)
 
 TextChannel::Private::~Private()
 {
+    if (messagesSubscription) {
+        messagesSubscription->removeChannel(parent, parent->objectPath());
+    }
+
     foreach (MessageEvent *e, incompleteMessages) {
         delete e;
     }
@@ -186,12 +197,16 @@ void TextChannel::Private::introspectMessageQueue(
 
         // FeatureMessageQueue needs signal connections + Get (but we
         // might as well do GetAll and reduce the number of code paths)
-        parent->connect(messagesInterface,
-                SIGNAL(MessageReceived(Tp::MessagePartList)),
-                SLOT(onMessageReceived(Tp::MessagePartList)));
-        parent->connect(messagesInterface,
-                SIGNAL(PendingMessagesRemoved(Tp::UIntList)),
-                SLOT(onPendingMessagesRemoved(Tp::UIntList)));
+        if (self->useMessagesSubscription()) {
+            self->messagesSubscription->addMessageQueueChannel(parent);
+        } else {
+            parent->connect(messagesInterface,
+                    SIGNAL(MessageReceived(Tp::MessagePartList)),
+                    SLOT(onMessageReceived(Tp::MessagePartList)));
+            parent->connect(messagesInterface,
+                    SIGNAL(PendingMessagesRemoved(Tp::UIntList)),
+                    SLOT(onPendingMessagesRemoved(Tp::UIntList)));
+        }
 
         if (!self->gotProperties && !self->getAllInFlight) {
             self->getAllInFlight = true;
@@ -260,9 +275,13 @@ void TextChannel::Private::introspectMessageSentSignal(
         Client::ChannelInterfaceMessagesInterface *messagesInterface =
             parent->interface<Client::ChannelInterfaceMessagesInterface>();
 
-        parent->connect(messagesInterface,
-                SIGNAL(MessageSent(Tp::MessagePartList,uint,QString)),
-                SLOT(onMessageSent(Tp::MessagePartList,uint,QString)));
+        if (self->useMessagesSubscription()) {
+            self->messagesSubscription->addMessageSentChannel(parent);
+        } else {
+            parent->connect(messagesInterface,
+                    SIGNAL(MessageSent(Tp::MessagePartList,uint,QString)),
+                    SLOT(onMessageSent(Tp::MessagePartList,uint,QString)));
+        }
     } else {
         parent->connect(self->textInterface,
                 SIGNAL(Sent(uint,uint,QString)),
@@ -288,6 +307,14 @@ void TextChannel::Private::enableChatStateNotifications(
     self->readinessHelper->setIntrospectCompleted(FeatureChatState, true);
 }
 
+bool TextChannel::Private::useMessagesSubscription()
+{
+    if (!messagesSubscription) {
+        messagesSubscription = TextMessagesSubscription::lookup(parent->connection());
+    }
+    return !messagesSubscription.isNull();
+}
+
 void TextChannel::Private::updateInitialMessages()
 {
     if (!readinessHelper->requestedFeatures().contains(FeatureMessageQueue) ||
@@ -407,13 +434,17 @@ void TextChannel::Private::processMessageQueue()
         return;
     }
 
-    ConnectionPtr conn = parent->connection();
-    conn->lowlevel()->injectContactIds(contactsRequired);
+    if (messagesSubscription) {
+        messagesSubscription->requestContacts(parent, contactsRequired);
+    } else {
+        ConnectionPtr conn = parent->connection();
+        conn->lowlevel()->injectContactIds(contactsRequired);
 
-    parent->connect(conn->contactManager()->contactsForHandles(
-                contactsRequired.keys()),
-            SIGNAL(finished(Tp::PendingOperation*)),
-            SLOT(onContactsFinished(Tp::PendingOperation*)));
+        parent->connect(conn->contactManager()->contactsForHandles(
+                    contactsRequired.keys()),
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(onContactsFinished(Tp::PendingOperation*)));
+    }
 
     awaitingContacts |= contactsRequired.keys().toSet();
 }
@@ -503,6 +534,219 @@ void TextChannel::Private::contactFound(ContactPtr contact)
     }
 }
 
+/*
+ * A TextMessagesSubscription matches the Messages signals of all the channels of a connection
+ * with one rule each, instead of one per channel and signal, for applications observing many text
+ * channels at once. Channels which start introspecting FeatureMessageQueue or
+ * FeatureMessageSentSignal while their connection has a subscription are fed from it, and the
+ * senders of the messages queued on all of them are resolved together, with one
+ * contactsForHandles() call per main loop iteration, so that a batch of channels with pending
+ * messages becomes ready together.
+ *
+ * The signals of a channel are still delivered to it in the order they were emitted.
+ */
+QHash<QString, WeakPtr<TextMessagesSubscription> > TextMessagesSubscription::subscriptions;
+
+static QString subscriptionKey(const ConnectionPtr &connection)
+{
+    return QString(QLatin1String("%1 %2"))
+        .arg(connection->dbusConnection().name())
+        .arg(connection->objectPath());
+}
+
+SharedPtr<TextMessagesSubscription> TextMessagesSubscription::lookup(
+        const ConnectionPtr &connection)
+{
+    if (subscriptions.isEmpty() || !connection) {
+        return SharedPtr<TextMessagesSubscription>();
+    }
+
+    SharedPtr<TextMessagesSubscription> subscription(
+            subscriptions.value(subscriptionKey(connection)));
+    // senders are resolved through the connection proxy of the subscription, which has to be
+    // the one of the channel
+    if (subscription && ConnectionPtr(subscription->mConnection) != connection) {
+        return SharedPtr<TextMessagesSubscription>();
+    }
+    return subscription;
+}
+
+SharedPtr<TextMessagesSubscription> TextMessagesSubscription::forConnection(
+        const ConnectionPtr &connection)
+{
+    QString key = subscriptionKey(connection);
+
+    SharedPtr<TextMessagesSubscription> subscription(subscriptions.value(key));
+    if (!subscription || ConnectionPtr(subscription->mConnection) != connection) {
+        QHash<QString, WeakPtr<TextMessagesSubscription> >::iterator i = subscriptions.begin();
+        while (i != subscriptions.end()) {
+            if (i.value().isNull()) {
+                i = subscriptions.erase(i);
+            } else {
+                ++i;
+            }
+        }
+
+        subscription = SharedPtr<TextMessagesSubscription>(
+                new TextMessagesSubscription(connection));
+        subscriptions.insert(key, WeakPtr<TextMessagesSubscription>(subscription));
+    }
+    return subscription;
+}
+
+TextMessagesSubscription::TextMessagesSubscription(const ConnectionPtr &connection)
+    : mConnection(connection),
+      mBus(connection->dbusConnection()),
+      mBusName(connection->busName()),
+      mContactRequestsScheduled(false)
+{
+    // an empty object path matches the signals of all the objects of the connection
+    mBus.connect(mBusName, QString(), TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+            QLatin1String("MessageReceived"), this, SLOT(onMessageReceived(QDBusMessage)));
+    mBus.connect(mBusName, QString(), TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+            QLatin1String("PendingMessagesRemoved"), this,
+            SLOT(onPendingMessagesRemoved(QDBusMessage)));
+    mBus.connect(mBusName, QString(), TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+            QLatin1String("MessageSent"), this, SLOT(onMessageSent(QDBusMessage)));
+}
+
+TextMessagesSubscription::~TextMessagesSubscription()
+{
+    mBus.disconnect(mBusName, QString(), TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+            QLatin1String("MessageReceived"), this, SLOT(onMessageReceived(QDBusMessage)));
+    mBus.disconnect(mBusName, QString(), TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+            QLatin1String("PendingMessagesRemoved"), this,
+            SLOT(onPendingMessagesRemoved(QDBusMessage)));
+    mBus.disconnect(mBusName, QString(), TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+            QLatin1String("MessageSent"), this, SLOT(onMessageSent(QDBusMessage)));
+}
+
+void TextMessagesSubscription::addMessageQueueChannel(TextChannel *channel)
+{
+    mMessageQueueChannels[channel->objectPath()].append(channel);
+}
+
+void TextMessagesSubscription::addMessageSentChannel(TextChannel *channel)
+{
+    mMessageSentChannels[channel->objectPath()].append(channel);
+}
+
+void TextMessagesSubscription::removeChannel(TextChannel *channel, const QString &objectPath)
+{
+    ChannelsByPath::iterator i = mMessageQueueChannels.find(objectPath);
+    if (i != mMessageQueueChannels.end() && i.value().removeAll(channel) && i.value().isEmpty()) {
+        mMessageQueueChannels.erase(i);
+    }
+
+    i = mMessageSentChannels.find(objectPath);
+    if (i != mMessageSentChannels.end() && i.value().removeAll(channel) && i.value().isEmpty()) {
+        mMessageSentChannels.erase(i);
+    }
+}
+
+void TextMessagesSubscription::requestContacts(TextChannel *channel,
+        const HandleIdentifierMap &contacts)
+{
+    for (HandleIdentifierMap::const_iterator i = contacts.constBegin();
+            i != contacts.constEnd(); ++i) {
+        mContactsRequired.insert(i.key(), i.value());
+    }
+    if (!mContactsChannels.contains(channel)) {
+        mContactsChannels.append(channel);
+    }
+
+    if (!mContactRequestsScheduled) {
+        mContactRequestsScheduled = true;
+        QTimer::singleShot(0, this, SLOT(flushContactRequests()));
+    }
+}
+
+QList<QPointer<TextChannel> > TextMessagesSubscription::channelsAt(
+        const ChannelsByPath &channels, const QString &objectPath)
+{
+    // a channel may go away while another one for the same object path handles a signal
+    QList<QPointer<TextChannel> > ret;
+    foreach (TextChannel *channel, channels.value(objectPath)) {
+        ret.append(QPointer<TextChannel>(channel));
+    }
+    return ret;
+}
+
+void TextMessagesSubscription::onMessageReceived(const QDBusMessage &message)
+{
+    QList<QPointer<TextChannel> > channels = channelsAt(mMessageQueueChannels, message.path());
+    if (channels.isEmpty() || message.arguments().size() != 1) {
+        return;
+    }
+
+    MessagePartList parts = qdbus_cast<MessagePartList>(message.arguments().at(0));
+    foreach (const QPointer<TextChannel> &channel, channels) {
+        if (channel) {
+            channel->onMessageReceived(parts);
+        }
+    }
+}
+
+void TextMessagesSubscription::onPendingMessagesRemoved(const QDBusMessage &message)
+{
+    QList<QPointer<TextChannel> > channels = channelsAt(mMessageQueueChannels, message.path());
+    if (channels.isEmpty() || message.arguments().size() != 1) {
+        return;
+    }
+
+    UIntList ids = qdbus_cast<UIntList>(message.arguments().at(0));
+    foreach (const QPointer<TextChannel> &channel, channels) {
+        if (channel) {
+            channel->onPendingMessagesRemoved(ids);
+        }
+    }
+}
+
+void TextMessagesSubscription::onMessageSent(const QDBusMessage &message)
+{
+    QList<QPointer<TextChannel> > channels = channelsAt(mMessageSentChannels, message.path());
+    if (channels.isEmpty() || message.arguments().size() != 3) {
+        return;
+    }
+
+    MessagePartList parts = qdbus_cast<MessagePartList>(message.arguments().at(0));
+    uint flags = message.arguments().at(1).toUInt();
+    QString sentMessageToken = message.arguments().at(2).toString();
+    foreach (const QPointer<TextChannel> &channel, channels) {
+        if (channel) {
+            channel->onMessageSent(parts, flags, sentMessageToken);
+        }
+    }
+}
+
+void TextMessagesSubscription::flushContactRequests()
+{
+    mContactRequestsScheduled = false;
+
+    HandleIdentifierMap contacts = mContactsRequired;
+    QList<QPointer<TextChannel> > channels = mContactsChannels;
+    mContactsRequired.clear();
+    mContactsChannels.clear();
+
+    // the channels keep their connection alive
+    ConnectionPtr connection(mConnection);
+    if (!connection || contacts.isEmpty()) {
+        return;
+    }
+
+    connection->lowlevel()->injectContactIds(contacts);
+    PendingContacts *pc = connection->contactManager()->contactsForHandles(contacts.keys());
+
+    // each channel only picks the senders of its own messages from the result
+    foreach (const QPointer<TextChannel> &channel, channels) {
+        if (channel) {
+            channel->connect(pc,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(onContactsFinished(Tp::PendingOperation*)));
+        }
+    }
+}
+
 /**
  * \class TextChannel
  * \ingroup clientchannel
@@ -131,6 +131,8 @@ private Q_SLOTS:
     TP_QT_NO_EXPORT void onChatStateChanged(uint, uint);
 
 private:
+    friend class TextMessagesSubscription; // to feed it the Messages signals of its connection
+
     struct Private;
     friend struct Private;
     Private *mPriv;
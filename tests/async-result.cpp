@@ -0,0 +1,274 @@
+#include <QtTest/QtTest>
+
+#include "TelepathyQt/async-result-internal.h"
+
+#include <TelepathyQt/Constants>
+
+using namespace Tp;
+
+namespace
+{
+
+struct Recorder
+{
+    Recorder(QStringList *calls, const QString &name)
+        : calls(calls), name(name)
+    {
+    }
+
+    void operator()(const AsyncResult &result) const
+    {
+        if (result.isError()) {
+            calls->append(name + QLatin1Char(':') + result.errorName());
+        } else {
+            calls->append(name);
+        }
+    }
+
+    QStringList *calls;
+    QString name;
+};
+
+struct Canceller
+{
+    Canceller(const AsyncResult &target)
+        : target(target)
+    {
+    }
+
+    void operator()(const AsyncResult &result) const
+    {
+        Q_UNUSED(result);
+        AsyncResult copy(target);
+        copy.cancel();
+    }
+
+    AsyncResult target;
+};
+
+}
+
+class TestAsyncResult : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testThenOrder();
+    void testThenAfterFinish();
+    void testNull();
+    void testWhenAll();
+    void testWhenAllWithErrors();
+    void testWhenAllWithNullEntries();
+    void testCancel();
+    void testCancelDuringFinish();
+    void testSetFinishedWhen();
+};
+
+void TestAsyncResult::testThenOrder()
+{
+    QStringList calls;
+    AsyncResult result = AsyncResult::create();
+    result.then(Recorder(&calls, QLatin1String("first")));
+    result.then(Recorder(&calls, QLatin1String("second")));
+    result.then(Recorder(&calls, QLatin1String("third")));
+    QVERIFY(calls.isEmpty());
+    QVERIFY(!result.isFinished());
+
+    // The continuations are invoked synchronously, in the order they were added
+    result.setFinished();
+    QCOMPARE(calls, QStringList() << QLatin1String("first") << QLatin1String("second") <<
+            QLatin1String("third"));
+    QVERIFY(result.isFinished());
+    QVERIFY(result.isValid());
+    QVERIFY(!result.isError());
+
+    // Finishing again is ignored
+    result.setFinishedWithError(TP_QT_ERROR_NOT_AVAILABLE, QLatin1String("Too late"));
+    QCOMPARE(calls.size(), 3);
+    QVERIFY(result.isValid());
+}
+
+void TestAsyncResult::testThenAfterFinish()
+{
+    QStringList calls;
+    AsyncResult result = AsyncResult::createFinishedWithError(TP_QT_ERROR_NOT_IMPLEMENTED,
+            QLatin1String("Not implemented"));
+    QVERIFY(result.isError());
+    QCOMPARE(result.errorName(), QString(TP_QT_ERROR_NOT_IMPLEMENTED));
+    QCOMPARE(result.errorMessage(), QString(QLatin1String("Not implemented")));
+
+    // Invoked right away
+    result.then(Recorder(&calls, QLatin1String("late")));
+    QCOMPARE(calls, QStringList() << QString(QLatin1String("late:")) + TP_QT_ERROR_NOT_IMPLEMENTED);
+
+    // Finished results all share the same data, which finishing again doesn't change
+    AsyncResult finished = AsyncResult::createFinished();
+    QVERIFY(finished.isValid());
+    finished.setFinishedWithError(TP_QT_ERROR_NOT_AVAILABLE, QLatin1String("Too late"));
+    finished.cancel();
+    QVERIFY(AsyncResult::createFinished().isValid());
+    QVERIFY(!AsyncResult::createFinished().isCancelled());
+
+    calls.clear();
+    AsyncResult::createFinished().then(Recorder(&calls, QLatin1String("finished")));
+    QCOMPARE(calls, QStringList() << QLatin1String("finished"));
+}
+
+void TestAsyncResult::testNull()
+{
+    QStringList calls;
+    AsyncResult result;
+    QVERIFY(result.isNull());
+    result.then(Recorder(&calls, QLatin1String("null")));
+    result.setFinished();
+    QVERIFY(!result.isFinished());
+    QVERIFY(calls.isEmpty());
+}
+
+void TestAsyncResult::testWhenAll()
+{
+    QStringList calls;
+    AsyncResult first = AsyncResult::create();
+    AsyncResult second = AsyncResult::create();
+    AsyncResult all = AsyncResult::whenAll(QList<AsyncResult>() << first << second <<
+            AsyncResult::createFinished());
+    all.then(Recorder(&calls, QLatin1String("all")));
+
+    second.setFinished();
+    QVERIFY(!all.isFinished());
+    first.setFinished();
+    QVERIFY(all.isValid());
+    QCOMPARE(calls, QStringList() << QLatin1String("all"));
+
+    // All of them already finished
+    calls.clear();
+    AsyncResult::whenAll(QList<AsyncResult>() << first << second).then(
+            Recorder(&calls, QLatin1String("finished")));
+    QCOMPARE(calls, QStringList() << QLatin1String("finished"));
+}
+
+void TestAsyncResult::testWhenAllWithErrors()
+{
+    QStringList calls;
+    AsyncResult first = AsyncResult::create();
+    AsyncResult second = AsyncResult::create();
+    AsyncResult third = AsyncResult::create();
+    AsyncResult all = AsyncResult::whenAll(QList<AsyncResult>() << first << second << third);
+    all.then(Recorder(&calls, QLatin1String("all")));
+
+    // Only finished once all of them have finished, even when one of them failed
+    second.setFinishedWithError(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Second"));
+    QVERIFY(!all.isFinished());
+    first.setFinishedWithError(TP_QT_ERROR_NOT_AVAILABLE, QLatin1String("First"));
+    QVERIFY(!all.isFinished());
+    third.setFinished();
+
+    // With the error of the first one to fail
+    QVERIFY(all.isError());
+    QCOMPARE(all.errorName(), QString(TP_QT_ERROR_NOT_IMPLEMENTED));
+    QCOMPARE(all.errorMessage(), QString(QLatin1String("Second")));
+    QCOMPARE(calls, QStringList() << QString(QLatin1String("all:")) + TP_QT_ERROR_NOT_IMPLEMENTED);
+}
+
+void TestAsyncResult::testWhenAllWithNullEntries()
+{
+    QStringList calls;
+    AsyncResult pending = AsyncResult::create();
+    AsyncResult all = AsyncResult::whenAll(QList<AsyncResult>() << AsyncResult() << pending <<
+            AsyncResult());
+    all.then(Recorder(&calls, QLatin1String("all")));
+    QVERIFY(!all.isFinished());
+    pending.setFinished();
+    QVERIFY(all.isValid());
+    QCOMPARE(calls, QStringList() << QLatin1String("all"));
+
+    // Nothing to wait for
+    QVERIFY(AsyncResult::whenAll(QList<AsyncResult>() << AsyncResult() << AsyncResult()).isValid());
+    QVERIFY(AsyncResult::whenAll(QList<AsyncResult>()).isValid());
+}
+
+void TestAsyncResult::testCancel()
+{
+    QStringList calls;
+    AsyncResult result = AsyncResult::create();
+    AsyncResult all = AsyncResult::whenAll(QList<AsyncResult>() << result);
+    result.then(Recorder(&calls, QLatin1String("cancelled")));
+    all.then(Recorder(&calls, QLatin1String("all")));
+
+    result.cancel();
+    QVERIFY(result.isCancelled());
+
+    // Finishing a cancelled result is ignored, and so are the results depending on it
+    result.setFinished();
+    QVERIFY(!result.isFinished());
+    QVERIFY(!all.isFinished());
+    result.then(Recorder(&calls, QLatin1String("later")));
+    QVERIFY(calls.isEmpty());
+
+    // Cancelling a finished result does nothing
+    AsyncResult finished = AsyncResult::create();
+    finished.setFinished();
+    finished.cancel();
+    QVERIFY(!finished.isCancelled());
+    QVERIFY(finished.isValid());
+}
+
+void TestAsyncResult::testCancelDuringFinish()
+{
+    QStringList calls;
+    AsyncResult result = AsyncResult::create();
+    result.then(Recorder(&calls, QLatin1String("first")));
+    result.then(Canceller(result));
+    result.then(Recorder(&calls, QLatin1String("skipped")));
+
+    // The continuations after the one cancelling the result are not invoked
+    result.setFinished();
+    QCOMPARE(calls, QStringList() << QLatin1String("first"));
+    QVERIFY(result.isCancelled());
+
+    // Cancelling another result from a continuation
+    calls.clear();
+    AsyncResult trigger = AsyncResult::create();
+    AsyncResult other = AsyncResult::create();
+    other.then(Recorder(&calls, QLatin1String("other")));
+    trigger.then(Canceller(other));
+    trigger.then(Recorder(&calls, QLatin1String("trigger")));
+    trigger.setFinished();
+    other.setFinished();
+    QCOMPARE(calls, QStringList() << QLatin1String("trigger"));
+}
+
+void TestAsyncResult::testSetFinishedWhen()
+{
+    QStringList calls;
+    AsyncResult source = AsyncResult::create();
+    AsyncResult target = AsyncResult::create();
+    target.then(Recorder(&calls, QLatin1String("target")));
+    target.setFinishedWhen(source);
+    QVERIFY(!target.isFinished());
+
+    source.setFinished();
+    QVERIFY(target.isValid());
+    QCOMPARE(calls, QStringList() << QLatin1String("target"));
+
+    // With the error of the other result
+    calls.clear();
+    AsyncResult failing = AsyncResult::create();
+    AsyncResult failed = AsyncResult::create();
+    failed.then(Recorder(&calls, QLatin1String("failed")));
+    failed.setFinishedWhen(failing);
+    failing.setFinishedWithError(TP_QT_ERROR_NOT_AVAILABLE, QLatin1String("Unavailable"));
+    QVERIFY(failed.isError());
+    QCOMPARE(failed.errorName(), QString(TP_QT_ERROR_NOT_AVAILABLE));
+    QCOMPARE(failed.errorMessage(), QString(QLatin1String("Unavailable")));
+    QCOMPARE(calls, QStringList() << QString(QLatin1String("failed:")) + TP_QT_ERROR_NOT_AVAILABLE);
+
+    // Right away if the other result has already finished
+    AsyncResult immediate = AsyncResult::create();
+    immediate.setFinishedWhen(AsyncResult::createFinished());
+    QVERIFY(immediate.isValid());
+}
+
+QTEST_MAIN(TestAsyncResult)
+
+#include "_gen/async-result.cpp.moc.hpp"
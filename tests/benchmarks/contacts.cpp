@@ -0,0 +1,347 @@
+#include <tests/lib/test.h>
+
+#include <tests/lib/glib-helpers/test-conn-helper.h>
+
+#include <tests/lib/glib/contact-list-manager.h>
+#include <tests/lib/glib/contacts-conn.h>
+
+#include <TelepathyQt/ChannelFactory>
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/Contact>
+#include <TelepathyQt/ContactFactory>
+#include <TelepathyQt/ContactManager>
+#include <TelepathyQt/PendingReady>
+
+#include <telepathy-glib/debug.h>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace Tp;
+
+namespace
+{
+
+// Bytes currently allocated from the heap of the main thread, or -1 if unknown
+qint64 heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+    return mallinfo().uordblks;
+#else
+    return -1;
+#endif
+}
+
+}
+
+class BenchContacts : public Test
+{
+    Q_OBJECT
+
+public:
+    BenchContacts(QObject *parent = 0)
+        : Test(parent), mConn(0)
+    { }
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void benchmarkUpgradeContacts_data();
+    void benchmarkUpgradeContacts();
+    void benchmarkRosterLoad_data();
+    void benchmarkRosterLoad();
+    void benchmarkRosterLoadCached_data();
+    void benchmarkRosterLoadCached();
+    void benchmarkRosterMemory_data();
+    void benchmarkRosterMemory();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    UIntList ensureHandles(TestConnHelper *conn, int count);
+    TestConnHelper *createRosterConnection(const QString &account, int count);
+
+    TestConnHelper *mConn;
+};
+
+UIntList BenchContacts::ensureHandles(TestConnHelper *conn, int count)
+{
+    TpHandleRepoIface *contactRepo = tp_base_connection_get_handles(
+            TP_BASE_CONNECTION(conn->service()), TP_HANDLE_TYPE_CONTACT);
+
+    UIntList handles;
+    for (int i = 0; i < count; ++i) {
+        QByteArray id = QString(QLatin1String("contact%1@example.com")).arg(i).toLatin1();
+        handles << tp_handle_ensure(contactRepo, id.constData(), NULL, NULL);
+    }
+    return handles;
+}
+
+TestConnHelper *BenchContacts::createRosterConnection(const QString &account, int count)
+{
+    TestConnHelper *conn = new TestConnHelper(this,
+            TP_TESTS_TYPE_CONTACTS_CONNECTION,
+            "account", account.toLatin1().constData(),
+            "protocol", "foo",
+            NULL);
+    if (!conn->connect()) {
+        delete conn;
+        return 0;
+    }
+
+    UIntList handles = ensureHandles(conn, count);
+    TestContactListManager *manager = tp_tests_contacts_connection_get_contact_list_manager(
+            TP_TESTS_CONTACTS_CONNECTION(conn->service()));
+    test_contact_list_manager_request_subscription(manager, handles.size(),
+            handles.toVector().data(), "hello");
+    return conn;
+}
+
+void BenchContacts::initTestCase()
+{
+    initTestCaseImpl();
+
+    g_type_init();
+    g_set_prgname("bench-contacts");
+    tp_debug_set_flags("");
+    dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+
+    // The benchmarks would otherwise mostly measure how fast we can print debug output
+    Tp::enableDebug(false);
+
+    mConn = new TestConnHelper(this,
+            TP_TESTS_TYPE_CONTACTS_CONNECTION,
+            "account", "me@example.com",
+            "protocol", "foo",
+            NULL);
+    QCOMPARE(mConn->connect(), true);
+}
+
+void BenchContacts::init()
+{
+    initImpl();
+}
+
+void BenchContacts::benchmarkUpgradeContacts_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void BenchContacts::benchmarkUpgradeContacts()
+{
+    QFETCH(int, count);
+
+    UIntList handles = ensureHandles(mConn, count);
+    Features features = Features()
+        << Contact::FeatureAlias
+        << Contact::FeatureAvatarToken
+        << Contact::FeatureSimplePresence
+        << Contact::FeatureCapabilities
+        << Contact::FeatureClientTypes;
+
+    QBENCHMARK {
+        // Contacts are only weakly cached by the ContactManager, so dropping them at the end of
+        // each iteration makes the next one start over from bare contacts
+        QList<ContactPtr> contacts = mConn->contacts(handles);
+        QCOMPARE(contacts.size(), count);
+
+        contacts = mConn->upgradeContacts(contacts, features);
+        QCOMPARE(contacts.size(), count);
+    }
+}
+
+void BenchContacts::benchmarkRosterLoad_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("50k") << 50000;
+}
+
+void BenchContacts::benchmarkRosterLoad()
+{
+    QFETCH(int, count);
+
+    // Use a separate service per roster size, so each row loads exactly count contacts
+    TestConnHelper *conn = createRosterConnection(
+            QString(QLatin1String("roster%1@example.com")).arg(count), count);
+    QVERIFY(conn != 0);
+
+    Features features = Features() << Connection::FeatureCore << Connection::FeatureRoster;
+
+    QBENCHMARK {
+        ConnectionPtr client = Connection::create(conn->client()->busName(),
+                conn->client()->objectPath(),
+                ChannelFactory::create(QDBusConnection::sessionBus()),
+                ContactFactory::create());
+        QVERIFY(connect(client->becomeReady(features),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+        QCOMPARE(mLoop->exec(), 0);
+        QCOMPARE(client->contactManager()->allKnownContacts().size(), count);
+    }
+
+    QCOMPARE(conn->disconnect(), true);
+    delete conn;
+}
+
+void BenchContacts::benchmarkRosterLoadCached_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<bool>("cached");
+
+    QTest::newRow("1k") << 1000 << false;
+    QTest::newRow("1k cached") << 1000 << true;
+    QTest::newRow("10k") << 10000 << false;
+    QTest::newRow("10k cached") << 10000 << true;
+}
+
+void BenchContacts::benchmarkRosterLoadCached()
+{
+    QFETCH(int, count);
+    QFETCH(bool, cached);
+
+    TestConnHelper *conn = createRosterConnection(
+            QString(QLatin1String("cached%1@example.com")).arg(count), count);
+    QVERIFY(conn != 0);
+
+    // The attributes the cache serves, besides the presence which always comes with the roster
+    Features features = Features()
+        << Contact::FeatureAlias
+        << Contact::FeatureAvatarToken
+        << Contact::FeatureSimplePresence
+        << Contact::FeatureCapabilities
+        << Contact::FeatureClientTypes;
+    QString cacheFileName = QDir::tempPath() +
+        QString(QLatin1String("/bench-contacts-cache-%1")).arg(count);
+    QFile::remove(cacheFileName);
+
+    // The first connection writes the cache, and the second one is timed until its roster is
+    // usable, leaving out the refresh of the cached attributes which then runs in the background
+    for (int i = cached ? 0 : 1; i < 2; ++i) {
+        ConnectionPtr client = Connection::create(conn->client()->busName(),
+                conn->client()->objectPath(),
+                ChannelFactory::create(QDBusConnection::sessionBus()),
+                ContactFactory::create(features));
+        if (cached) {
+            client->contactManager()->setAttributeCacheFileName(cacheFileName);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(connect(client->becomeReady(Features() << Connection::FeatureCore
+                        << Connection::FeatureRoster),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+        QCOMPARE(mLoop->exec(), 0);
+        qint64 elapsed = timer.elapsed();
+        QCOMPARE(client->contactManager()->allKnownContacts().size(), count);
+
+        if (i == 1) {
+            QTest::setBenchmarkResult(elapsed, QTest::WalltimeMilliseconds);
+        }
+    }
+
+    QFile::remove(cacheFileName);
+    QCOMPARE(conn->disconnect(), true);
+    delete conn;
+}
+
+void BenchContacts::benchmarkRosterMemory_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+}
+
+void BenchContacts::benchmarkRosterMemory()
+{
+    QFETCH(int, count);
+
+    if (heapInUse() < 0) {
+        qWarning() << "Heap usage is not available on this platform, not measuring";
+        return;
+    }
+
+    TestConnHelper *conn = createRosterConnection(
+            QString(QLatin1String("memory%1@example.com")).arg(count), count);
+    QVERIFY(conn != 0);
+
+    // Build the roster with the features a typical client asks for, so the shared capabilities,
+    // presences and feature sets are part of what is measured
+    Features features = Features()
+        << Contact::FeatureAlias
+        << Contact::FeatureSimplePresence
+        << Contact::FeatureCapabilities;
+
+    // An empty roster first accounts for the per-connection allocations, which are not what is
+    // being measured here
+    TestConnHelper *emptyConn = createRosterConnection(
+            QString(QLatin1String("memory%1-empty@example.com")).arg(count), 0);
+    QVERIFY(emptyConn != 0);
+
+    qint64 baseline = 0;
+    for (int i = 0; i < 2; ++i) {
+        TestConnHelper *service = i == 0 ? emptyConn : conn;
+        int expected = i == 0 ? 0 : count;
+
+        qint64 before = heapInUse();
+        ConnectionPtr client = Connection::create(service->client()->busName(),
+                service->client()->objectPath(),
+                ChannelFactory::create(QDBusConnection::sessionBus()),
+                ContactFactory::create(features));
+        QVERIFY(connect(client->becomeReady(Features() << Connection::FeatureCore
+                        << Connection::FeatureRoster),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+        QCOMPARE(mLoop->exec(), 0);
+        // Let the PendingOperations and reply messages still queued for deletion go first
+        processDBusQueue(client.data());
+        QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+        QCOMPARE(client->contactManager()->allKnownContacts().size(), expected);
+
+        qint64 used = heapInUse() - before;
+        if (i == 0) {
+            baseline = used;
+            continue;
+        }
+
+        // Reported in the benchmark results, per contact
+        QTest::setBenchmarkResult(qreal(used - baseline) / count, QTest::BytesAllocated);
+    }
+
+    QCOMPARE(emptyConn->disconnect(), true);
+    delete emptyConn;
+    QCOMPARE(conn->disconnect(), true);
+    delete conn;
+}
+
+void BenchContacts::cleanup()
+{
+    cleanupImpl();
+}
+
+void BenchContacts::cleanupTestCase()
+{
+    QCOMPARE(mConn->disconnect(), true);
+    delete mConn;
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(BenchContacts)
+#include "_gen/contacts.cpp.moc.hpp"
@@ -0,0 +1,345 @@
+#include <tests/lib/test.h>
+
+#define TP_QT_ENABLE_LOWLEVEL_API
+
+#include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/BaseConnection>
+#include <TelepathyQt/BaseConnectionManager>
+#include <TelepathyQt/BaseProtocol>
+#include <TelepathyQt/IODevice>
+
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/ConnectionLowlevel>
+#include <TelepathyQt/ConnectionManager>
+#include <TelepathyQt/ConnectionManagerLowlevel>
+#include <TelepathyQt/DBusError>
+#include <TelepathyQt/FileTransferChannelCreationProperties>
+#include <TelepathyQt/IncomingFileTransferChannel>
+#include <TelepathyQt/PendingConnection>
+#include <TelepathyQt/PendingReady>
+
+#include <QBuffer>
+
+using namespace Tp;
+
+namespace BenchFileTransferCM // Avoid clashing with the classes of the other tests
+{
+
+Tp::RequestableChannelClass createRequestableChannelClassFileTransfer()
+{
+    Tp::RequestableChannelClass fileTransfer;
+    fileTransfer.fixedProperties[TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")] = TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER;
+    fileTransfer.fixedProperties[TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType")] = Tp::HandleTypeContact;
+    fileTransfer.allowedProperties.append(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"));
+    fileTransfer.allowedProperties.append(TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER + QLatin1String(".ContentType"));
+    fileTransfer.allowedProperties.append(TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER + QLatin1String(".Filename"));
+    fileTransfer.allowedProperties.append(TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER + QLatin1String(".Size"));
+    return fileTransfer;
+}
+
+static const Tp::RequestableChannelClass c_requestableChannelClassFileTransfer = createRequestableChannelClassFileTransfer();
+
+// A trimmed down version of the connection in tests/dbus/base-filetransfer.cpp: it only knows
+// about a single remote contact, which sends us files
+class Connection : public Tp::BaseConnection
+{
+    Q_OBJECT
+public:
+    Connection(const QDBusConnection &dbusConnection,
+            const QString &cmName, const QString &protocolName,
+            const QVariantMap &parameters) :
+        Tp::BaseConnection(dbusConnection, cmName, protocolName, parameters)
+    {
+        m_contactsIface = Tp::BaseConnectionContactsInterface::create();
+        m_contactsIface->setGetContactAttributesCallback(Tp::memFun(this, &Connection::getContactAttributes));
+        m_contactsIface->setContactAttributeInterfaces(QStringList() << TP_QT_IFACE_CONNECTION);
+        plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(m_contactsIface));
+
+        m_requestsIface = Tp::BaseConnectionRequestsInterface::create(this);
+        m_requestsIface->requestableChannelClasses << c_requestableChannelClassFileTransfer;
+        plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(m_requestsIface));
+
+        setConnectCallback(Tp::memFun(this, &Connection::connectCB));
+        setCreateChannelCallback(Tp::memFun(this, &Connection::createChannelCB));
+        setInspectHandlesCallback(Tp::memFun(this, &Connection::inspectHandles));
+        setRequestHandlesCallback(Tp::memFun(this, &Connection::requestHandles));
+
+        mContactHandles.insert(1, QLatin1String("selfContact"));
+        mContactHandles.insert(2, QLatin1String("ftContact"));
+
+        setSelfContact(1, QLatin1String("selfContact"));
+    }
+
+    Tp::BaseChannelPtr receiveFile(const Tp::FileTransferChannelCreationProperties &properties)
+    {
+        QVariantMap request = properties.createRequest();
+        request[TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle")] = selfHandle();
+        request[TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorHandle")] = 2u;
+
+        Tp::DBusError error;
+        Tp::BaseChannelPtr channel = createChannel(request, /* suppressHandler */ false, &error);
+        if (error.isValid()) {
+            qWarning() << error.message();
+            return Tp::BaseChannelPtr();
+        }
+
+        return channel;
+    }
+
+protected:
+    void connectCB(Tp::DBusError *error)
+    {
+        Q_UNUSED(error)
+        setStatus(Tp::ConnectionStatusConnected, Tp::ConnectionStatusReasonRequested);
+    }
+
+    Tp::BaseChannelPtr createChannelCB(const QVariantMap &request, Tp::DBusError *error)
+    {
+        const QString channelType = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")).toString();
+        uint targetHandle = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle")).toUInt();
+
+        if (channelType != TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER || !mContactHandles.contains(targetHandle)) {
+            error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("Unexpected request"));
+            return Tp::BaseChannelPtr();
+        }
+
+        Tp::BaseChannelPtr baseChannel = Tp::BaseChannel::create(this, channelType, Tp::HandleTypeContact, targetHandle);
+        Tp::BaseChannelFileTransferTypePtr fileTransferChannel = Tp::BaseChannelFileTransferType::create(request);
+        baseChannel->plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(fileTransferChannel));
+        baseChannel->setTargetID(mContactHandles.value(targetHandle));
+
+        return baseChannel;
+    }
+
+    QStringList inspectHandles(uint handleType, const Tp::UIntList &handles, Tp::DBusError *error)
+    {
+        if (handleType != Tp::HandleTypeContact) {
+            error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("Unexpected handle type"));
+            return QStringList();
+        }
+
+        QStringList result;
+        Q_FOREACH (uint handle, handles) {
+            if (!mContactHandles.contains(handle)) {
+                error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Unknown handle"));
+                return QStringList();
+            }
+            result << mContactHandles.value(handle);
+        }
+        return result;
+    }
+
+    Tp::UIntList requestHandles(uint handleType, const QStringList &identifiers, Tp::DBusError *error)
+    {
+        Tp::UIntList result;
+        if (handleType != Tp::HandleTypeContact) {
+            error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("Unexpected handle type"));
+            return result;
+        }
+
+        Q_FOREACH (const QString &identifier, identifiers) {
+            uint handle = mContactHandles.key(identifier, 0);
+            if (!handle) {
+                error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Unknown identifier"));
+                return Tp::UIntList();
+            }
+            result << handle;
+        }
+        return result;
+    }
+
+    Tp::ContactAttributesMap getContactAttributes(const Tp::UIntList &handles,
+            const QStringList &interfaces, Tp::DBusError *error)
+    {
+        Q_UNUSED(interfaces)
+        Q_UNUSED(error)
+
+        Tp::ContactAttributesMap contactAttributes;
+        Q_FOREACH (uint handle, handles) {
+            if (mContactHandles.contains(handle)) {
+                QVariantMap attributes;
+                attributes[TP_QT_IFACE_CONNECTION + QLatin1String("/contact-id")] = mContactHandles.value(handle);
+                contactAttributes[handle] = attributes;
+            }
+        }
+        return contactAttributes;
+    }
+
+private:
+    Tp::BaseConnectionContactsInterfacePtr m_contactsIface;
+    Tp::BaseConnectionRequestsInterfacePtr m_requestsIface;
+
+    QMap<uint, QString> mContactHandles;
+};
+
+typedef Tp::SharedPtr<Connection> ConnectionPtr;
+
+} // namespace BenchFileTransferCM
+
+class BenchFileTransfer : public Test
+{
+    Q_OBJECT
+
+public:
+    BenchFileTransfer(QObject *parent = 0)
+        : Test(parent)
+    { }
+
+protected Q_SLOTS:
+    void onStateChanged(Tp::FileTransferState state, Tp::FileTransferStateChangeReason reason);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void benchmarkReceiveFile_data();
+    void benchmarkReceiveFile();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    Tp::BaseConnectionPtr createConnectionCb(const QVariantMap &parameters, Tp::DBusError *error)
+    {
+        Q_UNUSED(error)
+        mSvcConnection = Tp::BaseConnection::create<BenchFileTransferCM::Connection>(
+                mConnectionManager->name(), mProtocol->name(), parameters);
+        return mSvcConnection;
+    }
+
+    Tp::BaseProtocolPtr mProtocol;
+    Tp::BaseConnectionManagerPtr mConnectionManager;
+    BenchFileTransferCM::ConnectionPtr mSvcConnection;
+
+    Tp::ConnectionPtr mCliConnection;
+};
+
+void BenchFileTransfer::onStateChanged(Tp::FileTransferState state,
+        Tp::FileTransferStateChangeReason reason)
+{
+    Q_UNUSED(reason)
+
+    if (state == Tp::FileTransferStateCompleted) {
+        mLoop->exit(0);
+    } else if (state == Tp::FileTransferStateCancelled) {
+        mLoop->exit(1);
+    }
+}
+
+void BenchFileTransfer::initTestCase()
+{
+    initTestCaseImpl();
+
+    Tp::enableDebug(false);
+
+    mProtocol = Tp::BaseProtocol::create(QLatin1String("BenchProtocol"));
+    mProtocol->setRequestableChannelClasses(Tp::RequestableChannelClassSpecList()
+            << BenchFileTransferCM::c_requestableChannelClassFileTransfer);
+    mProtocol->setCreateConnectionCallback(Tp::memFun(this, &BenchFileTransfer::createConnectionCb));
+
+    mConnectionManager = Tp::BaseConnectionManager::create(QLatin1String("BenchFileTransferCM"));
+    mConnectionManager->addProtocol(mProtocol);
+
+    Tp::DBusError err;
+    QVERIFY(mConnectionManager->registerObject(&err));
+    QVERIFY(!err.isValid());
+
+    Tp::ConnectionManagerPtr cliCM = Tp::ConnectionManager::create(mConnectionManager->name());
+    QVERIFY(connect(cliCM->becomeReady(Tp::ConnectionManager::FeatureCore),
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    Tp::PendingConnection *pendingConnection = cliCM->lowlevel()->requestConnection(
+            mProtocol->name(), QVariantMap());
+    QVERIFY(connect(pendingConnection,
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    mCliConnection = pendingConnection->connection();
+    QVERIFY(connect(mCliConnection->lowlevel()->requestConnect(),
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mCliConnection->status(), Tp::ConnectionStatusConnected);
+    QVERIFY(!mSvcConnection.isNull());
+}
+
+void BenchFileTransfer::init()
+{
+    initImpl();
+}
+
+void BenchFileTransfer::benchmarkReceiveFile_data()
+{
+    QTest::addColumn<int>("fileSize");
+
+    QTest::newRow("64KiB") << 64 * 1024;
+    QTest::newRow("1MiB") << 1024 * 1024;
+    QTest::newRow("16MiB") << 16 * 1024 * 1024;
+}
+
+void BenchFileTransfer::benchmarkReceiveFile()
+{
+    QFETCH(int, fileSize);
+
+    const QByteArray fileContent(fileSize, 'x');
+    Tp::FileTransferChannelCreationProperties properties(
+            QLatin1String("bench-file-transfer.bin"),
+            QLatin1String("application/octet-stream"), fileSize);
+
+    // Each iteration measures a complete incoming transfer as seen by a handler: introspecting
+    // the channel, accepting it and reading the whole file from the CM's socket
+    QBENCHMARK {
+        Tp::BaseChannelPtr svcChannel = mSvcConnection->receiveFile(properties);
+        QVERIFY(!svcChannel.isNull());
+        Tp::BaseChannelFileTransferTypePtr svcTransfer =
+            Tp::BaseChannelFileTransferTypePtr::dynamicCast(
+                    svcChannel->interface(TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER));
+
+        Tp::IncomingFileTransferChannelPtr cliTransfer = Tp::IncomingFileTransferChannel::create(
+                mCliConnection, svcChannel->objectPath(), svcChannel->immutableProperties());
+        QVERIFY(connect(cliTransfer->becomeReady(Tp::IncomingFileTransferChannel::FeatureCore),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+        QCOMPARE(mLoop->exec(), 0);
+
+        QVERIFY(connect(cliTransfer.data(),
+                    SIGNAL(stateChanged(Tp::FileTransferState,Tp::FileTransferStateChangeReason)),
+                    SLOT(onStateChanged(Tp::FileTransferState,Tp::FileTransferStateChangeReason))));
+
+        Tp::IODevice cliInput;
+        cliInput.open(QIODevice::ReadWrite);
+        QVERIFY(connect(cliTransfer->acceptFile(0, &cliInput),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+        QCOMPARE(mLoop->exec(), 0);
+        QTRY_COMPARE(uint(svcTransfer->state()), uint(Tp::FileTransferStateAccepted));
+
+        QBuffer svcOutput;
+        svcOutput.setData(fileContent);
+        svcTransfer->remoteProvideFile(&svcOutput);
+        // The client only reports the transfer as completed once it has read everything
+        QCOMPARE(mLoop->exec(), 0);
+        QCOMPARE(int(cliInput.bytesAvailable()), fileSize);
+
+        svcChannel->close();
+    }
+}
+
+void BenchFileTransfer::cleanup()
+{
+    cleanupImpl();
+}
+
+void BenchFileTransfer::cleanupTestCase()
+{
+    mCliConnection.reset();
+    mSvcConnection.reset();
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(BenchFileTransfer)
+#include "_gen/file-transfer.cpp.moc.hpp"
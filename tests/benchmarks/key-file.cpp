@@ -0,0 +1,120 @@
+#include <QtCore/QTemporaryFile>
+#include <QtTest/QtTest>
+
+#include "TelepathyQt/key-file.h"
+
+using namespace Tp;
+
+class BenchKeyFile : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void benchmarkParse_data();
+    void benchmarkParse();
+    void benchmarkParseAndRead_data();
+    void benchmarkParseAndRead();
+
+    void cleanupTestCase();
+
+private:
+    QTemporaryFile *createManagerFile(int protocols, int params);
+
+    QList<QTemporaryFile *> mFiles;
+};
+
+QTemporaryFile *BenchKeyFile::createManagerFile(int protocols, int params)
+{
+    QTemporaryFile *file = new QTemporaryFile(this);
+    if (!file->open()) {
+        return 0;
+    }
+
+    QTextStream stream(file);
+    stream << "# synthetic connection manager file\n";
+    stream << "[ConnectionManager]\n";
+    stream << "Interfaces=\n\n";
+
+    for (int i = 0; i < protocols; ++i) {
+        stream << "[Protocol proto" << i << "]\n";
+        stream << "Interfaces=org.freedesktop.Telepathy.Protocol.Interface.Presence;\n";
+        stream << "ConnectionInterfaces=org.freedesktop.Telepathy.Connection.Interface.Requests;"
+            "org.freedesktop.Telepathy.Connection.Interface.Contacts;\n";
+        stream << "EnglishName=Protocol\\s" << i << "\n";
+        stream << "Icon=im-proto" << i << "\n";
+        stream << "VCardField=x-proto" << i << "\n";
+        for (int j = 0; j < params; ++j) {
+            stream << "param-param" << j << "=s\n";
+            stream << "default-param" << j << "=some\\svalue\\;with\\sescapes " << j << "\n";
+        }
+        stream << "status-available=2 settable message\n";
+        stream << "status-away=3 settable message\n";
+        stream << "status-offline=1\n\n";
+    }
+    stream.flush();
+    file->close();
+
+    mFiles.append(file);
+    return file;
+}
+
+void BenchKeyFile::initTestCase()
+{
+    QVERIFY(createManagerFile(4, 16) != 0);
+    QVERIFY(createManagerFile(32, 64) != 0);
+    QVERIFY(createManagerFile(128, 256) != 0);
+}
+
+void BenchKeyFile::benchmarkParse_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    QTest::newRow("small") << mFiles.at(0)->fileName();
+    QTest::newRow("medium") << mFiles.at(1)->fileName();
+    QTest::newRow("large") << mFiles.at(2)->fileName();
+}
+
+void BenchKeyFile::benchmarkParse()
+{
+    QFETCH(QString, fileName);
+
+    QBENCHMARK {
+        KeyFile keyFile(fileName);
+        QCOMPARE(keyFile.status(), KeyFile::NoError);
+    }
+}
+
+void BenchKeyFile::benchmarkParseAndRead_data()
+{
+    benchmarkParse_data();
+}
+
+void BenchKeyFile::benchmarkParseAndRead()
+{
+    QFETCH(QString, fileName);
+
+    QBENCHMARK {
+        KeyFile keyFile(fileName);
+        QCOMPARE(keyFile.status(), KeyFile::NoError);
+
+        // Mirror what ManagerFile does: read every value of every group once
+        foreach (const QString &group, keyFile.allGroups()) {
+            keyFile.setGroup(group);
+            foreach (const QString &key, keyFile.keys()) {
+                keyFile.value(key);
+            }
+        }
+    }
+}
+
+void BenchKeyFile::cleanupTestCase()
+{
+    qDeleteAll(mFiles);
+    mFiles.clear();
+}
+
+QTEST_MAIN(BenchKeyFile)
+
+#include "_gen/key-file.cpp.moc.hpp"
@@ -0,0 +1,181 @@
+#include <tests/lib/test.h>
+
+#include <tests/lib/glib-helpers/test-conn-helper.h>
+
+#include <tests/lib/glib/simple-conn.h>
+#include <tests/lib/glib/stream-tube-chan.h>
+
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/IncomingStreamTubeChannel>
+#include <TelepathyQt/PendingReady>
+#include <TelepathyQt/PendingStreamTubeConnection>
+
+#include <telepathy-glib/telepathy-glib.h>
+
+using namespace Tp;
+
+namespace
+{
+
+void destroySocketControlList(gpointer data)
+{
+    g_array_free((GArray *) data, TRUE);
+}
+
+GHashTable *createSupportedSocketTypesHash(TpSocketAddressType addressType,
+        TpSocketAccessControl accessControl)
+{
+    GHashTable *ret;
+    GArray *tab;
+
+    ret = g_hash_table_new_full(NULL, NULL, NULL, destroySocketControlList);
+
+    tab = g_array_sized_new(FALSE, FALSE, sizeof(TpSocketAccessControl), 1);
+    g_array_append_val(tab, accessControl);
+
+    g_hash_table_insert(ret, GUINT_TO_POINTER(addressType), tab);
+
+    return ret;
+}
+
+}
+
+class BenchStreamTubeChan : public Test
+{
+    Q_OBJECT
+
+public:
+    BenchStreamTubeChan(QObject *parent = 0)
+        : Test(parent),
+          mConn(0), mChanService(0), mChanCount(0)
+    { }
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void benchmarkAccept_data();
+    void benchmarkAccept();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    IncomingStreamTubeChannelPtr createTubeChannel(TpSocketAddressType addressType);
+
+    TestConnHelper *mConn;
+    TpTestsStreamTubeChannel *mChanService;
+    uint mChanCount;
+};
+
+IncomingStreamTubeChannelPtr BenchStreamTubeChan::createTubeChannel(
+        TpSocketAddressType addressType)
+{
+    tp_clear_object(&mChanService);
+
+    // Use a new object path for every tube, so we never race against the teardown of the
+    // previous one
+    QString chanPath = QString(QLatin1String("%1/Channel%2"))
+        .arg(mConn->objectPath()).arg(mChanCount++);
+
+    TpHandleRepoIface *contactRepo = tp_base_connection_get_handles(
+            TP_BASE_CONNECTION(mConn->service()), TP_HANDLE_TYPE_CONTACT);
+    TpHandle handle = tp_handle_ensure(contactRepo, "bob", NULL, NULL);
+
+    GHashTable *sockets = createSupportedSocketTypesHash(addressType,
+            TP_SOCKET_ACCESS_CONTROL_LOCALHOST);
+
+    mChanService = TP_TESTS_STREAM_TUBE_CHANNEL(g_object_new(
+            TP_TESTS_TYPE_CONTACT_STREAM_TUBE_CHANNEL,
+            "connection", mConn->service(),
+            "handle", handle,
+            "requested", FALSE,
+            "object-path", chanPath.toLatin1().constData(),
+            "supported-socket-types", sockets,
+            "initiator-handle", handle,
+            NULL));
+
+    g_hash_table_unref(sockets);
+
+    return IncomingStreamTubeChannel::create(mConn->client(), chanPath, QVariantMap());
+}
+
+void BenchStreamTubeChan::initTestCase()
+{
+    initTestCaseImpl();
+
+    g_type_init();
+    g_set_prgname("bench-stream-tube-chan");
+    tp_debug_set_flags("");
+    dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+
+    Tp::enableDebug(false);
+
+    mConn = new TestConnHelper(this,
+            TP_TESTS_TYPE_SIMPLE_CONNECTION,
+            "account", "me@example.com",
+            "protocol", "example",
+            NULL);
+    QCOMPARE(mConn->connect(), true);
+}
+
+void BenchStreamTubeChan::init()
+{
+    initImpl();
+}
+
+void BenchStreamTubeChan::benchmarkAccept_data()
+{
+    QTest::addColumn<int>("addressType");
+
+    QTest::newRow("unix") << (int) TP_SOCKET_ADDRESS_TYPE_UNIX;
+    QTest::newRow("ipv4") << (int) TP_SOCKET_ADDRESS_TYPE_IPV4;
+}
+
+void BenchStreamTubeChan::benchmarkAccept()
+{
+    QFETCH(int, addressType);
+
+    // Each iteration measures the full client-side path of an incoming tube: introspecting the
+    // channel and then accepting it, as a handler would do
+    QBENCHMARK {
+        IncomingStreamTubeChannelPtr chan = createTubeChannel(
+                (TpSocketAddressType) addressType);
+        QVERIFY(connect(chan->becomeReady(IncomingStreamTubeChannel::FeatureCore),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+        QCOMPARE(mLoop->exec(), 0);
+        QCOMPARE(chan->state(), TubeChannelStateLocalPending);
+
+        PendingStreamTubeConnection *pstc;
+        if (addressType == TP_SOCKET_ADDRESS_TYPE_UNIX) {
+            pstc = chan->acceptTubeAsUnixSocket();
+        } else {
+            pstc = chan->acceptTubeAsTcpSocket();
+        }
+        QVERIFY(connect(pstc,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+        QCOMPARE(mLoop->exec(), 0);
+        QCOMPARE(chan->state(), TubeChannelStateOpen);
+    }
+}
+
+void BenchStreamTubeChan::cleanup()
+{
+    tp_clear_object(&mChanService);
+    mLoop->processEvents();
+
+    cleanupImpl();
+}
+
+void BenchStreamTubeChan::cleanupTestCase()
+{
+    QCOMPARE(mConn->disconnect(), true);
+    delete mConn;
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(BenchStreamTubeChan)
+#include "_gen/stream-tube-chan.cpp.moc.hpp"
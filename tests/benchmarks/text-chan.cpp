@@ -0,0 +1,192 @@
+#include <tests/lib/test.h>
+
+#include <tests/lib/glib-helpers/test-conn-helper.h>
+
+#include <tests/lib/glib/contacts-conn.h>
+#include <tests/lib/glib/echo2/chan.h>
+
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/PendingReady>
+#include <TelepathyQt/ReceivedMessage>
+#include <TelepathyQt/TextChannel>
+
+#include <telepathy-glib/debug.h>
+
+using namespace Tp;
+
+class BenchTextChan : public Test
+{
+    Q_OBJECT
+
+public:
+    BenchTextChan(QObject *parent = 0)
+        : Test(parent),
+          mConn(0), mChanService(0), mExpected(0)
+    { }
+
+protected Q_SLOTS:
+    void onMessageReceived(const Tp::ReceivedMessage &);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void benchmarkReceiveMessages_data();
+    void benchmarkReceiveMessages();
+    void benchmarkMessageAccessors();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    TestConnHelper *mConn;
+    ExampleEcho2Channel *mChanService;
+    TextChannelPtr mChan;
+    QList<ReceivedMessage> mReceived;
+    int mExpected;
+};
+
+void BenchTextChan::onMessageReceived(const ReceivedMessage &message)
+{
+    mReceived << message;
+    if (mReceived.size() == mExpected) {
+        mLoop->exit(0);
+    }
+}
+
+void BenchTextChan::initTestCase()
+{
+    initTestCaseImpl();
+
+    g_type_init();
+    g_set_prgname("bench-text-chan");
+    tp_debug_set_flags("");
+    dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+
+    Tp::enableDebug(false);
+
+    mConn = new TestConnHelper(this,
+            TP_TESTS_TYPE_CONTACTS_CONNECTION,
+            "account", "me@example.com",
+            "protocol", "example",
+            NULL);
+    QCOMPARE(mConn->connect(), true);
+
+    TpHandleRepoIface *contactRepo = tp_base_connection_get_handles(
+            TP_BASE_CONNECTION(mConn->service()), TP_HANDLE_TYPE_CONTACT);
+    guint handle = tp_handle_ensure(contactRepo, "someone@localhost", 0, 0);
+
+    // create a Channel by magic, rather than doing D-Bus round-trips for it
+    QString chanPath = mConn->objectPath() + QLatin1String("/MessagesChannel");
+    mChanService = EXAMPLE_ECHO_2_CHANNEL(g_object_new(
+                EXAMPLE_TYPE_ECHO_2_CHANNEL,
+                "connection", mConn->service(),
+                "object-path", chanPath.toLatin1().constData(),
+                "handle", handle,
+                NULL));
+
+    mChan = TextChannel::create(mConn->client(), chanPath, QVariantMap());
+    QVERIFY(connect(mChan->becomeReady(TextChannel::FeatureMessageQueue),
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    QVERIFY(connect(mChan.data(),
+                SIGNAL(messageReceived(Tp::ReceivedMessage)),
+                SLOT(onMessageReceived(Tp::ReceivedMessage))));
+}
+
+void BenchTextChan::init()
+{
+    initImpl();
+
+    mReceived.clear();
+    mExpected = 0;
+}
+
+void BenchTextChan::benchmarkReceiveMessages_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void BenchTextChan::benchmarkReceiveMessages()
+{
+    QFETCH(int, count);
+
+    QBENCHMARK {
+        // The echo channel sends every message straight back to us, so each send results in
+        // one received message going through the whole message queue machinery
+        mReceived.clear();
+        mExpected = count;
+        for (int i = 0; i < count; ++i) {
+            mChan->send(QString(QLatin1String("Message %1")).arg(i));
+        }
+        QCOMPARE(mLoop->exec(), 0);
+        QCOMPARE(mReceived.size(), count);
+
+        // Don't let the pending message queue grow across iterations
+        mChan->acknowledge(mReceived);
+    }
+
+    processDBusQueue(mChan.data());
+}
+
+void BenchTextChan::benchmarkMessageAccessors()
+{
+    const int count = 100;
+
+    mExpected = count;
+    for (int i = 0; i < count; ++i) {
+        mChan->send(QString(QLatin1String("Message %1")).arg(i));
+    }
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mReceived.size(), count);
+
+    // UI models typically query the same few accessors over and over for every message
+    QBENCHMARK {
+        int length = 0;
+        foreach (const ReceivedMessage &message, mReceived) {
+            length += message.text().length();
+            QVERIFY(!message.hasNonTextContent());
+            QVERIFY(!message.isTruncated());
+            if (message.received().isValid()) {
+                ++length;
+            }
+            length += message.messageToken().length();
+            length += message.senderNickname().length();
+            QVERIFY(!message.isDeliveryReport());
+        }
+        QVERIFY(length > 0);
+    }
+
+    mChan->acknowledge(mReceived);
+    processDBusQueue(mChan.data());
+}
+
+void BenchTextChan::cleanup()
+{
+    mReceived.clear();
+
+    cleanupImpl();
+}
+
+void BenchTextChan::cleanupTestCase()
+{
+    mChan.reset();
+
+    QCOMPARE(mConn->disconnect(), true);
+    delete mConn;
+
+    if (mChanService != 0) {
+        g_object_unref(mChanService);
+        mChanService = 0;
+    }
+
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(BenchTextChan)
+#include "_gen/text-chan.cpp.moc.hpp"
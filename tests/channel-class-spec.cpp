@@ -29,6 +29,7 @@ public:
 
 private Q_SLOTS:
     void testChannelClassSpecHash();
+    void testChannelClassSpecHashUpdates();
     void testServiceLeaks();
 };
 
@@ -121,6 +122,48 @@ void TestChannelClassSpec::testChannelClassSpecHash()
     QVERIFY(qHash(sl1) != qHash(sl2));
 }
 
+void TestChannelClassSpec::testChannelClassSpecHashUpdates()
+{
+    ChannelClassSpec st = ChannelClassSpec::textChat();
+    ChannelClassSpec modified(st);
+    QCOMPARE(qHash(modified), qHash(st));
+    QVERIFY(modified == st);
+
+    // modifying a copy must not affect the hash of the original
+    modified.setRequested(true);
+    QVERIFY(qHash(modified) != qHash(st));
+    QVERIFY(!(modified == st));
+    QCOMPARE(qHash(st), qHash(ChannelClassSpec::textChat()));
+    QVERIFY(st.isSubsetOf(modified));
+    QVERIFY(!modified.isSubsetOf(st));
+
+    // and undoing the modification gets us back to an equal spec
+    modified.unsetRequested();
+    QCOMPARE(qHash(modified), qHash(st));
+    QVERIFY(modified == st);
+
+    // values of different types which QVariant considers equal make equal specs, even though
+    // their string forms differ
+    ChannelClassSpec boolSpec = ChannelClassSpec::textChat();
+    boolSpec.setProperty(TP_QT_IFACE_CHANNEL + QLatin1String(".Requested"), QVariant(true));
+    ChannelClassSpec uintSpec = ChannelClassSpec::textChat();
+    uintSpec.setProperty(TP_QT_IFACE_CHANNEL + QLatin1String(".Requested"), QVariant(1u));
+    QVERIFY(boolSpec.allProperties() == uintSpec.allProperties());
+    QVERIFY(boolSpec == uintSpec);
+    QVERIFY(uintSpec == boolSpec);
+
+    // an empty spec is a subset of anything, and equal to an invalid one
+    ChannelClassSpec empty(QString(), HandleTypeNone);
+    empty.unsetProperty(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"));
+    empty.unsetProperty(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"));
+    QVERIFY(empty.allProperties().isEmpty());
+    QVERIFY(empty == ChannelClassSpec());
+    QCOMPARE(qHash(empty), qHash(ChannelClassSpec()));
+    QVERIFY(empty.isSubsetOf(st));
+    QVERIFY(ChannelClassSpec().isSubsetOf(st));
+    QVERIFY(!st.isSubsetOf(ChannelClassSpec()));
+}
+
 void TestChannelClassSpec::testServiceLeaks()
 {
     ChannelClassSpec bareTube = ChannelClassSpec::outgoingStreamTube();
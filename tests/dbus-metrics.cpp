@@ -0,0 +1,127 @@
+#include <QtTest/QtTest>
+
+#include <TelepathyQt/DBusMetrics>
+
+using namespace Tp;
+
+class TestDBusMetrics : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+
+    void testDisabled();
+    void testCalls();
+    void testSignals();
+    void testReset();
+
+    void cleanup();
+};
+
+static DBusMetrics::Entry findEntry(DBusMetrics::Kind kind, const QString &memberName)
+{
+    foreach (const DBusMetrics::Entry &entry, DBusMetrics::entries()) {
+        if (entry.kind() == kind && entry.memberName() == memberName) {
+            return entry;
+        }
+    }
+    return DBusMetrics::Entry();
+}
+
+void TestDBusMetrics::init()
+{
+    DBusMetrics::reset();
+}
+
+void TestDBusMetrics::testDisabled()
+{
+    QCOMPARE(DBusMetrics::isEnabled(), false);
+
+    {
+        DBusMetrics::CallScope scope(QLatin1String("com.example.Foo"), QLatin1String("Bar"));
+    }
+
+    QVERIFY(DBusMetrics::entries().isEmpty());
+}
+
+void TestDBusMetrics::testCalls()
+{
+    DBusMetrics::setEnabled(true);
+
+    QList<uint> limits = DBusMetrics::latencyBucketLimits();
+    QVERIFY(!limits.isEmpty());
+
+    DBusMetrics::recordCall(DBusMetrics::OutgoingCall, QLatin1String("com.example.Foo"),
+            QLatin1String("Bar"), 0, false);
+    DBusMetrics::recordCall(DBusMetrics::OutgoingCall, QLatin1String("com.example.Foo"),
+            QLatin1String("Bar"), limits.last() + 1, true);
+
+    {
+        DBusMetrics::CallScope scope(QLatin1String("com.example.Foo"), QLatin1String("Bar"));
+        scope.setError();
+    }
+
+    QCOMPARE(DBusMetrics::entries().size(), 2);
+
+    DBusMetrics::Entry outgoing = findEntry(DBusMetrics::OutgoingCall, QLatin1String("Bar"));
+    QVERIFY(outgoing.isValid());
+    QCOMPARE(outgoing.interfaceName(), QString(QLatin1String("com.example.Foo")));
+    QCOMPARE(outgoing.count(), 2U);
+    QCOMPARE(outgoing.errorCount(), 1U);
+    QCOMPARE(outgoing.totalLatency(), (quint64) limits.last() + 1);
+
+    QList<uint> histogram = outgoing.latencyHistogram();
+    QCOMPARE(histogram.size(), limits.size() + 1);
+    QCOMPARE(histogram.first(), 1U);
+    QCOMPARE(histogram.last(), 1U);
+
+    DBusMetrics::Entry incoming = findEntry(DBusMetrics::IncomingCall, QLatin1String("Bar"));
+    QVERIFY(incoming.isValid());
+    QCOMPARE(incoming.count(), 1U);
+    QCOMPARE(incoming.errorCount(), 1U);
+}
+
+void TestDBusMetrics::testSignals()
+{
+    DBusMetrics::setEnabled(true);
+
+    DBusMetrics::recordSignal(DBusMetrics::IncomingSignal, QLatin1String("com.example.Foo"),
+            QLatin1String("Changed"));
+    DBusMetrics::recordSignal(DBusMetrics::IncomingSignal, QLatin1String("com.example.Foo"),
+            QLatin1String("Changed"));
+
+    DBusMetrics::Entry entry = findEntry(DBusMetrics::IncomingSignal, QLatin1String("Changed"));
+    QVERIFY(entry.isValid());
+    QCOMPARE(entry.count(), 2U);
+    QCOMPARE(entry.errorCount(), 0U);
+    QCOMPARE(entry.totalLatency(), (quint64) 0);
+}
+
+void TestDBusMetrics::testReset()
+{
+    DBusMetrics::setEnabled(true);
+
+    DBusMetrics::recordSignal(DBusMetrics::OutgoingSignal, QLatin1String("com.example.Foo"),
+            QLatin1String("Changed"));
+
+    // Entries already returned are not affected by later updates
+    DBusMetrics::Entry entry = findEntry(DBusMetrics::OutgoingSignal, QLatin1String("Changed"));
+    DBusMetrics::recordSignal(DBusMetrics::OutgoingSignal, QLatin1String("com.example.Foo"),
+            QLatin1String("Changed"));
+    QCOMPARE(entry.count(), 1U);
+
+    DBusMetrics::reset();
+    QVERIFY(DBusMetrics::entries().isEmpty());
+    QCOMPARE(entry.count(), 1U);
+}
+
+void TestDBusMetrics::cleanup()
+{
+    DBusMetrics::setEnabled(false);
+    DBusMetrics::reset();
+}
+
+QTEST_MAIN(TestDBusMetrics)
+
+#include "_gen/dbus-metrics.cpp.moc.hpp"
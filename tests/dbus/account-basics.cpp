@@ -5,6 +5,7 @@
 #include <tests/lib/glib/echo2/conn.h>
 
 #include <TelepathyQt/Account>
+#include <TelepathyQt/AccountFactory>
 #include <TelepathyQt/AccountManager>
 #include <TelepathyQt/AccountSet>
 #include <TelepathyQt/ConnectionCapabilities>
@@ -17,8 +18,73 @@
 
 #include <telepathy-glib/debug.h>
 
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryFile>
+
 using namespace Tp;
 
+namespace
+{
+
+// Hooks up the accounts to the test as soon as they are constructed, so that the signals emitted
+// while restoring them from the snapshot are seen as well
+class RecordingAccountFactory : public AccountFactory
+{
+public:
+    static AccountFactoryPtr create(const QDBusConnection &bus, const Features &features,
+            QObject *recorder)
+    {
+        return AccountFactoryPtr(new RecordingAccountFactory(bus, features, recorder));
+    }
+
+protected:
+    RecordingAccountFactory(const QDBusConnection &bus, const Features &features,
+            QObject *recorder)
+        : AccountFactory(bus, features),
+          mRecorder(recorder)
+    {
+    }
+
+    AccountPtr construct(const QString &busName, const QString &objectPath,
+            const ConnectionFactoryConstPtr &connFactory,
+            const ChannelFactoryConstPtr &chanFactory,
+            const ContactFactoryConstPtr &contactFactory) const
+    {
+        AccountPtr account = AccountFactory::construct(busName, objectPath, connFactory,
+                chanFactory, contactFactory);
+        QObject::connect(account.data(), SIGNAL(displayNameChanged(QString)),
+                mRecorder, SLOT(onSnapshotAccountDisplayNameChanged(QString)));
+        QObject::connect(account.data(), SIGNAL(removed()),
+                mRecorder, SLOT(onSnapshotAccountRemoved()));
+        return account;
+    }
+
+private:
+    QObject *mRecorder;
+};
+
+// As written by AccountManager
+bool readSnapshot(const QString &fileName, QMap<QString, QVariantMap> *accountsProperties)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+    quint32 magic, version;
+    QString busName;
+    QStringList interfaces, supportedAccountProperties;
+    stream >> magic >> version >> busName >> interfaces >> supportedAccountProperties >>
+        *accountsProperties;
+    return stream.status() == QDataStream::Ok && busName == TP_QT_ACCOUNT_MANAGER_BUS_NAME;
+}
+
+}
+
 class TestAccountBasics : public Test
 {
     Q_OBJECT
@@ -43,12 +109,15 @@ protected Q_SLOTS:
     void onAccountAutomaticPresenceChanged(const Tp::Presence &);
     void onAccountRequestedPresenceChanged(const Tp::Presence &);
     void onAccountCurrentPresenceChanged(const Tp::Presence &);
+    void onSnapshotAccountDisplayNameChanged(const QString &);
+    void onSnapshotAccountRemoved();
 
 private Q_SLOTS:
     void initTestCase();
     void init();
 
     void testBasics();
+    void testSnapshot();
 
     void cleanup();
     void cleanupTestCase();
@@ -63,6 +132,8 @@ private:
     bool mCreatingAccount;
 
     QHash<QString, QVariant> mProps;
+    QHash<QString, QStringList> mSnapshotDisplayNames;
+    QStringList mSnapshotRemoved;
 };
 
 #define TEST_VERIFY_PROPERTY_CHANGE(acc, Type, PropertyName, propertyName, expectedValue) \
@@ -129,6 +200,20 @@ TEST_IMPLEMENT_PROPERTY_CHANGE_SLOT(const Presence &, AutomaticPresence)
 TEST_IMPLEMENT_PROPERTY_CHANGE_SLOT(const Presence &, RequestedPresence)
 TEST_IMPLEMENT_PROPERTY_CHANGE_SLOT(const Presence &, CurrentPresence)
 
+void TestAccountBasics::onSnapshotAccountDisplayNameChanged(const QString &displayName)
+{
+    Account *account = qobject_cast<Account *>(sender());
+    QVERIFY(account != 0);
+    mSnapshotDisplayNames[account->objectPath()].append(displayName);
+}
+
+void TestAccountBasics::onSnapshotAccountRemoved()
+{
+    Account *account = qobject_cast<Account *>(sender());
+    QVERIFY(account != 0);
+    mSnapshotRemoved.append(account->objectPath());
+}
+
 QStringList TestAccountBasics::pathsForAccounts(const QList<AccountPtr> &list)
 {
     QStringList ret;
@@ -581,6 +666,119 @@ void TestAccountBasics::testBasics()
     processDBusQueue(mConn->client().data());
 }
 
+void TestAccountBasics::testSnapshot()
+{
+    // In a directory which doesn't exist yet, so that the snapshot creates it
+    QString dirName;
+    {
+        QTemporaryFile tmp;
+        QVERIFY(tmp.open());
+        dirName = tmp.fileName() + QLatin1String(".d");
+    }
+    QString fileName = dirName + QLatin1String("/snapshot");
+    QFile::Permissions groupAndOther = QFile::ReadGroup | QFile::WriteGroup | QFile::ExeGroup |
+        QFile::ReadOther | QFile::WriteOther | QFile::ExeOther;
+
+    AccountManagerPtr am = AccountManager::create(AccountFactory::create(
+                QDBusConnection::sessionBus(), Account::FeatureCore));
+    am->setSnapshotFileName(fileName);
+    QVERIFY(connect(am->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    // Saved once FeatureCore is ready, without the parameters
+    processDBusQueue(am.data());
+    QVERIFY(QFile::exists(fileName));
+    QVERIFY(!(QFile::permissions(fileName) & groupAndOther));
+    QVERIFY(!(QFile::permissions(dirName) & groupAndOther));
+    QMap<QString, QVariantMap> accountsProperties;
+    QVERIFY(readSnapshot(fileName, &accountsProperties));
+
+    QStringList paths = pathsForAccounts(am->allAccounts());
+    paths.sort();
+    QCOMPARE(paths.size(), 2);
+    QCOMPARE(QStringList(accountsProperties.keys()), paths);
+    Q_FOREACH (const QVariantMap &props, accountsProperties) {
+        QVERIFY(!props.contains(QLatin1String("Parameters")));
+    }
+
+    QString changedPath = QLatin1String("/org/freedesktop/Telepathy/Account/foo/bar/Account0");
+    QString removedPath = QLatin1String("/org/freedesktop/Telepathy/Account/spurious/normal/Account0");
+    QVERIFY(paths.contains(changedPath));
+    QVERIFY(paths.contains(removedPath));
+    AccountPtr acc = am->accountForObjectPath(changedPath);
+    QString displayName = acc->displayName();
+    QString nickname = acc->nickname();
+    bool enabled = acc->isEnabled();
+    QCOMPARE(accountsProperties[changedPath][QLatin1String("DisplayName")].toString(), displayName);
+    acc.reset();
+
+    // Nothing changed, so destroying the account manager doesn't write the snapshot again
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray data = file.readAll();
+    file.close();
+    QVERIFY(QFile::remove(fileName));
+    am.reset();
+    processDBusQueue(mAM.data());
+    QVERIFY(!QFile::exists(fileName));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(data), qint64(data.size()));
+    file.close();
+
+    // Make the account manager on the bus differ from the snapshot
+    QString changedDisplayName = QLatin1String("changed since the snapshot");
+    QVERIFY(connect(mAM->accountForObjectPath(changedPath)->setDisplayName(changedDisplayName),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(connect(mAM->accountForObjectPath(removedPath)->remove(),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    // Use a new factory, so that we don't get the already introspected proxies back
+    mSnapshotDisplayNames.clear();
+    mSnapshotRemoved.clear();
+    am = AccountManager::create(RecordingAccountFactory::create(
+                QDBusConnection::sessionBus(), Account::FeatureCore, this));
+    am->setSnapshotFileName(fileName);
+    QVERIFY(connect(am->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation *)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation *))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    // FeatureCore finished with the snapshot values, before they were reconciled with the bus
+    acc = am->accountForObjectPath(changedPath);
+    QVERIFY(acc->isReady(Account::FeatureCore));
+    QCOMPARE(mSnapshotDisplayNames.value(changedPath).value(0), displayName);
+    QCOMPARE(acc->nickname(), nickname);
+    QCOMPARE(acc->isEnabled(), enabled);
+
+    // The reconciliation then brings the accounts up to date, emitting the change signals
+    processDBusQueue(am.data());
+    processDBusQueue(acc.data());
+    QCOMPARE(acc->displayName(), changedDisplayName);
+    QCOMPARE(mSnapshotDisplayNames.value(changedPath),
+            QStringList() << displayName << changedDisplayName);
+    QCOMPARE(mSnapshotRemoved, QStringList() << removedPath);
+    QCOMPARE(pathsForAccounts(am->allAccounts()), QStringList() << changedPath);
+
+    // And the snapshot is saved again with the changes, still without the parameters
+    processDBusQueue(am.data());
+    QVERIFY(readSnapshot(fileName, &accountsProperties));
+    QCOMPARE(QStringList(accountsProperties.keys()), QStringList() << changedPath);
+    QCOMPARE(accountsProperties[changedPath][QLatin1String("DisplayName")].toString(),
+            changedDisplayName);
+    QVERIFY(!accountsProperties[changedPath].contains(QLatin1String("Parameters")));
+
+    acc.reset();
+    am.reset();
+    QFile::remove(fileName);
+    QDir().rmdir(dirName);
+}
+
 void TestAccountBasics::cleanup()
 {
     cleanupImpl();
@@ -235,7 +235,8 @@ public:
           mCurRequest(0),
           mInvokeHandler(false),
           mChannelRequestShouldFail(false),
-          mChannelRequestProceedNoop(false)
+          mChannelRequestProceedNoop(false),
+          mReplyDelay(0)
     {
     }
 
@@ -292,20 +293,28 @@ public Q_SLOTS: // Methods
 
     QDBusObjectPath CreateChannelWithHints(const QDBusObjectPath &account,
             const QVariantMap &requestedProperties, qlonglong userActionTime,
-            const QString &preferredHandler, const QVariantMap &hints)
+            const QString &preferredHandler, const QVariantMap &hints,
+            const QDBusMessage &message)
     {
         lastCall = CC;
         return createChannel(account, requestedProperties,
-                userActionTime, preferredHandler, hints);
+                userActionTime, preferredHandler, hints, message);
     }
 
     QDBusObjectPath EnsureChannelWithHints(const QDBusObjectPath &account,
             const QVariantMap &requestedProperties, qlonglong userActionTime,
-            const QString &preferredHandler, const QVariantMap &hints)
+            const QString &preferredHandler, const QVariantMap &hints,
+            const QDBusMessage &message)
     {
         lastCall = EC;
         return createChannel(account, requestedProperties,
-                userActionTime, preferredHandler, hints);
+                userActionTime, preferredHandler, hints, message);
+    }
+
+private Q_SLOTS:
+    void sendDelayedReply()
+    {
+        mBus.send(mDelayedReplies.takeFirst());
     }
 
 private:
@@ -313,10 +322,15 @@ private:
 
     QDBusObjectPath createChannel(const QDBusObjectPath &account,
             const QVariantMap &requestedProperties, qlonglong userActionTime,
-            const QString &preferredHandler, const QVariantMap &hints = QVariantMap())
+            const QString &preferredHandler, const QVariantMap &hints = QVariantMap(),
+            const QDBusMessage &message = QDBusMessage())
     {
         QObject *request = new QObject(this);
 
+        if (!mQueuedChanPaths.isEmpty()) {
+            mChanPath = mQueuedChanPaths.takeFirst();
+        }
+
         mCurRequest = new ChannelRequestAdaptor(
                 account,
                 userActionTime,
@@ -339,6 +353,14 @@ private:
             invokeHandler(userActionTime);
         }
 
+        // Let the handler receive the channel before we tell the account about the request
+        if (mReplyDelay > 0 && message.type() == QDBusMessage::MethodCallMessage) {
+            message.setDelayedReply(true);
+            mDelayedReplies.append(message.createReply(
+                        QVariant::fromValue(QDBusObjectPath(mCurRequestPath))));
+            QTimer::singleShot(mReplyDelay, this, SLOT(sendDelayedReply()));
+        }
+
         return QDBusObjectPath(mCurRequestPath);
     }
 
@@ -382,6 +404,10 @@ private:
     bool mChannelRequestProceedNoop;
     QString mConnPath, mChanPath;
     QVariantMap mConnProps, mChanProps;
+    // Channels to give to the next requests, in order
+    QStringList mQueuedChanPaths;
+    int mReplyDelay;
+    QList<QDBusMessage> mDelayedReplies;
     static MethodCall lastCall;
 };
 
@@ -408,6 +434,7 @@ protected Q_SLOTS:
     void onPendingChannelFinished(Tp::PendingOperation *op);
     void onChannelHandledAgain(const QDateTime &userActionTime,
             const Tp::ChannelRequestHints &hints);
+    void onConcurrentPendingChannelFinished(Tp::PendingOperation *op);
 
 private Q_SLOTS:
     void initTestCase();
@@ -438,6 +465,9 @@ private Q_SLOTS:
     void testCreateAndHandleChannelFail();
     void testCreateAndHandleChannelHandledAgain();
     void testCreateAndHandleChannelHandledChannels();
+    void testCreateAndHandleChannelConcurrent();
+    void testCreateAndHandleChannelBeforeRequestCreated();
+    void testCreateAndHandleChannelAfterIdle();
     void testCreateAndHandleFileTransferChannel();
     void testCreateAndHandleFileTransferChannelFail();
     void testCreateAndHandleFileTransferChannelInvalidParameters();
@@ -470,6 +500,7 @@ private:
     QString mChanPath;
     QVariantMap mConnProps, mChanProps;
     QString mFilePath;
+    QHash<Tp::PendingOperation *, QString> mConcurrentChannelPaths;
 };
 
 void TestAccountChannelDispatcher::onPendingChannelRequestFinished(
@@ -497,6 +528,20 @@ void TestAccountChannelDispatcher::onChannelHandledAgain(const QDateTime &userAc
     mLoop->exit(0);
 }
 
+void TestAccountChannelDispatcher::onConcurrentPendingChannelFinished(
+        Tp::PendingOperation *op)
+{
+    PendingChannel *pc = qobject_cast<PendingChannel *>(op);
+    QVERIFY(pc);
+    if (op->isError()) {
+        qWarning() << "Request failed with" << op->errorName() << ":" << op->errorMessage();
+        mConcurrentChannelPaths.insert(op, QString());
+    } else {
+        mConcurrentChannelPaths.insert(op, pc->channel()->objectPath());
+    }
+    mLoop->exit(0);
+}
+
 void TestAccountChannelDispatcher::initTestCase()
 {
     initTestCaseImpl();
@@ -568,6 +613,7 @@ void TestAccountChannelDispatcher::init()
 
     mChanPath.clear();
     mChanProps.clear();
+    mConcurrentChannelPaths.clear();
     mFilePath = QCoreApplication::applicationFilePath();
 }
 
@@ -1181,6 +1227,100 @@ void TestAccountChannelDispatcher::testCreateAndHandleChannelHandledChannels()
     QVERIFY(ourHandledChannels().isEmpty());
 }
 
+void TestAccountChannelDispatcher::testCreateAndHandleChannelConcurrent()
+{
+    QString chanPath1 = mConn->objectPath() + QLatin1String("/channelconcurrent1");
+    QString chanPath2 = mConn->objectPath() + QLatin1String("/channelconcurrent2");
+    mChanProps = ChannelClassSpec::textChat().allProperties();
+
+    mChannelDispatcherAdaptor->mInvokeHandler = true;
+    mChannelDispatcherAdaptor->mChannelRequestShouldFail = false;
+    mChannelDispatcherAdaptor->mChannelRequestProceedNoop = false;
+    mChannelDispatcherAdaptor->setChan(mConn->objectPath(), mConnProps, chanPath1, mChanProps);
+    mChannelDispatcherAdaptor->mQueuedChanPaths << chanPath1 << chanPath2;
+
+    QVariantMap request;
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+            TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            (uint) Tp::HandleTypeContact);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"),
+            QLatin1String("foo@bar"));
+
+    // Both requests are pending at the same time on the same shared handler, and each of them
+    // gets the channel which satisfied it
+    PendingChannel *pc1 = mAccount->createAndHandleChannel(request, mUserActionTime);
+    PendingChannel *pc2 = mAccount->createAndHandleChannel(request, mUserActionTime);
+    QVERIFY(connect(pc1,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(onConcurrentPendingChannelFinished(Tp::PendingOperation*))));
+    QVERIFY(connect(pc2,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(onConcurrentPendingChannelFinished(Tp::PendingOperation*))));
+    while (mConcurrentChannelPaths.size() < 2) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+
+    QCOMPARE(mConcurrentChannelPaths.value(pc1), chanPath1);
+    QCOMPARE(mConcurrentChannelPaths.value(pc2), chanPath2);
+    QVERIFY(mChannelDispatcherAdaptor->mQueuedChanPaths.isEmpty());
+    QCOMPARE(ourHandlers().size(), 1);
+}
+
+void TestAccountChannelDispatcher::testCreateAndHandleChannelBeforeRequestCreated()
+{
+    mChanPath = mConn->objectPath() + QLatin1String("/channelearly");
+    mChanProps = ChannelClassSpec::textChat().allProperties();
+
+    // The channel dispatcher invokes the handler, and only later replies to CreateChannel, so the
+    // handler receives the channel before knowing the object path of the request
+    mChannelDispatcherAdaptor->mReplyDelay = 200;
+    ChannelPtr channel;
+    TEST_CREATE_ENSURE_AND_HANDLE_CHANNEL(createAndHandleChannel, false, false, true, "", &channel, 0);
+    mChannelDispatcherAdaptor->mReplyDelay = 0;
+
+    QVERIFY(mChannelDispatcherAdaptor->mDelayedReplies.isEmpty());
+    QVERIFY(!channel.isNull());
+    QVERIFY(ourHandledChannels().contains(mChanPath));
+}
+
+void TestAccountChannelDispatcher::testCreateAndHandleChannelAfterIdle()
+{
+    mChanPath = mConn->objectPath() + QLatin1String("/channelidle");
+    mChanProps = ChannelClassSpec::textChat().allProperties();
+
+    ChannelPtr channel;
+    TEST_CREATE_ENSURE_AND_HANDLE_CHANNEL(createAndHandleChannel, false, false, true, "", &channel, 0);
+    QList<ClientHandlerInterface *> handlers = ourHandlers();
+    QCOMPARE(handlers.size(), 1);
+    QString handlerName = handlers.first()->service();
+
+    // Once the request and its channel are gone, the handler is idle but stays registered for a
+    // while, so that the next request doesn't have to register a new one
+    channel.reset();
+    while (ourHandledChannels().contains(mChanPath)) {
+        mLoop->processEvents();
+    }
+    handlers = ourHandlers();
+    QCOMPARE(handlers.size(), 1);
+    QCOMPARE(handlers.first()->service(), handlerName);
+
+    mChanPath = mConn->objectPath() + QLatin1String("/channelidle2");
+    TEST_CREATE_ENSURE_AND_HANDLE_CHANNEL(createAndHandleChannel, false, false, true, "", &channel, 0);
+    QVERIFY(!channel.isNull());
+    handlers = ourHandlers();
+    QCOMPARE(handlers.size(), 1);
+    QCOMPARE(handlers.first()->service(), handlerName);
+    QVERIFY(ourHandledChannels().contains(mChanPath));
+
+    // After being idle for long enough, it is unregistered
+    channel.reset();
+    while (!ourHandlers().isEmpty()) {
+        mLoop->processEvents();
+    }
+    QVERIFY(ourHandledChannels().isEmpty());
+}
+
 #define TEST_CREATE_AND_HANDLE_FILE_TRANSFER_CHANNEL(channelRequestShouldFail, shouldFail, \
         invalidProps, invokeHandler, expectedError, channelOut, pcOut) \
     TEST_CREATE_AND_HANDLE_FILE_TRANSFER_CHANNEL_EXTENDED(QLatin1String("foo@bar"), \
@@ -128,6 +128,16 @@ void TestBaseCM::testProtocolsCreateCM(BaseConnectionManagerPtr &cm)
             props[TP_QT_IFACE_CONNECTION_MANAGER + QLatin1String(".Protocols")]);
     QVERIFY(protocols.contains(QLatin1String("myprotocol")));
     QVERIFY(!protocols.contains(QLatin1String("otherprotocol")));
+
+    // the properties are built once after registration and reused afterwards
+    QVariantMap protocolProps = cm->protocol(QLatin1String("myprotocol"))->immutableProperties();
+    QCOMPARE(protocols.value(QLatin1String("myprotocol")).keys(), protocolProps.keys());
+
+    props = cm->immutableProperties();
+    protocols = qvariant_cast<Tp::ProtocolPropertiesMap>(
+            props[TP_QT_IFACE_CONNECTION_MANAGER + QLatin1String(".Protocols")]);
+    QCOMPARE(protocols.keys(), QStringList() << QLatin1String("myprotocol"));
+    QCOMPARE(protocols.value(QLatin1String("myprotocol")).keys(), protocolProps.keys());
 }
 
 void TestBaseCM::testProtocols()
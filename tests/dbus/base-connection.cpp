@@ -0,0 +1,804 @@
+#include <tests/lib/test.h>
+
+#define TP_QT_ENABLE_LOWLEVEL_API
+
+#include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/BaseConnection>
+#include <TelepathyQt/ChannelFactory>
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/ContactFactory>
+#include <TelepathyQt/DBusError>
+#include <TelepathyQt/DBusMetrics>
+#include <TelepathyQt/PendingReady>
+#include <TelepathyQt/RoomListChannel>
+
+#include <climits>
+
+using namespace Tp;
+
+namespace TestBaseConnectionCM // Avoid class name collisions with other tests and examples
+{
+
+class Connection : public BaseConnection
+{
+    Q_OBJECT
+
+public:
+    Connection(const QDBusConnection &dbusConnection,
+            const QString &cmName, const QString &protocolName,
+            const QVariantMap &parameters)
+        : BaseConnection(dbusConnection, cmName, protocolName, parameters),
+          mMatchChannelCalls(0)
+    {
+        setCreateChannelCallback(memFun(this, &Connection::createChannelCB));
+        setInspectHandlesCallback(memFun(this, &Connection::inspectHandlesCB));
+
+        mContactHandles.insert(1, QLatin1String("self@example.com"));
+        mContactHandles.insert(2, QLatin1String("alice@example.com"));
+        mContactHandles.insert(3, QLatin1String("bob@example.com"));
+
+        setSelfContact(1, QLatin1String("self@example.com"));
+
+        mSimplePresence = BaseConnectionSimplePresenceInterface::create();
+        plugInterface(AbstractConnectionInterfacePtr::dynamicCast(mSimplePresence));
+    }
+
+    using BaseConnection::setIndexedLookupOnly;
+
+    QMap<uint, QString> mContactHandles;
+    int mMatchChannelCalls;
+    BaseChannelRoomConfigInterfacePtr mRoomConfig;
+    BaseChannelRoomListTypePtr mRoomList;
+    BaseConnectionSimplePresenceInterfacePtr mSimplePresence;
+
+protected:
+    BaseChannelPtr createChannelCB(const QVariantMap &request, DBusError *error)
+    {
+        QString channelType = request.value(
+                TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")).toString();
+        if (channelType == TP_QT_IFACE_CHANNEL_TYPE_ROOM_LIST) {
+            BaseChannelPtr channel = BaseChannel::create(this, channelType);
+            mRoomList = BaseChannelRoomListType::create(QLatin1String("conference.example.com"));
+            channel->plugInterface(AbstractChannelInterfacePtr::dynamicCast(mRoomList));
+            return channel;
+        }
+
+        uint targetHandle = request.value(
+                TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle")).toUInt();
+        if (!targetHandle) {
+            targetHandle = mContactHandles.key(request.value(
+                        TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID")).toString().toLower());
+        }
+        if (!targetHandle) {
+            error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Unknown target"));
+            return BaseChannelPtr();
+        }
+
+        BaseChannelPtr channel = BaseChannel::create(this, channelType,
+                HandleTypeContact, targetHandle);
+
+        // Used to exercise the property change notifications
+        mRoomConfig = BaseChannelRoomConfigInterface::create();
+        channel->plugInterface(AbstractChannelInterfacePtr::dynamicCast(mRoomConfig));
+
+        return channel;
+    }
+
+    QStringList inspectHandlesCB(uint handleType, const UIntList &handles, DBusError *error)
+    {
+        Q_UNUSED(handleType);
+
+        QStringList ret;
+        Q_FOREACH (uint handle, handles) {
+            if (!mContactHandles.contains(handle)) {
+                error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Unknown handle"));
+                return QStringList();
+            }
+            ret << mContactHandles.value(handle);
+        }
+        return ret;
+    }
+
+    // Identifiers are case insensitive in this protocol
+    bool matchChannel(const BaseChannelPtr &channel, const QVariantMap &request,
+            DBusError *error)
+    {
+        ++mMatchChannelCalls;
+
+        QVariantMap::const_iterator targetID = request.constFind(
+                TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"));
+        if (targetID != request.constEnd()) {
+            return channel->targetID().compare(targetID.value().toString(),
+                    Qt::CaseInsensitive) == 0;
+        }
+
+        return BaseConnection::matchChannel(channel, request, error);
+    }
+};
+
+typedef SharedPtr<Connection> ConnectionPtr;
+
+} // TestBaseConnectionCM
+
+using namespace TestBaseConnectionCM;
+
+class TestBaseConnection : public Test
+{
+    Q_OBJECT
+
+public:
+    TestBaseConnection(QObject *parent = 0)
+        : Test(parent),
+          mClientBus(QDBusConnection::connectToBus(QDBusConnection::SessionBus,
+                      QLatin1String("base-connection-client")))
+    { }
+
+protected Q_SLOTS:
+    void onPropertiesChanged(const QString &interfaceName, const QVariantMap &changed,
+            const QStringList &invalidated);
+    void onUpdateConfigurationFinished(QDBusPendingCallWatcher *watcher);
+    void onPresencesChanged(const Tp::SimpleContactPresences &presences);
+    void onRoomsReceived(const Tp::RoomInfoList &rooms);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void testIndexedLookup();
+    void testMatchChannelOverride();
+    void testPropertiesChangedCoalescing();
+    void testPropertiesChangedBatches();
+    void testPropertiesChangedBeforeReply();
+    void testPresencesChangedChunks();
+    void testRoomList();
+    void testDBusMetrics();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    static QVariantMap textRequest(const QString &targetKey, const QVariant &target);
+    BaseChannelPtr ensureRoomConfigChannel();
+    void updateConfiguration(const QVariantMap &properties, DBusError *error);
+    void listRooms(DBusError *error);
+    static RoomInfo roomInfo(uint handle, const QString &id, const QString &name,
+            const QString &subject, int members);
+    static QList<uint> handlesFor(const RoomInfoList &rooms);
+    QDBusPendingCallWatcher *waitForCall(const QDBusPendingCall &call);
+
+    TestBaseConnectionCM::ConnectionPtr mConnection;
+
+    QDBusConnection mClientBus;
+    QString mWatchedChannelPath;
+    QList<QVariantMap> mPropertiesChanged;
+    QList<SimpleContactPresences> mPresencesChanged;
+    RoomListChannelPtr mRoomListChannel;
+    QList<int> mRoomBatchSizes;
+    QList<int> mRoomCounts;
+    QStringList mEvents;
+};
+
+QVariantMap TestBaseConnection::textRequest(const QString &targetKey, const QVariant &target)
+{
+    QVariantMap request;
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+            TP_QT_IFACE_CHANNEL_TYPE_TEXT);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            (uint) HandleTypeContact);
+    request.insert(TP_QT_IFACE_CHANNEL + targetKey, target);
+    return request;
+}
+
+void TestBaseConnection::onPropertiesChanged(const QString &interfaceName,
+        const QVariantMap &changed, const QStringList &invalidated)
+{
+    QCOMPARE(interfaceName, TP_QT_IFACE_CHANNEL_INTERFACE_ROOM_CONFIG);
+    QVERIFY(invalidated.isEmpty());
+
+    mPropertiesChanged.append(changed);
+    mEvents.append(QLatin1String("PropertiesChanged"));
+    mLoop->exit(0);
+}
+
+void TestBaseConnection::onUpdateConfigurationFinished(QDBusPendingCallWatcher *watcher)
+{
+    QVERIFY(!watcher->isError());
+    watcher->deleteLater();
+
+    mEvents.append(QLatin1String("UpdateConfiguration"));
+    mLoop->exit(0);
+}
+
+void TestBaseConnection::onPresencesChanged(const Tp::SimpleContactPresences &presences)
+{
+    mPresencesChanged.append(presences);
+    mLoop->exit(0);
+}
+
+void TestBaseConnection::onRoomsReceived(const Tp::RoomInfoList &rooms)
+{
+    // The rooms are indexed before the batch is signalled
+    mRoomBatchSizes.append(rooms.size());
+    mRoomCounts.append(mRoomListChannel->roomCount());
+    mLoop->exit(0);
+}
+
+BaseChannelPtr TestBaseConnection::ensureRoomConfigChannel()
+{
+    DBusError error;
+    bool yours;
+    BaseChannelPtr channel = mConnection->ensureChannel(
+            textRequest(QLatin1String(".TargetHandle"), 2U), yours, false, &error);
+    if (error.isValid() || !mConnection->mRoomConfig) {
+        return BaseChannelPtr();
+    }
+
+    // Watch from another connection, so that the signals and replies go through the bus
+    if (!mClientBus.connect(mConnection->busName(), channel->objectPath(),
+                TP_QT_IFACE_PROPERTIES, QLatin1String("PropertiesChanged"),
+                this, SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)))) {
+        return BaseChannelPtr();
+    }
+    mWatchedChannelPath = channel->objectPath();
+
+    return channel;
+}
+
+void TestBaseConnection::updateConfiguration(const QVariantMap &properties, DBusError *error)
+{
+    Q_UNUSED(error);
+
+    mConnection->mRoomConfig->setTitle(properties.value(QLatin1String("Title")).toString());
+    mConnection->mRoomConfig->setDescription(
+            properties.value(QLatin1String("Description")).toString());
+}
+
+void TestBaseConnection::listRooms(DBusError *error)
+{
+    Q_UNUSED(error);
+
+    mConnection->mRoomList->setListingRooms(true);
+}
+
+RoomInfo TestBaseConnection::roomInfo(uint handle, const QString &id, const QString &name,
+        const QString &subject, int members)
+{
+    RoomInfo room;
+    room.handle = handle;
+    room.channelType = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+    room.info.insert(QLatin1String("handle-name"), id);
+    room.info.insert(QLatin1String("name"), name);
+    if (!subject.isEmpty()) {
+        room.info.insert(QLatin1String("subject"), subject);
+    }
+    if (members >= 0) {
+        room.info.insert(QLatin1String("members"), QVariant::fromValue((uint) members));
+    }
+    return room;
+}
+
+QList<uint> TestBaseConnection::handlesFor(const RoomInfoList &rooms)
+{
+    QList<uint> ret;
+    Q_FOREACH (const RoomInfo &room, rooms) {
+        ret << room.handle;
+    }
+    return ret;
+}
+
+QDBusPendingCallWatcher *TestBaseConnection::waitForCall(const QDBusPendingCall &call)
+{
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), mLoop, SLOT(quit()));
+    mLoop->exec();
+    return watcher;
+}
+
+void TestBaseConnection::initTestCase()
+{
+    initTestCaseImpl();
+}
+
+void TestBaseConnection::init()
+{
+    initImpl();
+
+    mConnection = BaseConnection::create<TestBaseConnectionCM::Connection>(
+            QLatin1String("basecm"), QLatin1String("example"), QVariantMap());
+    DBusError error;
+    QVERIFY(mConnection->registerObject(&error));
+    QVERIFY(!error.isValid());
+}
+
+void TestBaseConnection::testIndexedLookup()
+{
+    DBusError error;
+    bool yours = false;
+
+    BaseChannelPtr alice = mConnection->ensureChannel(
+            textRequest(QLatin1String(".TargetHandle"), 2U), yours, false, &error);
+    QVERIFY(!error.isValid());
+    QCOMPARE(yours, true);
+    BaseChannelPtr bob = mConnection->ensureChannel(
+            textRequest(QLatin1String(".TargetHandle"), 3U), yours, false, &error);
+    QVERIFY(!error.isValid());
+    QCOMPARE(yours, true);
+
+    // Only the indexed channel is tried
+    mConnection->mMatchChannelCalls = 0;
+    QCOMPARE(mConnection->ensureChannel(
+                textRequest(QLatin1String(".TargetID"), QLatin1String("bob@example.com")),
+                yours, false, &error), bob);
+    QVERIFY(!error.isValid());
+    QCOMPARE(yours, false);
+    QCOMPARE(mConnection->mMatchChannelCalls, 1);
+
+    // None of the other channels of the type is tried when no channel is indexed for the target
+    mConnection->mMatchChannelCalls = 0;
+    BaseChannelPtr self = mConnection->ensureChannel(
+            textRequest(QLatin1String(".TargetHandle"), 1U), yours, false, &error);
+    QVERIFY(!error.isValid());
+    QVERIFY(!self.isNull());
+    QCOMPARE(yours, true);
+    QCOMPARE(mConnection->mMatchChannelCalls, 0);
+
+    // So the overridden matchChannel() doesn't get to match identifiers the index doesn't know
+    mConnection->mMatchChannelCalls = 0;
+    BaseChannelPtr otherAlice = mConnection->ensureChannel(
+            textRequest(QLatin1String(".TargetID"), QLatin1String("Alice@Example.com")),
+            yours, false, &error);
+    QVERIFY(!error.isValid());
+    QVERIFY(otherAlice != alice);
+    QCOMPARE(yours, true);
+    QCOMPARE(mConnection->mMatchChannelCalls, 0);
+}
+
+void TestBaseConnection::testMatchChannelOverride()
+{
+    DBusError error;
+    bool yours = false;
+
+    // The overridden matchChannel() matches channels which are not indexed under the TargetID
+    mConnection->setIndexedLookupOnly(false);
+
+    BaseChannelPtr channel = mConnection->ensureChannel(
+            textRequest(QLatin1String(".TargetID"), QLatin1String("alice@example.com")),
+            yours, false, &error);
+    QVERIFY(!error.isValid());
+    QVERIFY(!channel.isNull());
+    QCOMPARE(yours, true);
+    QCOMPARE(channel->targetID(), QLatin1String("alice@example.com"));
+
+    // Found through the index
+    mConnection->mMatchChannelCalls = 0;
+    QCOMPARE(mConnection->ensureChannel(
+                textRequest(QLatin1String(".TargetHandle"), 2U), yours, false, &error), channel);
+    QVERIFY(!error.isValid());
+    QCOMPARE(yours, false);
+    QCOMPARE(mConnection->mMatchChannelCalls, 1);
+
+    // Not in the index, but matched by the overridden matchChannel()
+    QCOMPARE(mConnection->ensureChannel(
+                textRequest(QLatin1String(".TargetID"), QLatin1String("Alice@Example.com")),
+                yours, false, &error), channel);
+    QVERIFY(!error.isValid());
+    QCOMPARE(yours, false);
+    QCOMPARE(mConnection->channelsDetails().size(), 1);
+
+    // Still creates a new channel when nothing matches
+    BaseChannelPtr otherChannel = mConnection->ensureChannel(
+            textRequest(QLatin1String(".TargetID"), QLatin1String("Bob@example.com")),
+            yours, false, &error);
+    QVERIFY(!error.isValid());
+    QVERIFY(!otherChannel.isNull());
+    QVERIFY(otherChannel != channel);
+    QCOMPARE(yours, true);
+    QCOMPARE(mConnection->channelsDetails().size(), 2);
+}
+
+void TestBaseConnection::testPropertiesChangedCoalescing()
+{
+    BaseChannelPtr channel = ensureRoomConfigChannel();
+    QVERIFY(!channel.isNull());
+    BaseChannelRoomConfigInterfacePtr roomConfig = mConnection->mRoomConfig;
+
+    // All the changes made in one main loop iteration go in one signal, with the latest values
+    roomConfig->setTitle(QLatin1String("first"));
+    roomConfig->setTitle(QLatin1String("second"));
+    roomConfig->setLimit(10);
+    QCOMPARE(roomConfig->propertiesChangedSignalsSent(), 0U);
+    QCOMPARE(roomConfig->propertyChangesCoalesced(), 2U);
+
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(roomConfig->propertiesChangedSignalsSent(), 1U);
+    QCOMPARE(mPropertiesChanged.size(), 1);
+    QCOMPARE(mPropertiesChanged[0].size(), 2);
+    QCOMPARE(mPropertiesChanged[0].value(QLatin1String("Title")).toString(),
+            QLatin1String("second"));
+    QCOMPARE(mPropertiesChanged[0].value(QLatin1String("Limit")).toUInt(), 10U);
+
+    // Nothing else is pending
+    QTimer::singleShot(100, mLoop, SLOT(quit()));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mPropertiesChanged.size(), 1);
+    QCOMPARE(roomConfig->propertiesChangedSignalsSent(), 1U);
+}
+
+void TestBaseConnection::testPropertiesChangedBatches()
+{
+    BaseChannelPtr channel = ensureRoomConfigChannel();
+    QVERIFY(!channel.isNull());
+    BaseChannelRoomConfigInterfacePtr roomConfig = mConnection->mRoomConfig;
+
+    roomConfig->beginPropertyChangeBatch();
+    roomConfig->setModerated(true);
+
+    roomConfig->beginPropertyChangeBatch();
+    roomConfig->setPersistent(true);
+    QVERIFY(roomConfig->endPropertyChangeBatch());
+
+    // The inner batch ending doesn't send anything, not even once back in the main loop
+    QCOMPARE(roomConfig->propertiesChangedSignalsSent(), 0U);
+    QCoreApplication::processEvents();
+    QCOMPARE(roomConfig->propertiesChangedSignalsSent(), 0U);
+
+    roomConfig->setInviteOnly(true);
+
+    // The outer one sends everything right away
+    QVERIFY(roomConfig->endPropertyChangeBatch());
+    QCOMPARE(roomConfig->propertiesChangedSignalsSent(), 1U);
+
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mPropertiesChanged.size(), 1);
+    QCOMPARE(mPropertiesChanged[0].size(), 3);
+    QCOMPARE(mPropertiesChanged[0].value(QLatin1String("Moderated")).toBool(), true);
+    QCOMPARE(mPropertiesChanged[0].value(QLatin1String("Persistent")).toBool(), true);
+    QCOMPARE(mPropertiesChanged[0].value(QLatin1String("InviteOnly")).toBool(), true);
+
+    // Unbalanced ends are refused
+    QVERIFY(!roomConfig->endPropertyChangeBatch());
+}
+
+void TestBaseConnection::testPropertiesChangedBeforeReply()
+{
+    BaseChannelPtr channel = ensureRoomConfigChannel();
+    QVERIFY(!channel.isNull());
+    BaseChannelRoomConfigInterfacePtr roomConfig = mConnection->mRoomConfig;
+    roomConfig->setUpdateConfigurationCallback(
+            memFun(this, &TestBaseConnection::updateConfiguration));
+
+    QVariantMap properties;
+    properties.insert(QLatin1String("Title"), QLatin1String("title"));
+    properties.insert(QLatin1String("Description"), QLatin1String("description"));
+
+    QDBusMessage call = QDBusMessage::createMethodCall(mConnection->busName(),
+            channel->objectPath(), TP_QT_IFACE_CHANNEL_INTERFACE_ROOM_CONFIG,
+            QLatin1String("UpdateConfiguration"));
+    call << properties;
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+            mClientBus.asyncCall(call), this);
+    connect(watcher,
+            SIGNAL(finished(QDBusPendingCallWatcher*)),
+            SLOT(onUpdateConfigurationFinished(QDBusPendingCallWatcher*)));
+
+    while (mEvents.size() < 2) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+
+    // The changes made by the method are announced before it returns, in a single signal
+    QCOMPARE(mEvents, QStringList() << QLatin1String("PropertiesChanged")
+            << QLatin1String("UpdateConfiguration"));
+    QCOMPARE(mPropertiesChanged.size(), 1);
+    QCOMPARE(mPropertiesChanged[0].value(QLatin1String("Title")).toString(),
+            QLatin1String("title"));
+    QCOMPARE(mPropertiesChanged[0].value(QLatin1String("Description")).toString(),
+            QLatin1String("description"));
+}
+
+void TestBaseConnection::testPresencesChangedChunks()
+{
+    QVERIFY(mClientBus.connect(mConnection->busName(), mConnection->objectPath(),
+                TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE,
+                QLatin1String("PresencesChanged"),
+                this, SLOT(onPresencesChanged(Tp::SimpleContactPresences))));
+
+    BaseConnectionSimplePresenceInterfacePtr simplePresence = mConnection->mSimplePresence;
+    simplePresence->setMaximumPresencesChangedSize(2);
+    QCOMPARE(simplePresence->maximumPresencesChangedSize(), 2U);
+
+    SimplePresence available;
+    available.type = ConnectionPresenceTypeAvailable;
+    available.status = QLatin1String("available");
+    SimplePresence away;
+    away.type = ConnectionPresenceTypeAway;
+    away.status = QLatin1String("away");
+    away.statusMessage = QLatin1String("Out for lunch");
+
+    SimpleContactPresences presences;
+    for (uint handle = 10; handle < 15; ++handle) {
+        presences.insert(handle, available);
+    }
+    simplePresence->setPresences(presences);
+
+    // 5 changes go in signals of 2, 2 and 1 contacts
+    while (mPresencesChanged.size() < 3) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    QCOMPARE(mPresencesChanged[0].size(), 2);
+    QCOMPARE(mPresencesChanged[1].size(), 2);
+    QCOMPARE(mPresencesChanged[2].size(), 1);
+
+    SimpleContactPresences received;
+    Q_FOREACH (const SimpleContactPresences &chunk, mPresencesChanged) {
+        for (SimpleContactPresences::const_iterator it = chunk.constBegin();
+                it != chunk.constEnd(); ++it) {
+            QVERIFY(!received.contains(it.key()));
+            received.insert(it.key(), it.value());
+        }
+    }
+    QCOMPARE(received.keys(), presences.keys());
+    QCOMPARE(received.value(12).status, QLatin1String("available"));
+    mPresencesChanged.clear();
+
+    // Only the presences which actually changed are signalled again
+    presences.insert(11, away);
+    simplePresence->setPresences(presences);
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mPresencesChanged.size(), 1);
+    QCOMPARE(mPresencesChanged[0].keys(), QList<uint>() << 11);
+    QCOMPARE(mPresencesChanged[0].value(11).type, (uint) ConnectionPresenceTypeAway);
+    QCOMPARE(mPresencesChanged[0].value(11).statusMessage, QLatin1String("Out for lunch"));
+    mPresencesChanged.clear();
+
+    simplePresence->setPresences(presences);
+    QTimer::singleShot(100, mLoop, SLOT(quit()));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(mPresencesChanged.isEmpty());
+
+    SimpleContactPresences stored = simplePresence->getPresences(UIntList() << 11 << 14 << 99);
+    QCOMPARE(stored.value(11).statusMessage, QLatin1String("Out for lunch"));
+    QCOMPARE(stored.value(14).type, (uint) ConnectionPresenceTypeAvailable);
+    QCOMPARE(stored.value(99).type, (uint) ConnectionPresenceTypeUnknown);
+
+    QVERIFY(mClientBus.disconnect(mConnection->busName(), mConnection->objectPath(),
+                TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE,
+                QLatin1String("PresencesChanged"),
+                this, SLOT(onPresencesChanged(Tp::SimpleContactPresences))));
+}
+
+void TestBaseConnection::testRoomList()
+{
+    mConnection->setStatus(ConnectionStatusConnected, ConnectionStatusReasonRequested);
+
+    QVariantMap request;
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+            TP_QT_IFACE_CHANNEL_TYPE_ROOM_LIST);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+            (uint) HandleTypeNone);
+    DBusError error;
+    BaseChannelPtr svcChannel = mConnection->createChannel(request, false, &error);
+    QVERIFY(!error.isValid());
+    QVERIFY(!svcChannel.isNull());
+    BaseChannelRoomListTypePtr svcRoomList = mConnection->mRoomList;
+    QVERIFY(!svcRoomList.isNull());
+    svcRoomList->setListRoomsCallback(memFun(this, &TestBaseConnection::listRooms));
+
+    Tp::ConnectionPtr cliConnection = Tp::Connection::create(mClientBus, mConnection->busName(),
+            mConnection->objectPath(), ChannelFactory::create(mClientBus),
+            ContactFactory::create());
+    mRoomListChannel = RoomListChannel::create(cliConnection, svcChannel->objectPath(),
+            svcChannel->immutableProperties());
+    connect(mRoomListChannel->becomeReady(RoomListChannel::FeatureCore),
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectSuccessfulCall(Tp::PendingOperation*)));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mRoomListChannel->server(), QLatin1String("conference.example.com"));
+    QVERIFY(!mRoomListChannel->isListingRooms());
+    QCOMPARE(mRoomListChannel->roomCount(), 0);
+
+    connect(mRoomListChannel.data(),
+            SIGNAL(roomsReceived(Tp::RoomInfoList)),
+            SLOT(onRoomsReceived(Tp::RoomInfoList)));
+
+    // ListingRooms is signalled by the callback, before ListRooms returns
+    connect(mRoomListChannel->listRooms(),
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectSuccessfulCall(Tp::PendingOperation*)));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(mRoomListChannel->isListingRooms());
+
+    RoomInfoList rooms;
+    rooms << roomInfo(100, QLatin1String("#linux"), QLatin1String("Linux users"),
+            QLatin1String("Kernel talk"), 50);
+    rooms << roomInfo(101, QLatin1String("#qt"), QLatin1String("Qt developers"),
+            QLatin1String("Signals and slots"), 120);
+    rooms << roomInfo(102, QLatin1String("#telepathy"), QLatin1String("Telepathy"),
+            QLatin1String("Real-time communication"), 30);
+    rooms << roomInfo(103, QLatin1String("#kde"), QLatin1String("KDE community"),
+            QLatin1String("Plasma and frameworks"), 120);
+    rooms << roomInfo(104, QLatin1String("#linux-dev"), QLatin1String("Linux kernel developers"),
+            QLatin1String("Patches"), 80);
+    rooms << roomInfo(105, QLatin1String("#empty"), QLatin1String("Empty room"),
+            QString(), -1);
+    rooms << roomInfo(106, QLatin1String("#gaming"), QLatin1String("Gaming on Linux"),
+            QString(), 10);
+
+    // The rooms are sent in chunks, and indexed as each of them is received
+    svcRoomList->setMaximumGotRoomsSize(3);
+    svcRoomList->gotRooms(rooms);
+    while (mRoomBatchSizes.size() < 3) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+    QCOMPARE(mRoomBatchSizes, QList<int>() << 3 << 3 << 1);
+    QCOMPARE(mRoomCounts, QList<int>() << 3 << 6 << 7);
+    QCOMPARE(handlesFor(mRoomListChannel->rooms()), handlesFor(rooms));
+    QVERIFY(mRoomListChannel->hasRoom(104));
+    QCOMPARE(mRoomListChannel->room(104).info.value(QLatin1String("name")).toString(),
+            QLatin1String("Linux kernel developers"));
+    QVERIFY(!mRoomListChannel->hasRoom(200));
+    QCOMPARE(mRoomListChannel->room(200).handle, 0U);
+
+    // Paging in arrival order
+    QCOMPARE(handlesFor(mRoomListChannel->rooms(5, 10)), QList<uint>() << 105 << 106);
+    QCOMPARE(handlesFor(mRoomListChannel->rooms(1, 2)), QList<uint>() << 101 << 102);
+    QVERIFY(mRoomListChannel->rooms(7).isEmpty());
+    QVERIFY(mRoomListChannel->rooms(2, 0).isEmpty());
+    QCOMPARE(handlesFor(mRoomListChannel->rooms(5, INT_MAX)), QList<uint>() << 105 << 106);
+
+    // Word prefixes, ignoring case, all the words of the query having to match
+    QCOMPARE(handlesFor(mRoomListChannel->searchRooms(QLatin1String("LIN"))),
+            QList<uint>() << 100 << 104 << 106);
+    QCOMPARE(mRoomListChannel->searchRoomsCount(QLatin1String("lin")), 3);
+    QCOMPARE(handlesFor(mRoomListChannel->searchRooms(QLatin1String("kern lin"))),
+            QList<uint>() << 100 << 104);
+    QCOMPARE(handlesFor(mRoomListChannel->searchRooms(QLatin1String("real-time"))),
+            QList<uint>() << 102);
+    QVERIFY(mRoomListChannel->searchRooms(QLatin1String("linuxes")).isEmpty());
+    QCOMPARE(handlesFor(mRoomListChannel->searchRooms(QLatin1String("lin"), 40)),
+            QList<uint>() << 100 << 104);
+    QCOMPARE(handlesFor(mRoomListChannel->searchRooms(QLatin1String("lin"), 0, 1, 1)),
+            QList<uint>() << 104);
+    QVERIFY(mRoomListChannel->searchRooms(QLatin1String("lin"), 0, 3).isEmpty());
+
+    // An empty query matches every room
+    QCOMPARE(mRoomListChannel->searchRoomsCount(QString()), 7);
+    QCOMPARE(handlesFor(mRoomListChannel->searchRooms(QString(), 0, 5, 10)),
+            QList<uint>() << 105 << 106);
+    QCOMPARE(handlesFor(mRoomListChannel->searchRooms(QLatin1String("#"), 100)),
+            QList<uint>() << 101 << 103);
+    QCOMPARE(mRoomListChannel->searchRoomsCount(QString(), 1), 6);
+
+    // Ordered by member count, ties in arrival order, rooms without a count last
+    QCOMPARE(handlesFor(mRoomListChannel->roomsByMemberCount()),
+            QList<uint>() << 101 << 103 << 104 << 100 << 102 << 106 << 105);
+    QCOMPARE(handlesFor(mRoomListChannel->roomsByMemberCount(2, 2)),
+            QList<uint>() << 104 << 100);
+    QCOMPARE(handlesFor(mRoomListChannel->roomsByMemberCount(-1, 1)),
+            QList<uint>() << 101);
+    QCOMPARE(handlesFor(mRoomListChannel->roomsByMemberCount(6, 5)),
+            QList<uint>() << 105);
+    QVERIFY(mRoomListChannel->roomsByMemberCount(7, 1).isEmpty());
+
+    // A room received again replaces the previous information
+    svcRoomList->gotRooms(RoomInfoList() << roomInfo(102, QLatin1String("#telepathy"),
+                QLatin1String("Telepathy"), QLatin1String("Release party"), 200));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mRoomBatchSizes.last(), 1);
+    QCOMPARE(mRoomListChannel->roomCount(), 7);
+    QCOMPARE(handlesFor(mRoomListChannel->roomsByMemberCount(0, 2)),
+            QList<uint>() << 102 << 101);
+    QVERIFY(mRoomListChannel->searchRooms(QLatin1String("real")).isEmpty());
+    QCOMPARE(handlesFor(mRoomListChannel->searchRooms(QLatin1String("party"))),
+            QList<uint>() << 102);
+
+    mRoomListChannel->clearRooms();
+    QCOMPARE(mRoomListChannel->roomCount(), 0);
+    QVERIFY(mRoomListChannel->roomsByMemberCount().isEmpty());
+    QVERIFY(mRoomListChannel->searchRooms(QLatin1String("lin")).isEmpty());
+}
+
+void TestBaseConnection::testDBusMetrics()
+{
+    // The adaptors only count the signals they emit if they were created while collection was
+    // enabled, so start over with a connection created afterwards
+    mConnection.reset();
+    DBusMetrics::setEnabled(true);
+    DBusMetrics::reset();
+
+    mConnection = BaseConnection::create<TestBaseConnectionCM::Connection>(
+            QLatin1String("basecm"), QLatin1String("example"), QVariantMap());
+    QVERIFY(mConnection->plugInterface(AbstractConnectionInterfacePtr::dynamicCast(
+                    BaseConnectionDBusMetricsInterface::create())));
+    DBusError error;
+    QVERIFY(mConnection->registerObject(&error));
+    QVERIFY(!error.isValid());
+
+    // Client and service live in the same process here, so both sides are accounted for
+    Client::ConnectionInterface iface(mClientBus, mConnection->busName(),
+            mConnection->objectPath());
+
+    QDBusPendingCallWatcher *watcher = waitForCall(iface.InspectHandles(HandleTypeContact,
+                UIntList() << 2 << 3));
+    QVERIFY(!watcher->isError());
+    QCOMPARE(QDBusPendingReply<QStringList>(*watcher).value(),
+            QStringList() << QLatin1String("alice@example.com") <<
+                QLatin1String("bob@example.com"));
+    delete watcher;
+
+    watcher = waitForCall(iface.InspectHandles(HandleTypeContact, UIntList() << 99));
+    QVERIFY(watcher->isError());
+    QCOMPARE(watcher->error().name(), TP_QT_ERROR_INVALID_HANDLE);
+    delete watcher;
+
+    connect(&iface, SIGNAL(StatusChanged(uint,uint)), mLoop, SLOT(quit()));
+    mConnection->setStatus(ConnectionStatusConnected, ConnectionStatusReasonRequested);
+    QCOMPARE(mLoop->exec(), 0);
+
+    QDBusMessage getMetrics = QDBusMessage::createMethodCall(mConnection->busName(),
+            mConnection->objectPath(), TP_QT_IFACE_DBUS_METRICS, QLatin1String("GetMetrics"));
+    watcher = waitForCall(mClientBus.asyncCall(getMetrics));
+    QVERIFY(!watcher->isError());
+    QVariantMap metrics = QDBusPendingReply<QVariantMap>(*watcher).value();
+    delete watcher;
+
+    QString inspectHandles = TP_QT_IFACE_CONNECTION + QLatin1String(".InspectHandles");
+    QString statusChanged = TP_QT_IFACE_CONNECTION + QLatin1String(".StatusChanged");
+    QStringList expectedKeys = QStringList() <<
+        QLatin1String("OutgoingCall:") + inspectHandles <<
+        QLatin1String("IncomingCall:") + inspectHandles <<
+        QLatin1String("OutgoingSignal:") + statusChanged <<
+        QLatin1String("IncomingSignal:") + statusChanged;
+    Q_FOREACH (const QString &key, expectedKeys) {
+        QVERIFY2(metrics.contains(key), qPrintable(key));
+    }
+
+    // Both calls were made and handled. Only the client side sees the error reply, as the
+    // adaptors can't tell errors the adaptee replies with from successes
+    for (int i = 0; i < 2; ++i) {
+        QVariantMap values = qdbus_cast<QVariantMap>(metrics.value(expectedKeys[i]));
+        QCOMPARE(values.value(QLatin1String("Count")).toUInt(), 2U);
+        QCOMPARE(values.value(QLatin1String("ErrorCount")).toUInt(), i == 0 ? 1U : 0U);
+
+        UIntList histogram = qdbus_cast<UIntList>(values.value(QLatin1String("LatencyHistogram")));
+        QCOMPARE(histogram.size(), DBusMetrics::latencyBucketLimits().size() + 1);
+        uint histogramCount = 0;
+        Q_FOREACH (uint bucketCount, histogram) {
+            histogramCount += bucketCount;
+        }
+        QCOMPARE(histogramCount, 2U);
+    }
+
+    for (int i = 2; i < 4; ++i) {
+        QVariantMap values = qdbus_cast<QVariantMap>(metrics.value(expectedKeys[i]));
+        QCOMPARE(values.value(QLatin1String("Count")).toUInt(), 1U);
+    }
+}
+
+void TestBaseConnection::cleanup()
+{
+    if (!mWatchedChannelPath.isEmpty()) {
+        mClientBus.disconnect(mConnection->busName(), mWatchedChannelPath,
+                TP_QT_IFACE_PROPERTIES, QLatin1String("PropertiesChanged"),
+                this, SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)));
+        mWatchedChannelPath.clear();
+    }
+    mPropertiesChanged.clear();
+    mPresencesChanged.clear();
+    mRoomListChannel.reset();
+    mRoomBatchSizes.clear();
+    mRoomCounts.clear();
+    mEvents.clear();
+    mConnection.reset();
+    DBusMetrics::setEnabled(false);
+    DBusMetrics::reset();
+
+    cleanupImpl();
+}
+
+void TestBaseConnection::cleanupTestCase()
+{
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(TestBaseConnection)
+#include "_gen/base-connection.cpp.moc.hpp"
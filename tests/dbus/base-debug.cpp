@@ -0,0 +1,187 @@
+#include <tests/lib/test.h>
+
+#define TP_QT_ENABLE_LOWLEVEL_API
+
+#include <TelepathyQt/BaseDebug>
+#include <TelepathyQt/DBusError>
+
+#include <QElapsedTimer>
+#include <QThread>
+
+using namespace Tp;
+
+namespace
+{
+
+const int producerCount = 4;
+const int messagesPerProducer = 1000;
+// As in BaseDebug
+const int maximumMessagesPerBatch = 256;
+const int batchInterval = 20;
+
+class Producer : public QThread
+{
+public:
+    Producer(BaseDebug *debug, int index)
+        : mDebug(debug), mIndex(index)
+    {
+    }
+
+protected:
+    void run()
+    {
+        QString domain = QString(QLatin1String("producer%1")).arg(mIndex);
+        for (int i = 0; i < messagesPerProducer; ++i) {
+            mDebug->newDebugMessage(domain, DebugLevelDebug, QString::number(i));
+        }
+    }
+
+private:
+    BaseDebug *mDebug;
+    int mIndex;
+};
+
+}
+
+class TestBaseDebug : public Test
+{
+    Q_OBJECT
+
+public:
+    TestBaseDebug(QObject *parent = 0)
+        : Test(parent),
+          mClientBus(QDBusConnection::connectToBus(QDBusConnection::SessionBus,
+                      QLatin1String("base-debug-client")))
+    { }
+
+protected Q_SLOTS:
+    void onNewDebugMessage(double time, const QString &domain, uint level,
+            const QString &message);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void testBatchesFromThreads();
+
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    BaseDebug *mDebug;
+
+    QDBusConnection mClientBus;
+    QElapsedTimer mElapsed;
+    QList<qint64> mReceivedAt;
+    QHash<QString, int> mLastReceived;
+    bool mOrdered;
+};
+
+void TestBaseDebug::onNewDebugMessage(double time, const QString &domain, uint level,
+        const QString &message)
+{
+    Q_UNUSED(time);
+    Q_UNUSED(level);
+
+    if (mReceivedAt.isEmpty()) {
+        mElapsed.start();
+    }
+    mReceivedAt.append(mElapsed.elapsed());
+
+    // The messages of each thread are received in the order they were logged
+    int index = message.toInt();
+    if (index != mLastReceived.value(domain, -1) + 1) {
+        mOrdered = false;
+    }
+    mLastReceived.insert(domain, index);
+
+    if (mReceivedAt.size() == producerCount * messagesPerProducer) {
+        mLoop->exit(0);
+    }
+}
+
+void TestBaseDebug::initTestCase()
+{
+    initTestCaseImpl();
+}
+
+void TestBaseDebug::init()
+{
+    initImpl();
+
+    mDebug = new BaseDebug();
+    DBusError error;
+    QVERIFY(mDebug->registerObject(QLatin1String("org.freedesktop.Telepathy.Qt.Test.BaseDebug"),
+                &error));
+    QVERIFY(!error.isValid());
+    mDebug->setGetMessagesLimit(producerCount * messagesPerProducer);
+    mDebug->setEnabled(true);
+
+    QVERIFY(mClientBus.connect(QLatin1String("org.freedesktop.Telepathy.Qt.Test.BaseDebug"),
+                TP_QT_DEBUG_OBJECT_PATH, TP_QT_IFACE_DEBUG, QLatin1String("NewDebugMessage"),
+                this, SLOT(onNewDebugMessage(double,QString,uint,QString))));
+
+    mReceivedAt.clear();
+    mLastReceived.clear();
+    mOrdered = true;
+}
+
+void TestBaseDebug::testBatchesFromThreads()
+{
+    QList<Producer *> producers;
+    for (int i = 0; i < producerCount; ++i) {
+        producers.append(new Producer(mDebug, i));
+    }
+    Q_FOREACH (Producer *producer, producers) {
+        producer->start();
+    }
+    Q_FOREACH (Producer *producer, producers) {
+        QVERIFY(producer->wait());
+    }
+    qDeleteAll(producers);
+
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mReceivedAt.size(), producerCount * messagesPerProducer);
+    QVERIFY(mOrdered);
+    QCOMPARE(mLastReceived.size(), producerCount);
+
+    // No more than one batch is emitted per interval. Batches delayed on their way to the bus may
+    // be received together with the following ones, hence the tolerance of two batches
+    int first = 0;
+    for (int last = 0; last < mReceivedAt.size(); ++last) {
+        while (mReceivedAt.at(last) - mReceivedAt.at(first) >= batchInterval) {
+            ++first;
+        }
+        QVERIFY2(last - first + 1 <= 3 * maximumMessagesPerBatch,
+                qPrintable(QString(QLatin1String("%1 messages received within %2ms"))
+                    .arg(last - first + 1).arg(batchInterval)));
+    }
+
+    // So sending all the messages took at least as many intervals as there are full batches
+    int batches = (mReceivedAt.size() + maximumMessagesPerBatch - 1) / maximumMessagesPerBatch;
+    QVERIFY(mReceivedAt.last() >= (batches - 2) * batchInterval);
+
+    // All the messages are kept for GetMessages()
+    DBusError error;
+    QCOMPARE(mDebug->getMessages(&error).size(), producerCount * messagesPerProducer);
+    QVERIFY(!error.isValid());
+}
+
+void TestBaseDebug::cleanup()
+{
+    mClientBus.disconnect(QLatin1String("org.freedesktop.Telepathy.Qt.Test.BaseDebug"),
+            TP_QT_DEBUG_OBJECT_PATH, TP_QT_IFACE_DEBUG, QLatin1String("NewDebugMessage"),
+            this, SLOT(onNewDebugMessage(double,QString,uint,QString)));
+    delete mDebug;
+    mDebug = 0;
+
+    cleanupImpl();
+}
+
+void TestBaseDebug::cleanupTestCase()
+{
+    cleanupTestCaseImpl();
+}
+
+QTEST_MAIN(TestBaseDebug)
+#include "_gen/base-debug.cpp.moc.hpp"
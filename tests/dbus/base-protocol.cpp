@@ -13,6 +13,9 @@
 #include <TelepathyQt/PendingConnection>
 #include <TelepathyQt/PendingString>
 
+#include <QDBusPendingReply>
+#include <QThreadPool>
+
 using namespace Tp;
 
 class TestBaseProtocolCM;
@@ -27,6 +30,10 @@ public:
 
     static void createCM(TestBaseProtocolCMPtr &cm);
 
+    static void normalizeContactAsyncCb(const QString &contactId,
+            const MethodInvocationContextPtr<QString> &context);
+    static void finishPendingNormalizationsCb(TestBaseProtocolCMPtr &cm);
+
 private:
     static BaseConnectionPtr createConnectionCb(const QVariantMap &parameters,
             Tp::DBusError *error);
@@ -36,8 +43,14 @@ private:
     static QString normalizeVCardAddressCb(const QString &vcardField,
             const QString &vcardAddress, Tp::DBusError *error);
     static QString normalizeContactUriCb(const QString &uri, Tp::DBusError *error);
+
+    // accessed from the thread of the connection manager only
+    static QList<QPair<QString, MethodInvocationContextPtr<QString> > > pendingNormalizations;
 };
 
+QList<QPair<QString, MethodInvocationContextPtr<QString> > >
+    TestBaseProtocolCM::pendingNormalizations;
+
 class TestBaseProtocol : public Test
 {
     Q_OBJECT
@@ -51,6 +64,10 @@ private:
     static void addressingIfaceSvcSideCb(TestBaseProtocolCMPtr &cm);
     static void avatarsIfaceSvcSideCb(TestBaseProtocolCMPtr &cm);
     static void presenceIfaceSvcSideCb(TestBaseProtocolCMPtr &cm);
+    static void enableCallbackThreadPoolCb(TestBaseProtocolCMPtr &cm);
+    static void enableAsyncCallbackCb(TestBaseProtocolCMPtr &cm);
+
+    void checkBulkNormalization(const QString &busName, const QString &objectPath);
 
 private Q_SLOTS:
     void initTestCase();
@@ -64,6 +81,9 @@ private Q_SLOTS:
     void avatarsIfaceClientSide();
     void presenceIfaceSvcSide();
     void presenceIfaceClientSide();
+    void callbackThreadPool();
+    void asyncCallback();
+    void bulkNormalization();
 
     void cleanup();
     void cleanupTestCase();
@@ -125,6 +145,10 @@ void TestBaseProtocolCM::createCM(TestBaseProtocolCMPtr &cm)
             << PresenceSpec::offline());
     QVERIFY(protocol->plugInterface(presenceIface));
 
+    BaseProtocolBulkNormalizationInterfacePtr bulkNormalizationIface =
+            BaseProtocolBulkNormalizationInterface::create(protocol.data());
+    QVERIFY(protocol->plugInterface(bulkNormalizationIface));
+
     QVERIFY(cm->addProtocol(protocol));
 
     Tp::DBusError err;
@@ -165,6 +189,34 @@ QString TestBaseProtocolCM::normalizeContactCb(const QString &contactId, Tp::DBu
     return contactId.toLower();
 }
 
+void TestBaseProtocolCM::normalizeContactAsyncCb(const QString &contactId,
+        const MethodInvocationContextPtr<QString> &context)
+{
+    pendingNormalizations.append(qMakePair(contactId, context));
+}
+
+void TestBaseProtocolCM::finishPendingNormalizationsCb(TestBaseProtocolCMPtr &cm)
+{
+    Q_UNUSED(cm);
+
+    // wait for the calls to reach the connection manager
+    while (pendingNormalizations.size() < 2) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    for (int i = 0; i < pendingNormalizations.size(); ++i) {
+        QString contactId = pendingNormalizations.at(i).first;
+        MethodInvocationContextPtr<QString> context = pendingNormalizations.at(i).second;
+        if (contactId.isEmpty()) {
+            context->setFinishedWithError(TP_QT_ERROR_INVALID_HANDLE,
+                    QLatin1String("ID must not be empty"));
+        } else {
+            context->setFinished(contactId.toUpper());
+        }
+    }
+    pendingNormalizations.clear();
+}
+
 QString TestBaseProtocolCM::normalizeVCardAddressCb(const QString &vcardField,
         const QString &vcardAddress, Tp::DBusError *error)
 {
@@ -234,7 +286,7 @@ void TestBaseProtocol::protocolObjectSvcSideCb(TestBaseProtocolCMPtr &cm)
     QVERIFY(!protocol->parameters().at(0).isSecret());
 
     //interfaces
-    QCOMPARE(protocol->interfaces().size(), 3);
+    QCOMPARE(protocol->interfaces().size(), 4);
 
     //immutable props
     QVariantMap props = protocol->immutableProperties();
@@ -245,6 +297,7 @@ void TestBaseProtocol::protocolObjectSvcSideCb(TestBaseProtocolCMPtr &cm)
     QVERIFY(sl.contains(TP_QT_IFACE_PROTOCOL_INTERFACE_ADDRESSING));
     QVERIFY(sl.contains(TP_QT_IFACE_PROTOCOL_INTERFACE_AVATARS));
     QVERIFY(sl.contains(TP_QT_IFACE_PROTOCOL_INTERFACE_PRESENCE));
+    QVERIFY(sl.contains(TP_QT_IFACE_PROTOCOL_INTERFACE_BULK_NORMALIZATION));
 
     QVERIFY(props.contains(TP_QT_IFACE_PROTOCOL + QLatin1String(".Parameters")));
     ParamSpecList params = qvariant_cast<ParamSpecList>(props.value(
@@ -419,6 +472,12 @@ void TestBaseProtocol::addressingIfaceSvcSideCb(TestBaseProtocolCMPtr &cm)
     QVERIFY(vcardFields.contains(QLatin1String("x-jabber")));
     QVERIFY(vcardFields.contains(QLatin1String("tel")));
 
+    //cannot change after registration
+    iface->setAddressableUriSchemes(QStringList() << QLatin1String("sip"));
+    iface->setAddressableVCardFields(QStringList() << QLatin1String("x-sip"));
+    QCOMPARE(iface->addressableUriSchemes(), uriSchemes);
+    QCOMPARE(iface->addressableVCardFields(), vcardFields);
+
     //no immutable properties
     QVERIFY(iface->immutableProperties().isEmpty());
 
@@ -673,6 +732,196 @@ void TestBaseProtocol::presenceIfaceClientSide()
     QVERIFY(!statuses.contains(PresenceSpec::xa()));
 }
 
+void TestBaseProtocol::enableCallbackThreadPoolCb(TestBaseProtocolCMPtr &cm)
+{
+    Tp::BaseProtocolPtr protocol = cm->protocols().at(0);
+    QVERIFY(protocol);
+    QVERIFY(!protocol->callbackThreadPool());
+    protocol->setCallbackThreadPool(QThreadPool::globalInstance());
+    QCOMPARE(protocol->callbackThreadPool(), QThreadPool::globalInstance());
+
+    Tp::BaseProtocolAddressingInterfacePtr iface =
+            Tp::BaseProtocolAddressingInterfacePtr::qObjectCast(
+                    protocol->interface(TP_QT_IFACE_PROTOCOL_INTERFACE_ADDRESSING));
+    QVERIFY(iface);
+    iface->setCallbackThreadPool(QThreadPool::globalInstance());
+}
+
+void TestBaseProtocol::callbackThreadPool()
+{
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseProtocol::enableCallbackThreadPoolCb);
+
+    ConnectionManagerPtr cliCM = ConnectionManager::create(QLatin1String("testcm"));
+    PendingReady *pr = cliCM->becomeReady(ConnectionManager::FeatureCore);
+    connect(pr, SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectSuccessfulCall(Tp::PendingOperation*)));
+    QCOMPARE(mLoop->exec(), 0);
+
+    Tp::Client::ProtocolInterface protocolIface(cliCM->busName(),
+            cliCM->objectPath() + QLatin1String("/example"));
+
+    // issue all the calls at once, the replies may come back in any order
+    QList<QDBusPendingReply<QString> > replies;
+    for (int i = 0; i < 32; ++i) {
+        replies << protocolIface.NormalizeContact(QString(QLatin1String("CoNtAcT%1")).arg(i));
+    }
+    QDBusPendingReply<QString> errorReply = protocolIface.NormalizeContact(QString());
+
+    QVariantMap map;
+    map.insert(QLatin1String("account"), QLatin1String("example@nowhere.com"));
+    QDBusPendingReply<QString> accountReply = protocolIface.IdentifyAccount(map);
+
+    for (int i = 0; i < replies.size(); ++i) {
+        replies[i].waitForFinished();
+        QVERIFY(!replies[i].isError());
+        QCOMPARE(replies[i].value(), QString(QLatin1String("contact%1")).arg(i));
+    }
+
+    errorReply.waitForFinished();
+    QVERIFY(errorReply.isError());
+    QCOMPARE(errorReply.error().name(), TP_QT_ERROR_INVALID_HANDLE);
+
+    accountReply.waitForFinished();
+    QVERIFY(!accountReply.isError());
+    QCOMPARE(accountReply.value(), QLatin1String("example@nowhere.com"));
+
+    ProtocolInfo protocol = cliCM->protocol(QLatin1String("example"));
+    QVERIFY(protocol.isValid());
+
+    PendingString *str = protocol.normalizeVCardAddress(QLatin1String("x-jabber"),
+                QLatin1String("Alice"));
+    connect(str, SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectSuccessfulCall(Tp::PendingOperation*)));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(str->result(), QLatin1String("alice@wonderland"));
+
+    str = protocol.normalizeContactUri(QLatin1String("xmpp:alice@wonderland/rabbit-hole"));
+    connect(str, SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectSuccessfulCall(Tp::PendingOperation*)));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(str->result(), QLatin1String("xmpp:alice@wonderland"));
+}
+
+void TestBaseProtocol::enableAsyncCallbackCb(TestBaseProtocolCMPtr &cm)
+{
+    Tp::BaseProtocolPtr protocol = cm->protocols().at(0);
+    QVERIFY(protocol);
+    protocol->setNormalizeContactAsyncCallback(
+            ptrFun(&TestBaseProtocolCM::normalizeContactAsyncCb));
+}
+
+void TestBaseProtocol::asyncCallback()
+{
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseProtocol::enableAsyncCallbackCb);
+
+    ConnectionManagerPtr cliCM = ConnectionManager::create(QLatin1String("testcm"));
+    PendingReady *pr = cliCM->becomeReady(ConnectionManager::FeatureCore);
+    connect(pr, SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectSuccessfulCall(Tp::PendingOperation*)));
+    QCOMPARE(mLoop->exec(), 0);
+
+    Tp::Client::ProtocolInterface protocolIface(cliCM->busName(),
+            cliCM->objectPath() + QLatin1String("/example"));
+
+    QDBusPendingReply<QString> reply = protocolIface.NormalizeContact(QLatin1String("ALiCe"));
+    QDBusPendingReply<QString> errorReply = protocolIface.NormalizeContact(QString());
+
+    // the replies are only sent once the connection manager finishes the contexts, with the
+    // result of the asynchronous callback rather than the synchronous one
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseProtocolCM::finishPendingNormalizationsCb);
+
+    reply.waitForFinished();
+    QVERIFY(!reply.isError());
+    QCOMPARE(reply.value(), QLatin1String("ALICE"));
+
+    errorReply.waitForFinished();
+    QVERIFY(errorReply.isError());
+    QCOMPARE(errorReply.error().name(), TP_QT_ERROR_INVALID_HANDLE);
+
+    // the other methods still use the synchronous callbacks
+    ProtocolInfo protocol = cliCM->protocol(QLatin1String("example"));
+    QVERIFY(protocol.isValid());
+
+    PendingString *str = protocol.normalizeVCardAddress(QLatin1String("x-jabber"),
+                QLatin1String("Alice"));
+    connect(str, SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectSuccessfulCall(Tp::PendingOperation*)));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(str->result(), QLatin1String("alice@wonderland"));
+}
+
+void TestBaseProtocol::checkBulkNormalization(const QString &busName, const QString &objectPath)
+{
+    QDBusMessage call = QDBusMessage::createMethodCall(busName, objectPath,
+            TP_QT_IFACE_PROTOCOL_INTERFACE_BULK_NORMALIZATION,
+            QLatin1String("NormalizeContacts"));
+    call << (QStringList() << QLatin1String("ALiCe") << QString() << QLatin1String("BoB")
+            << QLatin1String("ALiCe"));
+    QDBusPendingReply<Tp::StringStringMap, Tp::StringStringMap> reply =
+            QDBusConnection::sessionBus().asyncCall(call);
+    reply.waitForFinished();
+    QVERIFY(!reply.isError());
+
+    Tp::StringStringMap normalized = reply.argumentAt<0>();
+    QCOMPARE(normalized.size(), 2);
+    QCOMPARE(normalized.value(QLatin1String("ALiCe")), QLatin1String("alice"));
+    QCOMPARE(normalized.value(QLatin1String("BoB")), QLatin1String("bob"));
+    Tp::StringStringMap errors = reply.argumentAt<1>();
+    QCOMPARE(errors.size(), 1);
+    QCOMPARE(errors.value(QString()), TP_QT_ERROR_INVALID_HANDLE);
+
+    call = QDBusMessage::createMethodCall(busName, objectPath,
+            TP_QT_IFACE_PROTOCOL_INTERFACE_BULK_NORMALIZATION,
+            QLatin1String("NormalizeVCardAddresses"));
+    call << QLatin1String("x-jabber") << (QStringList() << QLatin1String("Alice")
+            << QLatin1String("Bob"));
+    reply = QDBusConnection::sessionBus().asyncCall(call);
+    reply.waitForFinished();
+    QVERIFY(!reply.isError());
+
+    normalized = reply.argumentAt<0>();
+    QCOMPARE(normalized.size(), 2);
+    QCOMPARE(normalized.value(QLatin1String("Alice")), QLatin1String("alice@wonderland"));
+    QCOMPARE(normalized.value(QLatin1String("Bob")), QLatin1String("bob@wonderland"));
+    QVERIFY(reply.argumentAt<1>().isEmpty());
+
+    call = QDBusMessage::createMethodCall(busName, objectPath,
+            TP_QT_IFACE_PROTOCOL_INTERFACE_BULK_NORMALIZATION,
+            QLatin1String("NormalizeContactURIs"));
+    call << (QStringList() << QLatin1String("xmpp:alice@wonderland/Mobile")
+            << QLatin1String("invalid"));
+    reply = QDBusConnection::sessionBus().asyncCall(call);
+    reply.waitForFinished();
+    QVERIFY(!reply.isError());
+
+    normalized = reply.argumentAt<0>();
+    QCOMPARE(normalized.size(), 1);
+    QCOMPARE(normalized.value(QLatin1String("xmpp:alice@wonderland/Mobile")),
+            QLatin1String("xmpp:alice@wonderland"));
+    errors = reply.argumentAt<1>();
+    QCOMPARE(errors.size(), 1);
+    QCOMPARE(errors.value(QLatin1String("invalid")), TP_QT_ERROR_INVALID_ARGUMENT);
+}
+
+void TestBaseProtocol::bulkNormalization()
+{
+    ConnectionManagerPtr cliCM = ConnectionManager::create(QLatin1String("testcm"));
+    PendingReady *pr = cliCM->becomeReady(ConnectionManager::FeatureCore);
+    connect(pr, SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectSuccessfulCall(Tp::PendingOperation*)));
+    QCOMPARE(mLoop->exec(), 0);
+
+    QString objectPath = cliCM->objectPath() + QLatin1String("/example");
+    checkBulkNormalization(cliCM->busName(), objectPath);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    // the same, as one job per call on the thread pool
+    TEST_THREAD_HELPER_EXECUTE(mThreadHelper, &TestBaseProtocol::enableCallbackThreadPoolCb);
+    checkBulkNormalization(cliCM->busName(), objectPath);
+}
+
 void TestBaseProtocol::cleanup()
 {
     delete mThreadHelper;
@@ -6,18 +6,77 @@
 
 #define TP_QT_ENABLE_LOWLEVEL_API
 
+#include <TelepathyQt/ChannelFactory>
 #include <TelepathyQt/Connection>
 #include <TelepathyQt/ConnectionLowlevel>
+#include <TelepathyQt/ContactFactory>
 #include <TelepathyQt/ContactManager>
+#include <TelepathyQt/DBusMetrics>
 #include <TelepathyQt/PendingChannel>
 #include <TelepathyQt/PendingContacts>
 #include <TelepathyQt/PendingReady>
 #include <TelepathyQt/CallChannel>
 
 #include <telepathy-glib/debug.h>
+#include <telepathy-glib/svc-call.h>
+#include <telepathy-glib/util.h>
+
+#include <dbus/dbus-glib.h>
 
 using namespace Tp;
 
+namespace
+{
+
+uint outgoingCallCount(const QString &interfaceName, const QString &memberName)
+{
+    Q_FOREACH (const DBusMetrics::Entry &entry, DBusMetrics::entries()) {
+        if (entry.kind() == DBusMetrics::OutgoingCall &&
+                entry.interfaceName() == interfaceName && entry.memberName() == memberName) {
+            return entry.count();
+        }
+    }
+    return 0;
+}
+
+// Emit Call1.Stream.RemoteMembersChanged from the service side, adding a remote member which is
+// sending, and with its identifier if one is given
+bool emitRemoteMemberAdded(const QString &streamPath, uint handle, const QString &identifier)
+{
+    DBusGConnection *bus = dbus_g_bus_get(DBUS_BUS_STARTER, 0);
+    GObject *stream = dbus_g_connection_lookup_g_object(bus, streamPath.toLatin1().constData());
+    dbus_g_connection_unref(bus);
+    if (!stream) {
+        return false;
+    }
+
+    QByteArray id = identifier.toUtf8();
+    GHashTable *updates = g_hash_table_new(NULL, NULL);
+    g_hash_table_insert(updates, GUINT_TO_POINTER(handle),
+            GUINT_TO_POINTER(TP_SENDING_STATE_SENDING));
+    GHashTable *identifiers = g_hash_table_new(NULL, NULL);
+    if (!identifier.isEmpty()) {
+        g_hash_table_insert(identifiers, GUINT_TO_POINTER(handle), (gpointer) id.constData());
+    }
+    GArray *removed = g_array_new(FALSE, FALSE, sizeof(guint));
+    GValueArray *reason = tp_value_array_build(4,
+            G_TYPE_UINT, 0,
+            G_TYPE_UINT, TP_CALL_STATE_CHANGE_REASON_UNKNOWN,
+            G_TYPE_STRING, "",
+            G_TYPE_STRING, "",
+            G_TYPE_INVALID);
+
+    tp_svc_call_stream_emit_remote_members_changed(stream, updates, identifiers, removed, reason);
+
+    tp_value_array_free(reason);
+    g_array_unref(removed);
+    g_hash_table_unref(identifiers);
+    g_hash_table_unref(updates);
+    return true;
+}
+
+}
+
 class TestCallChannel : public Test
 {
     Q_OBJECT
@@ -48,6 +107,10 @@ protected Q_SLOTS:
 
     void onLocalHoldStateChanged(Tp::LocalHoldState state, Tp::LocalHoldStateReason reason);
 
+    void onStreamRemoteSendingStateChanged(
+            const QHash<Tp::ContactPtr, Tp::SendingState> &remoteSendingStates,
+            const Tp::CallStateReason &reason);
+
     void onNewChannels(const Tp::ChannelDetailsList &details);
 
 private Q_SLOTS:
@@ -61,6 +124,7 @@ private Q_SLOTS:
     void testCallMembers();
     void testDTMF();
     void testFeatureCore();
+    void testStreamContacts();
 
     void cleanup();
     void cleanupTestCase();
@@ -79,6 +143,7 @@ private:
     SendingState mLSSCReturn;
     QQueue<uint> mLocalHoldStates;
     QQueue<uint> mLocalHoldStateReasons;
+    QHash<QString, QHash<ContactPtr, SendingState> > mStreamRemoteSendingStates;
 
     // Remote sending state changed state-machine
     enum {
@@ -230,6 +295,18 @@ void TestCallChannel::onLocalHoldStateChanged(Tp::LocalHoldState localHoldState,
     mLoop->exit(0);
 }
 
+void TestCallChannel::onStreamRemoteSendingStateChanged(
+        const QHash<Tp::ContactPtr, Tp::SendingState> &remoteSendingStates,
+        const Tp::CallStateReason &reason)
+{
+    Q_UNUSED(reason);
+
+    CallStream *stream = qobject_cast<CallStream *>(sender());
+    QVERIFY(stream != 0);
+    mStreamRemoteSendingStates.insert(stream->objectPath(), remoteSendingStates);
+    mLoop->exit(0);
+}
+
 void TestCallChannel::onNewChannels(const Tp::ChannelDetailsList &channels)
 {
     qDebug() << "new channels";
@@ -278,6 +355,7 @@ void TestCallChannel::init()
     mLSSCReturn = (Tp::SendingState) -1;
     mLocalHoldStates.clear();
     mLocalHoldStateReasons.clear();
+    mStreamRemoteSendingStates.clear();
 }
 
 void TestCallChannel::testOutgoingCall()
@@ -947,6 +1025,104 @@ void TestCallChannel::testFeatureCore()
     QVERIFY(chan2->handlerStreamingRequired());
 }
 
+void TestCallChannel::testStreamContacts()
+{
+    // Features are added to the contact factory once the channel contacts are built, so that
+    // resolving the remote members of the streams needs a contacts request
+    ContactFactoryPtr contactFactory = ContactFactory::create();
+    TestConnHelper *conn = new TestConnHelper(this,
+            ChannelFactory::create(QDBusConnection::sessionBus()),
+            contactFactory,
+            EXAMPLE_TYPE_CALL_CONNECTION,
+            "account", "streams@example.com",
+            "protocol", "example",
+            "simulation-delay", 1,
+            NULL);
+    QCOMPARE(conn->connect(Connection::FeatureSelfContact), true);
+
+    // This identifier contains the magic string (no answer), which means the example
+    // will never answer, so that the call members don't change behind our back
+    QList<ContactPtr> contacts = conn->contacts(QStringList() <<
+            QLatin1String("alice (no answer)") << QLatin1String("bob"));
+    QCOMPARE(contacts.size(), 2);
+    ContactPtr otherContact = contacts.at(0);
+    ContactPtr newMember = contacts.at(1);
+
+    QVariantMap request;
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType"),
+                   TP_QT_IFACE_CHANNEL_TYPE_CALL);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType"),
+                   (uint) Tp::HandleTypeContact);
+    request.insert(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"),
+                   otherContact->handle()[0]);
+    request.insert(TP_QT_IFACE_CHANNEL_TYPE_CALL + QLatin1String(".InitialAudio"),
+                   true);
+    request.insert(TP_QT_IFACE_CHANNEL_TYPE_CALL + QLatin1String(".InitialVideo"),
+                   true);
+    mChan = CallChannelPtr::qObjectCast(conn->createChannel(request));
+    QVERIFY(mChan);
+
+    QVERIFY(connect(mChan->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    contactFactory->addFeature(Contact::FeatureSimplePresence);
+    DBusMetrics::reset();
+    DBusMetrics::setEnabled(true);
+
+    QVERIFY(connect(mChan->becomeReady(CallChannel::FeatureContents),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    processDBusQueue(mChan.data());
+
+    QCOMPARE(mChan->contents().size(), 2);
+    CallStreams streams;
+    Q_FOREACH (const CallContentPtr &content, mChan->contents()) {
+        QCOMPARE(content->streams().size(), 1);
+        streams.append(content->streams().first());
+    }
+    Q_FOREACH (const CallStreamPtr &stream, streams) {
+        QVERIFY(stream->isReady());
+        QCOMPARE(stream->remoteMembers(), Contacts() << otherContact);
+    }
+
+    // The remote members of both streams were resolved with a single contacts request
+    QCOMPARE(outgoingCallCount(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS,
+                QLatin1String("GetContactAttributes")), 1u);
+    QVERIFY(otherContact->actualFeatures().contains(Contact::FeatureSimplePresence));
+
+    // A remote member with an invalid handle, resolved together with a valid one announced on
+    // the other stream, only affects the stream it was announced on
+    Q_FOREACH (const CallStreamPtr &stream, streams) {
+        QVERIFY(connect(stream.data(),
+                        SIGNAL(remoteSendingStateChanged(QHash<Tp::ContactPtr,Tp::SendingState>,Tp::CallStateReason)),
+                        SLOT(onStreamRemoteSendingStateChanged(QHash<Tp::ContactPtr,Tp::SendingState>,Tp::CallStateReason))));
+    }
+    uint invalidHandle = 0xdeadbeef;
+    QVERIFY(emitRemoteMemberAdded(streams.at(0)->objectPath(), newMember->handle()[0],
+                newMember->id()));
+    QVERIFY(emitRemoteMemberAdded(streams.at(1)->objectPath(), invalidHandle, QString()));
+    QCOMPARE(mLoop->exec(), 0);
+    processDBusQueue(mChan.data());
+
+    QCOMPARE(mStreamRemoteSendingStates.size(), 1);
+    QHash<ContactPtr, SendingState> states =
+        mStreamRemoteSendingStates.value(streams.at(0)->objectPath());
+    QCOMPARE(states.size(), 1);
+    QCOMPARE(states.value(newMember), SendingStateSending);
+    QCOMPARE(streams.at(0)->remoteMembers(), Contacts() << otherContact << newMember);
+    QCOMPARE(streams.at(1)->remoteMembers(), Contacts() << otherContact);
+
+    DBusMetrics::setEnabled(false);
+    DBusMetrics::reset();
+
+    mChan.reset();
+    QCOMPARE(conn->disconnect(), true);
+    delete conn;
+}
+
 void TestCallChannel::cleanup()
 {
     mChan.reset();
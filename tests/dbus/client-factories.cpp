@@ -1049,8 +1049,8 @@ void TestClientFactories::testChannelFactoryAccessors()
     chanFact->addFeaturesForStreamedMediaCalls(streamedMediaFeatures);
     streamedMediaFeatures |= commonFeatures;
 
-    // RoomListChannel has no feature, let's use FeatureConferenceInitialInviteeContacts just for
-    // testing purposes
+    // RoomListChannel only has its core feature, let's use FeatureConferenceInitialInviteeContacts
+    // just for testing purposes
     Features roomListFeatures;
     roomListFeatures.insert(Channel::FeatureConferenceInitialInviteeContacts);
     chanFact->addFeaturesForRoomLists(roomListFeatures);
@@ -19,6 +19,9 @@
 #include <telepathy-glib/dbus.h>
 #include <telepathy-glib/debug.h>
 
+#include <dbus/dbus.h>
+#include <dbus/dbus-glib-lowlevel.h>
+
 #include <tests/lib/glib/bug16307-conn.h>
 #include <tests/lib/glib/contacts-noroster-conn.h>
 #include <tests/lib/glib/simple-conn.h>
@@ -26,13 +29,62 @@
 
 using namespace Tp;
 
+namespace
+{
+
+// The introspection calls received by a service connection, in the order they were received
+struct CallRecorder
+{
+    QByteArray objectPath;
+    QStringList calls;
+};
+
+DBusHandlerResult recordIntrospectionCall(DBusConnection *connection, DBusMessage *message,
+        void *userData)
+{
+    Q_UNUSED(connection);
+
+    CallRecorder *recorder = static_cast<CallRecorder *>(userData);
+    if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL ||
+            recorder->objectPath != dbus_message_get_path(message)) {
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    QString interface = QLatin1String(dbus_message_get_interface(message));
+    QString member = QLatin1String(dbus_message_get_member(message));
+    if (interface == TP_QT_IFACE_PROPERTIES) {
+        const char *propertyInterface = 0;
+        const char *property = 0;
+        if (member == QLatin1String("GetAll") &&
+                dbus_message_get_args(message, NULL, DBUS_TYPE_STRING, &propertyInterface,
+                    DBUS_TYPE_INVALID)) {
+            recorder->calls << QString(QLatin1String("GetAll(%1)"))
+                .arg(QLatin1String(propertyInterface));
+        } else if (member == QLatin1String("Get") &&
+                dbus_message_get_args(message, NULL, DBUS_TYPE_STRING, &propertyInterface,
+                    DBUS_TYPE_STRING, &property, DBUS_TYPE_INVALID)) {
+            recorder->calls << QString(QLatin1String("Get(%1.%2)"))
+                .arg(QLatin1String(propertyInterface)).arg(QLatin1String(property));
+        }
+    } else if (interface == TP_QT_IFACE_CONNECTION &&
+            (member == QLatin1String("GetStatus") ||
+             member == QLatin1String("GetInterfaces") ||
+             member == QLatin1String("GetSelfHandle"))) {
+        recorder->calls << member;
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+}
+
 class TestConnIntrospectCornercases : public Test
 {
     Q_OBJECT
 
 public:
     TestConnIntrospectCornercases(QObject *parent = 0)
-        : Test(parent), mConnService(0), mNumSelfHandleChanged(0)
+        : Test(parent), mConnService(0), mNumSelfHandleChanged(0), mRecordingCalls(false)
     { }
 
 protected Q_SLOTS:
@@ -46,6 +98,7 @@ private Q_SLOTS:
     void testSelfHandleChangeBeforeConnecting();
     void testSelfHandleChangeWhileBuilding();
     void testSlowpath();
+    void testIntrospectionCalls();
     void testStatusChange();
     void testNoRoster();
 
@@ -53,12 +106,37 @@ private Q_SLOTS:
     void cleanupTestCase();
 
 private:
+    void startRecordingCalls(const gchar *connPath);
+    void stopRecordingCalls();
+
     TpBaseConnection *mConnService;
     ConnectionPtr mConn;
     QList<ConnectionStatus> mStatuses;
     int mNumSelfHandleChanged;
+    bool mRecordingCalls;
+    CallRecorder mRecorder;
 };
 
+void TestConnIntrospectCornercases::startRecordingCalls(const gchar *connPath)
+{
+    mRecorder.objectPath = QByteArray(connPath);
+    mRecorder.calls.clear();
+    dbus_connection_add_filter(dbus_g_connection_get_connection(tp_get_bus()),
+            recordIntrospectionCall, &mRecorder, NULL);
+    mRecordingCalls = true;
+}
+
+void TestConnIntrospectCornercases::stopRecordingCalls()
+{
+    if (!mRecordingCalls) {
+        return;
+    }
+
+    dbus_connection_remove_filter(dbus_g_connection_get_connection(tp_get_bus()),
+            recordIntrospectionCall, &mRecorder);
+    mRecordingCalls = false;
+}
+
 void TestConnIntrospectCornercases::expectConnInvalidated()
 {
     qDebug() << "conn invalidated";
@@ -311,6 +389,8 @@ void TestConnIntrospectCornercases::testSlowpath()
                 &name, &connPath, &error));
     QVERIFY(error == 0);
 
+    startRecordingCalls(connPath);
+
     mConn = Connection::create(QLatin1String(name), QLatin1String(connPath),
             ChannelFactory::create(QDBusConnection::sessionBus()),
             ContactFactory::create());
@@ -331,6 +411,102 @@ void TestConnIntrospectCornercases::testSlowpath()
     QCOMPARE(mConn->isReady(Connection::FeatureCore), true);
     QCOMPARE(static_cast<uint>(mConn->status()),
              static_cast<uint>(ConnectionStatusConnected));
+
+    // The interface properties are pipelined with the GetAll, as the interfaces aren't known yet.
+    // As the GetAll doesn't return the Connection properties, the fallbacks for them are only made
+    // after it has returned, all together.
+    QVERIFY(mRecorder.calls.size() >= 6);
+    QCOMPARE(mRecorder.calls.mid(0, 6), QStringList()
+            << QString(QLatin1String("GetAll(%1)")).arg(TP_QT_IFACE_CONNECTION)
+            << QString(QLatin1String("Get(%1.RequestableChannelClasses)"))
+                .arg(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS)
+            << QString(QLatin1String("Get(%1.ContactAttributeInterfaces)"))
+                .arg(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS)
+            << QLatin1String("GetStatus")
+            << QLatin1String("GetInterfaces")
+            << QLatin1String("GetSelfHandle"));
+}
+
+void TestConnIntrospectCornercases::testIntrospectionCalls()
+{
+    gchar *name;
+    gchar *connPath;
+    GError *error = 0;
+
+    TpTestsSimpleConnection *simpleConnService =
+        TP_TESTS_SIMPLE_CONNECTION(
+            g_object_new(
+                TP_TESTS_TYPE_SIMPLE_CONNECTION,
+                "account", "me@example.com",
+                "protocol", "simple",
+                NULL));
+    QVERIFY(simpleConnService != 0);
+
+    mConnService = TP_BASE_CONNECTION(simpleConnService);
+    QVERIFY(mConnService != 0);
+
+    QVERIFY(tp_base_connection_register(mConnService, "simple",
+                &name, &connPath, &error));
+    QVERIFY(error == 0);
+
+    startRecordingCalls(connPath);
+
+    mConn = Connection::create(QLatin1String(name), QLatin1String(connPath),
+            ChannelFactory::create(QDBusConnection::sessionBus()),
+            ContactFactory::create());
+    QCOMPARE(mConn->isReady(), false);
+
+    g_free(name); name = 0;
+    g_free(connPath); connPath = 0;
+
+    PendingOperation *op = mConn->becomeReady();
+    QVERIFY(connect(op,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mConn->isReady(Connection::FeatureCore), true);
+    QCOMPARE(static_cast<uint>(mConn->status()),
+             static_cast<uint>(ConnectionStatusDisconnected));
+
+    // Nothing is known about the interfaces at first, so both interface properties are requested
+    // together with the GetAll, which has everything else
+    QString getAll = QString(QLatin1String("GetAll(%1)")).arg(TP_QT_IFACE_CONNECTION);
+    QString getCapabilities = QString(QLatin1String("Get(%1.RequestableChannelClasses)"))
+        .arg(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS);
+    QString getContactAttributeInterfaces =
+        QString(QLatin1String("Get(%1.ContactAttributeInterfaces)"))
+            .arg(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS);
+    QCOMPARE(mRecorder.calls, QStringList() << getAll << getCapabilities
+            << getContactAttributeInterfaces);
+
+    QVERIFY(mConn->hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS));
+    QVERIFY(!mConn->hasInterface(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS));
+
+    // Once connected, FeatureCore is introspected again. This time around, only the interfaces
+    // which are known to be there have their properties requested.
+    mRecorder.calls.clear();
+
+    op = mConn->becomeReady(Connection::FeatureConnected);
+    QVERIFY(connect(op,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+
+    TpHandleRepoIface *contactRepo = tp_base_connection_get_handles(mConnService,
+            TP_HANDLE_TYPE_CONTACT);
+    mConnService->self_handle = tp_handle_ensure(contactRepo, "me@example.com",
+            NULL, NULL);
+    tp_base_connection_change_status(mConnService,
+            TP_CONNECTION_STATUS_CONNECTING,
+            TP_CONNECTION_STATUS_REASON_REQUESTED);
+    tp_base_connection_change_status(mConnService,
+            TP_CONNECTION_STATUS_CONNECTED,
+            TP_CONNECTION_STATUS_REASON_REQUESTED);
+
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mConn->isReady(Connection::FeatureConnected), true);
+    QCOMPARE(static_cast<uint>(mConn->status()),
+             static_cast<uint>(ConnectionStatusConnected));
+    QCOMPARE(mRecorder.calls, QStringList() << getAll << getCapabilities);
 }
 
 void TestConnIntrospectCornercases::testStatusChange()
@@ -484,6 +660,8 @@ void TestConnIntrospectCornercases::cleanup()
         mConn.reset();
     }
 
+    stopRecordingCalls();
+
     if (mConnService != 0) {
         g_object_unref(mConnService);
         mConnService = 0;
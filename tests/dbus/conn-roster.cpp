@@ -11,6 +11,9 @@
 #include <TelepathyQt/ContactManager>
 #include <TelepathyQt/PendingContacts>
 
+#include <QDir>
+#include <QTemporaryFile>
+
 #include <telepathy-glib/debug.h>
 
 using namespace Tp;
@@ -41,6 +44,7 @@ private Q_SLOTS:
     void init();
 
     void testRoster();
+    void testAttributeCache();
 
     void cleanup();
     void cleanupTestCase();
@@ -479,6 +483,62 @@ void TestConnRoster::testRoster()
     }
 }
 
+void TestConnRoster::testAttributeCache()
+{
+    // In a directory which doesn't exist yet, so that the cache creates it
+    QString cacheDirName;
+    {
+        QTemporaryFile tmp;
+        QVERIFY(tmp.open());
+        cacheDirName = tmp.fileName() + QLatin1String(".d");
+    }
+    QString cacheFileName = cacheDirName + QLatin1String("/cache");
+    QFile::Permissions groupAndOther = QFile::ReadGroup | QFile::WriteGroup | QFile::ExeGroup |
+        QFile::ReadOther | QFile::WriteOther | QFile::ExeOther;
+
+    // The first connection writes the cache, the second one is served from it
+    QMap<QString, QString> aliases;
+    for (int i = 0; i < 2; ++i) {
+        TestConnHelper *conn = new TestConnHelper(this,
+                ChannelFactory::create(QDBusConnection::sessionBus()),
+                ContactFactory::create(Contact::FeatureAlias),
+                EXAMPLE_TYPE_CONTACT_LIST_CONNECTION,
+                "account", "cache@example.com",
+                "protocol", "contactlist",
+                "simulation-delay", 1,
+                NULL);
+        QCOMPARE(conn->connect(), true);
+
+        ContactManagerPtr contactManager = conn->client()->contactManager();
+        contactManager->setAttributeCacheFileName(cacheFileName);
+        QCOMPARE(contactManager->attributeCacheFileName(), cacheFileName);
+
+        QCOMPARE(conn->enableFeatures(Features() << Connection::FeatureRoster), true);
+        QCOMPARE(contactManager->state(), ContactListStateSuccess);
+        QVERIFY(QFile::exists(cacheFileName));
+        QVERIFY(!(QFile::permissions(cacheFileName) & groupAndOther));
+        QVERIFY(!(QFile::permissions(cacheDirName) & groupAndOther));
+
+        QMap<QString, QString> currentAliases;
+        Q_FOREACH (const ContactPtr &contact, contactManager->allKnownContacts()) {
+            currentAliases.insert(contact->id(), contact->alias());
+        }
+        QVERIFY(!currentAliases.isEmpty());
+
+        if (i == 0) {
+            aliases = currentAliases;
+        } else {
+            QCOMPARE(currentAliases, aliases);
+        }
+
+        QCOMPARE(conn->disconnect(), true);
+        delete conn;
+    }
+
+    QFile::remove(cacheFileName);
+    QDir().rmdir(cacheDirName);
+}
+
 void TestConnRoster::cleanup()
 {
     cleanupImpl();
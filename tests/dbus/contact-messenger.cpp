@@ -23,6 +23,7 @@
 #include <TelepathyQt/PendingContacts>
 #include <TelepathyQt/PendingReady>
 #include <TelepathyQt/PendingSendMessage>
+#include <TelepathyQt/SimpleTextObserver>
 #include <TelepathyQt/TextChannel>
 #include <TelepathyQt/Types>
 
@@ -61,7 +62,8 @@ public:
     CDMessagesAdaptor(const QDBusConnection &bus, TestContactMessenger *test, QObject *parent)
         : QDBusAbstractAdaptor(parent),
         test(test),
-        mBus(bus)
+        mBus(bus),
+        mHoldReplies(false)
     {
     }
 
@@ -75,16 +77,39 @@ public:
         mSimulatedSendError = error;
     }
 
+    // While set, SendMessage calls are only answered by releaseHeldReply(), so that the test can
+    // see how many of them are in flight at once
+    void setHoldReplies(bool hold)
+    {
+        mHoldReplies = hold;
+    }
+
+    QStringList heldTexts() const
+    {
+        return mHeldTexts;
+    }
+
+    void releaseHeldReply(const QString &text)
+    {
+        int index = mHeldTexts.indexOf(text);
+        Q_ASSERT(index >= 0);
+        mHeldTexts.removeAt(index);
+        mBus.send(mHeldReplies.takeAt(index));
+    }
+
 public Q_SLOTS: // Methods
     QString SendMessage(const QDBusObjectPath &account,
             const QString &targetID, const Tp::MessagePartList &message,
-            uint flags);
+            uint flags, const QDBusMessage &dbusMessage);
 
 private:
 
     TestContactMessenger *test;
     QDBusConnection mBus;
     QString mSimulatedSendError;
+    bool mHoldReplies;
+    QStringList mHeldTexts;
+    QList<QDBusMessage> mHeldReplies;
 };
 
 class AccountAdaptor : public QDBusAbstractAdaptor
@@ -167,9 +192,12 @@ public:
     TestContactMessenger(QObject *parent = 0)
         : Test(parent),
           mCDMessagesAdaptor(0), mAccountAdaptor(0),
+          mCDBus(QDBusConnection::connectToBus(QDBusConnection::SessionBus,
+                      QLatin1String("contact-messenger-cd"))),
           // service side (telepathy-glib)
           mConnService(0), mBaseConnService(0), mContactRepo(0),
-          mSendFinished(false), mGotMessageSent(false)
+          mSendFinished(false), mGotMessageSent(false), mExpectedHeldSends(-1),
+          mExpectedBulkTexts(0)
     { }
 
 protected Q_SLOTS:
@@ -179,6 +207,8 @@ protected Q_SLOTS:
             const QString &sentMessageToken, const Tp::TextChannelPtr &channel);
     void onMessageReceived(const Tp::ReceivedMessage &message,
             const Tp::TextChannelPtr &channel);
+    void onMessagesReceived(const QList<Tp::ReceivedMessage> &messages,
+            const QList<Tp::TextChannelPtr> &channels);
 
 private Q_SLOTS:
     void initTestCase();
@@ -187,8 +217,10 @@ private Q_SLOTS:
     void testNoSupport();
     void testObserverRegistration();
     void testSimpleSend();
+    void testQueuedSend();
     void testReceived();
     void testReceivedFromContact();
+    void testReceivedInBulk();
 
     void cleanup();
     void cleanupTestCase();
@@ -198,9 +230,14 @@ private:
     friend class CDMessagesAdaptor;
 
     QList<ClientObserverInterface *> ourObservers();
+    bool waitForHeldSends(int count);
+    void verifySendWindows();
 
     CDMessagesAdaptor *mCDMessagesAdaptor;
     AccountAdaptor *mAccountAdaptor;
+    // The channel dispatcher is served on a connection of its own, as QtDBus can't delay the
+    // replies to calls made on the same connection
+    QDBusConnection mCDBus;
     QString mAccountBusName, mAccountPath;
 
     AccountManagerPtr mAM;
@@ -221,13 +258,17 @@ private:
     QString mSendError, mSendToken, mMessageSentText, mMessageSentToken, mMessageSentChannel;
     QString mMessageReceivedText;
     ChannelPtr mMessageReceivedChan;
+    QStringList mDispatchedTexts;
+    int mExpectedHeldSends;
+    QStringList mBulkReceivedTexts;
+    int mExpectedBulkTexts;
 
     QList<ContactPtr> mContacts;
 };
 
 QString CDMessagesAdaptor::SendMessage(const QDBusObjectPath &account,
         const QString &targetID, const MessagePartList &message,
-        uint flags)
+        uint flags, const QDBusMessage &dbusMessage)
 {
     if (!mSimulatedSendError.isEmpty()) {
         dynamic_cast<QDBusContext *>(QObject::parent())->sendErrorReply(mSimulatedSendError,
@@ -235,6 +276,22 @@ QString CDMessagesAdaptor::SendMessage(const QDBusObjectPath &account,
         return QString();
     }
 
+    QString text;
+    if (message.size() > 1) {
+        text = message.at(1).value(QLatin1String("content")).variant().toString();
+        test->mDispatchedTexts << text;
+    }
+
+    if (mHoldReplies) {
+        dbusMessage.setDelayedReply(true);
+        mHeldTexts << text;
+        mHeldReplies << dbusMessage.createReply(QString(QLatin1String("token-%1")).arg(text));
+        if (mHeldReplies.size() == test->mExpectedHeldSends) {
+            test->mLoop->exit(0);
+        }
+        return QString();
+    }
+
     /*
      * Sadly, the QDBus local-loop "optimization" prevents us from correctly waiting for the
      * ObserveChannels call to return, and consequently prevents us from knowing when we can call
@@ -322,6 +379,22 @@ void TestContactMessenger::onMessageReceived(const Tp::ReceivedMessage &message,
     mMessageReceivedChan = channel;
 }
 
+void TestContactMessenger::onMessagesReceived(const QList<Tp::ReceivedMessage> &messages,
+        const QList<Tp::TextChannelPtr> &channels)
+{
+    qDebug() << "Got SimpleTextObserver::messagesReceived()";
+
+    QCOMPARE(messages.size(), channels.size());
+    for (int i = 0; i < messages.size(); ++i) {
+        QCOMPARE(channels.at(i)->objectPath(), mChan->objectPath());
+        mBulkReceivedTexts << messages.at(i).text();
+    }
+
+    if (mExpectedBulkTexts > 0 && mBulkReceivedTexts.size() >= mExpectedBulkTexts) {
+        mLoop->exit(0);
+    }
+}
+
 void TestContactMessenger::initTestCase()
 {
     initTestCaseImpl();
@@ -332,12 +405,13 @@ void TestContactMessenger::initTestCase()
     dbus_g_bus_get(DBUS_BUS_STARTER, 0);
 
     QDBusConnection bus = QDBusConnection::sessionBus();
+    QVERIFY(mCDBus.isConnected());
     QString channelDispatcherBusName = TP_QT_IFACE_CHANNEL_DISPATCHER;
     QString channelDispatcherPath = QLatin1String("/org/freedesktop/Telepathy/ChannelDispatcher");
     Dispatcher *dispatcher = new Dispatcher(this);
-    mCDMessagesAdaptor = new CDMessagesAdaptor(bus, this, dispatcher);
-    QVERIFY(bus.registerService(channelDispatcherBusName));
-    QVERIFY(bus.registerObject(channelDispatcherPath, dispatcher));
+    mCDMessagesAdaptor = new CDMessagesAdaptor(mCDBus, this, dispatcher);
+    QVERIFY(mCDBus.registerService(channelDispatcherBusName));
+    QVERIFY(mCDBus.registerObject(channelDispatcherPath, dispatcher));
 
     mAccountBusName = TP_QT_IFACE_ACCOUNT_MANAGER;
     mAccountPath = QLatin1String("/org/freedesktop/Telepathy/Account/simple/simple/account");
@@ -428,7 +502,12 @@ void TestContactMessenger::init()
     mSendFinished = false;
     mGotMessageSent = false;
     mGotMessageReceived = false;
+    mDispatchedTexts.clear();
+    mExpectedHeldSends = -1;
+    mBulkReceivedTexts.clear();
+    mExpectedBulkTexts = 0;
     mCDMessagesAdaptor->setSimulatedSendError(QString());
+    mCDMessagesAdaptor->setHoldReplies(false);
 }
 
 void TestContactMessenger::testNoSupport()
@@ -511,6 +590,117 @@ void TestContactMessenger::testSimpleSend()
     QVERIFY(mSendError.isEmpty());
 }
 
+bool TestContactMessenger::waitForHeldSends(int count)
+{
+    if (mCDMessagesAdaptor->heldTexts().size() < count) {
+        QTimer timeout;
+        timeout.setSingleShot(true);
+        connect(&timeout, SIGNAL(timeout()), mLoop, SLOT(quit()));
+        timeout.start(5000);
+
+        mExpectedHeldSends = count;
+        mLoop->exec();
+        mExpectedHeldSends = -1;
+    }
+
+    return mCDMessagesAdaptor->heldTexts().size() == count;
+}
+
+void TestContactMessenger::verifySendWindows()
+{
+    // The texts sent by testQueuedSend() start with the identifier of their target
+    QHash<QString, int> inFlightPerTarget;
+    Q_FOREACH (const QString &text, mCDMessagesAdaptor->heldTexts()) {
+        ++inFlightPerTarget[text.left(3)];
+    }
+
+    QVERIFY(mCDMessagesAdaptor->heldTexts().size() <= 16);
+    Q_FOREACH (int inFlight, inFlightPerTarget) {
+        QVERIFY(inFlight <= 4);
+    }
+}
+
+void TestContactMessenger::testQueuedSend()
+{
+    // The dispatcher holds on to the calls, so that we can see the windows fill up: at most 16
+    // SendMessage calls in flight for the account, and at most 4 of them for the same contact
+    mCDMessagesAdaptor->setHoldReplies(true);
+
+    QStringList targets = QStringList() << QLatin1String("Ann") << QLatin1String("Bob") <<
+        QLatin1String("Cid") << QLatin1String("Dan") << QLatin1String("Eve");
+    QList<ContactMessengerPtr> messengers;
+    QHash<QString, QStringList> sentTexts;
+    Q_FOREACH (const QString &target, targets) {
+        ContactMessengerPtr messenger = ContactMessenger::create(mAccount, target);
+        messengers << messenger;
+
+        // More messages than fit in the window of a contact
+        for (int i = 1; i <= 6; ++i) {
+            QString text = target + QString::number(i);
+            QVERIFY(messenger->sendMessage(text) != NULL);
+            sentTexts[target] << text;
+        }
+    }
+    int total = targets.size() * 6;
+
+    // The first four contacts use up the account window, and Eve waits for a free slot
+    QVERIFY(waitForHeldSends(16));
+    verifySendWindows();
+    QStringList firstTexts;
+    Q_FOREACH (const QString &target, targets.mid(0, 4)) {
+        firstTexts << sentTexts[target].mid(0, 4);
+    }
+    QCOMPARE(mCDMessagesAdaptor->heldTexts(), firstTexts);
+    QCOMPARE(mDispatchedTexts, firstTexts);
+
+    // Each freed slot goes to the target which has waited the longest for one. Eve has been
+    // waiting from the start, and the others get back in line as their replies come back.
+    QStringList releases = QStringList() <<
+        QLatin1String("Ann1") << QLatin1String("Bob1") << QLatin1String("Cid1") <<
+        QLatin1String("Dan1") << QLatin1String("Ann2") << QLatin1String("Bob2") <<
+        QLatin1String("Cid2") << QLatin1String("Dan2");
+    QStringList refills = QStringList() <<
+        QLatin1String("Eve1") << QLatin1String("Ann5") << QLatin1String("Eve2") <<
+        QLatin1String("Bob5") << QLatin1String("Cid5") << QLatin1String("Eve3") <<
+        QLatin1String("Dan5") << QLatin1String("Ann6");
+    int released = 0;
+    for (int i = 0; i < releases.size(); ++i) {
+        mCDMessagesAdaptor->releaseHeldReply(releases.at(i));
+        ++released;
+        QVERIFY(waitForHeldSends(16));
+        QCOMPARE(mDispatchedTexts.size(), 17 + i);
+        QCOMPARE(mDispatchedTexts.last(), refills.at(i));
+        verifySendWindows();
+    }
+
+    // Let everything else through, a reply at a time
+    while (!mCDMessagesAdaptor->heldTexts().isEmpty()) {
+        mCDMessagesAdaptor->releaseHeldReply(mCDMessagesAdaptor->heldTexts().first());
+        ++released;
+        QVERIFY(waitForHeldSends(qMin(16, total - released)));
+        verifySendWindows();
+    }
+    mCDMessagesAdaptor->setHoldReplies(false);
+
+    QVERIFY(connect(ContactMessenger::waitForPendingMessages(mAccount),
+            SIGNAL(finished(Tp::PendingOperation*)),
+            SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    // Every message reached the dispatcher once, and those to the same contact in the order they
+    // were sent
+    QCOMPARE(mDispatchedTexts.size(), total);
+    Q_FOREACH (const QString &target, targets) {
+        QStringList targetTexts;
+        Q_FOREACH (const QString &text, mDispatchedTexts) {
+            if (text.startsWith(target)) {
+                targetTexts << text;
+            }
+        }
+        QCOMPARE(targetTexts, sentTexts[target]);
+    }
+}
+
 void TestContactMessenger::testReceived()
 {
     ContactMessengerPtr messenger = ContactMessenger::create(mAccount, QLatin1String("Ann"));
@@ -584,6 +774,55 @@ void TestContactMessenger::testReceivedFromContact()
     QCOMPARE(mMessageReceivedChan->objectPath(), mChan->objectPath());
 }
 
+void TestContactMessenger::testReceivedInBulk()
+{
+    SimpleTextObserverPtr observer = SimpleTextObserver::create(mAccount, QLatin1String("Ann"));
+
+    QVERIFY(connect(observer.data(),
+            SIGNAL(messageReceived(Tp::ReceivedMessage,Tp::TextChannelPtr)),
+            SLOT(onMessageReceived(Tp::ReceivedMessage,Tp::TextChannelPtr))));
+    QVERIFY(connect(observer.data(),
+            SIGNAL(messagesReceived(QList<Tp::ReceivedMessage>,QList<Tp::TextChannelPtr>)),
+            SLOT(onMessagesReceived(QList<Tp::ReceivedMessage>,QList<Tp::TextChannelPtr>))));
+
+    QList<ClientObserverInterface *> observers = ourObservers();
+    Q_FOREACH(ClientObserverInterface *iface, observers) {
+        ChannelDetails chan = { QDBusObjectPath(mChan->objectPath()), mChan->immutableProperties() };
+        iface->ObserveChannels(
+                QDBusObjectPath(mAccount->objectPath()),
+                QDBusObjectPath(mChan->connection()->objectPath()),
+                ChannelDetailsList() << chan,
+                QDBusObjectPath(QLatin1String("/")),
+                Tp::ObjectPathList(),
+                QVariantMap());
+    }
+
+    guint handle = tp_handle_ensure(mContactRepo, "Ann", 0, 0);
+    QStringList texts = QStringList() << QLatin1String("One") << QLatin1String("Two") <<
+        QLatin1String("Three");
+    Q_FOREACH (const QString &text, texts) {
+        TpMessage *msg = tp_cm_message_new_text(mBaseConnService, handle,
+                TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL, text.toLatin1().constData());
+        tp_message_mixin_take_received(G_OBJECT(mMessagesChanService), msg);
+    }
+
+    mExpectedBulkTexts = texts.size();
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    connect(&timeout, SIGNAL(timeout()), mLoop, SLOT(quit()));
+    timeout.start(5000);
+    mLoop->exec();
+    mExpectedBulkTexts = 0;
+
+    // Give any stray message the chance to be signalled too
+    QTimer::singleShot(100, mLoop, SLOT(quit()));
+    mLoop->exec();
+
+    // Each message is signalled exactly once, in the order it was received
+    QCOMPARE(mBulkReceivedTexts, texts);
+    QVERIFY(mGotMessageReceived);
+    QCOMPARE(mMessageReceivedText, texts.last());
+}
 
 void TestContactMessenger::cleanup()
 {
@@ -6,13 +6,55 @@
 #include <tests/lib/glib/contact-search-chan.h>
 
 #include <TelepathyQt/Connection>
+#include <TelepathyQt/Contact>
 #include <TelepathyQt/ContactSearchChannel>
+#include <TelepathyQt/DBusMetrics>
 #include <TelepathyQt/PendingReady>
 
 #include <telepathy-glib/debug.h>
+#include <telepathy-glib/svc-channel.h>
 
 using namespace Tp;
 
+namespace
+{
+
+uint outgoingCallCount(const QString &interfaceName, const QString &memberName)
+{
+    Q_FOREACH (const DBusMetrics::Entry &entry, DBusMetrics::entries()) {
+        if (entry.kind() == DBusMetrics::OutgoingCall &&
+                entry.interfaceName() == interfaceName && entry.memberName() == memberName) {
+            return entry.count();
+        }
+    }
+    return 0;
+}
+
+// Emit SearchResultReceived from the service side, with no contact info for the results
+void emitSearchResult(TpTestsContactSearchChannel *service, const QStringList &identifiers)
+{
+    GHashTable *result = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            (GDestroyNotify) g_ptr_array_unref);
+    Q_FOREACH (const QString &identifier, identifiers) {
+        g_hash_table_insert(result, g_strdup(identifier.toLatin1().constData()),
+                g_ptr_array_new());
+    }
+    tp_svc_channel_type_contact_search_emit_search_result_received(service, result);
+    g_hash_table_unref(result);
+}
+
+QStringList resultIdentifiers(const ContactSearchChannel::SearchResult &result)
+{
+    QStringList identifiers;
+    Q_FOREACH (const ContactPtr &contact, result.keys()) {
+        identifiers.append(contact->id());
+    }
+    identifiers.sort();
+    return identifiers;
+}
+
+}
+
 class TestContactSearchChan : public Test
 {
     Q_OBJECT
@@ -28,6 +70,7 @@ protected Q_SLOTS:
     void onSearchStateChanged(Tp::ChannelContactSearchState state, const QString &errorName,
         const Tp::ContactSearchChannel::SearchStateChangeDetails &details);
     void onSearchResultReceived(const Tp::ContactSearchChannel::SearchResult &result);
+    void onSearchResultBatchReceived(const Tp::ContactSearchChannel::SearchResult &result);
     void onSearchReturned(Tp::PendingOperation *op);
 
 private Q_SLOTS:
@@ -36,6 +79,7 @@ private Q_SLOTS:
 
     void testContactSearch();
     void testContactSearchEmptyResult();
+    void testSearchResultBatches();
 
     void cleanup();
     void cleanupTestCase();
@@ -54,6 +98,7 @@ private:
     TpTestsContactSearchChannel *mChan2Service;
 
     ContactSearchChannel::SearchResult mSearchResult;
+    QList<ContactSearchChannel::SearchResult> mSearchResultBatches;
     bool mSearchReturned;
 
     struct SearchStateChangeInfo
@@ -87,6 +132,13 @@ void TestContactSearchChan::onSearchResultReceived(
     mLoop->exit(0);
 }
 
+void TestContactSearchChan::onSearchResultBatchReceived(
+        const Tp::ContactSearchChannel::SearchResult &result)
+{
+    mSearchResultBatches.append(result);
+    mLoop->exit(0);
+}
+
 void TestContactSearchChan::onSearchReturned(Tp::PendingOperation *op)
 {
     TEST_VERIFY_OP(op);
@@ -135,6 +187,7 @@ void TestContactSearchChan::init()
 {
     initImpl();
     mSearchResult.clear();
+    mSearchResultBatches.clear();
     mSearchStateChangeInfoList.clear();
     mSearchReturned = false;
 }
@@ -157,6 +210,10 @@ void TestContactSearchChan::testContactSearch()
     QCOMPARE(mChan1->availableSearchKeys().first(), QLatin1String("employer"));
     QCOMPARE(mChan1->server(), QLatin1String("characters.shakespeare.lit"));
 
+    QCOMPARE(mChan1->maxPendingResultRequests(), static_cast<uint>(4));
+    mChan1->setMaxPendingResultRequests(1);
+    QCOMPARE(mChan1->maxPendingResultRequests(), static_cast<uint>(1));
+
     QVERIFY(connect(mChan1.data(),
                 SIGNAL(searchStateChanged(Tp::ChannelContactSearchState, const QString &,
                         const Tp::ContactSearchChannel::SearchStateChangeDetails &)),
@@ -193,6 +250,7 @@ void TestContactSearchChan::testContactSearch()
 
     QCOMPARE(mSearchResult.isEmpty(), false);
     QCOMPARE(mSearchResult.size(), 3);
+    QCOMPARE(mChan1->searchResults().keys().toSet(), mSearchResult.keys().toSet());
 
     QStringList expectedIds;
     expectedIds << QLatin1String("oggis") << QLatin1String("andrunko") <<
@@ -266,6 +324,7 @@ void TestContactSearchChan::testContactSearchEmptyResult()
     QCOMPARE(mSearchReturned, true);
 
     QCOMPARE(mSearchResult.isEmpty(), true);
+    QCOMPARE(mChan2->searchResults().isEmpty(), true);
 
     QCOMPARE(mSearchStateChangeInfoList.count(), 2);
     SearchStateChangeInfo info = mSearchStateChangeInfoList.at(0);
@@ -283,6 +342,69 @@ void TestContactSearchChan::testContactSearchEmptyResult()
     mChan2.reset();
 }
 
+void TestContactSearchChan::testSearchResultBatches()
+{
+    QString chanPath = mConn->objectPath() + QLatin1String("/ContactSearchChannel/3");
+    QByteArray chanPathLatin1 = chanPath.toLatin1();
+    TpTestsContactSearchChannel *chanService = TP_TESTS_CONTACT_SEARCH_CHANNEL(g_object_new(
+                TP_TESTS_TYPE_CONTACT_SEARCH_CHANNEL,
+                "connection", mConn->service(),
+                "object-path", chanPathLatin1.data(),
+                NULL));
+
+    ContactSearchChannelPtr chan = ContactSearchChannel::create(mConn->client(), chanPath,
+            QVariantMap());
+    QVERIFY(connect(chan->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(chan->isReady(ContactSearchChannel::FeatureCore));
+
+    chan->setMaxPendingResultRequests(1);
+    QVERIFY(connect(chan.data(),
+                SIGNAL(searchResultReceived(const Tp::ContactSearchChannel::SearchResult &)),
+                SLOT(onSearchResultBatchReceived(const Tp::ContactSearchChannel::SearchResult &))));
+
+    DBusMetrics::reset();
+    DBusMetrics::setEnabled(true);
+
+    // Received back to back, so that the later batches are queued behind the request for the
+    // first one, and overlapping each other
+    QStringList first = QStringList() << QLatin1String("oggis") << QLatin1String("andrunko");
+    QStringList second = QStringList() << QLatin1String("andrunko") << QLatin1String("wjt");
+    QStringList third = QStringList() << QLatin1String("oggis") << QLatin1String("wjt");
+    emitSearchResult(chanService, first);
+    emitSearchResult(chanService, second);
+    emitSearchResult(chanService, third);
+
+    while (mSearchResultBatches.size() < 3) {
+        QCOMPARE(mLoop->exec(), 0);
+    }
+
+    // Emitted in the order the batches were received
+    QCOMPARE(mSearchResultBatches.size(), 3);
+    first.sort();
+    second.sort();
+    third.sort();
+    QCOMPARE(resultIdentifiers(mSearchResultBatches.at(0)), first);
+    QCOMPARE(resultIdentifiers(mSearchResultBatches.at(1)), second);
+    QCOMPARE(resultIdentifiers(mSearchResultBatches.at(2)), third);
+
+    // Only the identifiers not resolved for an earlier batch still queued were requested: both of
+    // the first batch, then wjt, and nothing for the third batch
+    QCOMPARE(outgoingCallCount(TP_QT_IFACE_CONNECTION, QLatin1String("RequestHandles")), 2u);
+
+    QCOMPARE(resultIdentifiers(chan->searchResults()),
+            QStringList() << QLatin1String("andrunko") << QLatin1String("oggis") <<
+                QLatin1String("wjt"));
+
+    DBusMetrics::setEnabled(false);
+    DBusMetrics::reset();
+
+    chan.reset();
+    g_object_unref(chanService);
+}
+
 void TestContactSearchChan::cleanup()
 {
     cleanupImpl();
@@ -11,8 +11,10 @@
 #include <TelepathyQt/Connection>
 #include <TelepathyQt/ConnectionLowlevel>
 #include <TelepathyQt/Contact>
+#include <TelepathyQt/ContactCapabilities>
 #include <TelepathyQt/ContactFactory>
 #include <TelepathyQt/ContactManager>
+#include <TelepathyQt/LocationInfo>
 #include <TelepathyQt/PendingContacts>
 #include <TelepathyQt/PendingVoid>
 #include <TelepathyQt/PendingReady>
@@ -55,6 +57,7 @@ private Q_SLOTS:
     void testFeatures();
     void testFeaturesNotRequested();
     void testUpgrade();
+    void testAttributeKeys();
     void testSelfContactFallback();
 
     void cleanup();
@@ -717,6 +720,123 @@ void TestContacts::testUpgrade()
     processDBusQueue(mConn.data());
 }
 
+void TestContacts::testAttributeKeys()
+{
+    // Every attribute key known to the contact manager, bar the addressing ones which are
+    // covered by conn-addressing, should make it to the Contact through Contact::augment()
+    Features features = Features()
+        << Contact::FeatureAlias
+        << Contact::FeatureAvatarToken
+        << Contact::FeatureSimplePresence
+        << Contact::FeatureCapabilities
+        << Contact::FeatureLocation
+        << Contact::FeatureInfo
+        << Contact::FeatureClientTypes
+        << Contact::FeatureRosterGroups;
+    QVERIFY((features - mConn->contactManager()->supportedFeatures()).isEmpty());
+
+    TpHandleRepoIface *serviceRepo =
+        tp_base_connection_get_handles(TP_BASE_CONNECTION(mConnService), TP_HANDLE_TYPE_CONTACT);
+    TpHandle handle = tp_handle_ensure(serviceRepo, "dora", NULL, NULL);
+    QVERIFY(handle != 0);
+
+    const char *aliases[] = { "Dora the Explorer" };
+    const char *tokens[] = { "ddddd" };
+    static TpTestsContactsConnectionPresenceStatusIndex statuses[] = {
+        TP_TESTS_CONTACTS_CONNECTION_STATUS_BUSY
+    };
+    const char *messages[] = { "Exploring" };
+    tp_tests_contacts_connection_change_aliases(mConnService, 1, &handle, aliases);
+    tp_tests_contacts_connection_change_avatar_tokens(mConnService, 1, &handle, tokens);
+    tp_tests_contacts_connection_change_presences(mConnService, 1, &handle, statuses, messages);
+
+    GHashTable *location = tp_asv_new(
+        "country", G_TYPE_STRING, "Atlantis",
+        NULL);
+    tp_tests_contacts_connection_change_locations(mConnService, 1, &handle, &location);
+    g_hash_table_unref(location);
+
+    GHashTable *fixed = tp_asv_new(
+        TP_PROP_CHANNEL_CHANNEL_TYPE, G_TYPE_STRING, TP_IFACE_CHANNEL_TYPE_TEXT,
+        TP_PROP_CHANNEL_TARGET_HANDLE_TYPE, G_TYPE_UINT, TP_HANDLE_TYPE_CONTACT,
+        NULL);
+    const gchar * const allowed[] = { NULL };
+    GPtrArray *caps = g_ptr_array_new();
+    g_ptr_array_add(caps, tp_value_array_build(2,
+                TP_HASH_TYPE_STRING_VARIANT_MAP, fixed,
+                G_TYPE_STRV, allowed,
+                G_TYPE_INVALID));
+    g_hash_table_unref(fixed);
+    GHashTable *capabilities = g_hash_table_new(NULL, NULL);
+    g_hash_table_insert(capabilities, GUINT_TO_POINTER(handle), caps);
+    tp_tests_contacts_connection_change_capabilities(mConnService, capabilities);
+    g_hash_table_destroy(capabilities);
+    g_boxed_free(TP_ARRAY_TYPE_REQUESTABLE_CHANNEL_CLASS_LIST, caps);
+
+    GPtrArray *info = (GPtrArray *) dbus_g_type_specialized_construct(
+            TP_ARRAY_TYPE_CONTACT_INFO_FIELD_LIST);
+    const gchar * const fieldValues[] = { "Dora", NULL };
+    g_ptr_array_add(info, tp_value_array_build(3,
+                G_TYPE_STRING, "n",
+                G_TYPE_STRV, NULL,
+                G_TYPE_STRV, fieldValues,
+                G_TYPE_INVALID));
+    tp_tests_contacts_connection_change_contact_info(mConnService, handle, info);
+    g_boxed_free(TP_ARRAY_TYPE_CONTACT_INFO_FIELD_LIST, info);
+
+    const gchar *clientTypes[] = { "phone", NULL };
+    tp_tests_contacts_connection_change_client_types(mConnService, handle,
+            g_strdupv((gchar **) clientTypes));
+
+    // The roster attributes arrive with the contact list, before the roster becomes ready
+    TestContactListManager *listManager =
+        tp_tests_contacts_connection_get_contact_list_manager(mConnService);
+    test_contact_list_manager_request_subscription(listManager, 1, &handle, "Hi");
+    test_contact_list_manager_authorize_publication(listManager, 1, &handle);
+    test_contact_list_manager_add_to_group(listManager, "Explorers", handle);
+
+    Features connFeatures = Features()
+        << Connection::FeatureRoster
+        << Connection::FeatureRosterGroups;
+    QVERIFY(connect(mConn->becomeReady(connFeatures),
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mConn->isReady(connFeatures), true);
+
+    PendingContacts *pending = mConn->contactManager()->contactsForIdentifiers(
+            QStringList() << QLatin1String("dora"), features);
+    QVERIFY(connect(pending,
+                SIGNAL(finished(Tp::PendingOperation*)),
+                SLOT(expectPendingContactsFinished(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    QCOMPARE(mContacts.size(), 1);
+    ContactPtr contact = mContacts[0];
+    QCOMPARE(contact->handle()[0], handle);
+    QVERIFY((features - contact->actualFeatures()).isEmpty());
+
+    QCOMPARE(contact->id(), QString(QLatin1String("dora")));
+    QCOMPARE(contact->alias(), QString(QLatin1String(aliases[0])));
+    QVERIFY(contact->isAvatarTokenKnown());
+    QCOMPARE(contact->avatarToken(), QString(QLatin1String(tokens[0])));
+    QCOMPARE(contact->presence().status(), QString(QLatin1String("busy")));
+    QCOMPARE(contact->presence().statusMessage(), QString(QLatin1String(messages[0])));
+    QCOMPARE(contact->capabilities().textChats(), true);
+    QCOMPARE(contact->location().country(), QString(QLatin1String("Atlantis")));
+    QCOMPARE(contact->infoFields().allFields().size(), 1);
+    QCOMPARE(contact->infoFields().allFields()[0].fieldName, QString(QLatin1String("n")));
+    QCOMPARE(contact->infoFields().allFields()[0].fieldValue[0], QString(QLatin1String("Dora")));
+    QCOMPARE(contact->clientTypes(), QStringList() << QLatin1String("phone"));
+    QCOMPARE(contact->subscriptionState(), Contact::PresenceStateAsk);
+    QCOMPARE(contact->publishState(), Contact::PresenceStateYes);
+    QCOMPARE(contact->groups(), QStringList() << QLatin1String("Explorers"));
+
+    mContacts.clear();
+    mLoop->processEvents();
+    processDBusQueue(mConn.data());
+}
+
 void TestContacts::testSelfContactFallback()
 {
     gchar *name;
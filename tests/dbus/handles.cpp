@@ -32,6 +32,7 @@ private Q_SLOTS:
     void init();
 
     void testRequestAndRelease();
+    void testUnknownHandleType();
 
     void cleanup();
     void cleanupTestCase();
@@ -111,6 +112,41 @@ void TestHandles::testRequestAndRelease()
     processDBusQueue(mConn->client().data());
 }
 
+void TestHandles::testUnknownHandleType()
+{
+    HandleType unknownType = static_cast<HandleType>(NUM_HANDLE_TYPES + 1);
+
+    // Handle types outside the known range are not tracked, and are left to the CM to reject
+    PendingHandles *pending = mConn->client()->lowlevel()->requestHandles(unknownType,
+            QStringList() << QLatin1String("alice"));
+    QVERIFY(connect(pending,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectPendingHandlesFinished(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(mHandles.isEmpty());
+    QVERIFY(pending->invalidNames().contains(QLatin1String("alice")));
+
+    pending = mConn->client()->lowlevel()->referenceHandles(unknownType, UIntList() << 1);
+    QVERIFY(connect(pending,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectPendingHandlesFinished(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QVERIFY(mHandles.isEmpty());
+    QCOMPARE(pending->invalidHandles(), UIntList() << 1);
+
+    // Handles of known types are still tracked afterwards
+    pending = mConn->client()->lowlevel()->requestHandles(Tp::HandleTypeContact,
+            QStringList() << QLatin1String("alice"));
+    QVERIFY(connect(pending,
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectPendingHandlesFinished(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    QCOMPARE(mHandles.size(), 1);
+    mHandles = ReferencedHandles();
+    mLoop->processEvents();
+    processDBusQueue(mConn->client().data());
+}
+
 void TestHandles::cleanup()
 {
     cleanupImpl();
@@ -6,9 +6,12 @@
 
 #define TP_QT_ENABLE_LOWLEVEL_API
 
+#include <TelepathyQt/ChannelFactory>
 #include <TelepathyQt/Connection>
 #include <TelepathyQt/ConnectionLowlevel>
+#include <TelepathyQt/ContactFactory>
 #include <TelepathyQt/ContactManager>
+#include <TelepathyQt/DBusMetrics>
 #include <TelepathyQt/PendingChannel>
 #include <TelepathyQt/PendingContacts>
 #include <TelepathyQt/PendingReady>
@@ -18,6 +21,22 @@
 
 using namespace Tp;
 
+namespace
+{
+
+uint outgoingCallCount(const QString &interfaceName, const QString &memberName)
+{
+    Q_FOREACH (const DBusMetrics::Entry &entry, DBusMetrics::entries()) {
+        if (entry.kind() == DBusMetrics::OutgoingCall &&
+                entry.interfaceName() == interfaceName && entry.memberName() == memberName) {
+            return entry.count();
+        }
+    }
+    return 0;
+}
+
+}
+
 class TestStreamedMediaChan : public Test
 {
     Q_OBJECT
@@ -90,11 +109,15 @@ private Q_SLOTS:
     void testHoldInabilityUnhold();
     void testDTMF();
     void testDTMFNoContinuousTone();
+    void testStreamContacts();
+    void testInvalidStreamContact();
 
     void cleanup();
     void cleanupTestCase();
 
 private:
+    void requestStreamsBeforeIntrospection(const Tp::ContactPtr &contact);
+
     TestConnHelper *mConn;
     StreamedMediaChannelPtr mChan;
     QList<ContactPtr> mContacts;
@@ -1346,6 +1369,120 @@ void TestStreamedMediaChan::testDTMFNoContinuousTone()
     QCOMPARE(mLoop->exec(), 1);
 }
 
+void TestStreamedMediaChan::requestStreamsBeforeIntrospection(const Tp::ContactPtr &contact)
+{
+    QVERIFY(connect(mChan->becomeReady(),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+
+    // Request the streams directly, so that they are all listed by ListStreams when
+    // FeatureStreams is introspected
+    Client::ChannelTypeStreamedMediaInterface *streamedMediaInterface =
+        mChan->interface<Client::ChannelTypeStreamedMediaInterface>();
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+            streamedMediaInterface->RequestStreams(contact->handle()[0],
+                UIntList() << MediaStreamTypeAudio << MediaStreamTypeVideo), this);
+    QVERIFY(connect(watcher,
+                    SIGNAL(finished(QDBusPendingCallWatcher*)),
+                    SLOT(expectSuccessfulCall(QDBusPendingCallWatcher*))));
+    QCOMPARE(mLoop->exec(), 0);
+    processDBusQueue(mChan.data());
+}
+
+void TestStreamedMediaChan::testStreamContacts()
+{
+    // Features are added to the contact factory once the channel contacts are built, so that
+    // resolving the stream contacts needs a contacts request
+    ContactFactoryPtr contactFactory = ContactFactory::create();
+    TestConnHelper *conn = new TestConnHelper(this,
+            ChannelFactory::create(QDBusConnection::sessionBus()),
+            contactFactory,
+            EXAMPLE_TYPE_CALLABLE_CONNECTION,
+            "account", "streams@example.com",
+            "protocol", "example",
+            "simulation-delay", 1,
+            NULL);
+    QCOMPARE(conn->connect(Connection::FeatureSelfContact), true);
+
+    // This identifier contains the magic string (no answer), which means the example
+    // will never answer, so that the group members don't change behind our back
+    mContacts = conn->contacts(QStringList() << QLatin1String("alice (no answer)"));
+    QCOMPARE(mContacts.size(), 1);
+    ContactPtr otherContact = mContacts.first();
+
+    mChan = StreamedMediaChannelPtr::qObjectCast(
+            conn->createChannel(TP_QT_IFACE_CHANNEL_TYPE_STREAMED_MEDIA, otherContact));
+    QVERIFY(mChan);
+    requestStreamsBeforeIntrospection(otherContact);
+
+    contactFactory->addFeature(Contact::FeatureSimplePresence);
+    DBusMetrics::reset();
+    DBusMetrics::setEnabled(true);
+
+    QVERIFY(connect(mChan->becomeReady(StreamedMediaChannel::FeatureStreams),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    processDBusQueue(mChan.data());
+
+    QCOMPARE(mChan->streams().size(), 2);
+    Q_FOREACH (const StreamedMediaStreamPtr &stream, mChan->streams()) {
+        QCOMPARE(stream->contact(), otherContact);
+    }
+
+    // The contacts of both streams were resolved with a single contacts request
+    QCOMPARE(outgoingCallCount(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS,
+                QLatin1String("GetContactAttributes")), 1u);
+    QVERIFY(otherContact->actualFeatures().contains(Contact::FeatureSimplePresence));
+
+    DBusMetrics::setEnabled(false);
+    DBusMetrics::reset();
+
+    mChan.reset();
+    mContacts.clear();
+    QCOMPARE(conn->disconnect(), true);
+    delete conn;
+}
+
+void TestStreamedMediaChan::testInvalidStreamContact()
+{
+    // This identifier also contains the magic string (invalid video contact), which means the
+    // example will announce the video streams with an invalid contact handle
+    mContacts = mConn->contacts(QStringList() <<
+            QLatin1String("dave (no answer) (invalid video contact)"));
+    QCOMPARE(mContacts.size(), 1);
+    ContactPtr otherContact = mContacts.first();
+
+    mChan = StreamedMediaChannelPtr::qObjectCast(
+            mConn->createChannel(TP_QT_IFACE_CHANNEL_TYPE_STREAMED_MEDIA, otherContact));
+    QVERIFY(mChan);
+    requestStreamsBeforeIntrospection(otherContact);
+
+    DBusMetrics::reset();
+    DBusMetrics::setEnabled(true);
+
+    // The video stream fails to become ready, but FeatureStreams doesn't
+    QVERIFY(connect(mChan->becomeReady(StreamedMediaChannel::FeatureStreams),
+                    SIGNAL(finished(Tp::PendingOperation*)),
+                    SLOT(expectSuccessfulCall(Tp::PendingOperation*))));
+    QCOMPARE(mLoop->exec(), 0);
+    processDBusQueue(mChan.data());
+
+    // Even though both stream contacts were resolved with the same request, the audio stream
+    // still got its contact
+    QCOMPARE(outgoingCallCount(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACTS,
+                QLatin1String("GetContactAttributes")), 1u);
+    QCOMPARE(mChan->streams().size(), 1);
+    StreamedMediaStreamPtr stream = mChan->streams().first();
+    QCOMPARE(stream->type(), MediaStreamTypeAudio);
+    QCOMPARE(stream->contact(), otherContact);
+    QCOMPARE(mChan->streamsForType(MediaStreamTypeVideo).size(), 0);
+
+    DBusMetrics::setEnabled(false);
+    DBusMetrics::reset();
+}
+
 void TestStreamedMediaChan::cleanup()
 {
     mChan.reset();
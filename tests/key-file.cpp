@@ -56,9 +56,22 @@ void TestKeyFile::testKeyFile()
     QCOMPARE(keyFile.contains(QLatin1String("e")), true);
     QCOMPARE(keyFile.value(QLatin1String("e")), QString(QLatin1String("space")));
 
+    keyFile.setGroup(QLatin1String("test group 1"));
+    QCOMPARE(keyFile.rawValue(QLatin1String("c")), QString(QLatin1String("\\s\\t\\n\\r\\\\")));
+    QCOMPARE(keyFile.value(QLatin1String("c")), QString(QLatin1String(" \t\n\r\\")));
+    QCOMPARE(keyFile.value(QLatin1String("c")), QString(QLatin1String(" \t\n\r\\")));
+    QCOMPARE(keyFile.rawValue(QLatin1String("f")), QString());
+
+    // copies keep working after the original moves on to another file
+    KeyFile copiedKeyFile(keyFile);
+
     keyFile.setFileName(QLatin1String("telepathy/managers/test-manager-file.manager"));
     QCOMPARE(keyFile.status(), KeyFile::NoError);
 
+    QCOMPARE(copiedKeyFile.group(), QString(QLatin1String("test group 1")));
+    QCOMPARE(copiedKeyFile.value(QLatin1String("d")), QString(QLatin1String("true")));
+    QCOMPARE(copiedKeyFile.value(QLatin1String("c")), QString(QLatin1String(" \t\n\r\\")));
+
     keyFile.setGroup(QLatin1String("Protocol somewhat-pathological"));
     QCOMPARE(keyFile.value(QLatin1String("param-foo")), QString(QLatin1String("s required")));
     QCOMPARE(keyFile.value(QLatin1String("default-foo")), QString(QLatin1String("hello world")));
@@ -1034,6 +1034,9 @@ example_callable_media_channel_add_stream (ExampleCallableMediaChannel *self,
                                            gboolean locally_requested)
 {
   ExampleCallableMediaStream *stream;
+  TpHandleRepoIface *contact_repo = tp_base_connection_get_handles
+      (self->priv->conn, TP_HANDLE_TYPE_CONTACT);
+  TpHandle handle = self->priv->handle;
   guint id = self->priv->next_stream_id++;
   guint state, direction, pending_send;
 
@@ -1043,10 +1046,20 @@ example_callable_media_channel_add_stream (ExampleCallableMediaChannel *self,
           media_type == TP_MEDIA_STREAM_TYPE_AUDIO ? "audio" : "video");
     }
 
+  /* If the contact's ID contains the magic string "(invalid video contact)",
+   * simulate a broken CM which announces video streams with a contact handle
+   * that was never valid. */
+  if (media_type == TP_MEDIA_STREAM_TYPE_VIDEO &&
+      strstr (tp_handle_inspect (contact_repo, self->priv->handle),
+          "(invalid video contact)") != NULL)
+    {
+      handle = 0xdeadbeef;
+    }
+
   stream = g_object_new (EXAMPLE_TYPE_CALLABLE_MEDIA_STREAM,
       "channel", self,
       "id", id,
-      "handle", self->priv->handle,
+      "handle", handle,
       "type", media_type,
       "locally-requested", locally_requested,
       "simulation-delay", self->priv->simulation_delay,
@@ -1055,7 +1068,7 @@ example_callable_media_channel_add_stream (ExampleCallableMediaChannel *self,
   g_hash_table_insert (self->priv->streams, GUINT_TO_POINTER (id), stream);
 
   tp_svc_channel_type_streamed_media_emit_stream_added (self, id,
-      self->priv->handle, media_type);
+      handle, media_type);
 
   g_object_get (stream,
       "state", &state,
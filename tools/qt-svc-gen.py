@@ -122,6 +122,7 @@ class Generator(object):
 
             self.b("""\
 #include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusMetrics>
 #include <TelepathyQt/MethodInvocationContext>
 
 """)
@@ -155,6 +156,7 @@ namespace %s
         name = ifacenode.getAttribute('name').replace('/', '').replace('_', '') + 'Adaptor'
         iface, = get_by_path(ifacenode, 'interface')
         dbusname = iface.getAttribute('name')
+        self.dbusname = dbusname
         props = get_by_path(iface, 'property')
         methods = get_by_path(iface, 'method')
         signals = get_by_path(iface, 'signal')
@@ -207,6 +209,11 @@ public:
 
         self.do_signals_connect(signals)
 
+        if signals:
+            self.b("""\
+    Tp::DBusMetrics::trackAdaptorSignals(this);
+""")
+
         self.b("""\
 }
 
@@ -603,10 +610,14 @@ void %(ifacename)s::%(settername)s(const %(type)s &newValue)
         self.b("""
 %(rettype)s %(ifacename)s::%(name)s(%(params)s)
 {
+    Tp::DBusMetrics::CallScope metricsScope(QLatin1String("%(dbusname)s"), QLatin1String("%(name)s"));
+
     if (adaptee()->metaObject()->indexOfMethod("%(adaptee_name)s(%(normalized_adaptee_params)s)") < 0) {
+        metricsScope.setError();
         dbusConnection().send(dbusMessage.createErrorReply(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Not implemented")));
 """ % {'rettype': rettype,
        'ifacename': ifacename,
+       'dbusname': self.dbusname,
        'name': name,
        'adaptee_name': adaptee_name,
        'normalized_adaptee_params': normalized_adaptee_params,